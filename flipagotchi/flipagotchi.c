@@ -4,28 +4,183 @@
 #include <furi_hal.h>
 
 
-static bool flipagotchi_custom_event_callback(void* context, uint32_t event) {
-  furi_assert(context);
-  FlipagotchiApp* app = context;
-  return scene_manager_handle_custom_event(app->scene_manager, event);
-}
-
 static bool flipagotchi_back_event_callback(void* context) {
   furi_assert(context);
   FlipagotchiApp* app = context;
   return scene_manager_handle_back_event(app->scene_manager);
 }
 
-static void flipagotchi_tick_event_callback(void* context) {
+/**
+ * Snapshot a unit's model to the sd card if it changed since the last snapshot
+ *
+ * @param app FlipagotchiApp to save
+ * @param unit Unit whose model to save
+ * @param force Save even if the last snapshot is more recent than FLIPAGOTCHI_STATE_SAVE_INTERVAL_MS
+ */
+static void flipagotchi_save_state(FlipagotchiApp* app, uint8_t unit, bool force) {
+    FlipagotchiUnit* saved = &app->units[unit];
+    uint32_t now = furi_get_tick();
+    if(!force &&
+       now - saved->saved_state_tick < furi_ms_to_ticks(FLIPAGOTCHI_STATE_SAVE_INTERVAL_MS)) {
+        return;
+    }
+    saved->saved_state_tick = now;
+
+    // encode under the lock, the sd card write happens after it is released
+    uint8_t* buf = FLIPAGOTCHI_DIAG_MALLOC(FlipagotchiDiagHeapApp, FLIPAGOTCHI_STATE_MAX_SIZE);
+    uint32_t state_hash = 0;
+    size_t len = 0;
+    with_view_model(
+        pwnagotchi_get_view(saved->pwnagotchi),
+        PwnagotchiModel * model,
+        {
+            state_hash = flipagotchi_state_hash(model);
+            len = flipagotchi_state_encode(model, buf);
+        },
+        false);
+
+    if(state_hash == saved->saved_state_hash) {
+        FLIPAGOTCHI_DIAG_FREE(FlipagotchiDiagHeapApp, buf);
+        return;
+    }
+
+    if(flipagotchi_state_write(buf, len, unit)) {
+        saved->saved_state_hash = state_hash;
+    }
+    FLIPAGOTCHI_DIAG_FREE(FlipagotchiDiagHeapApp, buf);
+}
+
+/**
+ * Stop or start everything periodic, on the app thread
+ */
+static void flipagotchi_set_idle(FlipagotchiApp* app, bool idle) {
+    if(idle) {
+        furi_timer_stop(app->tick_timer);
+        // nothing saves the models while idle
+        for(uint8_t unit = 0; unit < app->unit_count; unit++) {
+            flipagotchi_save_state(app, unit, true);
+        }
+        if(app->power_settings.backlight == FlipagotchiPowerBacklightDim) {
+            static const NotificationMessage dim = {
+                .type = NotificationMessageTypeLedDisplayBacklight,
+                .data.led.value = FLIPAGOTCHI_POWER_DIM_LEVEL,
+            };
+            static const NotificationSequence sequence_dim = {&dim, NULL};
+            notification_message(app->notifications, &sequence_dim);
+        } else {
+            notification_message(app->notifications, &sequence_display_backlight_off);
+        }
+    } else {
+        notification_message(app->notifications, &sequence_display_backlight_on);
+        furi_timer_start(app->tick_timer, furi_ms_to_ticks(FLIPAGOTCHI_APP_TICK_MS));
+    }
+    for(uint8_t unit = 0; unit < app->unit_count; unit++) {
+        flipagotchi_uart_set_idle(app->units[unit].flipagotchi_uart, idle);
+    }
+}
+
+static void flipagotchi_tick(FlipagotchiApp* app) {
+    app->tick_pending = false;
+    for(uint8_t unit = 0; unit < app->unit_count; unit++) {
+        flipagotchi_save_state(app, unit, false);
+    }
+    scene_manager_handle_tick_event(app->scene_manager);
+    if(flipagotchi_power_check(app->power)) {
+        flipagotchi_set_idle(app, true);
+    }
+}
+
+static void flipagotchi_wake(FlipagotchiApp* app) {
+    if(flipagotchi_power_activity(app->power)) {
+        flipagotchi_set_idle(app, false);
+    }
+}
+
+static bool flipagotchi_custom_event_callback(void* context, uint32_t event) {
   furi_assert(context);
   FlipagotchiApp* app = context;
-  scene_manager_handle_tick_event(app->scene_manager);
+  if(event == FlipagotchiCustomEventTick) {
+    flipagotchi_tick(app);
+    return true;
+  }
+  if(event == FlipagotchiCustomEventWake) {
+    flipagotchi_wake(app);
+    return true;
+  }
+  return scene_manager_handle_custom_event(app->scene_manager, event);
+}
+
+static void flipagotchi_tick_timer_callback(void* context) {
+    FlipagotchiApp* app = context;
+    // one tick in the queue at a time, a busy app thread doesn't pile them up
+    if(!app->tick_pending) {
+        app->tick_pending = true;
+        view_dispatcher_send_custom_event(app->view_dispatcher, FlipagotchiCustomEventTick);
+    }
+}
+
+static void flipagotchi_input_callback(const void* message, void* context) {
+    const InputEvent* event = message;
+    FlipagotchiApp* app = context;
+    if(event->type == InputTypePress) {
+        view_dispatcher_send_custom_event(app->view_dispatcher, FlipagotchiCustomEventWake);
+    }
+}
+
+static void flipagotchi_uart_wake_callback(void* context) {
+    FlipagotchiApp* app = context;
+    view_dispatcher_send_custom_event(app->view_dispatcher, FlipagotchiCustomEventWake);
+}
+
+void flipagotchi_app_show_unit(FlipagotchiApp* app, uint8_t unit) {
+    furi_assert(unit < app->unit_count);
+    app->unit = unit;
+    app->flipagotchi_uart = app->units[unit].flipagotchi_uart;
+    app->pwnagotchi = app->units[unit].pwnagotchi;
+}
+
+/**
+ * Start a unit's screen, restored from its state file, and its link
+ */
+static void flipagotchi_unit_alloc(FlipagotchiApp* app, uint8_t unit) {
+    FlipagotchiUnit* started = &app->units[unit];
+
+    started->pwnagotchi = pwnagotchi_alloc(app->arena);
+    // show the last known state until the pwnagotchi tells us otherwise
+    with_view_model(
+        pwnagotchi_get_view(started->pwnagotchi),
+        PwnagotchiModel * model,
+        {
+            if(flipagotchi_state_load(model, unit)) {
+                FURI_LOG_I("PWN", "restored last known state of unit %u", (unsigned)unit);
+            }
+            // a layout on the sd card replaces the built in one
+            flipagotchi_layout_load(model);
+            started->saved_state_hash = flipagotchi_state_hash(model);
+        },
+        false);
+    started->saved_state_tick = furi_get_tick();
+    view_dispatcher_add_view(
+        app->view_dispatcher,
+        FlipagotchiAppViewPwnagotchi + unit,
+        pwnagotchi_get_view(started->pwnagotchi));
 }
 
 static FlipagotchiApp* flipagotchi_app_alloc() {
     FURI_LOG_I("PWN", "starting alloc");
-    // Self
-    FlipagotchiApp* app = malloc(sizeof(FlipagotchiApp));
+    // gui callbacks run on our own thread, watch it like the workers
+    flipagotchi_diag_thread_add("app", furi_thread_get_current_id(), FLIPAGOTCHI_APP_STACK_SIZE);
+    // what to talk over, it decides how many units the arena has room for
+    FlipagotchiTransportConfig transport;
+    flipagotchi_transport_settings_load(&transport);
+    // Self, everything long lived is carved out of one allocation made up front
+    FlipagotchiArena* arena = flipagotchi_arena_alloc(FLIPAGOTCHI_ARENA_SIZE(transport.units));
+    FlipagotchiApp* app = flipagotchi_arena_carve(arena, FlipagotchiDiagHeapApp, sizeof(FlipagotchiApp));
+    app->arena = arena;
+    app->transport = transport;
+    app->unit_count = transport.units;
+    flipagotchi_power_settings_load(&app->power_settings);
+    app->power = flipagotchi_power_alloc(app->arena, &app->power_settings);
 
     // Gui
     FURI_LOG_I("PWN", "alloc gui");
@@ -46,8 +201,9 @@ static FlipagotchiApp* flipagotchi_app_alloc() {
                                               app->view_dispatcher, flipagotchi_custom_event_callback);
     view_dispatcher_set_navigation_event_callback(
                                                   app->view_dispatcher, flipagotchi_back_event_callback);
-    view_dispatcher_set_tick_event_callback(
-                                            app->view_dispatcher, flipagotchi_tick_event_callback, 100);
+    // a timer instead of the dispatcher's own tick, which can't be stopped while idle
+    app->tick_timer =
+        furi_timer_alloc(flipagotchi_tick_timer_callback, FuriTimerTypePeriodic, app);
 
     view_dispatcher_attach_to_gui(app->view_dispatcher, app->gui, ViewDispatcherTypeFullscreen);
 
@@ -60,17 +216,57 @@ static FlipagotchiApp* flipagotchi_app_alloc() {
     view_dispatcher_add_view(
                              app->view_dispatcher, FlipagotchiAppViewExitConfirm, dialog_ex_get_view(app->dialog));
 
-    app->pwnagotchi = pwnagotchi_alloc();
+    for(uint8_t unit = 0; unit < app->unit_count; unit++) {
+        flipagotchi_unit_alloc(app, unit);
+    }
+
+    app->widget = widget_alloc();
+    view_dispatcher_add_view(
+                             app->view_dispatcher, FlipagotchiAppViewWidget, widget_get_view(app->widget));
+
+    app->handshake_list = handshake_list_alloc(app->arena);
+    view_dispatcher_add_view(
+        app->view_dispatcher, FlipagotchiAppViewHandshakes, handshake_list_get_view(app->handshake_list));
+
+    app->peer_list = peer_list_alloc(app->arena);
     view_dispatcher_add_view(
-                             app->view_dispatcher, FlipagotchiAppViewPwnagotchi, pwnagotchi_get_view(app->pwnagotchi));
+        app->view_dispatcher, FlipagotchiAppViewPeers, peer_list_get_view(app->peer_list));
+
+    app->submenu = submenu_alloc();
+    view_dispatcher_add_view(
+        app->view_dispatcher, FlipagotchiAppViewControl, submenu_get_view(app->submenu));
+
+    app->variable_item_list = variable_item_list_alloc();
+    view_dispatcher_add_view(
+        app->view_dispatcher,
+        FlipagotchiAppViewSettings,
+        variable_item_list_get_view(app->variable_item_list));
+
+    // Uart handlers, over whatever was picked in the settings last time
+    for(uint8_t unit = 0; unit < app->unit_count; unit++) {
+        app->units[unit].flipagotchi_uart = flipagotchi_uart_alloc(
+            app->arena, app->units[unit].pwnagotchi, unit, &app->transport.unit[unit]);
+    }
+    flipagotchi_app_show_unit(app, 0);
+
+    // anything that wakes the app up, the tick takes it from there
+    for(uint8_t unit = 0; unit < app->unit_count; unit++) {
+        flipagotchi_uart_set_wake_callback(
+            app->units[unit].flipagotchi_uart, flipagotchi_uart_wake_callback, app);
+    }
+    app->input_events = furi_record_open(RECORD_INPUT_EVENTS);
+    app->input_subscription =
+        furi_pubsub_subscribe(app->input_events, flipagotchi_input_callback, app);
+    furi_timer_start(app->tick_timer, furi_ms_to_ticks(FLIPAGOTCHI_APP_TICK_MS));
 
     // Start Scene Manager
     scene_manager_next_scene(app->scene_manager, FlipagotchiScenePwnagotchi);
 
-    // Uart handler
-    app->flipagotchi_uart = flipagotchi_uart_alloc();
-
-    FURI_LOG_I("PWN", "ALLC'd");
+    FURI_LOG_I(
+        "PWN",
+        "ALLC'd, %u of %u arena bytes carved",
+        (unsigned)flipagotchi_arena_get_used(app->arena),
+        (unsigned)flipagotchi_arena_get_size(app->arena));
 
     return app;
 }
@@ -79,16 +275,46 @@ static void flipagotchi_app_free(FlipagotchiApp* app) {
     FURI_LOG_I("PWN", "freeing!");
     furi_assert(app);
 
-    // Uart HAndler
-    flipagotchi_uart_free(app->flipagotchi_uart);
+    // final numbers, while the workers are still around to be sampled
+    flipagotchi_diag_log("exit");
+
+    furi_pubsub_unsubscribe(app->input_events, app->input_subscription);
+    furi_record_close(RECORD_INPUT_EVENTS);
+    furi_timer_stop(app->tick_timer);
+    furi_timer_free(app->tick_timer);
+    // leave the backlight as the rest of the system expects it
+    if(flipagotchi_power_is_idle(app->power)) {
+        notification_message(app->notifications, &sequence_display_backlight_on);
+    }
+
+    for(uint8_t unit = 0; unit < app->unit_count; unit++) {
+        // Uart HAndler
+        flipagotchi_uart_set_wake_callback(app->units[unit].flipagotchi_uart, NULL, NULL);
+        flipagotchi_uart_free(app->units[unit].flipagotchi_uart);
+
+        // the model won't change anymore, keep it for next time
+        flipagotchi_save_state(app, unit, true);
+    }
 
     FURI_LOG_I("PWN", "free views");
 
     // Views
-    view_dispatcher_remove_view(app->view_dispatcher, FlipagotchiAppViewPwnagotchi);
+    for(uint8_t unit = 0; unit < app->unit_count; unit++) {
+        view_dispatcher_remove_view(app->view_dispatcher, FlipagotchiAppViewPwnagotchi + unit);
+        pwnagotchi_free(app->units[unit].pwnagotchi);
+    }
     view_dispatcher_remove_view(app->view_dispatcher, FlipagotchiAppViewExitConfirm);
-    pwnagotchi_free(app->pwnagotchi);
+    view_dispatcher_remove_view(app->view_dispatcher, FlipagotchiAppViewWidget);
+    view_dispatcher_remove_view(app->view_dispatcher, FlipagotchiAppViewHandshakes);
+    view_dispatcher_remove_view(app->view_dispatcher, FlipagotchiAppViewPeers);
+    view_dispatcher_remove_view(app->view_dispatcher, FlipagotchiAppViewControl);
+    view_dispatcher_remove_view(app->view_dispatcher, FlipagotchiAppViewSettings);
+    handshake_list_free(app->handshake_list);
+    peer_list_free(app->peer_list);
     dialog_ex_free(app->dialog);
+    submenu_free(app->submenu);
+    variable_item_list_free(app->variable_item_list);
+    widget_free(app->widget);
     // View dispatcher
     view_dispatcher_free(app->view_dispatcher);
 
@@ -101,8 +327,10 @@ static void flipagotchi_app_free(FlipagotchiApp* app) {
     // Notifications
     furi_record_close(RECORD_NOTIFICATION);
 
-    // Self
-    free(app);
+    flipagotchi_diag_thread_remove(furi_thread_get_current_id());
+
+    // Self, and everything else carved out of the arena with it
+    flipagotchi_arena_free(app->arena);
 }
 
 int32_t flipagotchi_app(void* p) {
@@ -2,9 +2,10 @@
 
 #include "flipagotchi_app.h"
 #include "scenes/flipagotchi_scene.h"
-#include "flipagotchi_uart.h"
+#include "flipagotchi_uart_i.h"
 
 #include <gui/gui.h>
+#include <input/input.h>
 #include <gui/view_dispatcher.h>
 #include <gui/scene_manager.h>
 #include <gui/modules/submenu.h>
@@ -13,20 +14,128 @@
 #include <gui/modules/widget.h>
 #include <gui/modules/dialog_ex.h>
 #include "views/pwnagotchi.h"
+#include "views/handshake_list.h"
+#include "views/peer_list.h"
+#include "flipagotchi_diag.h"
+#include "flipagotchi_arena.h"
+#include "flipagotchi_state.h"
+#include "flipagotchi_power_i.h"
+#include "flipagotchi_layout.h"
 #include <assets_icons.h>
 
+/// Stack of the app thread, which also runs the gui callbacks, must match stack_size in application.fam
+/// 576 B of its own while restoring the state on start, see flipagotchi_diag.h
+#define FLIPAGOTCHI_APP_STACK_SIZE (2 * 1024)
+
+/// Period of the app's tick while awake, it stops while idle
+#define FLIPAGOTCHI_APP_TICK_MS 100
+
+/**
+ * One pwnagotchi the app talks to, each has its own link, workers, screen and state file
+ */
+typedef struct {
+    FlipagotchiUart* flipagotchi_uart;
+    Pwnagotchi* pwnagotchi;
+    // state hash of the last snapshot on the sd card, and when it was written
+    uint32_t saved_state_hash;
+    uint32_t saved_state_tick;
+} FlipagotchiUnit;
+
 struct FlipagotchiApp {
+    FlipagotchiArena* arena;
     Gui* gui;
     NotificationApp* notifications;
     ViewDispatcher* view_dispatcher;
     SceneManager* scene_manager;
     Widget* widget;
     DialogEx* dialog;
+    Submenu* submenu;
+    VariableItemList* variable_item_list;
+    // the first unit_count are running, that many stay until the app starts again
+    FlipagotchiUnit units[FLIPAGOTCHI_UNITS_MAX];
+    uint8_t unit_count;
+    // unit on screen, the scenes go through flipagotchi_uart and pwnagotchi which point at its
+    uint8_t unit;
     FlipagotchiUart* flipagotchi_uart;
     Pwnagotchi* pwnagotchi;
+    // what the units were last told to talk over, saved when the settings scene is left
+    FlipagotchiTransportConfig transport;
+    HandshakeList* handshake_list;
+    PeerList* peer_list;
+    // idle mode, the tick drives everything periodic and is stopped while idle. tick_pending keeps
+    // the timer from queueing ticks the app thread hasn't got to yet
+    FlipagotchiPower* power;
+    FlipagotchiPowerSettings power_settings;
+    FuriTimer* tick_timer;
+    volatile bool tick_pending;
+    FuriPubSub* input_events;
+    FuriPubSubSubscription* input_subscription;
+    // control scene: mode shown before the last switch, to go back to if it fails, the status the
+    // header last showed, and when a reboot or shutdown was last pressed
+    enum PwnagotchiMode control_previous_mode;
+    FlipagotchiControlStatus control_shown;
+    uint32_t control_armed_tick;
+    char control_header[24];
+    // settings scene: transports this build has in the order they are listed, and the rate item
+    FlipagotchiTransportId settings_transports[FlipagotchiTransportNum];
+    VariableItem* settings_rate_item;
 };
 
+/**
+ * Put a unit on screen, the scenes opened from here on talk to it
+ *
+ * @param app App to switch
+ * @param unit One of the running units
+ */
+void flipagotchi_app_show_unit(FlipagotchiApp* app, uint8_t unit);
+
 typedef enum {
+    /// Each unit's screen, FlipagotchiAppViewPwnagotchi + unit
     FlipagotchiAppViewPwnagotchi,
-    FlipagotchiAppViewExitConfirm,
+    FlipagotchiAppViewExitConfirm = FlipagotchiAppViewPwnagotchi + FLIPAGOTCHI_UNITS_MAX,
+    FlipagotchiAppViewWidget,
+    FlipagotchiAppViewHandshakes,
+    FlipagotchiAppViewPeers,
+    FlipagotchiAppViewControl,
+    FlipagotchiAppViewSettings,
 } FlipagotchiAppView;
+
+/// Size of the arena all long lived app state is carved from, grows with every module that carves
+#define FLIPAGOTCHI_ARENA_SIZE(units)                                   \
+    (FLIPAGOTCHI_ARENA_ALIGN(sizeof(FlipagotchiApp)) +                  \
+     (units) * (FLIPAGOTCHI_UART_ARENA_SIZE + PWNAGOTCHI_ARENA_SIZE) + \
+     HANDSHAKE_LIST_ARENA_SIZE + PEER_LIST_ARENA_SIZE + FLIPAGOTCHI_POWER_ARENA_SIZE)
+
+typedef enum {
+    /// Open the diagnostics screen
+    FlipagotchiCustomEventDiagnostics,
+    /// Re-sample the diagnostics and write them to the SD log
+    FlipagotchiCustomEventDiagnosticsLog,
+    /// Open the handshake browser
+    FlipagotchiCustomEventHandshakes,
+    /// The handshake browser's cursor moved
+    FlipagotchiCustomEventHandshakesMoved,
+    /// A page of handshakes came in
+    FlipagotchiCustomEventHandshakesPage,
+    /// Open the peer list
+    FlipagotchiCustomEventPeers,
+    /// Open the controls
+    FlipagotchiCustomEventControl,
+    /// The pwnagotchi answered a command
+    FlipagotchiCustomEventControlReply,
+    /// Control menu items, each sends the event that is its index
+    FlipagotchiCustomEventControlManual,
+    FlipagotchiCustomEventControlAuto,
+    FlipagotchiCustomEventControlAi,
+    FlipagotchiCustomEventControlReboot,
+    FlipagotchiCustomEventControlShutdown,
+    FlipagotchiCustomEventControlSettings,
+    FlipagotchiCustomEventControlUnits,
+    /// Units summary buttons, each puts the unit that is its offset from the first on screen
+    FlipagotchiCustomEventUnitsPickFirst,
+    FlipagotchiCustomEventUnitsPickSecond,
+    /// The app's tick, handled before the scenes get a look
+    FlipagotchiCustomEventTick,
+    /// A key press or news from a pwnagotchi, wakes an idle app up
+    FlipagotchiCustomEventWake,
+} FlipagotchiCustomEvent;
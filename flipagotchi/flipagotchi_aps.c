@@ -0,0 +1,159 @@
+#include "flipagotchi_aps.h"
+
+#include <string.h>
+
+#include "protocol.h"
+
+#define FNV_OFFSET_BASIS 2166136261UL
+#define FNV_PRIME 16777619UL
+
+#define FLIPAGOTCHI_APS_SLOT_MASK (PWNAGOTCHI_AP_SLOTS - 1)
+
+_Static_assert(
+    (PWNAGOTCHI_AP_SLOTS & FLIPAGOTCHI_APS_SLOT_MASK) == 0,
+    "PWNAGOTCHI_AP_SLOTS must be a power of two");
+_Static_assert(
+    PWNAGOTCHI_AP_SLOTS > PWNAGOTCHI_MAX_APS,
+    "every probe has to end at a free slot");
+_Static_assert(PWNAGOTCHI_MAX_APS < UINT8_MAX, "slots hold an index plus one in a byte");
+_Static_assert(
+    AP_SSID_MAX_LEN < PWNAGOTCHI_MAX_AP_SSID_LEN,
+    "the longest ssid a record carries has to fit with its terminator");
+
+/**
+ * Slot a bssid's probe run starts at
+ */
+static size_t flipagotchi_aps_home(const uint8_t* bssid) {
+    uint32_t hash = FNV_OFFSET_BASIS;
+    for(size_t i = 0; i < PWNAGOTCHI_BSSID_LEN; i++) {
+        hash ^= bssid[i];
+        hash *= FNV_PRIME;
+    }
+    return hash & FLIPAGOTCHI_APS_SLOT_MASK;
+}
+
+/**
+ * Find the slot holding a bssid
+ *
+ * @param slot Where the slot goes, or the free slot the probe run ended at
+ * @return If the table has the bssid
+ */
+static bool
+    flipagotchi_aps_probe(const PwnagotchiApTable* table, const uint8_t* bssid, size_t* slot) {
+    size_t i = flipagotchi_aps_home(bssid);
+    while(table->slots[i] != 0) {
+        if(memcmp(table->aps[table->slots[i] - 1].bssid, bssid, PWNAGOTCHI_BSSID_LEN) == 0) {
+            *slot = i;
+            return true;
+        }
+        i = (i + 1) & FLIPAGOTCHI_APS_SLOT_MASK;
+    }
+    *slot = i;
+    return false;
+}
+
+static void flipagotchi_aps_place(PwnagotchiApTable* table, size_t rank, uint8_t index) {
+    table->order[rank] = index;
+    table->rank[index] = rank;
+}
+
+/**
+ * Move the access point at rank to where its signal puts it, the rest stay in order
+ *
+ * Only the one access point changed, so this is a single pass of insertion sort. Equal signals
+ * keep the order they had, so a list that didn't really change doesn't shuffle on screen
+ */
+static void flipagotchi_aps_resort(PwnagotchiApTable* table, size_t rank) {
+    uint8_t index = table->order[rank];
+    int8_t rssi = table->aps[index].rssi;
+    while(rank > 0 && table->aps[table->order[rank - 1]].rssi < rssi) {
+        flipagotchi_aps_place(table, rank, table->order[rank - 1]);
+        rank--;
+    }
+    while(rank + 1 < table->count && table->aps[table->order[rank + 1]].rssi > rssi) {
+        flipagotchi_aps_place(table, rank, table->order[rank + 1]);
+        rank++;
+    }
+    flipagotchi_aps_place(table, rank, index);
+}
+
+void flipagotchi_aps_clear(PwnagotchiApTable* table) {
+    furi_assert(table);
+    memset(table, 0, sizeof(PwnagotchiApTable));
+}
+
+const PwnagotchiAp* flipagotchi_aps_find(const PwnagotchiApTable* table, const uint8_t* bssid) {
+    furi_assert(table);
+    size_t slot;
+    if(!flipagotchi_aps_probe(table, bssid, &slot)) {
+        return NULL;
+    }
+    return &table->aps[table->slots[slot] - 1];
+}
+
+bool flipagotchi_aps_set(PwnagotchiApTable* table, const PwnagotchiAp* ap) {
+    furi_assert(table);
+    size_t slot;
+    if(flipagotchi_aps_probe(table, ap->bssid, &slot)) {
+        uint8_t index = table->slots[slot] - 1;
+        table->aps[index] = *ap;
+        flipagotchi_aps_resort(table, table->rank[index]);
+        return true;
+    }
+
+    if(table->count >= PWNAGOTCHI_MAX_APS) {
+        return false;
+    }
+    uint8_t index = table->count++;
+    table->aps[index] = *ap;
+    table->slots[slot] = index + 1;
+    // in at the weak end, then up to where it belongs
+    flipagotchi_aps_place(table, index, index);
+    flipagotchi_aps_resort(table, index);
+    return true;
+}
+
+bool flipagotchi_aps_evict(PwnagotchiApTable* table, const uint8_t* bssid) {
+    furi_assert(table);
+    size_t slot;
+    if(!flipagotchi_aps_probe(table, bssid, &slot)) {
+        return false;
+    }
+    uint8_t index = table->slots[slot] - 1;
+
+    // out of the signal index, everything weaker moves up one
+    for(size_t rank = table->rank[index]; rank + 1 < table->count; rank++) {
+        flipagotchi_aps_place(table, rank, table->order[rank + 1]);
+    }
+
+    // shift the rest of the probe run back over the hole, anything whose home isn't between the
+    // hole and where it sits now can move into it
+    size_t hole = slot;
+    for(size_t i = (slot + 1) & FLIPAGOTCHI_APS_SLOT_MASK; table->slots[i] != 0;
+        i = (i + 1) & FLIPAGOTCHI_APS_SLOT_MASK) {
+        size_t home = flipagotchi_aps_home(table->aps[table->slots[i] - 1].bssid);
+        if(((i - home) & FLIPAGOTCHI_APS_SLOT_MASK) >= ((i - hole) & FLIPAGOTCHI_APS_SLOT_MASK)) {
+            table->slots[hole] = table->slots[i];
+            hole = i;
+        }
+    }
+    table->slots[hole] = 0;
+
+    // the last access point moves into the freed place so the used ones stay in front
+    uint8_t last = --table->count;
+    if(index != last) {
+        table->aps[index] = table->aps[last];
+        size_t last_slot;
+        flipagotchi_aps_probe(table, table->aps[index].bssid, &last_slot);
+        table->slots[last_slot] = index + 1;
+        flipagotchi_aps_place(table, table->rank[last], index);
+    }
+    memset(&table->aps[last], 0, sizeof(PwnagotchiAp));
+    return true;
+}
+
+const PwnagotchiAp* flipagotchi_aps_get(const PwnagotchiApTable* table, size_t rank) {
+    furi_assert(table);
+    furi_assert(rank < table->count);
+    return &table->aps[table->order[rank]];
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <furi.h>
+
+#include "views/pwnagotchi.h"
+
+/*
+ * Table of the access points in range of the pwnagotchi
+ *
+ * The pwnagotchi sends only what changed in bettercap's list: access points that showed up or
+ * changed with FLIPPER_CMD_AP_SET and ones that went away with FLIPPER_CMD_AP_EVICT. It keeps to the
+ * strongest PWNAGOTCHI_MAX_APS, so the table never has to make room by itself and an insert into a
+ * full table is refused.
+ *
+ * Lookups go through an open addressing index on the bssid hash with linear probing, removals shift
+ * the rest of a probe run back so there are no tombstones. The list page draws from an index by
+ * signal that is kept sorted as access points come, go and change, by moving just the one that
+ * changed.
+ */
+
+/**
+ * Empty the table
+ *
+ * @param table Table to empty, the caller holds the model lock
+ */
+void flipagotchi_aps_clear(PwnagotchiApTable* table);
+
+/**
+ * Look an access point up by bssid
+ *
+ * @param table Table to look in
+ * @param bssid PWNAGOTCHI_BSSID_LEN bytes
+ * @return The access point, NULL if the table doesn't have it
+ */
+const PwnagotchiAp* flipagotchi_aps_find(const PwnagotchiApTable* table, const uint8_t* bssid);
+
+/**
+ * Add an access point or replace the one with the same bssid
+ *
+ * @param table Table to update, the caller holds the model lock
+ * @param ap Access point to store
+ * @return If it was stored, false for a new access point when the table is full
+ */
+bool flipagotchi_aps_set(PwnagotchiApTable* table, const PwnagotchiAp* ap);
+
+/**
+ * Drop an access point
+ *
+ * @param table Table to update, the caller holds the model lock
+ * @param bssid PWNAGOTCHI_BSSID_LEN bytes
+ * @return If the table had it
+ */
+bool flipagotchi_aps_evict(PwnagotchiApTable* table, const uint8_t* bssid);
+
+/**
+ * Get an access point by signal
+ *
+ * @param table Table to read
+ * @param rank 0 for the strongest, below the table's count
+ * @return The access point
+ */
+const PwnagotchiAp* flipagotchi_aps_get(const PwnagotchiApTable* table, size_t rank);
@@ -0,0 +1,51 @@
+#include "flipagotchi_arena.h"
+
+struct FlipagotchiArena {
+    size_t size;
+    size_t used;
+    // bytes carved per subsystem, handed back to diagnostics when the arena goes
+    size_t carved[FlipagotchiDiagHeapNum];
+    // carves start here, the header is padded so they stay aligned
+    _Alignas(FLIPAGOTCHI_ARENA_ALIGNMENT) uint8_t memory[];
+};
+
+FlipagotchiArena* flipagotchi_arena_alloc(size_t size) {
+    FlipagotchiArena* arena = malloc(sizeof(FlipagotchiArena) + size);
+    arena->size = size;
+    arena->used = 0;
+    memset(arena->carved, 0, sizeof(arena->carved));
+    FURI_LOG_I("PWN", "arena of %u bytes", (unsigned)size);
+    return arena;
+}
+
+void flipagotchi_arena_free(FlipagotchiArena* arena) {
+    furi_assert(arena);
+    for(size_t i = 0; i < FlipagotchiDiagHeapNum; i++) {
+        flipagotchi_diag_heap_account(i, -(int32_t)arena->carved[i]);
+    }
+    free(arena);
+}
+
+void* flipagotchi_arena_carve(FlipagotchiArena* arena, FlipagotchiDiagHeap heap, size_t size) {
+    furi_assert(arena);
+    size_t aligned = FLIPAGOTCHI_ARENA_ALIGN(size);
+    furi_check(aligned <= arena->size - arena->used);
+
+    void* carve = arena->memory + arena->used;
+    arena->used += aligned;
+    memset(carve, 0, aligned);
+    arena->carved[heap] += aligned;
+    flipagotchi_diag_heap_account(heap, aligned);
+
+    return carve;
+}
+
+size_t flipagotchi_arena_get_used(FlipagotchiArena* arena) {
+    furi_assert(arena);
+    return arena->used;
+}
+
+size_t flipagotchi_arena_get_size(FlipagotchiArena* arena) {
+    furi_assert(arena);
+    return arena->size;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <furi.h>
+
+#include "flipagotchi_diag.h"
+
+/*
+ * All long lived app state is carved out of one allocation made at startup, sized at compile
+ * time by adding up the *_ARENA_SIZE of every module. Nothing carved is ever freed on its own,
+ * the whole arena goes at once when the app exits.
+ */
+
+/// Alignment of every carve, enough for any member of the structs we place
+#define FLIPAGOTCHI_ARENA_ALIGNMENT 8
+
+/// Round a size up to the arena alignment, use it when adding up a module's *_ARENA_SIZE
+#define FLIPAGOTCHI_ARENA_ALIGN(size) \
+    (((size) + FLIPAGOTCHI_ARENA_ALIGNMENT - 1) & ~(size_t)(FLIPAGOTCHI_ARENA_ALIGNMENT - 1))
+
+typedef struct FlipagotchiArena FlipagotchiArena;
+
+/**
+ * Make the one allocation the arena lives in
+ *
+ * @param size Bytes available for carving, the sum of the *_ARENA_SIZE of everything that goes in
+ * @return Pointer to the new arena
+ */
+FlipagotchiArena* flipagotchi_arena_alloc(size_t size);
+
+/**
+ * Free the arena and everything carved out of it
+ *
+ * @param arena Arena to free
+ */
+void flipagotchi_arena_free(FlipagotchiArena* arena);
+
+/**
+ * Carve zeroed memory out of the arena
+ *
+ * @note Running out of arena is a sizing bug, this crashes rather than returning NULL
+ *
+ * @param arena Arena to carve from
+ * @param heap Subsystem the memory is accounted to in diagnostics builds
+ * @param size Bytes needed
+ * @return Pointer to the memory, aligned to FLIPAGOTCHI_ARENA_ALIGNMENT
+ */
+void* flipagotchi_arena_carve(FlipagotchiArena* arena, FlipagotchiDiagHeap heap, size_t size);
+
+/**
+ * Get how many bytes of the arena are carved
+ *
+ * @param arena Arena to check
+ * @return Bytes in use
+ */
+size_t flipagotchi_arena_get_used(FlipagotchiArena* arena);
+
+/**
+ * Get the size the arena was allocated with
+ *
+ * @param arena Arena to check
+ * @return Bytes available for carving in total
+ */
+size_t flipagotchi_arena_get_size(FlipagotchiArena* arena);
@@ -0,0 +1,83 @@
+#include "flipagotchi_channels.h"
+
+#include <string.h>
+
+/// Decay steps after which every counter is 0 whatever it held, a step takes at least 1 off
+#define FLIPAGOTCHI_CHANNELS_FORGET_STEPS 512
+
+static const uint8_t flipagotchi_channels_5ghz[PWNAGOTCHI_CHANNEL_SLOTS_5GHZ] = {
+    36,  40,  44,  48,  52,  56,  60,  64,  100, 104, 108, 112, 116,
+    120, 124, 128, 132, 136, 140, 144, 149, 153, 157, 161, 165,
+};
+
+_Static_assert(
+    FLIPAGOTCHI_CHANNELS_DECAY_SHIFT > 0 && FLIPAGOTCHI_CHANNELS_DECAY_SHIFT < 32,
+    "a decay step has to take off part of a counter");
+
+void flipagotchi_channels_clear(PwnagotchiChannelTable* table, uint32_t now) {
+    furi_assert(table);
+    memset(table->heat, 0, sizeof(table->heat));
+    table->decay_tick = now;
+}
+
+int flipagotchi_channels_slot(uint8_t channel) {
+    if(channel >= 1 && channel <= PWNAGOTCHI_CHANNEL_SLOTS_2GHZ) {
+        return channel - 1;
+    }
+    for(size_t i = 0; i < PWNAGOTCHI_CHANNEL_SLOTS_5GHZ; i++) {
+        if(flipagotchi_channels_5ghz[i] == channel) {
+            return PWNAGOTCHI_CHANNEL_SLOTS_2GHZ + i;
+        }
+    }
+    return -1;
+}
+
+uint8_t flipagotchi_channels_number(size_t slot) {
+    furi_assert(slot < PWNAGOTCHI_CHANNEL_SLOTS);
+    if(slot < PWNAGOTCHI_CHANNEL_SLOTS_2GHZ) {
+        return slot + 1;
+    }
+    return flipagotchi_channels_5ghz[slot - PWNAGOTCHI_CHANNEL_SLOTS_2GHZ];
+}
+
+bool flipagotchi_channels_decay(PwnagotchiChannelTable* table, uint32_t now) {
+    furi_assert(table);
+    uint32_t period = furi_ms_to_ticks(FLIPAGOTCHI_CHANNELS_DECAY_MS);
+    uint32_t steps = (now - table->decay_tick) / period;
+    if(steps == 0) {
+        return false;
+    }
+    // whole steps only, the rest of the period carries over
+    table->decay_tick += steps * period;
+
+    bool changed = false;
+    uint32_t* heat = &table->heat[0][0];
+    for(size_t i = 0; i < PwnagotchiHeatNum * PWNAGOTCHI_CHANNEL_SLOTS; i++) {
+        if(heat[i] == 0) {
+            continue;
+        }
+        changed = true;
+        if(steps >= FLIPAGOTCHI_CHANNELS_FORGET_STEPS) {
+            heat[i] = 0;
+            continue;
+        }
+        for(uint32_t step = 0; step < steps && heat[i] != 0; step++) {
+            // at least 1 off, so a small counter gets to 0 instead of sticking under the shift
+            heat[i] -= MAX(heat[i] >> FLIPAGOTCHI_CHANNELS_DECAY_SHIFT, (uint32_t)1);
+        }
+    }
+    return changed;
+}
+
+void flipagotchi_channels_add(
+    PwnagotchiChannelTable* table,
+    size_t slot,
+    PwnagotchiHeat heat,
+    uint32_t count) {
+    furi_assert(table);
+    furi_assert(slot < PWNAGOTCHI_CHANNEL_SLOTS);
+    furi_assert(heat < PwnagotchiHeatNum);
+    uint32_t* counter = &table->heat[heat][slot];
+    uint32_t room = (UINT32_MAX - *counter) >> FLIPAGOTCHI_CHANNELS_FRACTION_BITS;
+    *counter += MIN(count, room) << FLIPAGOTCHI_CHANNELS_FRACTION_BITS;
+}
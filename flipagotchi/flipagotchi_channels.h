@@ -0,0 +1,74 @@
+#pragma once
+
+#include <furi.h>
+
+#include "views/pwnagotchi.h"
+
+/*
+ * Activity per wifi channel for the heatmap page
+ *
+ * The pwnagotchi batches what it saw on each channel since its last FLIPPER_CMD_CHANNEL_STATS and
+ * sends it at most once a second, only for channels that saw anything. Every count is added to a
+ * counter that loses 1/2^FLIPAGOTCHI_CHANNELS_DECAY_SHIFT of itself every FLIPAGOTCHI_CHANNELS_DECAY_MS,
+ * so the heatmap shows recent activity without the flipper keeping any history. It is all integer
+ * math on fixed arrays: the counters are fixed point with FLIPAGOTCHI_CHANNELS_FRACTION_BITS.
+ *
+ * Channels 1 to 14 take the first PWNAGOTCHI_CHANNEL_SLOTS_2GHZ slots, the 20 MHz 5 GHz channels from
+ * 36 to 165 the rest. Counts for any other channel are dropped.
+ */
+
+/// Fractional bits of the counters
+#define FLIPAGOTCHI_CHANNELS_FRACTION_BITS 4
+
+/// Time between decay steps
+#define FLIPAGOTCHI_CHANNELS_DECAY_MS 1000
+
+/// A decay step takes 1/2^this off every counter, 4 halves a counter in about 11 steps
+#define FLIPAGOTCHI_CHANNELS_DECAY_SHIFT 4
+
+/**
+ * Empty the heatmap
+ *
+ * @param table Table to empty, the caller holds the model lock
+ * @param now Tick decay counts from
+ */
+void flipagotchi_channels_clear(PwnagotchiChannelTable* table, uint32_t now);
+
+/**
+ * Slot of a channel
+ *
+ * @param channel Channel number
+ * @return Slot, -1 for a channel the heatmap doesn't keep
+ */
+int flipagotchi_channels_slot(uint8_t channel);
+
+/**
+ * Channel of a slot
+ *
+ * @param slot Below PWNAGOTCHI_CHANNEL_SLOTS
+ * @return Channel number
+ */
+uint8_t flipagotchi_channels_number(size_t slot);
+
+/**
+ * Take the decay steps due since the last one
+ *
+ * @param table Table to decay, the caller holds the model lock
+ * @param now Current tick
+ * @return If any counter changed
+ */
+bool flipagotchi_channels_decay(PwnagotchiChannelTable* table, uint32_t now);
+
+/**
+ * Add to a channel's counter, saturating
+ *
+ * @param table Table to update, the caller holds the model lock
+ * @param slot From flipagotchi_channels_slot
+ * @param heat Counter to add to
+ * @param count Whole count to add
+ */
+void flipagotchi_channels_add(
+    PwnagotchiChannelTable* table,
+    size_t slot,
+    PwnagotchiHeat heat,
+    uint32_t count);
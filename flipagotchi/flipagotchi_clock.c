@@ -0,0 +1,212 @@
+#include "flipagotchi_clock_i.h"
+
+#include <furi_hal_rtc.h>
+
+/**
+ * Milliseconds since alloc, the caller holds the mutex
+ */
+static int64_t flipagotchi_clock_uptime_ms(FlipagotchiClock* clock) {
+    uint32_t now = furi_get_tick();
+    clock->ticks += now - clock->last_tick;
+    clock->last_tick = now;
+    return (int64_t)(clock->ticks * 1000 / furi_ms_to_ticks(1000));
+}
+
+static bool flipagotchi_clock_settled(FlipagotchiClock* clock) {
+    return clock->anchored && clock->base_hi - clock->base_lo <= FLIPAGOTCHI_CLOCK_PRECISION_MS;
+}
+
+/**
+ * Ticks until the rtc is worth reading again, the caller holds the mutex
+ */
+static uint32_t flipagotchi_clock_window(FlipagotchiClock* clock) {
+    int64_t width = clock->base_hi - clock->base_lo;
+    if(!clock->anchored || width >= 999) {
+        return 1;
+    }
+    // the rtc's second turns over between phase 0 and phase width, it is read every tick in there
+    int64_t phase = (clock->base_hi + flipagotchi_clock_uptime_ms(clock)) % 1000;
+    if(phase < 0) {
+        phase += 1000;
+    }
+    return phase <= width ? 1 : furi_ms_to_ticks(1000 - phase);
+}
+
+/**
+ * Read the rtc and narrow down where its seconds turn over, the caller holds the mutex
+ */
+static void flipagotchi_clock_sample(FlipagotchiClock* clock) {
+    int64_t uptime = flipagotchi_clock_uptime_ms(clock);
+    int64_t lo = (int64_t)furi_hal_rtc_get_timestamp() * 1000 - uptime;
+    int64_t hi = lo + 999;
+    int64_t width = clock->base_hi - clock->base_lo;
+
+    if(!clock->anchored || lo > clock->base_hi + FLIPAGOTCHI_CLOCK_JUMP_MS ||
+       hi < clock->base_lo - FLIPAGOTCHI_CLOCK_JUMP_MS) {
+        if(clock->anchored) {
+            FURI_LOG_W("PWN", "rtc was set, timing its seconds again");
+        }
+        clock->base_lo = lo;
+        clock->base_hi = hi;
+        clock->anchored = true;
+    } else if(lo > clock->base_hi) {
+        // the tick fell behind the rtc, follow it
+        clock->base_lo = lo;
+        clock->base_hi = MIN(lo + width, hi);
+    } else if(hi < clock->base_lo) {
+        clock->base_hi = hi;
+        clock->base_lo = MAX(hi - width, lo);
+    } else {
+        clock->base_lo = MAX(clock->base_lo, lo);
+        clock->base_hi = MIN(clock->base_hi, hi);
+    }
+    if(flipagotchi_clock_settled(clock)) {
+        clock->settled_ms = uptime;
+    }
+}
+
+/**
+ * Allow for the tick drifting from the rtc since it was last pinned down, and for at least enough
+ * to unsettle it. The caller holds the mutex
+ */
+static void flipagotchi_clock_widen(FlipagotchiClock* clock) {
+    int64_t elapsed = flipagotchi_clock_uptime_ms(clock) - clock->settled_ms;
+    int64_t margin =
+        elapsed * FLIPAGOTCHI_CLOCK_DRIFT_PPM / 1000000 + FLIPAGOTCHI_CLOCK_PRECISION_MS;
+    clock->base_lo -= margin;
+    clock->base_hi += margin;
+}
+
+static uint64_t flipagotchi_clock_now_ms(FlipagotchiClock* clock) {
+    int64_t base = clock->base_lo + (clock->base_hi - clock->base_lo) / 2;
+    return (uint64_t)(base + flipagotchi_clock_uptime_ms(clock));
+}
+
+/**
+ * Send the time and the last round trip, the caller holds the mutex
+ */
+static void flipagotchi_clock_probe(FlipagotchiClock* clock, uint32_t now) {
+    uint8_t msg[CLOCK_SET_TIME_HEX_LEN + CLOCK_SET_RTT_HEX_LEN + 3] = {
+        PACKET_START, PWN_CMD_CLOCK_SET};
+    char hex[CLOCK_SET_TIME_HEX_LEN + CLOCK_SET_RTT_HEX_LEN + 1];
+    uint64_t t1 = flipagotchi_clock_now_ms(clock);
+    snprintf(hex, sizeof(hex), "%012llx%04x", (unsigned long long)t1, clock->rtt_ms);
+    memcpy(&msg[2], hex, CLOCK_SET_TIME_HEX_LEN + CLOCK_SET_RTT_HEX_LEN);
+    msg[sizeof(msg) - 1] = PACKET_END;
+
+    // timed from before it is queued, like the commands
+    if(flipagotchi_uart_tx(clock->flip_uart, msg, sizeof(msg))) {
+        // logged with the tick so the flipper's log lines up with the pwnagotchi's
+        FURI_LOG_I(
+            "PWN", "clock %llu ms at tick %lu", (unsigned long long)t1, (unsigned long)now);
+        clock->pending = true;
+        clock->sent_tick = now;
+        clock->rtt_ms = FLIPAGOTCHI_CLOCK_NO_RTT;
+        clock->probes++;
+    }
+
+    uint32_t delay = clock->period_ms;
+    if(clock->fast_probes > 0) {
+        clock->fast_probes--;
+        delay = FLIPAGOTCHI_CLOCK_FAST_PERIOD_MS;
+    }
+    clock->next_probe_tick = now + furi_ms_to_ticks(delay);
+}
+
+FlipagotchiClock* flipagotchi_clock_alloc(FlipagotchiArena* arena, FlipagotchiUart* flip_uart) {
+    // comes back zeroed, not anchored to the rtc and not probing
+    FlipagotchiClock* clock =
+        flipagotchi_arena_carve(arena, FlipagotchiDiagHeapUart, sizeof(FlipagotchiClock));
+    clock->flip_uart = flip_uart;
+    clock->mutex = furi_mutex_alloc(FuriMutexTypeNormal);
+    clock->last_tick = furi_get_tick();
+    clock->period_ms = FLIPAGOTCHI_CLOCK_PERIOD_MS;
+    clock->rtt_ms = FLIPAGOTCHI_CLOCK_NO_RTT;
+    clock->last_rtt_ms = FLIPAGOTCHI_CLOCK_NO_RTT;
+    return clock;
+}
+
+void flipagotchi_clock_free(FlipagotchiClock* clock) {
+    furi_assert(clock);
+    furi_mutex_free(clock->mutex);
+    clock->mutex = NULL;
+}
+
+void flipagotchi_clock_start(FlipagotchiClock* clock) {
+    furi_assert(clock);
+    furi_mutex_acquire(clock->mutex, FuriWaitForever);
+    // the first one goes out as soon as the rtc's seconds are pinned down
+    clock->running = true;
+    clock->fast_probes = FLIPAGOTCHI_CLOCK_FAST_PROBES;
+    clock->next_probe_tick = furi_get_tick();
+    clock->pending = false;
+    clock->rtt_ms = FLIPAGOTCHI_CLOCK_NO_RTT;
+    furi_mutex_release(clock->mutex);
+}
+
+void flipagotchi_clock_stop(FlipagotchiClock* clock) {
+    furi_assert(clock);
+    furi_mutex_acquire(clock->mutex, FuriWaitForever);
+    clock->running = false;
+    clock->pending = false;
+    furi_mutex_release(clock->mutex);
+}
+
+uint32_t flipagotchi_clock_tick(FlipagotchiClock* clock) {
+    furi_assert(clock);
+    furi_mutex_acquire(clock->mutex, FuriWaitForever);
+    uint32_t now = furi_get_tick();
+    bool due = clock->running && (int32_t)(clock->next_probe_tick - now) <= 0;
+    uint32_t timeout = FuriWaitForever;
+
+    if(due && flipagotchi_clock_settled(clock) && !clock->rechecked) {
+        // the tick drifts from the rtc, find the turn of its second again before the probe
+        flipagotchi_clock_widen(clock);
+        clock->rechecked = true;
+    }
+    if(!flipagotchi_clock_settled(clock)) {
+        flipagotchi_clock_sample(clock);
+    }
+    if(!flipagotchi_clock_settled(clock)) {
+        timeout = flipagotchi_clock_window(clock);
+    } else if(clock->running) {
+        if(due) {
+            flipagotchi_clock_probe(clock, now);
+            clock->rechecked = false;
+        }
+        timeout = clock->next_probe_tick - now;
+    }
+    furi_mutex_release(clock->mutex);
+    return timeout;
+}
+
+void flipagotchi_clock_reply(FlipagotchiClock* clock, bool acked) {
+    furi_assert(clock);
+    furi_mutex_acquire(clock->mutex, FuriWaitForever);
+    if(clock->pending) {
+        clock->pending = false;
+        if(acked) {
+            uint32_t rtt = (furi_get_tick() - clock->sent_tick) * 1000 / furi_ms_to_ticks(1000);
+            clock->rtt_ms = MIN(rtt, FLIPAGOTCHI_CLOCK_NO_RTT - 1U);
+            clock->last_rtt_ms = clock->rtt_ms;
+        }
+    }
+    furi_mutex_release(clock->mutex);
+}
+
+void flipagotchi_clock_get(FlipagotchiClock* clock, FlipagotchiClockInfo* info) {
+    furi_assert(clock);
+    furi_mutex_acquire(clock->mutex, FuriWaitForever);
+    info->now_ms = clock->anchored ? flipagotchi_clock_now_ms(clock) : 0;
+    info->precision_ms = clock->anchored ? (uint32_t)(clock->base_hi - clock->base_lo) : 0;
+    info->probes = clock->probes;
+    info->rtt_ms = clock->last_rtt_ms;
+    furi_mutex_release(clock->mutex);
+}
+
+void flipagotchi_clock_set_period(FlipagotchiClock* clock, uint32_t period_ms) {
+    furi_assert(clock);
+    furi_mutex_acquire(clock->mutex, FuriWaitForever);
+    clock->period_ms = period_ms;
+    furi_mutex_release(clock->mutex);
+}
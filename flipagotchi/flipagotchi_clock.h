@@ -0,0 +1,114 @@
+#pragma once
+
+#include <furi.h>
+
+#include "protocol.h"
+#include "flipagotchi_arena.h"
+
+/*
+ * The flipper's rtc time, sent to the pwnagotchi so it can set its own clock, which it has no
+ * hardware for
+ *
+ * The rtc only counts whole seconds, the tick fills in the milliseconds. Every read of the rtc
+ * narrows down where its seconds turn over relative to the tick, until that is known to within
+ * FLIPAGOTCHI_CLOCK_PRECISION_MS the rtc is read every tick around where the next one could be,
+ * which takes at most a second.
+ *
+ * Once the link is up a PWN_CMD_CLOCK_SET probe carries the time it went out and the round trip of
+ * the probe before it, FLIPAGOTCHI_CLOCK_FAST_PROBES of them a second apart and then one every
+ * FLIPAGOTCHI_CLOCK_PERIOD_MS. The pwnagotchi answers each with an ACK carrying the command's code
+ * and works out the offset and drift of its clock from them, NTP style.
+ */
+
+/// How well the rtc's second boundaries have to be known before the time goes out
+#define FLIPAGOTCHI_CLOCK_PRECISION_MS 2
+/// Most the tick and the rtc are expected to drift apart, in parts per million. Before each probe
+/// the rtc is read every tick around where its second should turn over, give or take that much
+#define FLIPAGOTCHI_CLOCK_DRIFT_PPM 500
+/// A read of the rtc further than this off the estimate means the rtc was set, start over
+#define FLIPAGOTCHI_CLOCK_JUMP_MS 1000
+/// Probes right after the link comes up, to give the pwnagotchi a few samples quickly
+#define FLIPAGOTCHI_CLOCK_FAST_PROBES 4
+/// Time between those
+#define FLIPAGOTCHI_CLOCK_FAST_PERIOD_MS 1000
+/// Time between probes after them, each is 23 bytes on the wire with its ack
+#define FLIPAGOTCHI_CLOCK_PERIOD_MS 60000
+/// Round trip a probe carries when the one before it wasn't answered
+#define FLIPAGOTCHI_CLOCK_NO_RTT 0xffff
+
+/**
+ * What the flipper knows about its clock
+ */
+typedef struct {
+    /// Milliseconds since the epoch by the rtc, 0 until the rtc was read
+    uint64_t now_ms;
+    /// How far off now_ms can be from the rtc
+    uint32_t precision_ms;
+    /// Probes sent since the uart was allocated
+    uint32_t probes;
+    /// Round trip of the last answered probe in milliseconds, FLIPAGOTCHI_CLOCK_NO_RTT if none was
+    uint16_t rtt_ms;
+} FlipagotchiClockInfo;
+
+typedef struct FlipagotchiClock FlipagotchiClock;
+
+struct FlipagotchiUart;
+
+/**
+ * Carve the clock out of the arena
+ *
+ * @param arena Arena to carve from, FLIPAGOTCHI_CLOCK_ARENA_SIZE of it is used
+ * @param flip_uart Uart the probes go out on
+ * @return Pointer to the clock
+ */
+FlipagotchiClock*
+    flipagotchi_clock_alloc(FlipagotchiArena* arena, struct FlipagotchiUart* flip_uart);
+
+void flipagotchi_clock_free(FlipagotchiClock* clock);
+
+/**
+ * Start probing, called from the io worker when the link comes up
+ *
+ * @param clock Clock
+ */
+void flipagotchi_clock_start(FlipagotchiClock* clock);
+
+/**
+ * Stop probing, called from the io worker when the link is lost
+ *
+ * @param clock Clock
+ */
+void flipagotchi_clock_stop(FlipagotchiClock* clock);
+
+/**
+ * Read the rtc while its seconds aren't pinned down yet and send a probe when one is due, called
+ * from the io worker
+ *
+ * @param clock Clock
+ * @return Ticks until it needs to run again
+ */
+uint32_t flipagotchi_clock_tick(FlipagotchiClock* clock);
+
+/**
+ * Take an ACK or NAK carrying PWN_CMD_CLOCK_SET, called from the io worker
+ *
+ * @param clock Clock
+ * @param acked If it was an ACK
+ */
+void flipagotchi_clock_reply(FlipagotchiClock* clock, bool acked);
+
+/**
+ * Get the time and how the probes are going
+ *
+ * @param clock Clock
+ * @param info Where the info goes
+ */
+void flipagotchi_clock_get(FlipagotchiClock* clock, FlipagotchiClockInfo* info);
+
+/**
+ * Change the time between probes once the fast ones are out
+ *
+ * @param clock Clock
+ * @param period_ms Milliseconds between probes, FLIPAGOTCHI_CLOCK_PERIOD_MS by default
+ */
+void flipagotchi_clock_set_period(FlipagotchiClock* clock, uint32_t period_ms);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "flipagotchi_clock.h"
+#include "flipagotchi_uart.h"
+
+struct FlipagotchiClock {
+    FlipagotchiUart* flip_uart;
+
+    // written by the io worker and read by whoever wants the time, only touched under the mutex
+    FuriMutex* mutex;
+    // ticks since alloc, extended past the 32 bits of a tick
+    uint64_t ticks;
+    uint32_t last_tick;
+    // rtc milliseconds minus milliseconds since alloc lie within [base_lo, base_hi]
+    int64_t base_lo;
+    int64_t base_hi;
+    bool anchored;
+    // milliseconds since alloc when they were last pinned down, and if they were again for the
+    // probe that is due
+    int64_t settled_ms;
+    bool rechecked;
+
+    bool running;
+    uint32_t period_ms;
+    uint32_t fast_probes;
+    uint32_t next_probe_tick;
+    // the last probe, waiting for its ack
+    bool pending;
+    uint32_t sent_tick;
+    // round trip the next probe carries
+    uint16_t rtt_ms;
+    uint16_t last_rtt_ms;
+    uint32_t probes;
+};
+
+/// Arena space flipagotchi_clock_alloc carves
+#define FLIPAGOTCHI_CLOCK_ARENA_SIZE FLIPAGOTCHI_ARENA_ALIGN(sizeof(FlipagotchiClock))
@@ -0,0 +1,104 @@
+#include "flipagotchi_control_i.h"
+
+static uint32_t flipagotchi_control_elapsed_ms(uint32_t since) {
+    return (furi_get_tick() - since) * 1000 / furi_ms_to_ticks(1000);
+}
+
+/**
+ * Give up on a command that went unanswered for too long, the caller holds the mutex
+ */
+static void flipagotchi_control_check_timeout(FlipagotchiControl* control) {
+    if(control->result.status == FlipagotchiControlPending &&
+       flipagotchi_control_elapsed_ms(control->sent_tick) >= FLIPAGOTCHI_CONTROL_TIMEOUT_MS) {
+        FURI_LOG_W("PWN", "command %02X timed out", control->result.cmd);
+        control->result.status = FlipagotchiControlTimedOut;
+    }
+}
+
+FlipagotchiControl* flipagotchi_control_alloc(FlipagotchiArena* arena, FlipagotchiUart* flip_uart) {
+    // comes back zeroed, idle
+    FlipagotchiControl* control =
+        flipagotchi_arena_carve(arena, FlipagotchiDiagHeapUart, sizeof(FlipagotchiControl));
+    control->flip_uart = flip_uart;
+    control->mutex = furi_mutex_alloc(FuriMutexTypeNormal);
+    return control;
+}
+
+void flipagotchi_control_free(FlipagotchiControl* control) {
+    furi_assert(control);
+    furi_mutex_free(control->mutex);
+    control->mutex = NULL;
+}
+
+void flipagotchi_control_set_callback(
+    FlipagotchiControl* control,
+    FlipagotchiControlCallback callback,
+    void* context) {
+    furi_assert(control);
+    furi_mutex_acquire(control->mutex, FuriWaitForever);
+    control->callback = callback;
+    control->context = context;
+    furi_mutex_release(control->mutex);
+}
+
+bool flipagotchi_control_send(FlipagotchiControl* control, uint8_t cmd, uint8_t arg) {
+    furi_assert(control);
+    uint8_t msg[] = {PACKET_START, cmd, arg, PACKET_END};
+    size_t len = sizeof(msg);
+    if(arg == 0) {
+        // no body
+        msg[2] = PACKET_END;
+        len--;
+    }
+
+    furi_mutex_acquire(control->mutex, FuriWaitForever);
+    flipagotchi_control_check_timeout(control);
+    bool sent = control->result.status != FlipagotchiControlPending;
+    if(sent) {
+        // timed from before it is queued, the wait behind other packets counts
+        control->sent_tick = furi_get_tick();
+        sent = flipagotchi_uart_tx(control->flip_uart, msg, len);
+    }
+    if(sent) {
+        FURI_LOG_I("PWN", "sent command %02X %02X", cmd, arg);
+        control->result.status = FlipagotchiControlPending;
+        control->result.cmd = cmd;
+        control->result.arg = arg;
+        control->result.rtt_ms = 0;
+    }
+    furi_mutex_release(control->mutex);
+    return sent;
+}
+
+void flipagotchi_control_get(FlipagotchiControl* control, FlipagotchiControlResult* result) {
+    furi_assert(control);
+    furi_mutex_acquire(control->mutex, FuriWaitForever);
+    flipagotchi_control_check_timeout(control);
+    *result = control->result;
+    furi_mutex_release(control->mutex);
+}
+
+void flipagotchi_control_reply(FlipagotchiControl* control, uint8_t cmd, bool acked) {
+    furi_assert(control);
+    furi_mutex_acquire(control->mutex, FuriWaitForever);
+    // a late reply to a command that already timed out changes nothing, the user was told
+    bool answered = control->result.status == FlipagotchiControlPending &&
+                    control->result.cmd == cmd;
+    if(answered) {
+        control->result.status = acked ? FlipagotchiControlAcked : FlipagotchiControlNaked;
+        control->result.rtt_ms = flipagotchi_control_elapsed_ms(control->sent_tick);
+        FURI_LOG_I(
+            "PWN",
+            "command %02X %s after %lu ms",
+            cmd,
+            acked ? "acked" : "naked",
+            (unsigned long)control->result.rtt_ms);
+    }
+    FlipagotchiControlCallback callback = answered ? control->callback : NULL;
+    void* context = control->context;
+    furi_mutex_release(control->mutex);
+
+    if(callback != NULL) {
+        callback(context);
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <furi.h>
+
+#include "protocol.h"
+#include "flipagotchi_arena.h"
+
+/*
+ * Commands the flipper sends to the pwnagotchi: switching mode, rebooting and shutting down
+ *
+ * A command goes out as a PWN_CMD_MODE, PWN_CMD_REBOOT or PWN_CMD_SHUTDOWN and the pwnagotchi
+ * answers with an ACK or NAK carrying the command's code, so it can't be taken for the reply to
+ * anything else. Only one command is out at a time. One that isn't answered within
+ * FLIPAGOTCHI_CONTROL_TIMEOUT_MS counts as timed out, it isn't sent again by itself since a reboot
+ * that did go through shouldn't be repeated.
+ */
+
+/// Time after which a command that went unanswered is given up on
+#define FLIPAGOTCHI_CONTROL_TIMEOUT_MS 1000
+
+typedef enum {
+    /// Nothing sent yet
+    FlipagotchiControlIdle,
+    /// Sent, waiting for the pwnagotchi to answer
+    FlipagotchiControlPending,
+    /// The pwnagotchi took the command
+    FlipagotchiControlAcked,
+    /// The pwnagotchi refused the command
+    FlipagotchiControlNaked,
+    /// No answer within FLIPAGOTCHI_CONTROL_TIMEOUT_MS
+    FlipagotchiControlTimedOut,
+} FlipagotchiControlStatus;
+
+/**
+ * The last command sent and how it went
+ */
+typedef struct {
+    FlipagotchiControlStatus status;
+    /// PWN_CMD_* code of the command
+    uint8_t cmd;
+    /// Byte of its body, 0 if it has none
+    uint8_t arg;
+    /// Milliseconds from sending to the answer, once there is one
+    uint32_t rtt_ms;
+} FlipagotchiControlResult;
+
+typedef struct FlipagotchiControl FlipagotchiControl;
+
+/// Called from the io worker when the pwnagotchi answered a command
+typedef void (*FlipagotchiControlCallback)(void* context);
+
+struct FlipagotchiUart;
+
+/**
+ * Carve the command state out of the arena
+ *
+ * @param arena Arena to carve from, FLIPAGOTCHI_CONTROL_ARENA_SIZE of it is used
+ * @param flip_uart Uart the commands go out on
+ * @return Pointer to the command state
+ */
+FlipagotchiControl*
+    flipagotchi_control_alloc(FlipagotchiArena* arena, struct FlipagotchiUart* flip_uart);
+
+void flipagotchi_control_free(FlipagotchiControl* control);
+
+/**
+ * Set the callback for answers coming in
+ *
+ * @param control Command state
+ * @param callback Callback, NULL for none
+ * @param context Passed to the callback
+ */
+void flipagotchi_control_set_callback(
+    FlipagotchiControl* control,
+    FlipagotchiControlCallback callback,
+    void* context);
+
+/**
+ * Send a command to the pwnagotchi
+ *
+ * @param control Command state
+ * @param cmd PWN_CMD_MODE, PWN_CMD_REBOOT or PWN_CMD_SHUTDOWN
+ * @param arg Byte of the body, the mode's code for PWN_CMD_MODE, 0 for none
+ * @return If it went out, not while another command is pending or the tx ring is full
+ */
+bool flipagotchi_control_send(FlipagotchiControl* control, uint8_t cmd, uint8_t arg);
+
+/**
+ * Get the last command and how it went, a pending one that is overdue times out here
+ *
+ * @param control Command state
+ * @param result Where the result goes
+ */
+void flipagotchi_control_get(FlipagotchiControl* control, FlipagotchiControlResult* result);
+
+/**
+ * Take an ACK or NAK carrying a command's code, called from the io worker
+ *
+ * @param control Command state
+ * @param cmd Code the reply carried
+ * @param acked If it was an ACK
+ */
+void flipagotchi_control_reply(FlipagotchiControl* control, uint8_t cmd, bool acked);
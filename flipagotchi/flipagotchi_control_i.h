@@ -0,0 +1,19 @@
+#pragma once
+
+#include "flipagotchi_control.h"
+#include "flipagotchi_uart.h"
+
+struct FlipagotchiControl {
+    FlipagotchiUart* flip_uart;
+
+    // shared by the io worker and the control scene, only touched under the mutex
+    FuriMutex* mutex;
+    FlipagotchiControlCallback callback;
+    void* context;
+    FlipagotchiControlResult result;
+    // when the pending command went out
+    uint32_t sent_tick;
+};
+
+/// Arena space flipagotchi_control_alloc carves
+#define FLIPAGOTCHI_CONTROL_ARENA_SIZE FLIPAGOTCHI_ARENA_ALIGN(sizeof(FlipagotchiControl))
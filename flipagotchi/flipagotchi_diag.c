@@ -0,0 +1,168 @@
+#include "flipagotchi_diag.h"
+
+#ifdef FLIPAGOTCHI_DIAG
+
+#include <storage/storage.h>
+
+#define FLIPAGOTCHI_DIAG_LOG_DIR EXT_PATH("apps_data/flipagotchi")
+
+typedef struct {
+    const char* name;
+    FuriThreadId thread_id;
+    size_t stack_size;
+    // least free stack seen so far, the watermark
+    uint32_t min_free;
+} FlipagotchiDiagThread;
+
+typedef struct {
+    int32_t current;
+    int32_t peak;
+} FlipagotchiDiagHeapUse;
+
+// every allocation carries its size in front so frees can be accounted
+typedef union {
+    size_t size;
+    max_align_t align;
+} FlipagotchiDiagAlloc;
+
+static const char* const flipagotchi_diag_heap_names[FlipagotchiDiagHeapNum] = {
+    "app",
+    "queue",
+    "view",
+    "uart",
+    "offload",
+    "handshakes",
+};
+
+static FlipagotchiDiagThread flipagotchi_diag_threads[FLIPAGOTCHI_DIAG_MAX_THREADS];
+static FlipagotchiDiagHeapUse flipagotchi_diag_heaps[FlipagotchiDiagHeapNum];
+
+void flipagotchi_diag_heap_account(FlipagotchiDiagHeap heap, int32_t delta) {
+    furi_assert(heap < FlipagotchiDiagHeapNum);
+
+    // allocations happen from every thread, some of them from inside the view model lock
+    FURI_CRITICAL_ENTER();
+    FlipagotchiDiagHeapUse* use = &flipagotchi_diag_heaps[heap];
+    use->current += delta;
+    if(use->current > use->peak) {
+        use->peak = use->current;
+    }
+    FURI_CRITICAL_EXIT();
+}
+
+void* flipagotchi_diag_malloc(FlipagotchiDiagHeap heap, size_t size) {
+    FlipagotchiDiagAlloc* alloc = malloc(sizeof(FlipagotchiDiagAlloc) + size);
+    alloc->size = size;
+    flipagotchi_diag_heap_account(heap, size);
+    return alloc + 1;
+}
+
+void flipagotchi_diag_free(FlipagotchiDiagHeap heap, void* ptr) {
+    if(ptr == NULL) {
+        return;
+    }
+    FlipagotchiDiagAlloc* alloc = (FlipagotchiDiagAlloc*)ptr - 1;
+    flipagotchi_diag_heap_account(heap, -(int32_t)alloc->size);
+    free(alloc);
+}
+
+void flipagotchi_diag_thread_add(const char* name, FuriThreadId thread_id, size_t stack_size) {
+    FURI_CRITICAL_ENTER();
+    for(size_t i = 0; i < FLIPAGOTCHI_DIAG_MAX_THREADS; i++) {
+        FlipagotchiDiagThread* thread = &flipagotchi_diag_threads[i];
+        if(thread->thread_id == NULL) {
+            thread->name = name;
+            thread->thread_id = thread_id;
+            thread->stack_size = stack_size;
+            thread->min_free = stack_size;
+            break;
+        }
+    }
+    FURI_CRITICAL_EXIT();
+}
+
+void flipagotchi_diag_thread_remove(FuriThreadId thread_id) {
+    FURI_CRITICAL_ENTER();
+    for(size_t i = 0; i < FLIPAGOTCHI_DIAG_MAX_THREADS; i++) {
+        if(flipagotchi_diag_threads[i].thread_id == thread_id) {
+            flipagotchi_diag_threads[i].thread_id = NULL;
+        }
+    }
+    FURI_CRITICAL_EXIT();
+}
+
+void flipagotchi_diag_sample() {
+    // the watermark only ever goes down, but keep our own minimum so a report
+    // still has the number after the thread is gone
+    FURI_CRITICAL_ENTER();
+    for(size_t i = 0; i < FLIPAGOTCHI_DIAG_MAX_THREADS; i++) {
+        FlipagotchiDiagThread* thread = &flipagotchi_diag_threads[i];
+        if(thread->thread_id != NULL) {
+            thread->min_free = MIN(thread->min_free, furi_thread_get_stack_space(thread->thread_id));
+        }
+    }
+    FURI_CRITICAL_EXIT();
+}
+
+void flipagotchi_diag_report(FuriString* out) {
+    FlipagotchiDiagThread threads[FLIPAGOTCHI_DIAG_MAX_THREADS];
+    FlipagotchiDiagHeapUse heaps[FlipagotchiDiagHeapNum];
+
+    // format from a copy, printing inside a critical section is not an option
+    FURI_CRITICAL_ENTER();
+    memcpy(threads, flipagotchi_diag_threads, sizeof(threads));
+    memcpy(heaps, flipagotchi_diag_heaps, sizeof(heaps));
+    FURI_CRITICAL_EXIT();
+
+    furi_string_cat_printf(
+        out,
+        "heap free %u, min %u\n",
+        (unsigned)memmgr_get_free_heap(),
+        (unsigned)memmgr_get_minimum_free_heap());
+
+    for(size_t i = 0; i < FLIPAGOTCHI_DIAG_MAX_THREADS; i++) {
+        if(threads[i].thread_id != NULL) {
+            furi_string_cat_printf(
+                out,
+                "stack %s %u/%u\n",
+                threads[i].name,
+                (unsigned)(threads[i].stack_size - threads[i].min_free),
+                (unsigned)threads[i].stack_size);
+        }
+    }
+
+    for(size_t i = 0; i < FlipagotchiDiagHeapNum; i++) {
+        furi_string_cat_printf(
+            out,
+            "heap %s %ld, peak %ld\n",
+            flipagotchi_diag_heap_names[i],
+            (long)heaps[i].current,
+            (long)heaps[i].peak);
+    }
+}
+
+void flipagotchi_diag_log(const char* reason) {
+    flipagotchi_diag_sample();
+
+    FuriString* text = furi_string_alloc_printf("-- %s, tick %lu\n", reason, furi_get_tick());
+    flipagotchi_diag_report(text);
+    FURI_LOG_I("PWN", "diagnostics:\n%s", furi_string_get_cstr(text));
+
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    storage_simply_mkdir(storage, EXT_PATH("apps_data"));
+    storage_simply_mkdir(storage, FLIPAGOTCHI_DIAG_LOG_DIR);
+
+    File* file = storage_file_alloc(storage);
+    if(storage_file_open(file, FLIPAGOTCHI_DIAG_LOG_PATH, FSAM_WRITE, FSOM_OPEN_APPEND)) {
+        storage_file_write(file, furi_string_get_cstr(text), furi_string_size(text));
+    } else {
+        FURI_LOG_W("PWN", "could not open %s", FLIPAGOTCHI_DIAG_LOG_PATH);
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+
+    furi_record_close(RECORD_STORAGE);
+    furi_string_free(text);
+}
+
+#endif
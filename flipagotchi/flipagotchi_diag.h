@@ -0,0 +1,142 @@
+#pragma once
+
+#include <furi.h>
+
+/*
+ * Stack and heap instrumentation
+ *
+ * Add "FLIPAGOTCHI_DIAG" to the cdefines in application.fam for a build that tracks the stack
+ * high-watermark of every app thread and the current and peak heap use of each subsystem.
+ * The numbers show up on the diagnostics screen and are appended to FLIPAGOTCHI_DIAG_LOG_PATH.
+ * Without it every call here compiles away and allocations go straight to malloc/free.
+ *
+ * Thread stacks are the deepest call chain through the app's own code, by -fstack-usage, plus
+ * 1 KiB for what the firmware runs below it: the printf behind FURI_LOG and snprintf, storage and
+ * hal calls, the exception frame. That is rounded up to 512 B. The watermarks of a DIAG=1 host
+ * build, see tools/hostsim, check the chains but also count glibc and the host's drawing, which
+ * take more than the flipper's, so they are an upper bound.
+ */
+
+/// Where diagnostics reports are appended on the SD card
+#define FLIPAGOTCHI_DIAG_LOG_PATH EXT_PATH("apps_data/flipagotchi/diag.log")
+
+/// Most threads that can be watched at once
+#define FLIPAGOTCHI_DIAG_MAX_THREADS 7
+
+/**
+ * Subsystems heap use is accounted to
+ */
+typedef enum {
+    /// App struct and everything else that doesn't belong to a subsystem
+    FlipagotchiDiagHeapApp,
+    /// Protocol queue and its messages
+    FlipagotchiDiagHeapQueue,
+    /// Pwnagotchi view, its model and the scratch buffers of the draw functions
+    FlipagotchiDiagHeapView,
+    /// Uart state, rings and worker thread stacks
+    FlipagotchiDiagHeapUart,
+    /// File offload state, its sd card buffers and worker thread stack
+    FlipagotchiDiagHeapOffload,
+    /// Handshake page cache and the browser's view
+    FlipagotchiDiagHeapHandshakes,
+    FlipagotchiDiagHeapNum,
+} FlipagotchiDiagHeap;
+
+#ifdef FLIPAGOTCHI_DIAG
+
+/**
+ * Allocate memory and account it to a subsystem
+ *
+ * @param heap Subsystem the memory belongs to
+ * @param size Bytes to allocate
+ * @return Pointer to the memory, release it with flipagotchi_diag_free
+ */
+void* flipagotchi_diag_malloc(FlipagotchiDiagHeap heap, size_t size);
+
+/**
+ * Free memory from flipagotchi_diag_malloc
+ *
+ * @param heap Subsystem the memory was allocated for
+ * @param ptr Memory to free
+ */
+void flipagotchi_diag_free(FlipagotchiDiagHeap heap, void* ptr);
+
+/**
+ * Account memory that something else allocated on our behalf, like a furi message queue
+ *
+ * @param heap Subsystem the memory belongs to
+ * @param delta Bytes allocated, negative when they are released
+ */
+void flipagotchi_diag_heap_account(FlipagotchiDiagHeap heap, int32_t delta);
+
+/**
+ * Start watching a thread's stack
+ *
+ * @param name Name to report the thread under, must outlive the registration
+ * @param thread_id Thread to watch
+ * @param stack_size Stack size the thread was started with
+ */
+void flipagotchi_diag_thread_add(const char* name, FuriThreadId thread_id, size_t stack_size);
+
+/**
+ * Stop watching a thread, must be called before the thread is freed
+ *
+ * @param thread_id Thread to stop watching
+ */
+void flipagotchi_diag_thread_remove(FuriThreadId thread_id);
+
+/**
+ * Sample the stack high-watermark of every watched thread
+ */
+void flipagotchi_diag_sample();
+
+/**
+ * Append a report of the current numbers to a string
+ *
+ * @param out String to append to
+ */
+void flipagotchi_diag_report(FuriString* out);
+
+/**
+ * Sample, then append a report to the SD log
+ *
+ * @param reason Why the report is being written, goes in its header
+ */
+void flipagotchi_diag_log(const char* reason);
+
+#define FLIPAGOTCHI_DIAG_MALLOC(heap, size) flipagotchi_diag_malloc(heap, size)
+#define FLIPAGOTCHI_DIAG_FREE(heap, ptr) flipagotchi_diag_free(heap, ptr)
+
+#else
+
+#define FLIPAGOTCHI_DIAG_MALLOC(heap, size) malloc(size)
+#define FLIPAGOTCHI_DIAG_FREE(heap, ptr) free(ptr)
+
+static inline void flipagotchi_diag_heap_account(FlipagotchiDiagHeap heap, int32_t delta) {
+    UNUSED(heap);
+    UNUSED(delta);
+}
+
+static inline void
+    flipagotchi_diag_thread_add(const char* name, FuriThreadId thread_id, size_t stack_size) {
+    UNUSED(name);
+    UNUSED(thread_id);
+    UNUSED(stack_size);
+}
+
+static inline void flipagotchi_diag_thread_remove(FuriThreadId thread_id) {
+    UNUSED(thread_id);
+}
+
+static inline void flipagotchi_diag_sample() {
+}
+
+static inline void flipagotchi_diag_report(FuriString* out) {
+    UNUSED(out);
+}
+
+static inline void flipagotchi_diag_log(const char* reason) {
+    UNUSED(reason);
+}
+
+#endif
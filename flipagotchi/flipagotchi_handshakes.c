@@ -0,0 +1,220 @@
+#include "flipagotchi_handshakes_i.h"
+
+#include <stdio.h>
+#include <string.h>
+
+_Static_assert(
+    HANDSHAKE_PAGE_HEADER_SIZE * 2 +
+            HANDSHAKE_PAGE_SIZE * (HANDSHAKE_RECORD_HEADER_SIZE * 2 + AP_SSID_MAX_LEN) +
+            BODY_CRC_SIZE * 2 <=
+        PWNAGOTCHI_PROTOCOL_MAX_MESSAGE_SIZE - 1,
+    "a page with every byte but the ssids escaped has to fit a message");
+
+static uint32_t flipagotchi_handshakes_read_le(const uint8_t* bytes, size_t len) {
+    uint32_t value = 0;
+    for(size_t i = 0; i < len; i++) {
+        value |= (uint32_t)bytes[i] << (8 * i);
+    }
+    return value;
+}
+
+/**
+ * Ask the pwnagotchi for a page, the caller holds the mutex
+ */
+static void flipagotchi_handshakes_request(FlipagotchiHandshakes* handshakes, uint16_t page) {
+    uint8_t msg[HANDSHAKE_LIST_HEX_LEN + 3] = {PACKET_START, PWN_CMD_HANDSHAKE_LIST};
+    char hex[HANDSHAKE_LIST_HEX_LEN + 1];
+    snprintf(hex, sizeof(hex), "%04x", page);
+    memcpy(&msg[2], hex, HANDSHAKE_LIST_HEX_LEN);
+    msg[sizeof(msg) - 1] = PACKET_END;
+
+    // a full tx ring is no different from a lost request, the retry takes care of both
+    flipagotchi_uart_tx(handshakes->flip_uart, msg, sizeof(msg));
+    handshakes->pending = true;
+    handshakes->pending_page = page;
+    handshakes->pending_tick = furi_get_tick();
+}
+
+/**
+ * Find the slot holding a page, the caller holds the mutex
+ */
+static FlipagotchiHandshakePage*
+    flipagotchi_handshakes_find(FlipagotchiHandshakes* handshakes, uint16_t page) {
+    for(size_t i = 0; i < FLIPAGOTCHI_HANDSHAKES_CACHE_PAGES; i++) {
+        if(handshakes->pages[i].valid && handshakes->pages[i].page == page) {
+            return &handshakes->pages[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Slot a new page goes into, a free one or the least recently used one
+ */
+static FlipagotchiHandshakePage* flipagotchi_handshakes_victim(FlipagotchiHandshakes* handshakes) {
+    FlipagotchiHandshakePage* victim = &handshakes->pages[0];
+    for(size_t i = 0; i < FLIPAGOTCHI_HANDSHAKES_CACHE_PAGES; i++) {
+        FlipagotchiHandshakePage* page = &handshakes->pages[i];
+        if(!page->valid) {
+            return page;
+        }
+        if(page->used < victim->used) {
+            victim = page;
+        }
+    }
+    return victim;
+}
+
+FlipagotchiHandshakes*
+    flipagotchi_handshakes_alloc(FlipagotchiArena* arena, FlipagotchiUart* flip_uart) {
+    // comes back zeroed, an empty cache with nothing pending
+    FlipagotchiHandshakes* handshakes = flipagotchi_arena_carve(
+        arena, FlipagotchiDiagHeapHandshakes, sizeof(FlipagotchiHandshakes));
+    handshakes->flip_uart = flip_uart;
+    handshakes->mutex = furi_mutex_alloc(FuriMutexTypeNormal);
+    return handshakes;
+}
+
+void flipagotchi_handshakes_free(FlipagotchiHandshakes* handshakes) {
+    furi_assert(handshakes);
+    furi_mutex_free(handshakes->mutex);
+    handshakes->mutex = NULL;
+}
+
+void flipagotchi_handshakes_set_callback(
+    FlipagotchiHandshakes* handshakes,
+    FlipagotchiHandshakesCallback callback,
+    void* context) {
+    furi_assert(handshakes);
+    furi_mutex_acquire(handshakes->mutex, FuriWaitForever);
+    handshakes->callback = callback;
+    handshakes->context = context;
+    furi_mutex_release(handshakes->mutex);
+}
+
+void flipagotchi_handshakes_open(FlipagotchiHandshakes* handshakes) {
+    furi_assert(handshakes);
+    furi_mutex_acquire(handshakes->mutex, FuriWaitForever);
+    // the captures may have changed since the browser was last open, the first page says
+    memset(handshakes->pages, 0, sizeof(handshakes->pages));
+    handshakes->known = false;
+    flipagotchi_handshakes_request(handshakes, 0);
+    furi_mutex_release(handshakes->mutex);
+}
+
+bool flipagotchi_handshakes_get_total(FlipagotchiHandshakes* handshakes, size_t* total) {
+    furi_assert(handshakes);
+    furi_mutex_acquire(handshakes->mutex, FuriWaitForever);
+    bool known = handshakes->known;
+    if(known) {
+        *total = handshakes->total;
+    }
+    furi_mutex_release(handshakes->mutex);
+    return known;
+}
+
+bool flipagotchi_handshakes_get(
+    FlipagotchiHandshakes* handshakes,
+    size_t index,
+    FlipagotchiHandshake* handshake) {
+    furi_assert(handshakes);
+    if(index >= (size_t)UINT16_MAX * HANDSHAKE_PAGE_SIZE) {
+        return false;
+    }
+    uint16_t number = index / HANDSHAKE_PAGE_SIZE;
+    size_t offset = index % HANDSHAKE_PAGE_SIZE;
+
+    furi_mutex_acquire(handshakes->mutex, FuriWaitForever);
+    FlipagotchiHandshakePage* page = flipagotchi_handshakes_find(handshakes, number);
+    bool found = page != NULL && offset < page->count;
+    if(found) {
+        page->used = ++handshakes->clock;
+        *handshake = page->handshakes[offset];
+    } else if(
+        page == NULL &&
+        (!handshakes->pending ||
+         furi_get_tick() - handshakes->pending_tick >=
+             furi_ms_to_ticks(FLIPAGOTCHI_HANDSHAKES_RETRY_MS))) {
+        flipagotchi_handshakes_request(handshakes, number);
+    }
+    furi_mutex_release(handshakes->mutex);
+    return found;
+}
+
+bool flipagotchi_handshakes_page(
+    FlipagotchiHandshakes* handshakes,
+    const uint8_t* body,
+    size_t len,
+    bool apply) {
+    furi_assert(handshakes);
+    if(len < HANDSHAKE_PAGE_HEADER_SIZE) {
+        return false;
+    }
+    uint32_t generation = flipagotchi_handshakes_read_le(body, 4);
+    uint16_t total = flipagotchi_handshakes_read_le(&body[4], 2);
+    uint16_t number = flipagotchi_handshakes_read_le(&body[6], 2);
+    // a page past the end is empty, the list got shorter since it was asked for
+    size_t first = (size_t)number * HANDSHAKE_PAGE_SIZE;
+    size_t count = first < total ? MIN((size_t)HANDSHAKE_PAGE_SIZE, total - first) : 0;
+
+    FlipagotchiHandshakePage* page = &handshakes->incoming;
+    memset(page, 0, sizeof(*page));
+    size_t pos = HANDSHAKE_PAGE_HEADER_SIZE;
+    for(size_t i = 0; i < count; i++) {
+        if(len - pos < HANDSHAKE_RECORD_HEADER_SIZE) {
+            return false;
+        }
+        FlipagotchiHandshake* handshake = &page->handshakes[i];
+        memcpy(handshake->bssid, &body[pos], PWNAGOTCHI_BSSID_LEN);
+        handshake->timestamp = flipagotchi_handshakes_read_le(&body[pos + 6], 4);
+        uint8_t ssid_len = body[pos + 10];
+        pos += HANDSHAKE_RECORD_HEADER_SIZE;
+        if(ssid_len > AP_SSID_MAX_LEN || len - pos < ssid_len) {
+            return false;
+        }
+        for(size_t c = 0; c < ssid_len; c++) {
+            if(body[pos + c] < ' ' || body[pos + c] > '~') {
+                return false;
+            }
+        }
+        memcpy(handshake->ssid, &body[pos], ssid_len);
+        pos += ssid_len;
+    }
+    if(pos != len) {
+        return false;
+    }
+    if(!apply) {
+        return true;
+    }
+
+    furi_mutex_acquire(handshakes->mutex, FuriWaitForever);
+    if(handshakes->known && handshakes->generation != generation) {
+        // from a different list, nothing cached lines up with it anymore
+        memset(handshakes->pages, 0, sizeof(handshakes->pages));
+    }
+    handshakes->known = true;
+    handshakes->generation = generation;
+    handshakes->total = total;
+    if(handshakes->pending && handshakes->pending_page == number) {
+        handshakes->pending = false;
+    }
+
+    FlipagotchiHandshakePage* slot = flipagotchi_handshakes_find(handshakes, number);
+    if(slot == NULL) {
+        slot = flipagotchi_handshakes_victim(handshakes);
+    }
+    page->valid = true;
+    page->page = number;
+    page->count = count;
+    page->used = ++handshakes->clock;
+    *slot = *page;
+
+    FlipagotchiHandshakesCallback callback = handshakes->callback;
+    void* context = handshakes->context;
+    furi_mutex_release(handshakes->mutex);
+
+    if(callback != NULL) {
+        callback(context);
+    }
+    return true;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <furi.h>
+
+#include "protocol.h"
+#include "flipagotchi_arena.h"
+#include "views/pwnagotchi.h"
+
+/*
+ * Captured handshakes on the pwnagotchi, fetched a page at a time for the handshake browser
+ *
+ * Nothing about the list is sent until the browser asks. It asks for a page with a
+ * PWN_CMD_HANDSHAKE_LIST when it needs a handshake the cache doesn't have, and the pwnagotchi
+ * answers with a FLIPPER_CMD_HANDSHAKE_PAGE, which also says how many handshakes there are. The
+ * last FLIPAGOTCHI_HANDSHAKES_CACHE_PAGES pages used are kept, so scrolling back and forth over a
+ * few pages costs nothing and a unit with thousands of captures costs no more memory than one with
+ * a few. Every page carries the generation of the list it came from, a page from a different list
+ * drops the rest of the cache.
+ *
+ * Only one request is out at a time. One that isn't answered within FLIPAGOTCHI_HANDSHAKES_RETRY_MS
+ * goes out again the next time the browser asks.
+ */
+
+/// Pages kept, the least recently used one makes room for a new one
+#define FLIPAGOTCHI_HANDSHAKES_CACHE_PAGES 3
+
+/// Time after which a request that went unanswered can go out again
+#define FLIPAGOTCHI_HANDSHAKES_RETRY_MS 1000
+
+/**
+ * One captured handshake
+ */
+typedef struct {
+    uint8_t bssid[PWNAGOTCHI_BSSID_LEN];
+    /// Seconds since the epoch, by the pwnagotchi's clock
+    uint32_t timestamp;
+    char ssid[PWNAGOTCHI_MAX_AP_SSID_LEN];
+} FlipagotchiHandshake;
+
+typedef struct FlipagotchiHandshakes FlipagotchiHandshakes;
+
+/// Called from the io worker when a page came in
+typedef void (*FlipagotchiHandshakesCallback)(void* context);
+
+struct FlipagotchiUart;
+
+/**
+ * Carve the page cache out of the arena
+ *
+ * @param arena Arena to carve from, FLIPAGOTCHI_HANDSHAKES_ARENA_SIZE of it is used
+ * @param flip_uart Uart the requests go out on
+ * @return Pointer to the page cache
+ */
+FlipagotchiHandshakes*
+    flipagotchi_handshakes_alloc(FlipagotchiArena* arena, struct FlipagotchiUart* flip_uart);
+
+void flipagotchi_handshakes_free(FlipagotchiHandshakes* handshakes);
+
+/**
+ * Set the callback for pages coming in
+ *
+ * @param handshakes Page cache
+ * @param callback Callback, NULL for none
+ * @param context Passed to the callback
+ */
+void flipagotchi_handshakes_set_callback(
+    FlipagotchiHandshakes* handshakes,
+    FlipagotchiHandshakesCallback callback,
+    void* context);
+
+/**
+ * Forget every page and ask for the first one, done when the browser opens
+ *
+ * @param handshakes Page cache
+ */
+void flipagotchi_handshakes_open(FlipagotchiHandshakes* handshakes);
+
+/**
+ * Get the number of handshakes on the pwnagotchi
+ *
+ * @param handshakes Page cache
+ * @param total Where the number goes
+ * @return If a page came in since the browser opened, total is left alone otherwise
+ */
+bool flipagotchi_handshakes_get_total(FlipagotchiHandshakes* handshakes, size_t* total);
+
+/**
+ * Get a handshake, asking the pwnagotchi for its page if the cache doesn't have it
+ *
+ * @param handshakes Page cache
+ * @param index 0 for the newest handshake
+ * @param handshake Where the handshake goes
+ * @return If the cache had it
+ */
+bool flipagotchi_handshakes_get(
+    FlipagotchiHandshakes* handshakes,
+    size_t index,
+    FlipagotchiHandshake* handshake);
+
+/**
+ * Take an unescaped FLIPPER_CMD_HANDSHAKE_PAGE, called from the io worker
+ *
+ * @param handshakes Page cache
+ * @param body Page, without its crc32
+ * @param len Bytes in body
+ * @param apply Store the page, otherwise only check it decodes
+ * @return If the page decoded, it is NAKed otherwise
+ */
+bool flipagotchi_handshakes_page(
+    FlipagotchiHandshakes* handshakes,
+    const uint8_t* body,
+    size_t len,
+    bool apply);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "flipagotchi_handshakes.h"
+#include "flipagotchi_uart.h"
+
+/**
+ * A page of the handshake list
+ */
+typedef struct {
+    /// If the slot holds a page
+    bool valid;
+    uint16_t page;
+    /// Handshakes on the page, the last page can have fewer than HANDSHAKE_PAGE_SIZE
+    uint8_t count;
+    /// Value of the use clock when the page was last read
+    uint32_t used;
+    FlipagotchiHandshake handshakes[HANDSHAKE_PAGE_SIZE];
+} FlipagotchiHandshakePage;
+
+struct FlipagotchiHandshakes {
+    FlipagotchiUart* flip_uart;
+
+    // shared by the io worker and whoever browses, only touched under the mutex
+    FuriMutex* mutex;
+    FlipagotchiHandshakesCallback callback;
+    void* context;
+    // set once a page came in since the browser opened, generation and total are only known then
+    bool known;
+    uint32_t generation;
+    uint16_t total;
+    // bumped on every read, the page with the lowest used goes first
+    uint32_t clock;
+    FlipagotchiHandshakePage pages[FLIPAGOTCHI_HANDSHAKES_CACHE_PAGES];
+    // where a page coming in is decoded before it goes into the cache, only touched by the io
+    // worker so it needs no lock and stays off the worker's stack
+    FlipagotchiHandshakePage incoming;
+    // page asked for last and when, while pending
+    bool pending;
+    uint16_t pending_page;
+    uint32_t pending_tick;
+};
+
+/// Arena space flipagotchi_handshakes_alloc carves, the pages live inside the struct
+#define FLIPAGOTCHI_HANDSHAKES_ARENA_SIZE FLIPAGOTCHI_ARENA_ALIGN(sizeof(FlipagotchiHandshakes))
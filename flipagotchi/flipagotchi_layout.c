@@ -0,0 +1,66 @@
+#include "flipagotchi_layout.h"
+
+#include <storage/storage.h>
+
+#include "flipagotchi_diag.h"
+
+static const uint8_t flipagotchi_layout_magic[4] = {'P', 'W', 'N', 'L'};
+
+/**
+ * Decode a layout file into items, all or nothing
+ *
+ * @return Number of items, 0 if the file doesn't parse
+ */
+static size_t flipagotchi_layout_decode(const uint8_t* buf, size_t len, PwnagotchiLayoutItem* items) {
+    if(len < FLIPAGOTCHI_LAYOUT_HEADER_SIZE ||
+       memcmp(buf, flipagotchi_layout_magic, sizeof(flipagotchi_layout_magic)) != 0 ||
+       buf[4] != FLIPAGOTCHI_LAYOUT_VERSION) {
+        return 0;
+    }
+    size_t count = buf[5];
+    if(count == 0 || count > PWNAGOTCHI_LAYOUT_MAX_ENTRIES ||
+       len != FLIPAGOTCHI_LAYOUT_HEADER_SIZE + count * FLIPAGOTCHI_LAYOUT_ENTRY_SIZE) {
+        return 0;
+    }
+
+    for(size_t i = 0; i < count; i++) {
+        const uint8_t* entry = buf + FLIPAGOTCHI_LAYOUT_HEADER_SIZE + i * FLIPAGOTCHI_LAYOUT_ENTRY_SIZE;
+        items[i].kind = entry[0];
+        items[i].x = entry[1];
+        items[i].y = entry[2];
+        items[i].width = entry[3];
+        items[i].height = entry[4];
+        items[i].font = entry[5];
+        items[i].align = entry[6];
+        memcpy(items[i].text, entry + 7, PWNAGOTCHI_LAYOUT_TEXT_LEN);
+    }
+    return count;
+}
+
+bool flipagotchi_layout_load(PwnagotchiModel* model) {
+    bool loaded = false;
+    // one byte over the largest layout, so a file that is too long doesn't read as a good one
+    uint8_t* buf = FLIPAGOTCHI_DIAG_MALLOC(FlipagotchiDiagHeapApp, FLIPAGOTCHI_LAYOUT_MAX_SIZE + 1);
+    PwnagotchiLayoutItem* items = FLIPAGOTCHI_DIAG_MALLOC(
+        FlipagotchiDiagHeapApp, sizeof(PwnagotchiLayoutItem) * PWNAGOTCHI_LAYOUT_MAX_ENTRIES);
+
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    File* file = storage_file_alloc(storage);
+    if(storage_file_open(file, FLIPAGOTCHI_LAYOUT_PATH, FSAM_READ, FSOM_OPEN_EXISTING)) {
+        size_t len = storage_file_read(file, buf, FLIPAGOTCHI_LAYOUT_MAX_SIZE + 1);
+        size_t count = flipagotchi_layout_decode(buf, len, items);
+        loaded = count > 0 && pwnagotchi_layout_compile(model->layout, items, count);
+        if(loaded) {
+            FURI_LOG_I("PWN", "loaded layout of %u entries", (unsigned)count);
+        } else {
+            FURI_LOG_W("PWN", "ignoring bad layout of %u bytes", (unsigned)len);
+        }
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+    furi_record_close(RECORD_STORAGE);
+
+    FLIPAGOTCHI_DIAG_FREE(FlipagotchiDiagHeapApp, items);
+    FLIPAGOTCHI_DIAG_FREE(FlipagotchiDiagHeapApp, buf);
+    return loaded;
+}
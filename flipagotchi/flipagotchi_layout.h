@@ -0,0 +1,46 @@
+#pragma once
+
+#include <furi.h>
+
+#include "views/pwnagotchi.h"
+
+/*
+ * Screen layout of the pwnagotchi view
+ *
+ * Where each field goes is read from FLIPAGOTCHI_LAYOUT_PATH at startup and compiled into the draw
+ * list the view iterates, so a new layout only needs a new file on the SD card. The file is written
+ * by tools/layout/layoutc.py, which also checks the rects for bounds and overlaps on the host. The
+ * built in layout stays in place when there is no file or it doesn't validate.
+ *
+ * Layout file, multi byte values are little endian
+ *
+ *   "PWNL" | version | entry count |
+ *   entries of FLIPAGOTCHI_LAYOUT_ENTRY_SIZE bytes, drawn in file order:
+ *     kind | x | y | width | height | font | align | text (PWNAGOTCHI_LAYOUT_TEXT_LEN bytes, NUL padded)
+ */
+
+/// Where the layout lives on the SD card
+#define FLIPAGOTCHI_LAYOUT_PATH EXT_PATH("apps_data/flipagotchi/layout.bin")
+
+/// Bumped whenever the file layout changes, layouts of another version are ignored
+#define FLIPAGOTCHI_LAYOUT_VERSION 1
+
+/// Bytes in front of the entries
+#define FLIPAGOTCHI_LAYOUT_HEADER_SIZE 6
+
+/// Bytes in each entry
+#define FLIPAGOTCHI_LAYOUT_ENTRY_SIZE (7 + PWNAGOTCHI_LAYOUT_TEXT_LEN)
+
+/// Largest layout file we read
+#define FLIPAGOTCHI_LAYOUT_MAX_SIZE \
+    (FLIPAGOTCHI_LAYOUT_HEADER_SIZE + FLIPAGOTCHI_LAYOUT_ENTRY_SIZE * PWNAGOTCHI_LAYOUT_MAX_ENTRIES)
+
+/**
+ * Replace the model's layout with the one on the SD card
+ *
+ * @note Leaves the layout alone if there is no file or any of it doesn't validate
+ *
+ * @param model Model whose layout to replace, the caller holds its lock
+ * @return If the layout was loaded
+ */
+bool flipagotchi_layout_load(PwnagotchiModel* model);
@@ -0,0 +1,638 @@
+#include "flipagotchi_offload_i.h"
+
+#include <stdio.h>
+
+#include "flipagotchi_diag.h"
+
+/// Bumped whenever the resume record layout changes, older records are ignored
+#define FLIPAGOTCHI_OFFLOAD_RESUME_VERSION 1
+
+/// Bytes in front of the name in a resume record
+#define FLIPAGOTCHI_OFFLOAD_RESUME_HEADER_SIZE 14
+
+/// Longest path of an offloaded file, the .part included
+#define FLIPAGOTCHI_OFFLOAD_PATH_LEN \
+    (FLIPAGOTCHI_OFFLOAD_DIR_LEN + FILE_NAME_MAX_LEN + sizeof(".part"))
+
+/// Hex characters of the numbers in a FLIPPER_CMD_FILE_OPEN and a PWN_CMD_FILE_ACK
+#define FLIPAGOTCHI_OFFLOAD_HEX_LEN 8
+
+_Static_assert(
+    (FILE_CHUNK_SIZE + FILE_CHUNK_OVERHEAD) * 2 <= PWNAGOTCHI_PROTOCOL_MAX_MESSAGE_SIZE - 1,
+    "a chunk with every byte escaped has to fit a message");
+_Static_assert(
+    FLIPAGOTCHI_OFFLOAD_BUFFER_SIZE >= FILE_CHUNK_SIZE,
+    "a buffer has to hold at least one chunk");
+
+static const uint8_t flipagotchi_offload_resume_magic[4] = {'P', 'W', 'N', 'O'};
+
+/// What each unit's worker shows up as on the diagnostics screen
+static const char* const flipagotchi_offload_thread_names[FLIPAGOTCHI_UNITS_MAX] = {
+    "offload",
+    "offload2",
+};
+
+/*
+ * Resume record, kept next to the .part of the transfer in progress. Multi byte values are
+ * little endian
+ *
+ *   "PWNO" | version | size (4 bytes) | crc (4 bytes) | name length | name
+ */
+
+// crc32 of every nibble, small enough to keep in flash and still a lot quicker than bit by bit
+static const uint32_t flipagotchi_offload_crc32_table[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+uint32_t flipagotchi_offload_crc32(uint32_t crc, const uint8_t* data, size_t len) {
+    crc = ~crc;
+    for(size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ flipagotchi_offload_crc32_table[crc & 0x0f];
+        crc = (crc >> 4) ^ flipagotchi_offload_crc32_table[crc & 0x0f];
+    }
+    return ~crc;
+}
+
+static uint32_t flipagotchi_offload_get_le32(const uint8_t* bytes) {
+    return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static void flipagotchi_offload_put_le32(uint8_t* bytes, uint32_t value) {
+    for(size_t byte = 0; byte < 4; byte++) {
+        bytes[byte] = value >> (8 * byte);
+    }
+}
+
+static bool flipagotchi_offload_parse_hex(const uint8_t* hex, uint32_t* value) {
+    *value = 0;
+    for(size_t i = 0; i < FLIPAGOTCHI_OFFLOAD_HEX_LEN; i++) {
+        uint8_t c = hex[i];
+        uint32_t digit;
+        if(c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if(c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if(c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            return false;
+        }
+        *value = *value << 4 | digit;
+    }
+    return true;
+}
+
+/**
+ * A name has to be a plain file name the sd card takes, nothing that could climb out of the
+ * offload directory or clash with a .part
+ */
+static bool flipagotchi_offload_name_is_valid(const char* name, size_t len) {
+    if(len == 0 || len > FILE_NAME_MAX_LEN || name[0] == '.') {
+        return false;
+    }
+    for(size_t i = 0; i < len; i++) {
+        char c = name[i];
+        if(!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+             c == '.' || c == '_' || c == '-')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void flipagotchi_offload_path(
+    FlipagotchiOffload* offload,
+    char* path,
+    const char* name,
+    bool part) {
+    snprintf(
+        path, FLIPAGOTCHI_OFFLOAD_PATH_LEN, "%s/%s%s", offload->dir, name, part ? ".part" : "");
+}
+
+static void flipagotchi_offload_send_ack(FlipagotchiOffload* offload, uint8_t status, uint32_t offset) {
+    uint8_t msg[FLIPAGOTCHI_OFFLOAD_HEX_LEN + 4] = {PACKET_START, PWN_CMD_FILE_ACK, status};
+    char hex[FLIPAGOTCHI_OFFLOAD_HEX_LEN + 1];
+    snprintf(hex, sizeof(hex), "%08lx", (unsigned long)offset);
+    memcpy(&msg[3], hex, FLIPAGOTCHI_OFFLOAD_HEX_LEN);
+    msg[sizeof(msg) - 1] = PACKET_END;
+    flipagotchi_uart_tx(offload->flip_uart, msg, sizeof(msg));
+}
+
+/**
+ * Hand the buffer being filled to the worker, the caller holds the mutex
+ *
+ * @return If there was anything in it
+ */
+static bool flipagotchi_offload_hand_over(FlipagotchiOffload* offload) {
+    if(offload->buffer_busy[offload->fill] || offload->buffer_len[offload->fill] == 0) {
+        return false;
+    }
+    offload->buffer_busy[offload->fill] = true;
+    offload->fill ^= 1;
+    return true;
+}
+
+bool flipagotchi_offload_open(FlipagotchiOffload* offload, const uint8_t* args, size_t len) {
+    furi_assert(offload);
+    len = strnlen((const char*)args, len);
+    uint32_t size;
+    uint32_t crc;
+    const char* name = (const char*)&args[2 * FLIPAGOTCHI_OFFLOAD_HEX_LEN];
+    if(len < 2 * FLIPAGOTCHI_OFFLOAD_HEX_LEN || !flipagotchi_offload_parse_hex(args, &size) ||
+       !flipagotchi_offload_parse_hex(&args[FLIPAGOTCHI_OFFLOAD_HEX_LEN], &crc) ||
+       !flipagotchi_offload_name_is_valid(name, len - 2 * FLIPAGOTCHI_OFFLOAD_HEX_LEN)) {
+        return false;
+    }
+    size_t name_len = len - 2 * FLIPAGOTCHI_OFFLOAD_HEX_LEN;
+
+    bool open = true;
+    bool resume = false;
+    uint32_t expected = 0;
+
+    furi_check(furi_mutex_acquire(offload->mutex, FuriWaitForever) == FuriStatusOk);
+    bool same = offload->state != FlipagotchiOffloadIdle && offload->size == size &&
+                offload->crc == crc && strlen(offload->name) == name_len &&
+                memcmp(offload->name, name, name_len) == 0;
+    if(same) {
+        // the pwnagotchi lost track of the transfer, most likely the link dropped. it picks up
+        // where we are, or hears from the worker once it is done with the open or the file
+        open = false;
+        if(offload->state == FlipagotchiOffloadReceiving) {
+            resume = true;
+            expected = offload->expected;
+            offload->unacked_chunks = 0;
+            offload->nudged = false;
+        }
+    } else {
+        memset(offload->name, 0, sizeof(offload->name));
+        memcpy(offload->name, name, name_len);
+        offload->size = size;
+        offload->crc = crc;
+        offload->open_seq++;
+        offload->state = FlipagotchiOffloadOpening;
+        // whatever was taken of another file and not handed over yet is dropped with it
+        if(!offload->buffer_busy[offload->fill]) {
+            offload->buffer_len[offload->fill] = 0;
+        }
+    }
+    furi_mutex_release(offload->mutex);
+
+    if(resume) {
+        FURI_LOG_I("PWN", "offload of %s resumes at %lu", name, expected);
+        flipagotchi_offload_send_ack(offload, FILE_ACK_OK, expected);
+    }
+    if(open) {
+        furi_thread_flags_set(furi_thread_get_id(offload->worker_thread), OffloadEventOpen);
+    }
+    return true;
+}
+
+void flipagotchi_offload_chunk(FlipagotchiOffload* offload, const uint8_t* chunk, size_t len) {
+    furi_assert(offload);
+    // too short or long to be a chunk is as good as a bad crc
+    bool valid = len > FILE_CHUNK_OVERHEAD && len <= FILE_CHUNK_SIZE + FILE_CHUNK_OVERHEAD &&
+                 flipagotchi_offload_crc32(0, chunk, len - 4) ==
+                     flipagotchi_offload_get_le32(&chunk[len - 4]);
+    uint32_t offset = valid ? flipagotchi_offload_get_le32(chunk) : 0;
+    size_t data_len = valid ? len - FILE_CHUNK_OVERHEAD : 0;
+
+    uint8_t ack = 0;
+    uint32_t ack_offset = 0;
+    bool write = false;
+
+    furi_check(furi_mutex_acquire(offload->mutex, FuriWaitForever) == FuriStatusOk);
+    if(offload->state != FlipagotchiOffloadReceiving) {
+        // stragglers of a transfer that is over or not set up yet
+        furi_mutex_release(offload->mutex);
+        return;
+    }
+
+    // every chunk but the last is full, so offsets stay on FILE_CHUNK_SIZE steps
+    bool in_order = valid && offset == offload->expected && offset + data_len <= offload->size &&
+                    (data_len == FILE_CHUNK_SIZE || offset + data_len == offload->size);
+    if(!valid) {
+        offload->stats.crc_errors++;
+    }
+
+    if(in_order && !offload->buffer_busy[offload->fill]) {
+        size_t fill = offload->fill;
+        memcpy(&offload->buffer[fill][offload->buffer_len[fill]], &chunk[4], data_len);
+        offload->buffer_len[fill] += data_len;
+        offload->expected += data_len;
+        offload->stats.bytes += data_len;
+        offload->unacked_chunks++;
+        offload->nudged = false;
+
+        if(offload->expected == offload->size) {
+            // the worker acks the file as a whole once it is checked
+            write = flipagotchi_offload_hand_over(offload);
+            offload->state = FlipagotchiOffloadFinishing;
+        } else {
+            if(offload->buffer_len[fill] + FILE_CHUNK_SIZE > FLIPAGOTCHI_OFFLOAD_BUFFER_SIZE) {
+                write = flipagotchi_offload_hand_over(offload);
+            }
+            if(offload->unacked_chunks >= FLIPAGOTCHI_OFFLOAD_ACK_INTERVAL) {
+                ack = FILE_ACK_OK;
+                ack_offset = offload->expected;
+                offload->unacked_chunks = 0;
+            }
+        }
+    } else if(!offload->nudged) {
+        // go back n, everything the pwnagotchi sent after the expected offset is dropped until it
+        // comes round to it again. a chunk we already have just means our acks got lost
+        bool duplicate = valid && offset < offload->expected;
+        ack = duplicate ? FILE_ACK_OK : FILE_ACK_RESEND;
+        ack_offset = offload->expected;
+        offload->unacked_chunks = 0;
+        offload->nudged = true;
+        if(!duplicate) {
+            offload->stats.resends++;
+        }
+    }
+    furi_mutex_release(offload->mutex);
+
+    if(ack) {
+        flipagotchi_offload_send_ack(offload, ack, ack_offset);
+    }
+    if(write) {
+        furi_thread_flags_set(furi_thread_get_id(offload->worker_thread), OffloadEventWrite);
+    }
+}
+
+void flipagotchi_offload_get_stats(FlipagotchiOffload* offload, FlipagotchiOffloadStats* stats) {
+    furi_assert(offload);
+    furi_check(furi_mutex_acquire(offload->mutex, FuriWaitForever) == FuriStatusOk);
+    memcpy(stats, &offload->stats, sizeof(FlipagotchiOffloadStats));
+    furi_mutex_release(offload->mutex);
+}
+
+/**
+ * Crc32 of the first len bytes of the file the worker has open, read through buffer 0
+ *
+ * @note Only while nothing of a transfer is in the buffers
+ */
+static bool flipagotchi_offload_file_crc(FlipagotchiOffload* offload, uint32_t len, uint32_t* crc) {
+    if(!storage_file_seek(offload->file, 0, true)) {
+        return false;
+    }
+    *crc = 0;
+    while(len > 0) {
+        uint16_t read = MIN(len, (uint32_t)FLIPAGOTCHI_OFFLOAD_BUFFER_SIZE);
+        if(storage_file_read(offload->file, offload->buffer[0], read) != read) {
+            return false;
+        }
+        *crc = flipagotchi_offload_crc32(*crc, offload->buffer[0], read);
+        len -= read;
+    }
+    return true;
+}
+
+static bool flipagotchi_offload_resume_matches(FlipagotchiOffload* offload) {
+    uint8_t record[FLIPAGOTCHI_OFFLOAD_RESUME_HEADER_SIZE + FILE_NAME_MAX_LEN];
+    size_t name_len = strlen(offload->file_name);
+    size_t len = 0;
+
+    File* file = storage_file_alloc(offload->storage);
+    if(storage_file_open(file, offload->resume_path, FSAM_READ, FSOM_OPEN_EXISTING)) {
+        len = storage_file_read(file, record, sizeof(record));
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+
+    return len == FLIPAGOTCHI_OFFLOAD_RESUME_HEADER_SIZE + name_len &&
+           memcmp(record, flipagotchi_offload_resume_magic, sizeof(flipagotchi_offload_resume_magic)) ==
+               0 &&
+           record[4] == FLIPAGOTCHI_OFFLOAD_RESUME_VERSION &&
+           flipagotchi_offload_get_le32(&record[5]) == offload->file_size &&
+           flipagotchi_offload_get_le32(&record[9]) == offload->file_crc && record[13] == name_len &&
+           memcmp(&record[14], offload->file_name, name_len) == 0;
+}
+
+static bool flipagotchi_offload_resume_write(FlipagotchiOffload* offload) {
+    uint8_t record[FLIPAGOTCHI_OFFLOAD_RESUME_HEADER_SIZE + FILE_NAME_MAX_LEN];
+    size_t name_len = strlen(offload->file_name);
+    memcpy(record, flipagotchi_offload_resume_magic, sizeof(flipagotchi_offload_resume_magic));
+    record[4] = FLIPAGOTCHI_OFFLOAD_RESUME_VERSION;
+    flipagotchi_offload_put_le32(&record[5], offload->file_size);
+    flipagotchi_offload_put_le32(&record[9], offload->file_crc);
+    record[13] = name_len;
+    memcpy(&record[14], offload->file_name, name_len);
+    size_t len = FLIPAGOTCHI_OFFLOAD_RESUME_HEADER_SIZE + name_len;
+
+    bool written = false;
+    File* file = storage_file_alloc(offload->storage);
+    if(storage_file_open(file, offload->resume_path, FSAM_WRITE, FSOM_CREATE_ALWAYS)) {
+        written = storage_file_write(file, record, len) == len;
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+    return written;
+}
+
+/**
+ * Let go of the file the worker has open, the transfer is over one way or another
+ *
+ * @param keep Leave the .part and resume record for a later transfer to pick up
+ */
+static void flipagotchi_offload_worker_close(FlipagotchiOffload* offload, bool keep) {
+    if(!storage_file_is_open(offload->file)) {
+        return;
+    }
+    storage_file_close(offload->file);
+    if(!keep) {
+        char path[FLIPAGOTCHI_OFFLOAD_PATH_LEN];
+        flipagotchi_offload_path(offload, path, offload->file_name, true);
+        storage_common_remove(offload->storage, path);
+        storage_common_remove(offload->storage, offload->resume_path);
+    }
+}
+
+/**
+ * End the transfer the worker's file belongs to, unless another open overtook it already
+ *
+ * The ack carries the file's crc32 rather than an offset, so a stale or garbled one can't end the
+ * pwnagotchi's next transfer
+ */
+static void flipagotchi_offload_worker_end(FlipagotchiOffload* offload, uint8_t ack) {
+    furi_check(furi_mutex_acquire(offload->mutex, FuriWaitForever) == FuriStatusOk);
+    bool current = offload->open_seq == offload->file_seq;
+    if(current) {
+        offload->state = FlipagotchiOffloadIdle;
+        if(ack == FILE_ACK_DONE) {
+            offload->stats.files++;
+        }
+    }
+    furi_mutex_release(offload->mutex);
+
+    if(current) {
+        flipagotchi_offload_send_ack(offload, ack, offload->file_crc);
+    }
+}
+
+/**
+ * Close the finished file, check it and move it into place
+ */
+static void flipagotchi_offload_worker_finish(FlipagotchiOffload* offload) {
+    if(offload->written != offload->file_size || offload->written_crc != offload->file_crc) {
+        FURI_LOG_W(
+            "PWN",
+            "offload of %s doesn't check out, %lu bytes with crc %08lx",
+            offload->file_name,
+            offload->written,
+            offload->written_crc);
+        flipagotchi_offload_worker_close(offload, false);
+        flipagotchi_offload_worker_end(offload, FILE_ACK_FAILED);
+        return;
+    }
+
+    char part[FLIPAGOTCHI_OFFLOAD_PATH_LEN];
+    char path[FLIPAGOTCHI_OFFLOAD_PATH_LEN];
+    flipagotchi_offload_path(offload, part, offload->file_name, true);
+    flipagotchi_offload_path(offload, path, offload->file_name, false);
+
+    storage_file_close(offload->file);
+    storage_common_remove(offload->storage, path);
+    bool moved = storage_common_rename(offload->storage, part, path) == FSE_OK;
+    storage_common_remove(offload->storage, offload->resume_path);
+
+    if(moved) {
+        FURI_LOG_I("PWN", "offloaded %s, %lu bytes", offload->file_name, offload->written);
+        flipagotchi_offload_worker_end(offload, FILE_ACK_DONE);
+    } else {
+        FURI_LOG_W("PWN", "could not move %s into place", part);
+        flipagotchi_offload_worker_end(offload, FILE_ACK_FAILED);
+    }
+}
+
+/**
+ * Write out every buffer handed over so far, in the order they were handed over
+ */
+static void flipagotchi_offload_worker_write(FlipagotchiOffload* offload) {
+    while(true) {
+        size_t index = offload->write_next;
+        furi_check(furi_mutex_acquire(offload->mutex, FuriWaitForever) == FuriStatusOk);
+        bool busy = offload->buffer_busy[index];
+        size_t len = offload->buffer_len[index];
+        bool finishing = offload->state == FlipagotchiOffloadFinishing &&
+                         offload->open_seq == offload->file_seq && !offload->buffer_busy[0] &&
+                         !offload->buffer_busy[1];
+        furi_mutex_release(offload->mutex);
+
+        if(!busy) {
+            if(finishing && storage_file_is_open(offload->file)) {
+                flipagotchi_offload_worker_finish(offload);
+            }
+            return;
+        }
+
+        // a buffer of a transfer that was given up on is only handed back
+        bool written = !storage_file_is_open(offload->file) ||
+                       storage_file_write(offload->file, offload->buffer[index], len) == len;
+        if(written && storage_file_is_open(offload->file)) {
+            offload->written += len;
+            offload->written_crc =
+                flipagotchi_offload_crc32(offload->written_crc, offload->buffer[index], len);
+        }
+
+        furi_check(furi_mutex_acquire(offload->mutex, FuriWaitForever) == FuriStatusOk);
+        offload->buffer_len[index] = 0;
+        offload->buffer_busy[index] = false;
+        furi_mutex_release(offload->mutex);
+        offload->write_next ^= 1;
+
+        if(!written) {
+            FURI_LOG_W("PWN", "could not write to the .part of %s", offload->file_name);
+            flipagotchi_offload_worker_close(offload, false);
+            flipagotchi_offload_worker_end(offload, FILE_ACK_FAILED);
+        }
+    }
+}
+
+/**
+ * Open the file asked for last, picking up whatever an earlier attempt left on the card
+ */
+static void flipagotchi_offload_worker_open(FlipagotchiOffload* offload) {
+    char name[FILE_NAME_MAX_LEN + 1];
+    furi_check(furi_mutex_acquire(offload->mutex, FuriWaitForever) == FuriStatusOk);
+    bool opening = offload->state == FlipagotchiOffloadOpening;
+    memcpy(name, offload->name, sizeof(name));
+    uint32_t size = offload->size;
+    uint32_t crc = offload->crc;
+    uint32_t seq = offload->open_seq;
+    furi_mutex_release(offload->mutex);
+    if(!opening) {
+        return;
+    }
+
+    // a transfer that was overtaken by this one won't be back, it goes with its .part
+    bool same = strcmp(name, offload->file_name) == 0 && size == offload->file_size &&
+                crc == offload->file_crc;
+    flipagotchi_offload_worker_close(offload, same);
+
+    memcpy(offload->file_name, name, sizeof(name));
+    offload->file_size = size;
+    offload->file_crc = crc;
+    offload->file_seq = seq;
+    offload->written = 0;
+    offload->written_crc = 0;
+
+    storage_simply_mkdir(offload->storage, EXT_PATH("apps_data"));
+    storage_simply_mkdir(offload->storage, EXT_PATH("apps_data/flipagotchi"));
+    storage_simply_mkdir(offload->storage, offload->dir);
+
+    char path[FLIPAGOTCHI_OFFLOAD_PATH_LEN];
+    flipagotchi_offload_path(offload, path, name, false);
+    uint32_t have_crc;
+    if(storage_file_open(offload->file, path, FSAM_READ, FSOM_OPEN_EXISTING)) {
+        bool have = storage_file_size(offload->file) == size &&
+                    flipagotchi_offload_file_crc(offload, size, &have_crc) && have_crc == crc;
+        storage_file_close(offload->file);
+        if(have) {
+            // our DONE got lost on the way, the file is already here
+            flipagotchi_offload_worker_end(offload, FILE_ACK_DONE);
+            return;
+        }
+    }
+
+    flipagotchi_offload_path(offload, path, name, true);
+    if(flipagotchi_offload_resume_matches(offload) &&
+       storage_file_open(offload->file, path, FSAM_READ_WRITE, FSOM_OPEN_EXISTING)) {
+        // chunks are written whole and in order, anything on the card up to the last full
+        // chunk is good. a short last chunk can only be the end of the file
+        uint32_t offset = MIN(storage_file_size(offload->file), size);
+        if(offset < size) {
+            offset -= offset % FILE_CHUNK_SIZE;
+        }
+        if(flipagotchi_offload_file_crc(offload, offset, &offload->written_crc) &&
+           storage_file_seek(offload->file, offset, true) && storage_file_truncate(offload->file)) {
+            offload->written = offset;
+        } else {
+            storage_file_close(offload->file);
+            offload->written_crc = 0;
+        }
+    }
+    if(!storage_file_is_open(offload->file) &&
+       (!storage_file_open(offload->file, path, FSAM_READ_WRITE, FSOM_CREATE_ALWAYS) ||
+        !flipagotchi_offload_resume_write(offload))) {
+        FURI_LOG_W("PWN", "could not start %s", path);
+        flipagotchi_offload_worker_close(offload, false);
+        flipagotchi_offload_worker_end(offload, FILE_ACK_FAILED);
+        return;
+    }
+
+    FURI_LOG_I("PWN", "offload of %s starts at %lu of %lu", name, offload->written, size);
+    furi_check(furi_mutex_acquire(offload->mutex, FuriWaitForever) == FuriStatusOk);
+    bool current = offload->open_seq == seq;
+    if(current) {
+        offload->expected = offload->written;
+        offload->unacked_chunks = 0;
+        offload->nudged = false;
+        offload->state = offload->written == size ? FlipagotchiOffloadFinishing :
+                                                    FlipagotchiOffloadReceiving;
+    }
+    furi_mutex_release(offload->mutex);
+
+    if(!current) {
+        // the next open is already waiting on our flags
+        return;
+    }
+    if(offload->written == size) {
+        flipagotchi_offload_worker_finish(offload);
+    } else {
+        flipagotchi_offload_send_ack(offload, FILE_ACK_OK, offload->written);
+    }
+}
+
+static int32_t flipagotchi_offload_worker(void* context) {
+    furi_assert(context);
+    FlipagotchiOffload* offload = context;
+
+    offload->storage = furi_record_open(RECORD_STORAGE);
+    offload->file = storage_file_alloc(offload->storage);
+
+    FURI_LOG_I("PWN", "offload worker, starting loop");
+    while(true) {
+        uint32_t events =
+            furi_thread_flags_wait(OFFLOAD_EVENTS_MASK, FuriFlagWaitAny, FuriWaitForever);
+        furi_check((events & FuriFlagError) == 0);
+
+        // chunks already taken go onto the card before anything else happens to the file
+        flipagotchi_offload_worker_write(offload);
+
+        if(events & OffloadEventStop) {
+            FURI_LOG_I("PWN", "offload worker received stop");
+            break;
+        }
+        if(events & OffloadEventOpen) {
+            flipagotchi_offload_worker_open(offload);
+        }
+    }
+
+    // the io worker is gone, what it took but didn't hand over yet is ours to write out. it was
+    // acked, so it has to be on the card for the transfer to resume from the right place
+    furi_check(furi_mutex_acquire(offload->mutex, FuriWaitForever) == FuriStatusOk);
+    if(offload->state == FlipagotchiOffloadReceiving) {
+        flipagotchi_offload_hand_over(offload);
+    }
+    furi_mutex_release(offload->mutex);
+    flipagotchi_offload_worker_write(offload);
+    flipagotchi_offload_worker_close(offload, true);
+
+    storage_file_free(offload->file);
+    offload->file = NULL;
+    furi_record_close(RECORD_STORAGE);
+    offload->storage = NULL;
+
+    return 0;
+}
+
+FlipagotchiOffload* flipagotchi_offload_alloc(
+    FlipagotchiArena* arena,
+    FlipagotchiUart* flip_uart,
+    uint8_t unit) {
+    // comes back zeroed, idle with both buffers empty
+    FlipagotchiOffload* offload =
+        flipagotchi_arena_carve(arena, FlipagotchiDiagHeapOffload, sizeof(FlipagotchiOffload));
+    offload->flip_uart = flip_uart;
+    // two pwnagotchis may well capture the same network, their files are kept apart
+    if(unit == 0) {
+        strlcpy(offload->dir, FLIPAGOTCHI_OFFLOAD_DIR, sizeof(offload->dir));
+    } else {
+        snprintf(
+            offload->dir,
+            sizeof(offload->dir),
+            "%s%u",
+            FLIPAGOTCHI_OFFLOAD_DIR,
+            (unsigned)(unit + 1));
+    }
+    snprintf(offload->resume_path, sizeof(offload->resume_path), "%s/resume.bin", offload->dir);
+    offload->mutex = furi_mutex_alloc(FuriMutexTypeNormal);
+
+    offload->worker_thread = furi_thread_alloc();
+    furi_thread_set_stack_size(offload->worker_thread, FLIPAGOTCHI_OFFLOAD_WORKER_STACK_SIZE);
+    furi_thread_set_context(offload->worker_thread, offload);
+    furi_thread_set_callback(offload->worker_thread, flipagotchi_offload_worker);
+    furi_thread_start(offload->worker_thread);
+    flipagotchi_diag_heap_account(FlipagotchiDiagHeapOffload, FLIPAGOTCHI_OFFLOAD_WORKER_STACK_SIZE);
+    flipagotchi_diag_thread_add(
+        flipagotchi_offload_thread_names[unit],
+        furi_thread_get_id(offload->worker_thread),
+        FLIPAGOTCHI_OFFLOAD_WORKER_STACK_SIZE);
+
+    return offload;
+}
+
+void flipagotchi_offload_free(FlipagotchiOffload* offload) {
+    FURI_LOG_I("PWN", "free offload worker");
+    flipagotchi_diag_thread_remove(furi_thread_get_id(offload->worker_thread));
+    furi_thread_flags_set(furi_thread_get_id(offload->worker_thread), OffloadEventStop);
+    furi_thread_join(offload->worker_thread);
+    furi_thread_free(offload->worker_thread);
+    offload->worker_thread = NULL;
+    flipagotchi_diag_heap_account(FlipagotchiDiagHeapOffload, -FLIPAGOTCHI_OFFLOAD_WORKER_STACK_SIZE);
+
+    furi_mutex_free(offload->mutex);
+    offload->mutex = NULL;
+}
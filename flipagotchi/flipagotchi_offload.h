@@ -0,0 +1,118 @@
+#pragma once
+
+#include <furi.h>
+
+#include "protocol.h"
+#include "flipagotchi_arena.h"
+
+/*
+ * Files sent over from the pwnagotchi, handshake captures mostly, stream to the sd card here
+ *
+ * A FLIPPER_CMD_FILE_OPEN names the file, its size and its crc32. The offload worker answers
+ * with a FILE_ACK_OK at the offset the file picks up from, which is past whatever an earlier
+ * attempt got onto the card. Chunks follow at FILE_CHUNK_SIZE steps, each carrying its offset
+ * and a crc32, and are copied by the io worker into one of two buffers while the offload worker
+ * writes the other one out. Chunks are acked together every FLIPAGOTCHI_OFFLOAD_ACK_INTERVAL,
+ * a bad one, one out of order, or one that arrives while both buffers are still on their way to
+ * the card is answered with FILE_ACK_RESEND at the offset expected next. Once the last chunk is
+ * written the file is checked against its crc32 and renamed into place.
+ */
+
+/// Where the first unit's offloaded files end up, the others get their number after it
+#define FLIPAGOTCHI_OFFLOAD_DIR EXT_PATH("apps_data/flipagotchi/offload")
+
+/// Room for FLIPAGOTCHI_OFFLOAD_DIR with a unit number after it
+#define FLIPAGOTCHI_OFFLOAD_DIR_LEN (sizeof(FLIPAGOTCHI_OFFLOAD_DIR) + 3)
+
+/// Size of each of the two buffers between the io worker and the sd card
+#define FLIPAGOTCHI_OFFLOAD_BUFFER_SIZE 512
+
+/// Chunks taken between FILE_ACK_OKs, the pwnagotchi's window has to be bigger than this
+#define FLIPAGOTCHI_OFFLOAD_ACK_INTERVAL 4
+
+/// Stack of the offload worker, which does all the sd card work of a transfer. 784 B of its own,
+/// see flipagotchi_diag.h
+#define FLIPAGOTCHI_OFFLOAD_WORKER_STACK_SIZE 2048
+
+/**
+ * Running totals of the file offload
+ */
+typedef struct {
+    /// Files that made it onto the sd card whole
+    uint32_t files;
+    /// Bytes taken from chunks
+    uint32_t bytes;
+    /// Chunks dropped because their crc didn't match
+    uint32_t crc_errors;
+    /// FILE_ACK_RESENDs sent
+    uint32_t resends;
+} FlipagotchiOffloadStats;
+
+typedef struct FlipagotchiOffload FlipagotchiOffload;
+
+struct FlipagotchiUart;
+
+/**
+ * Carve the offload state out of the arena and start its worker
+ *
+ * @param arena Arena to carve from, FLIPAGOTCHI_OFFLOAD_ARENA_SIZE of it is used
+ * @param flip_uart Uart the file acks go out on
+ * @param unit Unit the files come from, each unit's go in a directory of their own
+ * @return Pointer to the offload state
+ */
+FlipagotchiOffload* flipagotchi_offload_alloc(
+    FlipagotchiArena* arena,
+    struct FlipagotchiUart* flip_uart,
+    uint8_t unit);
+
+/**
+ * Stop the worker, whatever was taken of a transfer is written out first so it can be resumed
+ *
+ * @note Nothing may call flipagotchi_offload_open or flipagotchi_offload_chunk anymore, and the
+ * uart has to still be sending, the worker may have a last ack to send
+ *
+ * @param offload Offload to stop
+ */
+void flipagotchi_offload_free(FlipagotchiOffload* offload);
+
+/**
+ * Take a FLIPPER_CMD_FILE_OPEN, called from the io worker
+ *
+ * The body is the size and crc32 of the file as 8 hex characters each, then its name. The answer
+ * comes later as a PWN_CMD_FILE_ACK, once the worker knows where the file picks up
+ *
+ * @param offload Offload to open the file on
+ * @param args Arguments of the message
+ * @param len Space in args
+ * @return If the body was valid, the message is NAKed otherwise
+ */
+bool flipagotchi_offload_open(FlipagotchiOffload* offload, const uint8_t* args, size_t len);
+
+/**
+ * Take an unescaped FLIPPER_CMD_FILE_CHUNK, called from the io worker
+ *
+ * Chunks are never NAKed, anything wrong with one is answered with a FILE_ACK_RESEND
+ *
+ * @param offload Offload the chunk belongs to
+ * @param chunk Offset, data and crc32 of the chunk
+ * @param len Bytes in chunk
+ */
+void flipagotchi_offload_chunk(FlipagotchiOffload* offload, const uint8_t* chunk, size_t len);
+
+/**
+ * Get a snapshot of the offload totals
+ *
+ * @param offload Offload to read
+ * @param stats Where to copy the totals to
+ */
+void flipagotchi_offload_get_stats(FlipagotchiOffload* offload, FlipagotchiOffloadStats* stats);
+
+/**
+ * Crc32 as zlib computes it, pass 0 to start and the last result to continue
+ *
+ * @param crc Crc of everything before data
+ * @param data Bytes to add
+ * @param len Bytes in data
+ * @return Crc including data
+ */
+uint32_t flipagotchi_offload_crc32(uint32_t crc, const uint8_t* data, size_t len);
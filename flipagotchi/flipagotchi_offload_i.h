@@ -0,0 +1,78 @@
+#pragma once
+
+#include "flipagotchi_offload.h"
+#include "flipagotchi_uart.h"
+
+#include <storage/storage.h>
+
+/**
+ * Where a transfer is at
+ */
+typedef enum {
+    /// No transfer, chunks are ignored
+    FlipagotchiOffloadIdle,
+    /// The worker is finding out where the file picks up, chunks are ignored
+    FlipagotchiOffloadOpening,
+    /// Chunks are being taken
+    FlipagotchiOffloadReceiving,
+    /// Every chunk is in, the worker is writing out the rest and checking the file
+    FlipagotchiOffloadFinishing,
+} FlipagotchiOffloadState;
+
+typedef enum {
+    OffloadEventReserved = (1 << 0), // Reserved for StreamBuffer internal event
+    OffloadEventStop = (1 << 1),
+    OffloadEventOpen = (1 << 2),
+    OffloadEventWrite = (1 << 3),
+} OffloadEventFlags;
+
+#define OFFLOAD_EVENTS_MASK (OffloadEventStop | OffloadEventOpen | OffloadEventWrite)
+
+struct FlipagotchiOffload {
+    FlipagotchiUart* flip_uart;
+    FuriThread* worker_thread;
+
+    // everything up to the worker's own fields is shared by the io worker and the offload
+    // worker, and only touched under the mutex. nobody does sd card io while holding it
+    FuriMutex* mutex;
+    FlipagotchiOffloadState state;
+    // file of the current transfer, or the one the worker has been asked to open
+    char name[FILE_NAME_MAX_LEN + 1];
+    uint32_t size;
+    uint32_t crc;
+    // bumped for every open the worker is asked for, so it can tell it was overtaken by another
+    uint32_t open_seq;
+    // offset the next chunk is taken at
+    uint32_t expected;
+    // chunks taken since the last FILE_ACK_OK
+    uint32_t unacked_chunks;
+    // an ack pointing the pwnagotchi at expected went out and nothing at expected came in since,
+    // keeps a burst of chunks behind a bad one from each getting its own resend
+    bool nudged;
+    // the io worker fills buffer[fill], full ones are handed to the worker in turn with busy set
+    // and belong to it until it clears busy again
+    uint8_t buffer[2][FLIPAGOTCHI_OFFLOAD_BUFFER_SIZE];
+    size_t buffer_len[2];
+    bool buffer_busy[2];
+    size_t fill;
+    FlipagotchiOffloadStats stats;
+
+    // only touched by the offload worker, dir and resume_path are set once at alloc
+    char dir[FLIPAGOTCHI_OFFLOAD_DIR_LEN];
+    char resume_path[FLIPAGOTCHI_OFFLOAD_DIR_LEN + sizeof("/resume.bin")];
+    Storage* storage;
+    File* file;
+    // file the worker has open, and the open it was for
+    char file_name[FILE_NAME_MAX_LEN + 1];
+    uint32_t file_size;
+    uint32_t file_crc;
+    uint32_t file_seq;
+    // buffer written out next
+    size_t write_next;
+    // bytes on the card and their crc32
+    uint32_t written;
+    uint32_t written_crc;
+};
+
+/// Arena space flipagotchi_offload_alloc carves, both buffers live inside the struct
+#define FLIPAGOTCHI_OFFLOAD_ARENA_SIZE FLIPAGOTCHI_ARENA_ALIGN(sizeof(FlipagotchiOffload))
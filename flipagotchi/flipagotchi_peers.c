@@ -0,0 +1,74 @@
+#include "flipagotchi_peers.h"
+
+#include <string.h>
+
+#include "protocol.h"
+
+_Static_assert(
+    PEER_NAME_MAX_LEN < PWNAGOTCHI_MAX_HOSTNAME_LEN,
+    "the longest name a record carries has to fit with its terminator");
+
+/**
+ * Index of a key in the table, count if it isn't there
+ */
+static size_t flipagotchi_peers_index(const PwnagotchiPeerTable* table, uint32_t key) {
+    size_t i = 0;
+    while(i < table->count && table->peers[i].key != key) {
+        i++;
+    }
+    return i;
+}
+
+void flipagotchi_peers_clear(PwnagotchiPeerTable* table) {
+    furi_assert(table);
+    memset(table, 0, sizeof(PwnagotchiPeerTable));
+}
+
+const PwnagotchiPeer* flipagotchi_peers_find(const PwnagotchiPeerTable* table, uint32_t key) {
+    furi_assert(table);
+    size_t i = flipagotchi_peers_index(table, key);
+    return i < table->count ? &table->peers[i] : NULL;
+}
+
+bool flipagotchi_peers_set(PwnagotchiPeerTable* table, const PwnagotchiPeer* peer) {
+    furi_assert(table);
+    size_t i = flipagotchi_peers_index(table, peer->key);
+    if(i == table->count) {
+        if(table->count >= PWNAGOTCHI_MAX_PEERS) {
+            return false;
+        }
+        // in at the weak end, then up to where it belongs
+        table->count++;
+    }
+
+    // one pass of insertion sort either way, equal signals keep their order so the list doesn't
+    // shuffle on screen
+    while(i > 0 && table->peers[i - 1].rssi < peer->rssi) {
+        table->peers[i] = table->peers[i - 1];
+        i--;
+    }
+    while(i + 1 < table->count && table->peers[i + 1].rssi > peer->rssi) {
+        table->peers[i] = table->peers[i + 1];
+        i++;
+    }
+    table->peers[i] = *peer;
+    return true;
+}
+
+bool flipagotchi_peers_expire(PwnagotchiPeerTable* table, uint32_t key) {
+    furi_assert(table);
+    size_t i = flipagotchi_peers_index(table, key);
+    if(i == table->count) {
+        return false;
+    }
+    memmove(
+        &table->peers[i], &table->peers[i + 1], (table->count - i - 1) * sizeof(PwnagotchiPeer));
+    table->count--;
+    memset(&table->peers[table->count], 0, sizeof(PwnagotchiPeer));
+    return true;
+}
+
+const PwnagotchiPeer* flipagotchi_peers_closest(const PwnagotchiPeerTable* table) {
+    furi_assert(table);
+    return table->count > 0 ? &table->peers[0] : NULL;
+}
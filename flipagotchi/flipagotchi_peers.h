@@ -0,0 +1,59 @@
+#pragma once
+
+#include <furi.h>
+
+#include "views/pwnagotchi.h"
+
+/*
+ * Table of the other pwnagotchis the unit can hear
+ *
+ * The pwnagotchi never sends the whole list. Peers that showed up or changed come in with
+ * FLIPPER_CMD_PEER_SET and ones it lost with FLIPPER_CMD_PEER_EXPIRE, keyed by a hash of their
+ * fingerprint. It keeps to the closest PWNAGOTCHI_MAX_PEERS, so the table never has to make room by
+ * itself and an insert into a full table is refused.
+ *
+ * With so few peers a lookup is a linear search. The table is kept closest first, so the main screen
+ * takes the first one and the peer list draws them in order.
+ */
+
+/**
+ * Empty the table
+ *
+ * @param table Table to empty, the caller holds the model lock
+ */
+void flipagotchi_peers_clear(PwnagotchiPeerTable* table);
+
+/**
+ * Look a peer up by key
+ *
+ * @param table Table to search, the caller holds the model lock
+ * @param key Hash of the peer's fingerprint
+ * @return The peer, NULL if the table doesn't have it
+ */
+const PwnagotchiPeer* flipagotchi_peers_find(const PwnagotchiPeerTable* table, uint32_t key);
+
+/**
+ * Add a peer or replace the one with its key, then move it to where its signal puts it
+ *
+ * @param table Table to store into, the caller holds the model lock
+ * @param peer Peer to store
+ * @return If it was stored, a new peer doesn't fit a full table
+ */
+bool flipagotchi_peers_set(PwnagotchiPeerTable* table, const PwnagotchiPeer* peer);
+
+/**
+ * Remove a peer
+ *
+ * @param table Table to remove from, the caller holds the model lock
+ * @param key Hash of the peer's fingerprint
+ * @return If the table had it
+ */
+bool flipagotchi_peers_expire(PwnagotchiPeerTable* table, uint32_t key);
+
+/**
+ * The peer with the strongest signal
+ *
+ * @param table Table to look in, the caller holds the model lock
+ * @return The closest peer, NULL if the table is empty
+ */
+const PwnagotchiPeer* flipagotchi_peers_closest(const PwnagotchiPeerTable* table);
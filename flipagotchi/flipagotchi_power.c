@@ -0,0 +1,165 @@
+#include "flipagotchi_power_i.h"
+#include "flipagotchi_diag.h"
+
+#include <furi_hal.h>
+#include <storage/storage.h>
+
+#define FLIPAGOTCHI_POWER_SETTINGS_DIR EXT_PATH("apps_data/flipagotchi")
+
+/// Bumped whenever the settings layout changes, older settings are ignored
+#define FLIPAGOTCHI_POWER_SETTINGS_VERSION 1
+
+/// "PWNP" | version | idle seconds (2 bytes, little endian) | backlight
+#define FLIPAGOTCHI_POWER_SETTINGS_SIZE 8
+
+static const uint8_t flipagotchi_power_magic[4] = {'P', 'W', 'N', 'P'};
+
+static uint32_t flipagotchi_power_elapsed_ms(uint32_t since) {
+    // in 32 bits the product wraps after 71 minutes at 1 kHz, shorter than a night idle
+    return (uint32_t)((uint64_t)(furi_get_tick() - since) * 1000 / furi_ms_to_ticks(1000));
+}
+
+/**
+ * Fold a reading into a running average, the first one is taken as is
+ */
+static int32_t flipagotchi_power_average(int32_t average, int32_t reading) {
+    if(average == 0) {
+        return reading;
+    }
+    return average + (reading - average) * FLIPAGOTCHI_POWER_AVERAGE_WEIGHT / 16;
+}
+
+/**
+ * Read the fuel gauge, which averages over the last second on its own
+ */
+static int32_t flipagotchi_power_sample(FlipagotchiPower* power) {
+    // amps, positive while charging
+    float current = furi_hal_power_get_battery_current(FuriHalPowerICFuelGauge);
+    power->now_ua = (int32_t)(-current * 1000000.0f);
+    return power->now_ua;
+}
+
+FlipagotchiPower*
+    flipagotchi_power_alloc(FlipagotchiArena* arena, const FlipagotchiPowerSettings* settings) {
+    // comes back zeroed, awake with no readings
+    FlipagotchiPower* power =
+        flipagotchi_arena_carve(arena, FlipagotchiDiagHeapApp, sizeof(FlipagotchiPower));
+    power->settings = *settings;
+    power->activity_tick = furi_get_tick();
+    power->sample_tick = power->activity_tick;
+    return power;
+}
+
+void flipagotchi_power_set_settings(
+    FlipagotchiPower* power,
+    const FlipagotchiPowerSettings* settings) {
+    furi_assert(power);
+    power->settings = *settings;
+}
+
+bool flipagotchi_power_activity(FlipagotchiPower* power) {
+    furi_assert(power);
+    power->activity_tick = furi_get_tick();
+    if(!power->idle) {
+        return false;
+    }
+    uint32_t slept = flipagotchi_power_elapsed_ms(power->idle_tick);
+    power->idle = false;
+    power->idle_ms += slept;
+    // nothing ran for the gauge's last second but the idle app, so this is what idling costs
+    power->idle_ua = flipagotchi_power_average(power->idle_ua, flipagotchi_power_sample(power));
+    power->sample_tick = power->activity_tick;
+    FURI_LOG_I("PWN", "awake after %lu ms idle", slept);
+    return true;
+}
+
+bool flipagotchi_power_check(FlipagotchiPower* power) {
+    furi_assert(power);
+    if(power->idle) {
+        return false;
+    }
+    if(flipagotchi_power_elapsed_ms(power->sample_tick) >= FLIPAGOTCHI_POWER_SAMPLE_MS) {
+        power->sample_tick = furi_get_tick();
+        power->awake_ua =
+            flipagotchi_power_average(power->awake_ua, flipagotchi_power_sample(power));
+    }
+    if(power->settings.idle_s == 0 ||
+       flipagotchi_power_elapsed_ms(power->activity_tick) < power->settings.idle_s * 1000UL) {
+        return false;
+    }
+    power->idle = true;
+    power->idle_tick = furi_get_tick();
+    power->idle_count++;
+    FURI_LOG_I("PWN", "idle after %u s without activity", power->settings.idle_s);
+    return true;
+}
+
+bool flipagotchi_power_is_idle(FlipagotchiPower* power) {
+    furi_assert(power);
+    return power->idle;
+}
+
+void flipagotchi_power_get_stats(FlipagotchiPower* power, FlipagotchiPowerStats* stats) {
+    furi_assert(power);
+    stats->now_ma = power->now_ua / 1000;
+    stats->awake_ma = power->awake_ua / 1000;
+    stats->idle_ma = power->idle_ua / 1000;
+    stats->idle_count = power->idle_count;
+    stats->idle_ms = power->idle_ms;
+    if(power->idle) {
+        stats->idle_ms += flipagotchi_power_elapsed_ms(power->idle_tick);
+    }
+}
+
+bool flipagotchi_power_settings_load(FlipagotchiPowerSettings* settings) {
+    uint8_t buf[FLIPAGOTCHI_POWER_SETTINGS_SIZE];
+    size_t len = 0;
+
+    settings->idle_s = FLIPAGOTCHI_POWER_DEFAULT_IDLE_S;
+    settings->backlight = FlipagotchiPowerBacklightOff;
+
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    File* file = storage_file_alloc(storage);
+    if(storage_file_open(file, FLIPAGOTCHI_POWER_SETTINGS_PATH, FSAM_READ, FSOM_OPEN_EXISTING)) {
+        len = storage_file_read(file, buf, sizeof(buf));
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+    furi_record_close(RECORD_STORAGE);
+
+    if(len != sizeof(buf) ||
+       memcmp(buf, flipagotchi_power_magic, sizeof(flipagotchi_power_magic)) != 0 ||
+       buf[4] != FLIPAGOTCHI_POWER_SETTINGS_VERSION || buf[7] >= FlipagotchiPowerBacklightCount) {
+        return false;
+    }
+    settings->idle_s = buf[5] | buf[6] << 8;
+    settings->backlight = buf[7];
+    return true;
+}
+
+bool flipagotchi_power_settings_save(const FlipagotchiPowerSettings* settings) {
+    uint8_t buf[FLIPAGOTCHI_POWER_SETTINGS_SIZE];
+    bool written = false;
+
+    memcpy(buf, flipagotchi_power_magic, sizeof(flipagotchi_power_magic));
+    buf[4] = FLIPAGOTCHI_POWER_SETTINGS_VERSION;
+    buf[5] = settings->idle_s;
+    buf[6] = settings->idle_s >> 8;
+    buf[7] = settings->backlight;
+
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    storage_simply_mkdir(storage, EXT_PATH("apps_data"));
+    storage_simply_mkdir(storage, FLIPAGOTCHI_POWER_SETTINGS_DIR);
+    File* file = storage_file_alloc(storage);
+    if(storage_file_open(file, FLIPAGOTCHI_POWER_SETTINGS_PATH, FSAM_WRITE, FSOM_CREATE_ALWAYS)) {
+        written = storage_file_write(file, buf, sizeof(buf)) == sizeof(buf);
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+    furi_record_close(RECORD_STORAGE);
+
+    if(!written) {
+        FURI_LOG_W("PWN", "could not write %s", FLIPAGOTCHI_POWER_SETTINGS_PATH);
+    }
+    return written;
+}
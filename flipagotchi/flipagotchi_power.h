@@ -0,0 +1,124 @@
+#pragma once
+
+#include <furi.h>
+
+#include "flipagotchi_arena.h"
+
+/*
+ * Idle mode. With nothing new for a while the app stops its tick, the backlight goes off, the face
+ * stops animating and the io workers probe a lost link at a slower pace, until a key is pressed or
+ * something worth looking at comes in. Everything here runs on the app thread
+ */
+
+/// Where the power settings live on the sd card
+#define FLIPAGOTCHI_POWER_SETTINGS_PATH EXT_PATH("apps_data/flipagotchi/power.bin")
+
+/// Seconds without activity before the app goes idle, until a delay is picked in the settings
+#define FLIPAGOTCHI_POWER_DEFAULT_IDLE_S 30
+
+/// Backlight level while idle when it is dimmed rather than off, out of 255
+#define FLIPAGOTCHI_POWER_DIM_LEVEL 0x20
+
+/// Least ms between fuel gauge readings while awake, each one is an i2c transfer
+#define FLIPAGOTCHI_POWER_SAMPLE_MS 1000
+
+/// Weight of a new current reading in the running averages, out of 16
+#define FLIPAGOTCHI_POWER_AVERAGE_WEIGHT 2
+
+typedef enum {
+    FlipagotchiPowerBacklightOff,
+    FlipagotchiPowerBacklightDim,
+    FlipagotchiPowerBacklightCount,
+} FlipagotchiPowerBacklight;
+
+typedef struct {
+    /// Seconds without activity before the app goes idle, 0 never
+    uint16_t idle_s;
+    /// What the backlight does while idle
+    FlipagotchiPowerBacklight backlight;
+} FlipagotchiPowerSettings;
+
+/**
+ * Current draw from the fuel gauge and how much of the time went by idle
+ */
+typedef struct {
+    /// Last reading in mA, drawn from the battery is positive, charging negative
+    int32_t now_ma;
+    /// Running averages while awake and while idle, 0 until there is a reading. Idle is read on
+    /// waking up, there is no tick to read it with while idle
+    int32_t awake_ma;
+    int32_t idle_ma;
+    /// Times the app went idle, and ms spent idle in total
+    uint32_t idle_count;
+    uint32_t idle_ms;
+} FlipagotchiPowerStats;
+
+typedef struct FlipagotchiPower FlipagotchiPower;
+
+/**
+ * Carve the idle state out of the arena, awake with the activity clock starting now
+ *
+ * Nothing in it needs freeing, it goes away with the arena
+ *
+ * @param arena Arena to carve from, FLIPAGOTCHI_POWER_ARENA_SIZE of it is used
+ * @param settings When to go idle
+ * @return Pointer to the idle state
+ */
+FlipagotchiPower*
+    flipagotchi_power_alloc(FlipagotchiArena* arena, const FlipagotchiPowerSettings* settings);
+
+/**
+ * Change when to go idle, the activity clock keeps running
+ *
+ * @param power Idle state
+ * @param settings New settings
+ */
+void flipagotchi_power_set_settings(
+    FlipagotchiPower* power,
+    const FlipagotchiPowerSettings* settings);
+
+/**
+ * Note something worth staying awake for, a key press or news from a pwnagotchi
+ *
+ * @param power Idle state
+ * @return If this woke the app up, the caller starts what going idle stopped
+ */
+bool flipagotchi_power_activity(FlipagotchiPower* power);
+
+/**
+ * Take a current reading every FLIPAGOTCHI_POWER_SAMPLE_MS and go idle once nothing happened for
+ * long enough
+ *
+ * @param power Idle state
+ * @return If the app just went idle, the caller stops its tick and everything else it can
+ */
+bool flipagotchi_power_check(FlipagotchiPower* power);
+
+/**
+ * @param power Idle state
+ * @return If the app is idle
+ */
+bool flipagotchi_power_is_idle(FlipagotchiPower* power);
+
+/**
+ * @param power Idle state
+ * @param stats Where the numbers go
+ */
+void flipagotchi_power_get_stats(FlipagotchiPower* power, FlipagotchiPowerStats* stats);
+
+/**
+ * Read the settings from the sd card
+ *
+ * @param settings Filled in, idle after FLIPAGOTCHI_POWER_DEFAULT_IDLE_S with the backlight off if
+ *                 there are none
+ * @return If they were read
+ */
+bool flipagotchi_power_settings_load(FlipagotchiPowerSettings* settings);
+
+/**
+ * Write the settings to the sd card
+ *
+ * @param settings Settings to write
+ * @return If they were written
+ */
+bool flipagotchi_power_settings_save(const FlipagotchiPowerSettings* settings);
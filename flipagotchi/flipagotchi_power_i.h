@@ -0,0 +1,21 @@
+#pragma once
+
+#include "flipagotchi_power.h"
+
+struct FlipagotchiPower {
+    FlipagotchiPowerSettings settings;
+    bool idle;
+    // last activity, when the app last went idle and when the gauge was last read
+    uint32_t activity_tick;
+    uint32_t idle_tick;
+    uint32_t sample_tick;
+    // readings in uA, so the averages still move on changes smaller than their weight
+    int32_t now_ua;
+    int32_t awake_ua;
+    int32_t idle_ua;
+    uint32_t idle_count;
+    uint32_t idle_ms;
+};
+
+/// Arena space flipagotchi_power_alloc carves
+#define FLIPAGOTCHI_POWER_ARENA_SIZE FLIPAGOTCHI_ARENA_ALIGN(sizeof(FlipagotchiPower))
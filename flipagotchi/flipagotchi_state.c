@@ -0,0 +1,240 @@
+#include "flipagotchi_state.h"
+
+#include <stdio.h>
+#include <storage/storage.h>
+
+#include "flipagotchi_diag.h"
+
+#define FLIPAGOTCHI_STATE_DIR EXT_PATH("apps_data/flipagotchi")
+
+/// Room for FLIPAGOTCHI_STATE_PATH with a unit number in it
+#define FLIPAGOTCHI_STATE_PATH_LEN (sizeof(FLIPAGOTCHI_STATE_PATH) + 3)
+
+/// Bumped whenever the snapshot layout changes, older snapshots are ignored
+#define FLIPAGOTCHI_STATE_VERSION 2
+
+/// Bytes in front of the field hashes
+#define FLIPAGOTCHI_STATE_HEADER_SIZE 11
+
+#define FNV_OFFSET_BASIS 2166136261UL
+#define FNV_PRIME 16777619UL
+
+_Static_assert(
+    PWNAGOTCHI_ANIMATION_MAX_PERIOD_MS <= UINT16_MAX,
+    "the snapshot keeps the animation period in 2 bytes");
+
+static const uint8_t flipagotchi_state_magic[4] = {'P', 'W', 'N', 'S'};
+
+/*
+ * Snapshot layout, multi byte values are little endian
+ *
+ *   "PWNS" | version | face | mode | animation | animation period (2 bytes) | field count |
+ *   field hashes (4 bytes each) |
+ *   hostname, channel, apStat, uptime, status, handshakes (length byte, then the characters)
+ */
+
+/**
+ * The first unit's snapshot is FLIPAGOTCHI_STATE_PATH, the others have their number after "state"
+ */
+static void flipagotchi_state_path(char* path, uint8_t unit, const char* extension) {
+    if(unit == 0) {
+        snprintf(path, FLIPAGOTCHI_STATE_PATH_LEN, "%s/state.%s", FLIPAGOTCHI_STATE_DIR, extension);
+    } else {
+        snprintf(
+            path,
+            FLIPAGOTCHI_STATE_PATH_LEN,
+            "%s/state%u.%s",
+            FLIPAGOTCHI_STATE_DIR,
+            (unsigned)(unit + 1),
+            extension);
+    }
+}
+
+static uint32_t flipagotchi_state_fnv(uint32_t hash, const uint8_t* data, size_t len) {
+    for(size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+uint32_t flipagotchi_state_message_hash(const PwnMessage* message) {
+    size_t len = strnlen((const char*)message->arguments, sizeof(message->arguments));
+    uint32_t hash = flipagotchi_state_fnv(FNV_OFFSET_BASIS, &message->code, 1);
+    hash = flipagotchi_state_fnv(hash, message->arguments, len);
+    // 0 marks a field that was never set
+    return hash ? hash : 1;
+}
+
+uint32_t flipagotchi_state_hash_fields(const uint32_t field_hash[PwnagotchiFieldNum]) {
+    uint32_t hash = FNV_OFFSET_BASIS;
+    for(size_t i = 0; i < PwnagotchiFieldNum; i++) {
+        uint8_t bytes[4] = {
+            field_hash[i],
+            field_hash[i] >> 8,
+            field_hash[i] >> 16,
+            field_hash[i] >> 24,
+        };
+        hash = flipagotchi_state_fnv(hash, bytes, sizeof(bytes));
+    }
+    return hash;
+}
+
+uint32_t flipagotchi_state_hash(const PwnagotchiModel* model) {
+    return flipagotchi_state_hash_fields(model->field_hash);
+}
+
+static size_t flipagotchi_state_put_string(uint8_t* buf, const char* field, size_t field_len) {
+    size_t len = strnlen(field, field_len - 1);
+    buf[0] = len;
+    memcpy(buf + 1, field, len);
+    return len + 1;
+}
+
+size_t flipagotchi_state_encode(const PwnagotchiModel* model, uint8_t* buf) {
+    size_t pos = 0;
+
+    memcpy(buf, flipagotchi_state_magic, sizeof(flipagotchi_state_magic));
+    pos += sizeof(flipagotchi_state_magic);
+    buf[pos++] = FLIPAGOTCHI_STATE_VERSION;
+    buf[pos++] = model->face;
+    buf[pos++] = model->mode;
+    buf[pos++] = model->animation;
+    buf[pos++] = model->animation_period_ms;
+    buf[pos++] = model->animation_period_ms >> 8;
+    buf[pos++] = PwnagotchiFieldNum;
+
+    for(size_t i = 0; i < PwnagotchiFieldNum; i++) {
+        for(size_t byte = 0; byte < 4; byte++) {
+            buf[pos++] = model->field_hash[i] >> (8 * byte);
+        }
+    }
+
+    pos += flipagotchi_state_put_string(buf + pos, model->hostname, sizeof(model->hostname));
+    pos += flipagotchi_state_put_string(buf + pos, model->channel, sizeof(model->channel));
+    pos += flipagotchi_state_put_string(buf + pos, model->apStat, sizeof(model->apStat));
+    pos += flipagotchi_state_put_string(buf + pos, model->uptime, sizeof(model->uptime));
+    pos += flipagotchi_state_put_string(buf + pos, model->status, sizeof(model->status));
+    pos += flipagotchi_state_put_string(buf + pos, model->handshakes, sizeof(model->handshakes));
+
+    furi_assert(pos <= FLIPAGOTCHI_STATE_MAX_SIZE);
+    return pos;
+}
+
+static bool flipagotchi_state_get_string(
+    const uint8_t* buf,
+    size_t len,
+    size_t* pos,
+    char* field,
+    size_t field_len) {
+    if(*pos >= len) {
+        return false;
+    }
+    size_t str_len = buf[*pos];
+    if(str_len > field_len - 1 || *pos + 1 + str_len > len) {
+        return false;
+    }
+    memset(field, 0, field_len);
+    memcpy(field, buf + *pos + 1, str_len);
+    *pos += 1 + str_len;
+    return true;
+}
+
+/**
+ * Decode a snapshot, all or nothing
+ */
+static bool flipagotchi_state_decode(const uint8_t* buf, size_t len, PwnagotchiModel* model) {
+    size_t pos = FLIPAGOTCHI_STATE_HEADER_SIZE + 4 * PwnagotchiFieldNum;
+    if(len < pos || memcmp(buf, flipagotchi_state_magic, sizeof(flipagotchi_state_magic)) != 0 ||
+       buf[4] != FLIPAGOTCHI_STATE_VERSION || buf[10] != PwnagotchiFieldNum) {
+        return false;
+    }
+    if(buf[5] < Look_r || buf[5] >= EndFace || buf[6] > PwnMode_Ai) {
+        return false;
+    }
+    uint32_t animation_period = buf[8] | buf[9] << 8;
+    if(buf[7] != PwnAnimation_None && !pwnagotchi_animation_is_valid(buf[7], animation_period)) {
+        return false;
+    }
+
+    // decode into a copy so a bad snapshot can't leave the model half restored
+    PwnagotchiModel restored = *model;
+    restored.face = buf[5];
+    restored.mode = buf[6];
+    restored.animation = PwnAnimation_None;
+    if(buf[7] != PwnAnimation_None) {
+        // picks up from the first frame, the io worker starts the timer
+        pwnagotchi_start_animation(&restored, buf[7], animation_period);
+    }
+    for(size_t i = 0; i < PwnagotchiFieldNum; i++) {
+        const uint8_t* bytes = buf + FLIPAGOTCHI_STATE_HEADER_SIZE + 4 * i;
+        restored.field_hash[i] = bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+    }
+
+    if(!flipagotchi_state_get_string(buf, len, &pos, restored.hostname, sizeof(restored.hostname)) ||
+       !flipagotchi_state_get_string(buf, len, &pos, restored.channel, sizeof(restored.channel)) ||
+       !flipagotchi_state_get_string(buf, len, &pos, restored.apStat, sizeof(restored.apStat)) ||
+       !flipagotchi_state_get_string(buf, len, &pos, restored.uptime, sizeof(restored.uptime)) ||
+       !flipagotchi_state_get_string(buf, len, &pos, restored.status, sizeof(restored.status)) ||
+       !flipagotchi_state_get_string(
+           buf, len, &pos, restored.handshakes, sizeof(restored.handshakes))) {
+        return false;
+    }
+
+    *model = restored;
+    return true;
+}
+
+bool flipagotchi_state_load(PwnagotchiModel* model, uint8_t unit) {
+    bool loaded = false;
+    uint8_t* buf = FLIPAGOTCHI_DIAG_MALLOC(FlipagotchiDiagHeapApp, FLIPAGOTCHI_STATE_MAX_SIZE);
+    char path[FLIPAGOTCHI_STATE_PATH_LEN];
+    flipagotchi_state_path(path, unit, "bin");
+
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    File* file = storage_file_alloc(storage);
+    if(storage_file_open(file, path, FSAM_READ, FSOM_OPEN_EXISTING)) {
+        size_t len = storage_file_read(file, buf, FLIPAGOTCHI_STATE_MAX_SIZE);
+        loaded = flipagotchi_state_decode(buf, len, model);
+        if(!loaded) {
+            FURI_LOG_W("PWN", "ignoring bad state snapshot of %u bytes", (unsigned)len);
+        }
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+    furi_record_close(RECORD_STORAGE);
+
+    FLIPAGOTCHI_DIAG_FREE(FlipagotchiDiagHeapApp, buf);
+    return loaded;
+}
+
+bool flipagotchi_state_write(const uint8_t* buf, size_t len, uint8_t unit) {
+    bool written = false;
+    char path[FLIPAGOTCHI_STATE_PATH_LEN];
+    char tmp_path[FLIPAGOTCHI_STATE_PATH_LEN];
+    flipagotchi_state_path(path, unit, "bin");
+    flipagotchi_state_path(tmp_path, unit, "tmp");
+
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    storage_simply_mkdir(storage, EXT_PATH("apps_data"));
+    storage_simply_mkdir(storage, FLIPAGOTCHI_STATE_DIR);
+
+    // write next to the old snapshot and swap, pulling the card mid write leaves the old one
+    File* file = storage_file_alloc(storage);
+    if(storage_file_open(file, tmp_path, FSAM_WRITE, FSOM_CREATE_ALWAYS)) {
+        written = storage_file_write(file, buf, len) == len;
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+
+    if(written) {
+        storage_common_remove(storage, path);
+        written = storage_common_rename(storage, tmp_path, path) == FSE_OK;
+    }
+    if(!written) {
+        FURI_LOG_W("PWN", "could not write %s", path);
+    }
+
+    furi_record_close(RECORD_STORAGE);
+    return written;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <furi.h>
+
+#include "protocol.h"
+#include "views/pwnagotchi.h"
+
+/*
+ * Last known pwnagotchi state
+ *
+ * The model is snapshotted to FLIPAGOTCHI_STATE_PATH (state2.bin next to it for the second unit) on
+ * exit and every so often while it changes, and restored before the first draw so the screen is
+ * meaningful right away. Every field remembers the hash of the message it was set from, which
+ * serves as its version. The state hash over those goes out with SYN and the field hashes
+ * themselves with UI_REFRESH, so the pwnagotchi only resends the fields whose hash differs from
+ * what it would send.
+ */
+
+/// Where the first unit's snapshot lives on the SD card
+#define FLIPAGOTCHI_STATE_PATH EXT_PATH("apps_data/flipagotchi/state.bin")
+
+/// Least time between two snapshots while the model keeps changing
+#define FLIPAGOTCHI_STATE_SAVE_INTERVAL_MS 30000
+
+/// Characters a hash takes up in a SYN or UI_REFRESH body
+#define FLIPAGOTCHI_STATE_HASH_HEX_LEN 8
+
+/**
+ * Hash a message the way the pwnagotchi does, the command code followed by the argument bytes
+ *
+ * @param message Message to hash
+ * @return Hash of the message, never 0
+ */
+uint32_t flipagotchi_state_message_hash(const PwnMessage* message);
+
+/**
+ * Hash the whole state from the field hashes, in PwnagotchiField order
+ *
+ * @param field_hash Hash of every field
+ * @return State hash
+ */
+uint32_t flipagotchi_state_hash_fields(const uint32_t field_hash[PwnagotchiFieldNum]);
+
+/**
+ * Hash the whole state of a model
+ *
+ * @param model Model to hash
+ * @return State hash
+ */
+uint32_t flipagotchi_state_hash(const PwnagotchiModel* model);
+
+/**
+ * Restore the model from the snapshot on the SD card
+ *
+ * @note Leaves the model alone if there is no snapshot or it doesn't parse
+ *
+ * @param model Model to restore into, the caller holds its lock
+ * @param unit Unit the model belongs to
+ * @return If the model was restored
+ */
+bool flipagotchi_state_load(PwnagotchiModel* model, uint8_t unit);
+
+/**
+ * Encode the model into a snapshot
+ *
+ * @param model Model to encode, the caller holds its lock
+ * @param buf Where to encode to, FLIPAGOTCHI_STATE_MAX_SIZE bytes
+ * @return Bytes used in buf
+ */
+size_t flipagotchi_state_encode(const PwnagotchiModel* model, uint8_t* buf);
+
+/**
+ * Write an encoded snapshot to the SD card, replacing the last one
+ *
+ * @param buf Snapshot from flipagotchi_state_encode
+ * @param len Bytes in buf
+ * @param unit Unit the snapshot is of
+ * @return If the snapshot was written
+ */
+bool flipagotchi_state_write(const uint8_t* buf, size_t len, uint8_t unit);
+
+/// Largest snapshot flipagotchi_state_encode writes
+#define FLIPAGOTCHI_STATE_MAX_SIZE                                                               \
+    (11 + 4 * PwnagotchiFieldNum + PWNAGOTCHI_MAX_HOSTNAME_LEN + PWNAGOTCHI_MAX_CHANNEL_LEN +   \
+     PWNAGOTCHI_MAX_APS_LEN + PWNAGOTCHI_MAX_UPTIME_LEN + PWNAGOTCHI_MAX_STATUS_LEN +           \
+     PWNAGOTCHI_MAX_SSID_LEN)
@@ -0,0 +1,147 @@
+#include "flipagotchi_transport.h"
+
+#include <storage/storage.h>
+
+#define FLIPAGOTCHI_TRANSPORT_SETTINGS_DIR EXT_PATH("apps_data/flipagotchi")
+
+/// Bumped whenever the settings layout changes, older settings are ignored
+#define FLIPAGOTCHI_TRANSPORT_SETTINGS_VERSION 2
+
+/// Bytes of each unit's entry, transport | rate (4 bytes, little endian)
+#define FLIPAGOTCHI_TRANSPORT_SETTINGS_UNIT_SIZE 5
+
+/// "PWNT" | version | units | an entry for each of FLIPAGOTCHI_UNITS_MAX, used or not
+#define FLIPAGOTCHI_TRANSPORT_SETTINGS_SIZE \
+    (6 + FLIPAGOTCHI_TRANSPORT_SETTINGS_UNIT_SIZE * FLIPAGOTCHI_UNITS_MAX)
+
+static const uint8_t flipagotchi_transport_magic[4] = {'P', 'W', 'N', 'T'};
+
+_Static_assert(FLIPAGOTCHI_UNITS_MAX == 2, "the default settings name a transport for every unit");
+
+static const FlipagotchiTransport* const flipagotchi_transports[FlipagotchiTransportNum] = {
+    [FlipagotchiTransportLpuart] = &flipagotchi_transport_lpuart,
+    [FlipagotchiTransportUsart] = &flipagotchi_transport_usart,
+    [FlipagotchiTransportUsbCdc] = &flipagotchi_transport_usb_cdc,
+#ifdef FLIPAGOTCHI_TRANSPORT_PTY
+    [FlipagotchiTransportPty] = &flipagotchi_transport_pty,
+#endif
+};
+
+const FlipagotchiTransport* flipagotchi_transport_get(FlipagotchiTransportId id) {
+    return id < FlipagotchiTransportNum ? flipagotchi_transports[id] : NULL;
+}
+
+FlipagotchiTransportId
+    flipagotchi_transport_config_free(const FlipagotchiTransportConfig* config, uint8_t unit) {
+    for(FlipagotchiTransportId id = 0; id < FlipagotchiTransportNum; id++) {
+        bool used = flipagotchi_transport_get(id) == NULL;
+        for(uint8_t other = 0; other < config->units && !used; other++) {
+            used = other != unit && config->unit[other].id == id;
+        }
+        if(!used) {
+            return id;
+        }
+    }
+    return FlipagotchiTransportNum;
+}
+
+/**
+ * Check every unit in use has a transport of its own that this build has, at a rate
+ */
+static bool flipagotchi_transport_config_valid(const FlipagotchiTransportConfig* config) {
+    if(config->units < 1 || config->units > FLIPAGOTCHI_UNITS_MAX) {
+        return false;
+    }
+    for(uint8_t unit = 0; unit < config->units; unit++) {
+        const FlipagotchiTransportSettings* settings = &config->unit[unit];
+        if(flipagotchi_transport_get(settings->id) == NULL || settings->rate == 0) {
+            return false;
+        }
+        for(uint8_t other = 0; other < unit; other++) {
+            if(config->unit[other].id == settings->id) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool flipagotchi_transport_settings_load(FlipagotchiTransportConfig* config) {
+    uint8_t buf[FLIPAGOTCHI_TRANSPORT_SETTINGS_SIZE];
+    size_t len = 0;
+
+    config->units = 1;
+    config->unit[0].id = FlipagotchiTransportLpuart;
+    config->unit[0].rate = FLIPAGOTCHI_TRANSPORT_DEFAULT_RATE;
+    config->unit[1].id = FlipagotchiTransportUsart;
+    config->unit[1].rate = FLIPAGOTCHI_TRANSPORT_DEFAULT_RATE;
+
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    File* file = storage_file_alloc(storage);
+    if(storage_file_open(
+           file, FLIPAGOTCHI_TRANSPORT_SETTINGS_PATH, FSAM_READ, FSOM_OPEN_EXISTING)) {
+        len = storage_file_read(file, buf, sizeof(buf));
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+    furi_record_close(RECORD_STORAGE);
+
+    if(len != sizeof(buf) ||
+       memcmp(buf, flipagotchi_transport_magic, sizeof(flipagotchi_transport_magic)) != 0 ||
+       buf[4] != FLIPAGOTCHI_TRANSPORT_SETTINGS_VERSION) {
+        return false;
+    }
+    FlipagotchiTransportConfig read = {.units = buf[5]};
+    for(uint8_t unit = 0; unit < FLIPAGOTCHI_UNITS_MAX; unit++) {
+        const uint8_t* entry = &buf[6 + FLIPAGOTCHI_TRANSPORT_SETTINGS_UNIT_SIZE * unit];
+        read.unit[unit].id = entry[0];
+        read.unit[unit].rate =
+            entry[1] | entry[2] << 8 | entry[3] << 16 | (uint32_t)entry[4] << 24;
+    }
+    // settings from a host build on a real flipper's card, or a rate nothing could run at
+    if(!flipagotchi_transport_config_valid(&read)) {
+        FURI_LOG_W(
+            "PWN",
+            "ignoring transport settings for %u units, %u at %lu first",
+            (unsigned)read.units,
+            (unsigned)read.unit[0].id,
+            (unsigned long)read.unit[0].rate);
+        return false;
+    }
+    *config = read;
+    return true;
+}
+
+bool flipagotchi_transport_settings_save(const FlipagotchiTransportConfig* config) {
+    uint8_t buf[FLIPAGOTCHI_TRANSPORT_SETTINGS_SIZE];
+    bool written = false;
+
+    memcpy(buf, flipagotchi_transport_magic, sizeof(flipagotchi_transport_magic));
+    buf[4] = FLIPAGOTCHI_TRANSPORT_SETTINGS_VERSION;
+    buf[5] = config->units;
+    for(uint8_t unit = 0; unit < FLIPAGOTCHI_UNITS_MAX; unit++) {
+        uint8_t* entry = &buf[6 + FLIPAGOTCHI_TRANSPORT_SETTINGS_UNIT_SIZE * unit];
+        entry[0] = config->unit[unit].id;
+        for(size_t byte = 0; byte < 4; byte++) {
+            entry[1 + byte] = config->unit[unit].rate >> (8 * byte);
+        }
+    }
+
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    storage_simply_mkdir(storage, EXT_PATH("apps_data"));
+    storage_simply_mkdir(storage, FLIPAGOTCHI_TRANSPORT_SETTINGS_DIR);
+    File* file = storage_file_alloc(storage);
+    // small enough to go in one write, there is no older copy worth keeping around
+    if(storage_file_open(
+           file, FLIPAGOTCHI_TRANSPORT_SETTINGS_PATH, FSAM_WRITE, FSOM_CREATE_ALWAYS)) {
+        written = storage_file_write(file, buf, sizeof(buf)) == sizeof(buf);
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+    furi_record_close(RECORD_STORAGE);
+
+    if(!written) {
+        FURI_LOG_W("PWN", "could not write %s", FLIPAGOTCHI_TRANSPORT_SETTINGS_PATH);
+    }
+    return written;
+}
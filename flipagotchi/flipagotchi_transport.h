@@ -0,0 +1,123 @@
+#pragma once
+
+#include <furi.h>
+
+/*
+ * The wire to the pwnagotchi, everything above it only ever talks to a FlipagotchiTransport
+ *
+ * Each backend drives one piece of hardware, so each is a single static instance. Received bytes
+ * are handed to the rx callback from whatever context the hardware delivers them in, interrupt
+ * included, tx blocks the calling thread until the bytes are out. Open, tx, set_rate and close
+ * are never called concurrently with each other, the uart makes sure of that
+ */
+
+/// Where the transport settings live on the sd card
+#define FLIPAGOTCHI_TRANSPORT_SETTINGS_PATH EXT_PATH("apps_data/flipagotchi/transport.bin")
+
+/// Line rate used until one is picked in the settings
+#define FLIPAGOTCHI_TRANSPORT_DEFAULT_RATE 115200
+
+/// Pwnagotchis the app can talk to at once, each over a transport of its own
+#define FLIPAGOTCHI_UNITS_MAX 2
+
+typedef enum {
+    /// TX pin 15, RX pin 16
+    FlipagotchiTransportLpuart,
+    /// TX pin 13, RX pin 14, the debug console is off while it is in use
+    FlipagotchiTransportUsart,
+    /// Second interface of a dual cdc config, the cli keeps the first
+    FlipagotchiTransportUsbCdc,
+    /// Linux pty, only in host builds
+    FlipagotchiTransportPty,
+    FlipagotchiTransportNum,
+} FlipagotchiTransportId;
+
+/**
+ * Receives bytes from the wire
+ *
+ * @param data Bytes received, only valid during the call
+ * @param length Number of bytes in data
+ * @param context Context given to open
+ */
+typedef void (*FlipagotchiTransportRxCallback)(const uint8_t* data, size_t length, void* context);
+
+typedef struct {
+    /// Shown in the settings
+    const char* name;
+    /// If the line rate means anything, usb goes as fast as it goes
+    bool has_rate;
+
+    /**
+     * Take the hardware and start receiving
+     *
+     * @return If it could be taken, nothing else may be called if not
+     */
+    bool (*open)(uint32_t rate, FlipagotchiTransportRxCallback callback, void* context);
+    /// Send bytes, returns once they are out or were given up on
+    void (*tx)(const uint8_t* data, size_t length);
+    /// Change the line rate, bytes being sent at the time may go out garbled
+    void (*set_rate)(uint32_t rate);
+    /// Stop receiving and give the hardware back, the rx callback isn't called after this
+    void (*close)(void);
+} FlipagotchiTransport;
+
+/**
+ * What the app is told to talk to the pwnagotchi over
+ */
+typedef struct {
+    FlipagotchiTransportId id;
+    /// Line rate in baud, ignored by transports without has_rate
+    uint32_t rate;
+} FlipagotchiTransportSettings;
+
+/**
+ * What every unit talks over
+ */
+typedef struct {
+    /// Units the app runs, a change takes effect the next time it starts
+    uint8_t units;
+    /// The first units entries are in use, and no two of those share a transport
+    FlipagotchiTransportSettings unit[FLIPAGOTCHI_UNITS_MAX];
+} FlipagotchiTransportConfig;
+
+/**
+ * Get a backend
+ *
+ * @param id Backend to get
+ * @return The backend, NULL if this build doesn't have it
+ */
+const FlipagotchiTransport* flipagotchi_transport_get(FlipagotchiTransportId id);
+
+/**
+ * Find a transport for a unit that no other unit in use has
+ *
+ * @param config Units and what they talk over
+ * @param unit Unit to find one for
+ * @return The first transport this build has that is free, FlipagotchiTransportNum if none is
+ */
+FlipagotchiTransportId
+    flipagotchi_transport_config_free(const FlipagotchiTransportConfig* config, uint8_t unit);
+
+/**
+ * Read the settings from the sd card
+ *
+ * @param config Filled in, with one unit on LPUART1 at FLIPAGOTCHI_TRANSPORT_DEFAULT_RATE and the
+ *               second on USART1 if there are none or they name a backend this build doesn't have
+ * @return If they were read
+ */
+bool flipagotchi_transport_settings_load(FlipagotchiTransportConfig* config);
+
+/**
+ * Write the settings to the sd card
+ *
+ * @param config Settings to write
+ * @return If they were written
+ */
+bool flipagotchi_transport_settings_save(const FlipagotchiTransportConfig* config);
+
+extern const FlipagotchiTransport flipagotchi_transport_lpuart;
+extern const FlipagotchiTransport flipagotchi_transport_usart;
+extern const FlipagotchiTransport flipagotchi_transport_usb_cdc;
+#ifdef FLIPAGOTCHI_TRANSPORT_PTY
+extern const FlipagotchiTransport flipagotchi_transport_pty;
+#endif
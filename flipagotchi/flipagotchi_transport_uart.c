@@ -0,0 +1,109 @@
+#include "flipagotchi_transport.h"
+
+#include <furi_hal_uart.h>
+#include <furi_hal_console.h>
+
+typedef struct {
+    FlipagotchiTransportRxCallback callback;
+    void* context;
+} FlipagotchiTransportUart;
+
+// one per channel, indexed by FuriHalUartId
+static FlipagotchiTransportUart flipagotchi_transport_uart[FuriHalUartIdLPUART1 + 1];
+
+static void flipagotchi_transport_uart_irq_cb(UartIrqEvent ev, uint8_t data, void* context) {
+    FlipagotchiTransportUart* uart = context;
+
+    if(ev == UartIrqEventRXNE) {
+        uart->callback(&data, 1, uart->context);
+    }
+}
+
+static bool flipagotchi_transport_uart_open(
+    FuriHalUartId channel,
+    uint32_t rate,
+    FlipagotchiTransportRxCallback callback,
+    void* context) {
+    FlipagotchiTransportUart* uart = &flipagotchi_transport_uart[channel];
+    uart->callback = callback;
+    uart->context = context;
+
+    if(channel == FuriHalUartIdUSART1) {
+        // the labeled pins are the console's, it has to be quiet or it dirties our wire. this is
+        // annoying for debugging :(
+        furi_hal_console_disable();
+    } else {
+        furi_hal_uart_init(channel, rate);
+    }
+    furi_hal_uart_set_br(channel, rate);
+    furi_hal_uart_set_irq_cb(channel, flipagotchi_transport_uart_irq_cb, uart);
+    return true;
+}
+
+static void flipagotchi_transport_uart_close(FuriHalUartId channel) {
+    furi_hal_uart_set_irq_cb(channel, NULL, NULL);
+    if(channel == FuriHalUartIdUSART1) {
+        // back at the console's rate
+        furi_hal_uart_set_br(channel, FLIPAGOTCHI_TRANSPORT_DEFAULT_RATE);
+        furi_hal_console_enable();
+    } else {
+        furi_hal_uart_deinit(channel);
+    }
+}
+
+static bool flipagotchi_transport_lpuart_open(
+    uint32_t rate,
+    FlipagotchiTransportRxCallback callback,
+    void* context) {
+    return flipagotchi_transport_uart_open(FuriHalUartIdLPUART1, rate, callback, context);
+}
+
+static void flipagotchi_transport_lpuart_tx(const uint8_t* data, size_t length) {
+    // the hal only gives us a blocking tx, it never writes to the buffer
+    furi_hal_uart_tx(FuriHalUartIdLPUART1, (uint8_t*)data, length);
+}
+
+static void flipagotchi_transport_lpuart_set_rate(uint32_t rate) {
+    furi_hal_uart_set_br(FuriHalUartIdLPUART1, rate);
+}
+
+static void flipagotchi_transport_lpuart_close(void) {
+    flipagotchi_transport_uart_close(FuriHalUartIdLPUART1);
+}
+
+static bool flipagotchi_transport_usart_open(
+    uint32_t rate,
+    FlipagotchiTransportRxCallback callback,
+    void* context) {
+    return flipagotchi_transport_uart_open(FuriHalUartIdUSART1, rate, callback, context);
+}
+
+static void flipagotchi_transport_usart_tx(const uint8_t* data, size_t length) {
+    furi_hal_uart_tx(FuriHalUartIdUSART1, (uint8_t*)data, length);
+}
+
+static void flipagotchi_transport_usart_set_rate(uint32_t rate) {
+    furi_hal_uart_set_br(FuriHalUartIdUSART1, rate);
+}
+
+static void flipagotchi_transport_usart_close(void) {
+    flipagotchi_transport_uart_close(FuriHalUartIdUSART1);
+}
+
+const FlipagotchiTransport flipagotchi_transport_lpuart = {
+    .name = "LPUART 15/16",
+    .has_rate = true,
+    .open = flipagotchi_transport_lpuart_open,
+    .tx = flipagotchi_transport_lpuart_tx,
+    .set_rate = flipagotchi_transport_lpuart_set_rate,
+    .close = flipagotchi_transport_lpuart_close,
+};
+
+const FlipagotchiTransport flipagotchi_transport_usart = {
+    .name = "USART 13/14",
+    .has_rate = true,
+    .open = flipagotchi_transport_usart_open,
+    .tx = flipagotchi_transport_usart_tx,
+    .set_rate = flipagotchi_transport_usart_set_rate,
+    .close = flipagotchi_transport_usart_close,
+};
@@ -0,0 +1,126 @@
+#include "flipagotchi_transport.h"
+
+#include <furi_hal_usb.h>
+#include <furi_hal_usb_cdc.h>
+
+/// Interface of the dual cdc config the pwnagotchi gets, the cli keeps interface 0
+#define FLIPAGOTCHI_TRANSPORT_USB_IF 1
+
+/// Longest a packet waits for the host to take the one before it
+#define FLIPAGOTCHI_TRANSPORT_USB_TX_TIMEOUT_MS 100
+
+typedef struct {
+    // config the usb was in before, put back on close
+    FuriHalUsbInterface* previous;
+    FlipagotchiTransportRxCallback callback;
+    void* context;
+    // taken for each packet sent and given back once the host took it
+    FuriSemaphore* tx_done;
+    // the host opened the port, nothing goes out before that
+    volatile bool connected;
+} FlipagotchiTransportUsb;
+
+static FlipagotchiTransportUsb flipagotchi_transport_usb;
+
+static void flipagotchi_transport_usb_on_tx(void* context) {
+    UNUSED(context);
+    furi_semaphore_release(flipagotchi_transport_usb.tx_done);
+}
+
+static void flipagotchi_transport_usb_on_rx(void* context) {
+    UNUSED(context);
+    uint8_t buf[CDC_DATA_SZ];
+    int32_t length = furi_hal_cdc_receive(FLIPAGOTCHI_TRANSPORT_USB_IF, buf, sizeof(buf));
+    if(length > 0) {
+        flipagotchi_transport_usb.callback(buf, length, flipagotchi_transport_usb.context);
+    }
+}
+
+static void flipagotchi_transport_usb_on_state(void* context, uint8_t state) {
+    UNUSED(context);
+    flipagotchi_transport_usb.connected = state == CdcStateConnected;
+    // a packet that was out when the host went away is never taken, don't wait on it
+    furi_semaphore_release(flipagotchi_transport_usb.tx_done);
+}
+
+static CdcCallbacks flipagotchi_transport_usb_callbacks = {
+    .tx_ep_callback = flipagotchi_transport_usb_on_tx,
+    .rx_ep_callback = flipagotchi_transport_usb_on_rx,
+    .state_callback = flipagotchi_transport_usb_on_state,
+    .ctrl_line_callback = NULL,
+    .config_callback = NULL,
+};
+
+static bool flipagotchi_transport_usb_open(
+    uint32_t rate,
+    FlipagotchiTransportRxCallback callback,
+    void* context) {
+    // the host's line coding is whatever it likes, bytes go as fast as the bus takes them
+    UNUSED(rate);
+    FlipagotchiTransportUsb* usb = &flipagotchi_transport_usb;
+
+    usb->previous = furi_hal_usb_get_config();
+    furi_hal_usb_unlock();
+    if(!furi_hal_usb_set_config(&usb_cdc_dual, NULL)) {
+        FURI_LOG_E("PWN", "usb is taken, can't switch it to dual cdc");
+        return false;
+    }
+
+    usb->callback = callback;
+    usb->context = context;
+    usb->connected = false;
+    usb->tx_done = furi_semaphore_alloc(1, 1);
+    // tells us right away if the host already has the port open
+    furi_hal_cdc_set_callbacks(
+        FLIPAGOTCHI_TRANSPORT_USB_IF, &flipagotchi_transport_usb_callbacks, NULL);
+    return true;
+}
+
+static void flipagotchi_transport_usb_tx(const uint8_t* data, size_t length) {
+    FlipagotchiTransportUsb* usb = &flipagotchi_transport_usb;
+    size_t sent = 0;
+    bool full = false;
+
+    while(sent < length || full) {
+        // nobody is listening, the link times out on its own
+        if(!usb->connected) {
+            return;
+        }
+        if(furi_semaphore_acquire(
+               usb->tx_done, furi_ms_to_ticks(FLIPAGOTCHI_TRANSPORT_USB_TX_TIMEOUT_MS)) !=
+           FuriStatusOk) {
+            FURI_LOG_W(
+                "PWN", "usb host isn't reading, dropping %u bytes", (unsigned)(length - sent));
+            return;
+        }
+        uint16_t packet = MIN(length - sent, (size_t)CDC_DATA_SZ);
+        furi_hal_cdc_send(FLIPAGOTCHI_TRANSPORT_USB_IF, (uint8_t*)&data[sent], packet);
+        sent += packet;
+        // the host only sees a write end on a short packet, one that ends on a full one gets an
+        // empty one after it
+        full = packet == CDC_DATA_SZ;
+    }
+}
+
+static void flipagotchi_transport_usb_set_rate(uint32_t rate) {
+    UNUSED(rate);
+}
+
+static void flipagotchi_transport_usb_close(void) {
+    FlipagotchiTransportUsb* usb = &flipagotchi_transport_usb;
+
+    furi_hal_cdc_set_callbacks(FLIPAGOTCHI_TRANSPORT_USB_IF, NULL, NULL);
+    furi_hal_usb_set_config(usb->previous, NULL);
+    furi_semaphore_free(usb->tx_done);
+    usb->tx_done = NULL;
+    usb->connected = false;
+}
+
+const FlipagotchiTransport flipagotchi_transport_usb_cdc = {
+    .name = "USB",
+    .has_rate = false,
+    .open = flipagotchi_transport_usb_open,
+    .tx = flipagotchi_transport_usb_tx,
+    .set_rate = flipagotchi_transport_usb_set_rate,
+    .close = flipagotchi_transport_usb_close,
+};
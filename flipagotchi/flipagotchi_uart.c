@@ -1,12 +1,9 @@
-#include "flipagotchi_uart.h"
-
-struct FlipagotchiUart {
-    FuriThread* uart_worker_thread;
-    FuriThread* cmd_worker_thread;
-    FuriStreamBuffer* rx_stream;
-    ProtocolQueue* queue;
-    bool synack_complete;
-};
+#include "flipagotchi_uart_i.h"
+
+_Static_assert(
+    FLIPAGOTCHI_UART_SCRATCH_SIZE >= sizeof(((PwnMessage*)0)->arguments) &&
+        FLIPAGOTCHI_UART_SCRATCH_SIZE > FILE_CHUNK_SIZE + FILE_CHUNK_OVERHEAD,
+    "scratch holds any crc checked body and a file chunk with one byte over");
 
 const NotificationSequence sequence_notification = {
     &message_display_backlight_on,
@@ -15,43 +12,634 @@ const NotificationSequence sequence_notification = {
     NULL,
 };
 
-static void flipagotchi_send_syn() {
-    uint8_t msg[] = {PACKET_START, CMD_SYN, PACKET_END};
-    furi_hal_uart_tx(PWNAGOTCHI_UART_CHANNEL, msg, sizeof(msg));
+/// What each unit's workers show up as on the diagnostics screen
+static const char* const flipagotchi_uart_io_names[FLIPAGOTCHI_UNITS_MAX] = {"io", "io2"};
+static const char* const flipagotchi_uart_tx_names[FLIPAGOTCHI_UNITS_MAX] = {"tx", "tx2"};
+
+bool flipagotchi_uart_tx(FlipagotchiUart* flipagotchi_uart, const uint8_t* data, size_t len) {
+    furi_assert(flipagotchi_uart);
+    bool queued = false;
+
+    furi_check(furi_mutex_acquire(flipagotchi_uart->tx_mutex, FuriWaitForever) == FuriStatusOk);
+    size_t head = flipagotchi_uart->tx_head;
+    size_t tail = __atomic_load_n(&flipagotchi_uart->tx_tail, __ATOMIC_ACQUIRE);
+    // never queue part of a packet, the pwnagotchi can't recover from a truncated one
+    if(TX_BUF_SIZE - (head - tail) >= len) {
+        for(size_t i = 0; i < len; i++) {
+            flipagotchi_uart->tx_ring[(head + i) & (TX_BUF_SIZE - 1)] = data[i];
+        }
+        // publish the bytes before the tx worker can see the new head
+        __atomic_store_n(&flipagotchi_uart->tx_head, head + len, __ATOMIC_RELEASE);
+        queued = true;
+    }
+    furi_mutex_release(flipagotchi_uart->tx_mutex);
+
+    if(queued) {
+        furi_thread_flags_set(
+            furi_thread_get_id(flipagotchi_uart->tx_worker_thread), WorkerEventTx);
+    } else {
+        FURI_LOG_W("PWN", "tx ring is full! dropping %d bytes", (int)len);
+    }
+
+    return queued;
+}
+
+/**
+ * Send a command whose body is a list of hashes in hex, the pwnagotchi uses them to skip resending
+ * fields we already have
+ */
+static void flipagotchi_send_hashes(
+    FlipagotchiUart* flipagotchi_uart,
+    uint8_t cmd,
+    const uint32_t* hashes,
+    size_t count) {
+    uint8_t msg[FLIPAGOTCHI_STATE_HASH_HEX_LEN * PwnagotchiFieldNum + 3] = {PACKET_START, cmd};
+    furi_assert(count <= PwnagotchiFieldNum);
+
+    size_t len = 2;
+    for(size_t i = 0; i < count; i++) {
+        char hex[FLIPAGOTCHI_STATE_HASH_HEX_LEN + 1];
+        snprintf(hex, sizeof(hex), "%08lx", (unsigned long)hashes[i]);
+        memcpy(&msg[len], hex, FLIPAGOTCHI_STATE_HASH_HEX_LEN);
+        len += FLIPAGOTCHI_STATE_HASH_HEX_LEN;
+    }
+    msg[len++] = PACKET_END;
+    flipagotchi_uart_tx(flipagotchi_uart, msg, len);
+}
+
+static void flipagotchi_send_syn(FlipagotchiUart* flipagotchi_uart) {
+    // syns go out often while probing, keep them to the one state hash
+    uint32_t state_hash = flipagotchi_state_hash_fields(flipagotchi_uart->field_hash);
+    flipagotchi_send_hashes(flipagotchi_uart, CMD_SYN, &state_hash, 1);
 }
 
-static void flipagotchi_send_ack(const uint8_t received_cmd) {
+static void flipagotchi_send_ack(FlipagotchiUart* flipagotchi_uart, const uint8_t received_cmd) {
     uint8_t ack_msg[] = {PACKET_START, CMD_ACK, PACKET_END};
     FURI_LOG_I("PWN", "valid command %02X received, replying with ACK", received_cmd);
-    furi_hal_uart_tx(PWNAGOTCHI_UART_CHANNEL, ack_msg, sizeof(ack_msg));
+    flipagotchi_uart_tx(flipagotchi_uart, ack_msg, sizeof(ack_msg));
 }
 
-static void flipagotchi_send_nak(const uint8_t received_cmd) {
+static void flipagotchi_send_nak(FlipagotchiUart* flipagotchi_uart, const uint8_t received_cmd) {
     uint8_t nak_msg[] = {PACKET_START, CMD_NAK, PACKET_END};
     FURI_LOG_I("PWN", "invalid command %02X received, replying with NAK", received_cmd);
-    furi_hal_uart_tx(PWNAGOTCHI_UART_CHANNEL, nak_msg, sizeof(nak_msg));
+    flipagotchi_uart_tx(flipagotchi_uart, nak_msg, sizeof(nak_msg));
 }
 
-static void flipagotchi_send_ui_refresh() {
-    uint8_t msg[] = {PACKET_START, PWN_CMD_UI_REFRESH, PACKET_END};
+static void flipagotchi_send_ui_refresh(FlipagotchiUart* flipagotchi_uart) {
     FURI_LOG_I("PWN", "sending ui refresh cmd");
-    furi_hal_uart_tx(PWNAGOTCHI_UART_CHANNEL, msg, sizeof(msg));
+    // every field hash, so only the fields that differ are sent again
+    flipagotchi_send_hashes(
+        flipagotchi_uart, PWN_CMD_UI_REFRESH, flipagotchi_uart->field_hash, PwnagotchiFieldNum);
+}
+
+const char* flipagotchi_link_state_name(FlipagotchiLinkState state) {
+    switch(state) {
+    case FlipagotchiLinkProbing:
+        return "probing";
+    case FlipagotchiLinkConnected:
+        return "connected";
+    case FlipagotchiLinkDegraded:
+        return "degraded";
+    case FlipagotchiLinkLost:
+        return "lost";
+    }
+    return "unknown";
+}
+
+static uint32_t flipagotchi_link_jitter(uint32_t delay_ms) {
+    // pick somewhere in the upper half of the delay so both ends don't retry in lockstep
+    return delay_ms / 2 + furi_hal_random_get() % (delay_ms / 2 + 1);
+}
+
+static void flipagotchi_link_start_display_timer(FlipagotchiUart* ctx) {
+    ctx->awaiting_display = true;
+    ctx->display_start_tick = furi_get_tick();
+}
+
+static void flipagotchi_link_set_state(FlipagotchiUart* ctx, FlipagotchiLinkState state) {
+    if(ctx->link_state == state) {
+        return;
+    }
+
+    FURI_LOG_I(
+        "PWN",
+        "link %s -> %s",
+        flipagotchi_link_state_name(ctx->link_state),
+        flipagotchi_link_state_name(state));
+    FlipagotchiLinkState previous = ctx->link_state;
+    ctx->link_state = state;
+
+    switch(state) {
+    case FlipagotchiLinkProbing:
+        ctx->probe_attempts = 0;
+        ctx->next_probe_tick = furi_get_tick();
+        flipagotchi_link_start_display_timer(ctx);
+        break;
+    case FlipagotchiLinkDegraded:
+        // probe right away, if the pwnagotchi is still there it will ack
+        ctx->next_probe_tick = furi_get_tick();
+        break;
+    case FlipagotchiLinkConnected:
+        if(previous == FlipagotchiLinkProbing) {
+            // a new pwnagotchi, or the same one restarted, either way it gets our time
+            flipagotchi_clock_start(ctx->clock);
+            ctx->wake_pending = true;
+        }
+        break;
+    case FlipagotchiLinkLost:
+        flipagotchi_clock_stop(ctx->clock);
+        ctx->wake_pending = true;
+        break;
+    }
+}
+
+/**
+ * Tell the app about news worth waking up for, the caller holds no lock
+ */
+static void flipagotchi_uart_wake(FlipagotchiUart* ctx) {
+    if(!ctx->wake_pending) {
+        return;
+    }
+    ctx->wake_pending = false;
+    furi_mutex_acquire(ctx->wake_mutex, FuriWaitForever);
+    FlipagotchiUartWakeCallback callback = ctx->wake_callback;
+    void* context = ctx->wake_context;
+    furi_mutex_release(ctx->wake_mutex);
+    if(callback != NULL) {
+        callback(context);
+    }
+}
+
+/**
+ * Note a valid message from the pwnagotchi
+ */
+static void flipagotchi_link_on_rx(FlipagotchiUart* ctx) {
+    ctx->last_rx_tick = furi_get_tick();
+    if(ctx->link_state == FlipagotchiLinkDegraded) {
+        flipagotchi_link_set_state(ctx, FlipagotchiLinkConnected);
+    }
+}
+
+/**
+ * Note a ui update from the pwnagotchi made it into the model
+ */
+static void flipagotchi_link_on_display(FlipagotchiUart* ctx) {
+    if(!ctx->awaiting_display) {
+        return;
+    }
+    ctx->awaiting_display = false;
+
+    uint32_t elapsed = furi_get_tick() - ctx->display_start_tick;
+    if(elapsed > furi_ms_to_ticks(PWNAGOTCHI_LINK_DISPLAY_BOUND_MS)) {
+        FURI_LOG_W("PWN", "time to display %lu ticks, over bound", elapsed);
+    } else {
+        FURI_LOG_I("PWN", "time to display %lu ticks", elapsed);
+    }
+}
+
+/**
+ * Runs the link state machine, sending syns when they are due
+ *
+ * @param ctx FlipagotchiUart to operate on
+ * @return Ticks until the state machine needs to run again
+ */
+static uint32_t flipagotchi_link_tick(FlipagotchiUart* ctx) {
+    uint32_t now = furi_get_tick();
+    uint32_t silence = now - ctx->last_rx_tick;
+
+    switch(ctx->link_state) {
+    case FlipagotchiLinkLost:
+        flipagotchi_link_set_state(ctx, FlipagotchiLinkProbing);
+        // fall through
+    case FlipagotchiLinkProbing:
+        if((int32_t)(ctx->next_probe_tick - now) <= 0) {
+            flipagotchi_send_syn(ctx);
+
+            // a few quick retries to catch a pwnagotchi that is just starting up,
+            // then back off exponentially so we don't spam a missing one
+            uint32_t delay = PWNAGOTCHI_LINK_PROBE_MIN_MS;
+            if(ctx->probe_attempts >= PWNAGOTCHI_LINK_PROBE_FAST_RETRIES) {
+                uint32_t shift = MIN(ctx->probe_attempts - PWNAGOTCHI_LINK_PROBE_FAST_RETRIES + 1, 16U);
+                // an idle app can wait longer, each syn wakes the worker and the wire
+                uint32_t max =
+                    ctx->idle ? PWNAGOTCHI_LINK_IDLE_PROBE_MS : PWNAGOTCHI_LINK_PROBE_MAX_MS;
+                delay = MIN((uint32_t)PWNAGOTCHI_LINK_PROBE_MIN_MS << shift, max);
+            }
+            ctx->probe_attempts++;
+            ctx->next_probe_tick = now + furi_ms_to_ticks(flipagotchi_link_jitter(delay));
+        }
+        return ctx->next_probe_tick - now;
+
+    case FlipagotchiLinkConnected:
+        if(silence < furi_ms_to_ticks(PWNAGOTCHI_LINK_DEGRADED_MS)) {
+            return furi_ms_to_ticks(PWNAGOTCHI_LINK_DEGRADED_MS) - silence;
+        }
+        flipagotchi_link_set_state(ctx, FlipagotchiLinkDegraded);
+        // fall through
+    case FlipagotchiLinkDegraded:
+        if(silence >= furi_ms_to_ticks(PWNAGOTCHI_LINK_LOST_MS)) {
+            flipagotchi_link_set_state(ctx, FlipagotchiLinkLost);
+            return 0;
+        }
+        if((int32_t)(ctx->next_probe_tick - now) <= 0) {
+            flipagotchi_send_syn(ctx);
+            ctx->next_probe_tick = now + furi_ms_to_ticks(PWNAGOTCHI_LINK_KEEPALIVE_MS);
+        }
+        return MIN(
+            ctx->next_probe_tick - now, furi_ms_to_ticks(PWNAGOTCHI_LINK_LOST_MS) - silence);
+    }
+
+    return FuriWaitForever;
+}
+
+/**
+ * Runs everything the io worker does on its own, the link state machine and the clock
+ *
+ * @param ctx FlipagotchiUart to operate on
+ * @return Ticks until either needs to run again
+ */
+static uint32_t flipagotchi_io_tick(FlipagotchiUart* ctx) {
+    uint32_t timeout = flipagotchi_link_tick(ctx);
+    return MIN(timeout, flipagotchi_clock_tick(ctx->clock));
 }
 
 void flipagotchi_uart_init(FlipagotchiUart* ctx) {
-    ctx->synack_complete = false;
-    flipagotchi_send_syn();
+    // start from lost so the transition into probing resets the backoff and display timer
+    ctx->link_state = FlipagotchiLinkLost;
+    ctx->last_rx_tick = furi_get_tick();
+    flipagotchi_link_set_state(ctx, FlipagotchiLinkProbing);
+}
+
+
+/**
+ * Copy a string argument into a model field, always leaving the field NUL terminated
+ *
+ * @param dest Model field to write over
+ * @param dest_len Space in dest including the terminator
+ * @param message Message whose arguments hold the string
+ */
+static void flipagotchi_copy_arg(char* dest, size_t dest_len, const PwnMessage* message) {
+    // the pwnagotchi doesn't terminate its strings, stop at the end of the message instead
+    size_t len = strnlen((const char*)message->arguments, MIN(dest_len - 1, sizeof(message->arguments)));
+    memset(dest, 0, dest_len);
+    memcpy(dest, message->arguments, len);
+}
+
+/**
+ * Parse an unsigned ASCII decimal argument, the pwnagotchi sends numbers as text so they can't
+ * collide with the packet framing bytes
+ *
+ * @param digits First digit, runs to the first NUL or max_len
+ * @param max_len Most digits to look at
+ * @param value Where the number goes
+ * @return If there was a number of at most 9 digits and nothing else
+ */
+static bool flipagotchi_parse_decimal(const uint8_t* digits, size_t max_len, uint32_t* value) {
+    size_t len = strnlen((const char*)digits, max_len);
+    if(len == 0 || len > 9) {
+        return false;
+    }
+
+    *value = 0;
+    for(size_t i = 0; i < len; i++) {
+        if(digits[i] < '0' || digits[i] > '9') {
+            return false;
+        }
+        *value = *value * 10 + (digits[i] - '0');
+    }
+    return true;
+}
+
+/**
+ * Reads a binary body, undoing the PACKET_ESCAPE escaping
+ */
+typedef struct {
+    const uint8_t* data;
+    size_t len;
+    size_t pos;
+} FlipagotchiBodyReader;
+
+static bool flipagotchi_body_read(FlipagotchiBodyReader* reader, uint8_t* byte) {
+    if(reader->pos >= reader->len) {
+        return false;
+    }
+    uint8_t value = reader->data[reader->pos++];
+    if(value == PACKET_ESCAPE) {
+        if(reader->pos >= reader->len) {
+            return false;
+        }
+        value = reader->data[reader->pos++] ^ PACKET_ESCAPE_XOR;
+    }
+    *byte = value;
+    return true;
+}
+
+static bool flipagotchi_tile_read(FlipagotchiBodyReader* reader, uint8_t* byte) {
+    if(!flipagotchi_body_read(reader, byte)) {
+        return false;
+    }
+    *byte ^= TILE_XOR;
+    return true;
+}
+
+/**
+ * Walk the tiles of a FLIPPER_CMD_UI_TILES body
+ *
+ * Each tile is an index byte, then either its rows as is when TILE_RAW is set in the index, or
+ * (count, value) runs that add up to the tile height. Every byte is xored with TILE_XOR
+ *
+ * @param pwn_model Model to blit into, the caller holds its lock
+ * @param tiles Escaped tiles, after the TILES_UPDATE or TILES_CLEAR byte
+ * @param len Bytes in tiles
+ * @param apply Blit the tiles, otherwise only check they all decode
+ * @return If every tile decoded
+ */
+static bool flipagotchi_parse_tiles(
+    PwnagotchiModel* pwn_model,
+    const uint8_t* tiles,
+    size_t len,
+    bool apply) {
+    FlipagotchiBodyReader reader = {.data = tiles, .len = len, .pos = 0};
+    uint8_t header;
+    while(flipagotchi_tile_read(&reader, &header)) {
+        uint8_t index = header & ~TILE_RAW;
+        if(index >= PWNAGOTCHI_TILE_COUNT) {
+            return false;
+        }
+
+        uint8_t rows[PWNAGOTCHI_TILE_SIZE];
+        size_t row = 0;
+        while(row < PWNAGOTCHI_TILE_SIZE) {
+            uint8_t count = 1;
+            uint8_t value;
+            if(!(header & TILE_RAW) &&
+               (!flipagotchi_tile_read(&reader, &count) || count == 0 ||
+                count > PWNAGOTCHI_TILE_SIZE - row)) {
+                return false;
+            }
+            if(!flipagotchi_tile_read(&reader, &value)) {
+                return false;
+            }
+            memset(&rows[row], value, count);
+            row += count;
+        }
+
+        if(apply) {
+            pwnagotchi_blit_tile(pwn_model, index, rows);
+        }
+    }
+    return true;
+}
+
+/**
+ * Turn an element id from the pwnagotchi into its slot in the element table
+ *
+ * @param id Id as sent, ELEMENT_BYTE_OFFSET above the slot
+ * @param index Where the slot goes
+ * @return If the id has a slot
+ */
+static bool flipagotchi_element_index(uint8_t id, size_t* index) {
+    if(id < ELEMENT_BYTE_OFFSET || id - ELEMENT_BYTE_OFFSET >= PWNAGOTCHI_MAX_ELEMENTS) {
+        return false;
+    }
+    *index = id - ELEMENT_BYTE_OFFSET;
+    return true;
+}
+
+/**
+ * Read a FLIPPER_CMD_UI_ELEMENT declaration
+ *
+ * After the id come x, y, font and the most characters of the value to keep, each
+ * ELEMENT_BYTE_OFFSET above its value, then the label
+ *
+ * @param message Message holding the declaration
+ * @param element Where the declared element goes, its value starts out empty
+ * @return If the element fits on the screen and in the table
+ */
+static bool flipagotchi_parse_element(const PwnMessage* message, PwnagotchiElement* element) {
+    const uint8_t* args = message->arguments;
+    for(size_t i = 1; i <= 4; i++) {
+        if(args[i] < ELEMENT_BYTE_OFFSET) {
+            return false;
+        }
+    }
+
+    uint8_t x = args[1] - ELEMENT_BYTE_OFFSET;
+    uint8_t y = args[2] - ELEMENT_BYTE_OFFSET;
+    uint8_t font = args[3] - ELEMENT_BYTE_OFFSET;
+    uint8_t max_len = args[4] - ELEMENT_BYTE_OFFSET;
+    if(x >= FLIPPER_SCREEN_WIDTH || y >= FLIPPER_SCREEN_HEIGHT || font >= FontTotalNumber ||
+       max_len == 0 || max_len >= PWNAGOTCHI_MAX_ELEMENT_VALUE_LEN) {
+        return false;
+    }
+
+    memset(element, 0, sizeof(PwnagotchiElement));
+    element->declared = true;
+    element->x = x;
+    element->y = y;
+    element->font = font;
+    element->max_len = max_len;
+    // a label too long for the slot is cut short like any other string
+    size_t label_len = strnlen((const char*)&args[5], sizeof(element->label) - 1);
+    memcpy(element->label, &args[5], label_len);
+    return true;
+}
+
+/**
+ * Unescape a crc checked body and check its crc32
+ *
+ * A flipped bit in a bssid would leave an access point in the table that nothing ever evicts, or
+ * a wrong handshake in the browser's cache until it is closed, so unlike the fields these bodies
+ * are checked
+ *
+ * @param message Message to read
+ * @param body Where the unescaped body goes, FLIPAGOTCHI_UART_SCRATCH_SIZE of it
+ * @param len Where the length of the body without its crc32 goes
+ * @return If the crc32 matched
+ */
+static bool flipagotchi_crc_body(const PwnMessage* message, uint8_t* body, size_t* len) {
+    // escaping keeps 0 out of the body, so it ends where the arguments do
+    FlipagotchiBodyReader reader = {
+        .data = message->arguments,
+        .len = strnlen((const char*)message->arguments, sizeof(message->arguments)),
+        .pos = 0,
+    };
+    size_t n = 0;
+    while(flipagotchi_body_read(&reader, &body[n])) {
+        n++;
+    }
+    if(reader.pos != reader.len || n < BODY_CRC_SIZE) {
+        return false;
+    }
+
+    n -= BODY_CRC_SIZE;
+    uint32_t crc = body[n] | body[n + 1] << 8 | body[n + 2] << 16 | (uint32_t)body[n + 3] << 24;
+    *len = n;
+    return flipagotchi_offload_crc32(0, body, n) == crc;
+}
+
+/**
+ * Walk the access point records of a FLIPPER_CMD_AP_SET body
+ *
+ * Each record is the bssid, the rssi as a signed byte, channel, security, clients and the length
+ * of the ssid, then the ssid
+ *
+ * @param table Table to store into, the caller holds the model lock
+ * @param records Unescaped records
+ * @param len Bytes in records
+ * @param apply Store the records, otherwise only check they decode and the new ones fit
+ * @return If every record decoded and the table has room for them
+ */
+static bool flipagotchi_parse_aps(
+    PwnagotchiApTable* table,
+    const uint8_t* records,
+    size_t len,
+    bool apply) {
+    size_t pos = 0;
+    size_t added = 0;
+    while(pos < len) {
+        if(len - pos < AP_RECORD_HEADER_SIZE) {
+            return false;
+        }
+        const uint8_t* header = &records[pos];
+        pos += AP_RECORD_HEADER_SIZE;
+
+        PwnagotchiAp ap;
+        memset(&ap, 0, sizeof(ap));
+        memcpy(ap.bssid, header, PWNAGOTCHI_BSSID_LEN);
+        ap.rssi = (int8_t)header[6];
+        ap.channel = header[7];
+        ap.security = header[8];
+        ap.clients = header[9];
+        uint8_t ssid_len = header[10];
+        if(ap.security > AP_SECURITY_WPA3 || ssid_len > AP_SSID_MAX_LEN || len - pos < ssid_len) {
+            return false;
+        }
+        for(size_t i = 0; i < ssid_len; i++) {
+            uint8_t c = records[pos++];
+            if(c < ' ' || c > '~') {
+                return false;
+            }
+            ap.ssid[i] = c;
+        }
+
+        if(apply) {
+            flipagotchi_aps_set(table, &ap);
+        } else if(flipagotchi_aps_find(table, ap.bssid) == NULL) {
+            added++;
+        }
+    }
+    return apply || table->count + added <= PWNAGOTCHI_MAX_APS;
+}
+
+/**
+ * Walk the channel records of a FLIPPER_CMD_CHANNEL_STATS body
+ *
+ * Each record is the channel, the KiB of traffic as 2 little endian bytes, access points seen and
+ * handshakes captured since the last one. Channels the heatmap doesn't keep are skipped
+ *
+ * @param table Heatmap to add to, the caller holds the model lock
+ * @param records Unescaped records
+ * @param len Bytes in records
+ * @param apply Add the records, otherwise only check they decode
+ * @return If every record decoded
+ */
+static bool flipagotchi_parse_channels(
+    PwnagotchiChannelTable* table,
+    const uint8_t* records,
+    size_t len,
+    bool apply) {
+    if(len % CHANNEL_RECORD_SIZE != 0) {
+        return false;
+    }
+    if(!apply) {
+        return true;
+    }
+
+    // counts go in on top of what decayed until now, not before
+    flipagotchi_channels_decay(table, furi_get_tick());
+    for(size_t pos = 0; pos < len; pos += CHANNEL_RECORD_SIZE) {
+        int slot = flipagotchi_channels_slot(records[pos]);
+        if(slot < 0) {
+            continue;
+        }
+        flipagotchi_channels_add(
+            table, slot, PwnagotchiHeatTraffic, records[pos + 1] | records[pos + 2] << 8);
+        flipagotchi_channels_add(table, slot, PwnagotchiHeatAps, records[pos + 3]);
+        flipagotchi_channels_add(table, slot, PwnagotchiHeatHandshakes, records[pos + 4]);
+    }
+    return true;
 }
 
+/**
+ * Walk the peer records of a FLIPPER_CMD_PEER_SET body
+ *
+ * Each record is the key as 4 little endian bytes, face, rssi as a signed byte, pwned as 2 little
+ * endian bytes, seconds since it was last heard as 2 little endian bytes and the length of the
+ * name, then the name
+ *
+ * @param table Table to store into, the caller holds the model lock
+ * @param records Unescaped records
+ * @param len Bytes in records
+ * @param apply Store the records, otherwise only check they decode and the new ones fit
+ * @return If every record decoded and the table has room for them
+ */
+static bool flipagotchi_parse_peers(
+    PwnagotchiPeerTable* table,
+    const uint8_t* records,
+    size_t len,
+    bool apply) {
+    uint32_t now = furi_get_tick();
+    size_t pos = 0;
+    size_t added = 0;
+    while(pos < len) {
+        if(len - pos < PEER_RECORD_HEADER_SIZE) {
+            return false;
+        }
+        const uint8_t* header = &records[pos];
+        pos += PEER_RECORD_HEADER_SIZE;
+
+        PwnagotchiPeer peer;
+        memset(&peer, 0, sizeof(peer));
+        peer.key = header[0] | header[1] << 8 | header[2] << 16 | (uint32_t)header[3] << 24;
+        peer.face = header[4];
+        peer.rssi = (int8_t)header[5];
+        peer.pwned = header[6] | header[7] << 8;
+        uint16_t seen = header[8] | header[9] << 8;
+        peer.seen_tick = now - furi_ms_to_ticks((uint32_t)seen * 1000);
+        uint8_t name_len = header[10];
+        if(peer.face < Look_r || peer.face >= EndFace || name_len > PEER_NAME_MAX_LEN ||
+           len - pos < name_len) {
+            return false;
+        }
+        for(size_t i = 0; i < name_len; i++) {
+            uint8_t c = records[pos++];
+            if(c < ' ' || c > '~') {
+                return false;
+            }
+            peer.name[i] = c;
+        }
+
+        if(apply) {
+            flipagotchi_peers_set(table, &peer);
+        } else if(flipagotchi_peers_find(table, peer.key) == NULL) {
+            added++;
+        }
+    }
+    return apply || table->count + added <= PWNAGOTCHI_MAX_PEERS;
+}
 
 static bool flipagotchi_exec_cmd(PwnagotchiModel* pwn_model, FlipagotchiUart* flipagotchi_uart) {
     if (protocol_queue_has_message(flipagotchi_uart->queue)) {
         PwnMessage message;
         protocol_queue_pop_message(flipagotchi_uart->queue, &message);
         FURI_LOG_I("PWN", "Has message (code: %02X), processing...", message.code);
-        //TODO REMOVE, only here to debug crashes
-        flipagotchi_send_ack(message.code);
-        return false;
+        flipagotchi_link_on_rx(flipagotchi_uart);
+
+        if (message.code >= FLIPPER_CMD_UI_FACE && message.code <= FLIPPER_CMD_UI_FACE_ANIM) {
+            // the pwnagotchi sends either fields or tiles, a field means it is back to fields
+            pwn_model->mirror = false;
+        }
 
         // See what the message wants
         switch (message.code) {
@@ -59,141 +647,160 @@ static bool flipagotchi_exec_cmd(PwnagotchiModel* pwn_model, FlipagotchiUart* fl
             // Process ACK
             case CMD_ACK: {
               FURI_LOG_I("PWN", "received ACK");
-              //TODO NOT IMPLEMENTED
-              //TODO, add logic to ensure every message we send receives an ACK
+              // replies to mode, reboot, shutdown and clock set carry the command's code and go
+              // to whoever waits on it, each times out on its own. a bare ack answers a syn or a
+              // ui refresh, only the link state below cares. a lost refresh isn't sent again, the
+              // screen catches up as the fields change. file acks and handshake list requests
+              // are never answered, the pwnagotchi's resend window and the browser's retry cover
+              // a lost one
+
+              if (message.arguments[0] == PWN_CMD_CLOCK_SET) {
+                  flipagotchi_clock_reply(flipagotchi_uart->clock, true);
+              } else if (message.arguments[0] != 0) {
+                  // answers one of our commands, nothing else carries a body
+                  flipagotchi_control_reply(flipagotchi_uart->control, message.arguments[0], true);
+              }
 
-              if (!flipagotchi_uart->synack_complete){
-                  flipagotchi_uart->synack_complete = true;
+              if (flipagotchi_uart->link_state == FlipagotchiLinkProbing){
                   // this ack is likely an ack to our last syn
-                  // assume that is true, and mark synack complete
+                  // assume that is true, and mark the link connected
+                  flipagotchi_link_set_state(flipagotchi_uart, FlipagotchiLinkConnected);
 
                   // either we start first, or the pwnagotchi does
                   // if the pwn does, then we won't have up to date ui elements
-                  // send a ui refresh.
-                  // if we get a reply, pwn started first
-                  // if we don't get a reply, just move on. we probably started first
-                  // pwn will update us when it gets going
+                  // send a ui refresh so we get a full resync either way
                   FURI_LOG_I("PWN", "sending ui refresh");
-                  flipagotchi_send_ui_refresh();
+                  flipagotchi_send_ui_refresh(flipagotchi_uart);
+              }
+              break;
+            }
+
+            // Process NAK
+            case CMD_NAK: {
+              // never answered, a NAK back would have the two of us NAKing each other forever
+              FURI_LOG_I("PWN", "received NAK");
+              if (message.arguments[0] == PWN_CMD_CLOCK_SET) {
+                  flipagotchi_clock_reply(flipagotchi_uart->clock, false);
+              } else if (message.arguments[0] != 0) {
+                  flipagotchi_control_reply(flipagotchi_uart->control, message.arguments[0], false);
               }
               break;
             }
 
             // Process SYN
             case CMD_SYN: {
-              flipagotchi_send_ack(message.code);
+              flipagotchi_send_ack(flipagotchi_uart, message.code);
+
+              if (flipagotchi_uart->link_state == FlipagotchiLinkProbing){
+                  // the pwnagotchi resends everything once its syn is acked, no refresh needed
+                  flipagotchi_link_set_state(flipagotchi_uart, FlipagotchiLinkConnected);
+              } else {
+                  // a syn on a live link means the pwnagotchi restarted, time its resync
+                  flipagotchi_link_start_display_timer(flipagotchi_uart);
+              }
               break;
             }
 
             // Process Face
             case FLIPPER_CMD_UI_FACE: {
+                if (message.arguments[0] < Look_r || message.arguments[0] >= EndFace) {
+                    flipagotchi_send_nak(flipagotchi_uart, message.code);
+                    return false;
+                }
+
                 // send ack before handling to avoid stalling the pwnagotchi
-                flipagotchi_send_ack(message.code);
+                flipagotchi_send_ack(flipagotchi_uart, message.code);
 
                 pwn_model->face = message.arguments[0];
+                // a still face replaces whatever animation was playing
+                pwn_model->animation = PwnAnimation_None;
+                pwn_model->field_hash[PwnagotchiFieldFace] = flipagotchi_state_message_hash(&message);
 
                 return true;
             }
 
-            // Process Name
-            case FLIPPER_CMD_UI_NAME: {
+            // Process face animation, we step the frames from here on
+            case FLIPPER_CMD_UI_FACE_ANIM: {
+                uint32_t period_ms = 0;
+                if (!flipagotchi_parse_decimal(&message.arguments[1], sizeof(message.arguments) - 1, &period_ms) ||
+                    !pwnagotchi_animation_is_valid(message.arguments[0], period_ms)) {
+                    flipagotchi_send_nak(flipagotchi_uart, message.code);
+                    return false;
+                }
+
                 // send ack before handling to avoid stalling the pwnagotchi
-                flipagotchi_send_ack(message.code);
+                flipagotchi_send_ack(flipagotchi_uart, message.code);
 
-                // Write over hostname with nothing
-                strncpy(pwn_model->hostname, "", PWNAGOTCHI_MAX_HOSTNAME_LEN);
+                pwnagotchi_start_animation(pwn_model, message.arguments[0], period_ms);
+                pwn_model->field_hash[PwnagotchiFieldFace] = flipagotchi_state_message_hash(&message);
 
-                for (size_t i = 0; i < PWNAGOTCHI_MAX_HOSTNAME_LEN; i++) {
-                    // Break if we hit the end of the name
-                    if (message.arguments[i] == 0x00) {
-                        break;
-                    }
+                return true;
+            }
 
-                    pwn_model->hostname[i] = message.arguments[i];
-                }
+            // Process Name
+            case FLIPPER_CMD_UI_NAME: {
+                // send ack before handling to avoid stalling the pwnagotchi
+                flipagotchi_send_ack(flipagotchi_uart, message.code);
+
+                flipagotchi_copy_arg(pwn_model->hostname, PWNAGOTCHI_MAX_HOSTNAME_LEN, &message);
+                pwn_model->field_hash[PwnagotchiFieldName] = flipagotchi_state_message_hash(&message);
                 return true;
             }
 
             // Process channel
             case FLIPPER_CMD_UI_CHANNEL: {
                 // send ack before handling to avoid stalling the pwnagotchi
-                flipagotchi_send_ack(message.code);
+                flipagotchi_send_ack(flipagotchi_uart, message.code);
 
-                // Write over channel with nothing
-                strncpy(pwn_model->channel, "", PWNAGOTCHI_MAX_CHANNEL_LEN);
-
-                for (size_t i = 0; i < PWNAGOTCHI_MAX_CHANNEL_LEN; i++) {
-                    // Break if we hit the end of the name
-                    if (message.arguments[i] == 0x00) {
-                        break;
-                    }
-
-                    pwn_model->channel[i] = message.arguments[i];
-                }
+                flipagotchi_copy_arg(pwn_model->channel, PWNAGOTCHI_MAX_CHANNEL_LEN, &message);
+                pwn_model->field_hash[PwnagotchiFieldChannel] = flipagotchi_state_message_hash(&message);
                 return true;
             }
 
             // Process APS (Access Points)
             case FLIPPER_CMD_UI_APS: {
                 // send ack before handling to avoid stalling the pwnagotchi
-                flipagotchi_send_ack(message.code);
+                flipagotchi_send_ack(flipagotchi_uart, message.code);
 
-                // Write over APS with nothing
-                strncpy(pwn_model->apStat, "", PWNAGOTCHI_MAX_APS_LEN);
-
-                for (size_t i = 0; i < PWNAGOTCHI_MAX_APS_LEN; i++) {
-                    // Break if we hit the end of the name
-                    if (message.arguments[i] == 0x00) {
-                        break;
-                    }
-                    pwn_model->apStat[i] = message.arguments[i];
-                }
+                flipagotchi_copy_arg(pwn_model->apStat, PWNAGOTCHI_MAX_APS_LEN, &message);
+                pwn_model->field_hash[PwnagotchiFieldAps] = flipagotchi_state_message_hash(&message);
                 return true;
             }
 
             // Process uptime
             case FLIPPER_CMD_UI_UPTIME: {
                 // send ack before handling to avoid stalling the pwnagotchi
-                flipagotchi_send_ack(message.code);
-
-                // Write over uptime with nothing
-                strncpy(pwn_model->uptime, "", PWNAGOTCHI_MAX_UPTIME_LEN);
+                flipagotchi_send_ack(flipagotchi_uart, message.code);
 
-                for (size_t i = 0; i < PWNAGOTCHI_MAX_UPTIME_LEN; i++) {
-                    // Break if we hit the end of the name
-                    if (message.arguments[i] == 0x00) {
-                        break;
-                    }
-                    pwn_model->uptime[i] = message.arguments[i];
-                }
+                flipagotchi_copy_arg(pwn_model->uptime, PWNAGOTCHI_MAX_UPTIME_LEN, &message);
+                pwn_model->field_hash[PwnagotchiFieldUptime] = flipagotchi_state_message_hash(&message);
                 return true;
             }
 
             // Process friend
             case FLIPPER_CMD_UI_FRIEND: {
                 // send ack before handling to avoid stalling the pwnagotchi
-                flipagotchi_send_ack(message.code);
+                flipagotchi_send_ack(flipagotchi_uart, message.code);
 
-                // Friend not implemented yet,
-                // nothing to update
+                // the closest friend comes from the peer table, nothing to update
                 return false;
             }
 
             // Process mode
             case FLIPPER_CMD_UI_MODE: {
                 // send ack before handling to avoid stalling the pwnagotchi
-                flipagotchi_send_ack(message.code);
+                flipagotchi_send_ack(flipagotchi_uart, message.code);
 
                 enum PwnagotchiMode mode;
 
                 switch (message.arguments[0]) {
-                    case 0x04:
+                    case MODE_MANUAL:
                         mode = PwnMode_Manual;
                         break;
-                    case 0x05:
+                    case MODE_AUTO:
                         mode = PwnMode_Auto;
                         break;
-                    case 0x06:
+                    case MODE_AI:
                         mode = PwnMode_Ai;
                         break;
                     default:
@@ -201,6 +808,7 @@ static bool flipagotchi_exec_cmd(PwnagotchiModel* pwn_model, FlipagotchiUart* fl
                         break;
                 }
                 pwn_model->mode = mode;
+                pwn_model->field_hash[PwnagotchiFieldMode] = flipagotchi_state_message_hash(&message);
 
                 return true;
             }
@@ -208,42 +816,256 @@ static bool flipagotchi_exec_cmd(PwnagotchiModel* pwn_model, FlipagotchiUart* fl
             // Process Handshakes
             case FLIPPER_CMD_UI_HANDSHAKES: {
                 // send ack before handling to avoid stalling the pwnagotchi
-                flipagotchi_send_ack(message.code);
+                flipagotchi_send_ack(flipagotchi_uart, message.code);
 
-                // Write over handshakes with nothing
-                strncpy(pwn_model->handshakes, "", PWNAGOTCHI_MAX_HANDSHAKES_LEN);
-
-                for (size_t i = 0; i < PWNAGOTCHI_MAX_HANDSHAKES_LEN; i++) {
-                    // Break if we hit the end of the name
-                    if (message.arguments[i] == 0x00) {
-                        break;
-                    }
-                    pwn_model->handshakes[i] = message.arguments[i];
-                }
+                flipagotchi_copy_arg(pwn_model->handshakes, PWNAGOTCHI_MAX_HANDSHAKES_LEN, &message);
+                pwn_model->field_hash[PwnagotchiFieldHandshakes] = flipagotchi_state_message_hash(&message);
                 return true;
             }
 
             // Process status
             case FLIPPER_CMD_UI_STATUS: {
                 // send ack before handling to avoid stalling the pwnagotchi
-                flipagotchi_send_ack(message.code);
+                flipagotchi_send_ack(flipagotchi_uart, message.code);
+
+                flipagotchi_copy_arg(pwn_model->status, PWNAGOTCHI_MAX_STATUS_LEN, &message);
+                pwn_model->field_hash[PwnagotchiFieldStatus] = flipagotchi_state_message_hash(&message);
+                FURI_LOG_I("PWN", "rec status: %s", pwn_model->status);
+                return true;
+            }
+            // Process framebuffer tiles
+            case FLIPPER_CMD_UI_TILES: {
+                // escaping keeps 0 out of the body, so it ends where the arguments do
+                const uint8_t* tiles = &message.arguments[1];
+                size_t len = strnlen((const char*)tiles, sizeof(message.arguments) - 1);
+
+                // check the whole body first, half a frame is worse than the last one
+                if ((message.arguments[0] != TILES_UPDATE && message.arguments[0] != TILES_CLEAR) ||
+                    !flipagotchi_parse_tiles(pwn_model, tiles, len, false)) {
+                    flipagotchi_send_nak(flipagotchi_uart, message.code);
+                    return false;
+                }
+
+                // send ack before handling to avoid stalling the pwnagotchi
+                flipagotchi_send_ack(flipagotchi_uart, message.code);
 
-                // Write over the status with nothing
-                strncpy(pwn_model->status, "", PWNAGOTCHI_MAX_STATUS_LEN);
+                if (message.arguments[0] == TILES_CLEAR) {
+                    memset(pwn_model->framebuffer, 0, PWNAGOTCHI_FRAMEBUFFER_SIZE);
+                }
+                flipagotchi_parse_tiles(pwn_model, tiles, len, true);
+                pwn_model->mirror = true;
+                // nothing of the face shows, don't keep stepping it
+                pwn_model->animation = PwnAnimation_None;
+                return true;
+            }
 
-                for (size_t i = 0; i < PWNAGOTCHI_MAX_STATUS_LEN; i++) {
-                    if (message.arguments[i] == 0x00) {
-                        break;
-                    }
-                    pwn_model->status[i] = message.arguments[i];
+            // Process a plugin element declaration, an id on its own removes the element
+            case FLIPPER_CMD_UI_ELEMENT: {
+                size_t index;
+                PwnagotchiElement element;
+                bool remove = message.arguments[1] == 0;
+                if (!flipagotchi_element_index(message.arguments[0], &index) ||
+                    (!remove && !flipagotchi_parse_element(&message, &element))) {
+                    flipagotchi_send_nak(flipagotchi_uart, message.code);
+                    return false;
                 }
-                FURI_LOG_I("PWN", "rec status: %s", pwn_model->status);
+
+                // send ack before handling to avoid stalling the pwnagotchi
+                flipagotchi_send_ack(flipagotchi_uart, message.code);
+
+                if (remove) {
+                    memset(&pwn_model->elements[index], 0, sizeof(PwnagotchiElement));
+                } else {
+                    pwn_model->elements[index] = element;
+                }
+                return true;
+            }
+
+            // Process a plugin element value
+            case FLIPPER_CMD_UI_ELEMENT_SET: {
+                size_t index;
+                if (!flipagotchi_element_index(message.arguments[0], &index) ||
+                    !pwn_model->elements[index].declared) {
+                    flipagotchi_send_nak(flipagotchi_uart, message.code);
+                    return false;
+                }
+
+                // send ack before handling to avoid stalling the pwnagotchi
+                flipagotchi_send_ack(flipagotchi_uart, message.code);
+
+                PwnagotchiElement* element = &pwn_model->elements[index];
+                size_t len = strnlen((const char*)&message.arguments[1], element->max_len);
+                memset(element->value, 0, sizeof(element->value));
+                memcpy(element->value, &message.arguments[1], len);
                 return true;
             }
+
+            // Process the start of a file offload, the offload acks where the file picks up later
+            case FLIPPER_CMD_FILE_OPEN: {
+                if (!flipagotchi_offload_open(flipagotchi_uart->offload, message.arguments, sizeof(message.arguments))) {
+                    flipagotchi_send_nak(flipagotchi_uart, message.code);
+                    return false;
+                }
+                flipagotchi_send_ack(flipagotchi_uart, message.code);
+                return false;
+            }
+
+            // Process a chunk of the file being offloaded, the offload acks chunks a window at a time
+            case FLIPPER_CMD_FILE_CHUNK: {
+                uint8_t* chunk = flipagotchi_uart->scratch;
+                size_t len = 0;
+                // escaping keeps 0 out of the body, so it ends where the arguments do
+                FlipagotchiBodyReader reader = {
+                    .data = message.arguments,
+                    .len = strnlen((const char*)message.arguments, sizeof(message.arguments)),
+                    .pos = 0,
+                };
+                // one byte over a whole chunk is enough to tell it is too long
+                while (len < FILE_CHUNK_SIZE + FILE_CHUNK_OVERHEAD + 1 &&
+                       flipagotchi_body_read(&reader, &chunk[len])) {
+                    len++;
+                }
+                flipagotchi_offload_chunk(flipagotchi_uart->offload, chunk, len);
+                return false;
+            }
+
+            // Process access points that showed up or changed
+            case FLIPPER_CMD_AP_SET: {
+                uint8_t* body = flipagotchi_uart->scratch;
+                size_t len;
+
+                // all or nothing, so the pwnagotchi knows exactly what we have
+                if (!flipagotchi_crc_body(&message, body, &len) ||
+                    !flipagotchi_parse_aps(pwn_model->aps, body, len, false)) {
+                    flipagotchi_send_nak(flipagotchi_uart, message.code);
+                    return false;
+                }
+
+                // send ack before handling to avoid stalling the pwnagotchi
+                flipagotchi_send_ack(flipagotchi_uart, message.code);
+
+                flipagotchi_parse_aps(pwn_model->aps, body, len, true);
+                // nothing to redraw unless the list is on screen
+                return pwn_model->page == PwnagotchiPageAps;
+            }
+
+            // Process access points that went away, no bssids at all empties the table
+            case FLIPPER_CMD_AP_EVICT: {
+                uint8_t* body = flipagotchi_uart->scratch;
+                size_t len;
+
+                if (!flipagotchi_crc_body(&message, body, &len) ||
+                    len % PWNAGOTCHI_BSSID_LEN != 0) {
+                    flipagotchi_send_nak(flipagotchi_uart, message.code);
+                    return false;
+                }
+
+                // send ack before handling to avoid stalling the pwnagotchi
+                flipagotchi_send_ack(flipagotchi_uart, message.code);
+
+                if (len == 0) {
+                    flipagotchi_aps_clear(pwn_model->aps);
+                }
+                // ones we don't have are skipped
+                for (size_t i = 0; i < len; i += PWNAGOTCHI_BSSID_LEN) {
+                    flipagotchi_aps_evict(pwn_model->aps, &body[i]);
+                }
+                return pwn_model->page == PwnagotchiPageAps;
+            }
+
+            // Process what was seen on each channel since the last one
+            case FLIPPER_CMD_CHANNEL_STATS: {
+                uint8_t* body = flipagotchi_uart->scratch;
+                size_t len;
+
+                if (!flipagotchi_crc_body(&message, body, &len) ||
+                    !flipagotchi_parse_channels(pwn_model->channels, body, len, false)) {
+                    flipagotchi_send_nak(flipagotchi_uart, message.code);
+                    return false;
+                }
+
+                // send ack before handling to avoid stalling the pwnagotchi
+                flipagotchi_send_ack(flipagotchi_uart, message.code);
+
+                flipagotchi_parse_channels(pwn_model->channels, body, len, true);
+                // a handshake on any channel is a new capture, worth waking up for
+                for(size_t pos = 0; pos < len; pos += CHANNEL_RECORD_SIZE) {
+                    if(body[pos + 4] > 0) {
+                        flipagotchi_uart->wake_pending = true;
+                    }
+                }
+                return pwn_model->page == PwnagotchiPageChannels;
+            }
+
+            // Process peers that showed up or changed
+            case FLIPPER_CMD_PEER_SET: {
+                uint8_t* body = flipagotchi_uart->scratch;
+                size_t len;
+
+                // all or nothing, so the pwnagotchi knows exactly what we have
+                if (!flipagotchi_crc_body(&message, body, &len) ||
+                    !flipagotchi_parse_peers(pwn_model->peers, body, len, false)) {
+                    flipagotchi_send_nak(flipagotchi_uart, message.code);
+                    return false;
+                }
+
+                // send ack before handling to avoid stalling the pwnagotchi
+                flipagotchi_send_ack(flipagotchi_uart, message.code);
+
+                flipagotchi_parse_peers(pwn_model->peers, body, len, true);
+                // the peer list reads the table on its own, only the closest friend is drawn here
+                return pwn_model->page == PwnagotchiPageFace;
+            }
+
+            // Process peers the pwnagotchi lost, no keys at all empties the table
+            case FLIPPER_CMD_PEER_EXPIRE: {
+                uint8_t* body = flipagotchi_uart->scratch;
+                size_t len;
+
+                if (!flipagotchi_crc_body(&message, body, &len) || len % PEER_KEY_SIZE != 0) {
+                    flipagotchi_send_nak(flipagotchi_uart, message.code);
+                    return false;
+                }
+
+                // send ack before handling to avoid stalling the pwnagotchi
+                flipagotchi_send_ack(flipagotchi_uart, message.code);
+
+                if (len == 0) {
+                    flipagotchi_peers_clear(pwn_model->peers);
+                }
+                // ones we don't have are skipped
+                for (size_t i = 0; i < len; i += PEER_KEY_SIZE) {
+                    flipagotchi_peers_expire(
+                        pwn_model->peers,
+                        body[i] | body[i + 1] << 8 | body[i + 2] << 16 |
+                            (uint32_t)body[i + 3] << 24);
+                }
+                return pwn_model->page == PwnagotchiPageFace;
+            }
+
+            // Process a page of the handshake list the browser asked for
+            case FLIPPER_CMD_HANDSHAKE_PAGE: {
+                uint8_t* body = flipagotchi_uart->scratch;
+                size_t len;
+
+                if (!flipagotchi_crc_body(&message, body, &len) ||
+                    !flipagotchi_handshakes_page(flipagotchi_uart->handshakes, body, len, false)) {
+                    flipagotchi_send_nak(flipagotchi_uart, message.code);
+                    return false;
+                }
+
+                // send ack before handling to avoid stalling the pwnagotchi
+                flipagotchi_send_ack(flipagotchi_uart, message.code);
+
+                // the browser has its own view, nothing here to redraw
+                flipagotchi_handshakes_page(flipagotchi_uart->handshakes, body, len, true);
+                return false;
+            }
+
             default: {
                 // didn't match any of the known FLIPPER_CMDs
                 // reply with a NAK
-                flipagotchi_send_nak(message.code);
+                flipagotchi_send_nak(flipagotchi_uart, message.code);
                 return false;
             }
         }
@@ -252,138 +1074,392 @@ static bool flipagotchi_exec_cmd(PwnagotchiModel* pwn_model, FlipagotchiUart* fl
     return false;
 }
 
-static void flipagotchi_on_irq_cb(UartIrqEvent ev, uint8_t data, void* context) {
+_Static_assert((RX_BUF_SIZE & (RX_BUF_SIZE - 1)) == 0, "RX_BUF_SIZE must be a power of two");
+_Static_assert((TX_BUF_SIZE & (TX_BUF_SIZE - 1)) == 0, "TX_BUF_SIZE must be a power of two");
+
+static void flipagotchi_on_rx(const uint8_t* data, size_t length, void* context) {
     furi_assert(context);
-    // loads the rx_stream with each byte we receive
+    // loads the rx ring with the bytes we receive, a byte at a time from the uart irq and a packet
+    // at a time from usb
     FlipagotchiUart* flipagotchi_uart = context;
 
-    if(ev == UartIrqEventRXNE) {
-        // put bytes onto the rx_stream, one by one as they come in
+    size_t head = flipagotchi_uart->rx_head;
+    size_t tail = __atomic_load_n(&flipagotchi_uart->rx_tail, __ATOMIC_ACQUIRE);
+    size_t space = RX_BUF_SIZE - (head - tail);
+    if(length > space) {
+        flipagotchi_uart->rx_overruns += length - space;
+        length = space;
+    }
+    if(length == 0) {
+        return;
+    }
+
+    for(size_t i = 0; i < length; i++) {
+        flipagotchi_uart->rx_ring[(head + i) & (RX_BUF_SIZE - 1)] = data[i];
+    }
+    // publish the bytes before the io worker can see the new head
+    __atomic_store_n(&flipagotchi_uart->rx_head, head + length, __ATOMIC_RELEASE);
+    furi_thread_flags_set(furi_thread_get_id(flipagotchi_uart->io_worker_thread), WorkerEventRx);
+}
 
+/**
+ * Run what waits in the rx ring through the framer, straight out of the ring, until the queue is
+ * full. Whatever is left stays in the ring for once the queue has been dispatched
+ *
+ * @param flipagotchi_uart FlipagotchiUart to operate on
+ * @return Number of bytes consumed
+ */
+static size_t flipagotchi_rx_frame(FlipagotchiUart* flipagotchi_uart) {
+    size_t head = __atomic_load_n(&flipagotchi_uart->rx_head, __ATOMIC_ACQUIRE);
+    size_t start = flipagotchi_uart->rx_tail;
+    size_t tail = start;
+
+    for(; tail != head && !protocol_queue_is_full(flipagotchi_uart->queue); tail++) {
+        protocol_queue_push_byte(flipagotchi_uart->queue, flipagotchi_uart->rx_ring[tail & (RX_BUF_SIZE - 1)]);
+    }
+    // hand the slots back to the rx callback only once we are done reading them
+    __atomic_store_n(&flipagotchi_uart->rx_tail, tail, __ATOMIC_RELEASE);
+
+    return tail - start;
+}
 
-        if (data < 65){
-          FURI_LOG_I("PWN", "pushing %02X to queue", data);
+/**
+ * Dispatch queued messages into the model, at most PWNAGOTCHI_DISPATCH_BATCH_MAX of them
+ *
+ * @param pwn_model Model to update, the caller holds its lock
+ * @param flipagotchi_uart FlipagotchiUart to operate on
+ * @param update Set if any of the messages changed the model
+ * @return Number of messages dispatched
+ */
+static size_t flipagotchi_exec_batch(
+    PwnagotchiModel* pwn_model,
+    FlipagotchiUart* flipagotchi_uart,
+    bool* update) {
+    size_t count = 0;
+    while(count < PWNAGOTCHI_DISPATCH_BATCH_MAX &&
+          protocol_queue_has_message(flipagotchi_uart->queue)) {
+        if(flipagotchi_exec_cmd(pwn_model, flipagotchi_uart)) {
+            *update = true;
         }
-        else{
-          FURI_LOG_I("PWN", "pushing %c to queue", data);
+        count++;
+    }
+    if(*update) {
+        // the handshakes field only changes with a new capture, or a restart that cleared them
+        if(flipagotchi_uart->field_hash[PwnagotchiFieldHandshakes] !=
+           pwn_model->field_hash[PwnagotchiFieldHandshakes]) {
+            flipagotchi_uart->wake_pending = true;
         }
+        memcpy(flipagotchi_uart->field_hash, pwn_model->field_hash, sizeof(flipagotchi_uart->field_hash));
+    }
+    return count;
+}
+
+static void flipagotchi_dispatch_stats_record(FlipagotchiUart* ctx, size_t count) {
+    FlipagotchiDispatchStats* stats = &ctx->dispatch_stats;
+    stats->wakeups++;
+    stats->messages += count;
+    stats->max_per_wakeup = MAX(stats->max_per_wakeup, count);
+    stats->histogram[MIN(count, PWNAGOTCHI_DISPATCH_HISTOGRAM_SIZE - 1)]++;
+}
+
+void flipagotchi_uart_get_dispatch_stats(FlipagotchiUart* ctx, FlipagotchiDispatchStats* stats) {
+    furi_assert(ctx);
+    // fields are word sized, a snapshot taken mid update is off by one message at worst
+    memcpy(stats, &ctx->dispatch_stats, sizeof(FlipagotchiDispatchStats));
+}
+
+FlipagotchiLinkState flipagotchi_uart_get_link_state(FlipagotchiUart* ctx) {
+    furi_assert(ctx);
+    return ctx->link_state;
+}
+
+uint32_t flipagotchi_uart_get_rx_overruns(FlipagotchiUart* ctx) {
+    furi_assert(ctx);
+    return ctx->rx_overruns;
+}
+
+FlipagotchiHandshakes* flipagotchi_uart_get_handshakes(FlipagotchiUart* ctx) {
+    furi_assert(ctx);
+    return ctx->handshakes;
+}
+
+FlipagotchiControl* flipagotchi_uart_get_control(FlipagotchiUart* ctx) {
+    furi_assert(ctx);
+    return ctx->control;
+}
+
+FlipagotchiClock* flipagotchi_uart_get_clock(FlipagotchiUart* ctx) {
+    furi_assert(ctx);
+    return ctx->clock;
+}
+
+void flipagotchi_uart_get_offload_stats(FlipagotchiUart* ctx, FlipagotchiOffloadStats* stats) {
+    furi_assert(ctx);
+    flipagotchi_offload_get_stats(ctx->offload, stats);
+}
+
+void flipagotchi_uart_set_transport(
+    FlipagotchiUart* ctx,
+    const FlipagotchiTransportSettings* transport) {
+    furi_assert(ctx);
+    furi_mutex_acquire(ctx->transport_mutex, FuriWaitForever);
+    ctx->transport_request = *transport;
+    furi_mutex_release(ctx->transport_mutex);
+    furi_thread_flags_set(furi_thread_get_id(ctx->io_worker_thread), WorkerEventTransport);
+}
+
+void flipagotchi_uart_set_idle(FlipagotchiUart* ctx, bool idle) {
+    furi_assert(ctx);
+    ctx->idle = idle;
+    furi_thread_flags_set(furi_thread_get_id(ctx->io_worker_thread), WorkerEventIdle);
+}
+
+void flipagotchi_uart_set_wake_callback(
+    FlipagotchiUart* ctx,
+    FlipagotchiUartWakeCallback callback,
+    void* context) {
+    furi_assert(ctx);
+    furi_mutex_acquire(ctx->wake_mutex, FuriWaitForever);
+    ctx->wake_callback = callback;
+    ctx->wake_context = context;
+    furi_mutex_release(ctx->wake_mutex);
+}
+
+void flipagotchi_uart_get_transport(FlipagotchiUart* ctx, FlipagotchiTransportSettings* transport) {
+    furi_assert(ctx);
+    furi_mutex_acquire(ctx->transport_mutex, FuriWaitForever);
+    *transport = ctx->transport_settings;
+    furi_mutex_release(ctx->transport_mutex);
+}
+
+/**
+ * Open the transport asked for, or LPUART1 if it can't be, the caller holds the transport mutex
+ */
+static void flipagotchi_transport_setup(FlipagotchiUart* ctx) {
+    FlipagotchiTransportSettings* settings = &ctx->transport_settings;
+    *settings = ctx->transport_request;
+    ctx->transport = flipagotchi_transport_get(settings->id);
+    if(ctx->transport == NULL || !ctx->transport->open(settings->rate, flipagotchi_on_rx, ctx)) {
+        FURI_LOG_W("PWN", "transport %u won't open, using lpuart", (unsigned)settings->id);
+        settings->id = FlipagotchiTransportLpuart;
+        ctx->transport = flipagotchi_transport_get(settings->id);
+        furi_check(ctx->transport->open(settings->rate, flipagotchi_on_rx, ctx));
+    }
+    FURI_LOG_I(
+        "PWN", "talking over %s at %lu", ctx->transport->name, (unsigned long)settings->rate);
+}
+
+static void flipagotchi_transport_teardown(FlipagotchiUart* ctx) {
+    FURI_LOG_I("PWN", "close %s", ctx->transport->name);
+    ctx->transport->close();
+    ctx->transport = NULL;
+}
 
-        furi_stream_buffer_send(flipagotchi_uart->rx_stream, &data, 1, 0);
-        furi_thread_flags_set(furi_thread_get_id(flipagotchi_uart->uart_worker_thread), WorkerEventRx);
+/**
+ * Pick up a transport or line rate asked for with flipagotchi_uart_set_transport
+ */
+static void flipagotchi_transport_switch(FlipagotchiUart* ctx) {
+    // the tx worker is kept off the wire while it changes
+    furi_mutex_acquire(ctx->transport_mutex, FuriWaitForever);
+    FlipagotchiTransportSettings* request = &ctx->transport_request;
+    bool reopen = request->id != ctx->transport_settings.id;
+    if(reopen) {
+        flipagotchi_transport_teardown(ctx);
+        flipagotchi_transport_setup(ctx);
+    } else if(request->rate != ctx->transport_settings.rate) {
+        FURI_LOG_I("PWN", "%s at %lu", ctx->transport->name, (unsigned long)request->rate);
+        ctx->transport->set_rate(request->rate);
+        ctx->transport_settings.rate = request->rate;
     }
+    furi_mutex_release(ctx->transport_mutex);
+
+    if(reopen) {
+        // whoever is on the new wire has never heard of us, probe for them right away
+        flipagotchi_link_set_state(ctx, FlipagotchiLinkLost);
+    }
+}
+
+/**
+ * Pick up the app going idle or waking up, asked for with flipagotchi_uart_set_idle
+ */
+static void flipagotchi_io_set_idle(FlipagotchiUart* ctx) {
+    uint32_t animation_period = 0;
+    if(!ctx->idle) {
+        with_view_model(
+            pwnagotchi_get_view(ctx->pwnagotchi),
+            PwnagotchiModel * model,
+            { animation_period = pwnagotchi_animation_timer_period(model); },
+            false);
+        // whoever woke the app up shouldn't wait out the rest of an idle probe delay
+        if(ctx->link_state == FlipagotchiLinkProbing) {
+            ctx->next_probe_tick = furi_get_tick();
+        }
+    }
+    // the timer takes the model lock, so it is only touched once we let go
+    pwnagotchi_run_animation_timer(ctx->pwnagotchi, animation_period);
 }
 
-static int32_t flipagotchi_uart_worker(void* context) {
+static int32_t flipagotchi_tx_worker(void* context) {
     furi_assert(context);
     FlipagotchiUart* flipagotchi_uart = context;
 
-    FURI_LOG_I("PWN", "setup uart");
-    // setup uart
-    if(PWNAGOTCHI_UART_CHANNEL == FuriHalUartIdUSART1) {
-      // when using the main uart, aka the ones labeled on the flippper, we
-      // MUST DISABLE CONSOLE OR ELSE IT DIRTIES OUR UART!
-      // this is annoying for debugging :(
-      furi_hal_console_disable();
-    } else if(PWNAGOTCHI_UART_CHANNEL == FuriHalUartIdLPUART1) {
-      furi_hal_uart_init(PWNAGOTCHI_UART_CHANNEL, PWNAGOTCHI_UART_BAUD);
-    }
-    furi_hal_uart_set_br(PWNAGOTCHI_UART_CHANNEL, PWNAGOTCHI_UART_BAUD);
-    furi_hal_uart_set_irq_cb(PWNAGOTCHI_UART_CHANNEL, flipagotchi_on_irq_cb, flipagotchi_uart);
-
-    uint8_t rx_buf[RX_BUF_SIZE + 1];
-    FURI_LOG_I("PWN", "uart worker, staring loop");
+    // the transports only give us a blocking tx, so this thread is the only one that ever waits
+    // on the wire. everyone else just drops bytes into the tx ring and moves on
+    FURI_LOG_I("PWN", "tx worker, starting loop");
     while(true) {
         uint32_t events =
-            furi_thread_flags_wait(WORKER_EVENTS_MASK, FuriFlagWaitAny, FuriWaitForever);
+            furi_thread_flags_wait(TX_WORKER_EVENTS_MASK, FuriFlagWaitAny, FuriWaitForever);
         furi_check((events & FuriFlagError) == 0);
 
         if(events & WorkerEventStop) {
-            FURI_LOG_I("PWN", "uart_worker received stop");
+            FURI_LOG_I("PWN", "tx_worker received stop");
             break;
-        }
-        else if(events & WorkerEventRx) {
-            size_t length = furi_stream_buffer_receive(flipagotchi_uart->rx_stream, rx_buf, RX_BUF_SIZE, 0);
-            if(length > 0) {
-                for(size_t i = 0; i < length; i++) {
-                    protocol_queue_push_byte(flipagotchi_uart->queue, rx_buf[i]);
-                }
-                furi_thread_flags_set(furi_thread_get_id(flipagotchi_uart->cmd_worker_thread), WorkerEventRx);
+        } else if(events & WorkerEventTx) {
+            // drain everything that is pending, small control replies that queued up
+            // while we were busy go out together in one write. the write blocks until
+            // the bytes are on the wire, so it goes straight from the ring
+            size_t head = __atomic_load_n(&flipagotchi_uart->tx_head, __ATOMIC_ACQUIRE);
+            size_t tail = flipagotchi_uart->tx_tail;
+            while(tail != head) {
+                size_t offset = tail & (TX_BUF_SIZE - 1);
+                size_t length = MIN(MIN(head - tail, TX_BUF_SIZE - offset), (size_t)TX_BATCH_SIZE);
+                // a batch at a time, so a switch of transports only ever waits on one
+                furi_mutex_acquire(flipagotchi_uart->transport_mutex, FuriWaitForever);
+                flipagotchi_uart->transport->tx(&flipagotchi_uart->tx_ring[offset], length);
+                furi_mutex_release(flipagotchi_uart->transport_mutex);
+                tail += length;
+                // hand the sent bytes back to the producers a batch at a time
+                __atomic_store_n(&flipagotchi_uart->tx_tail, tail, __ATOMIC_RELEASE);
             }
         }
     }
 
-
-    FURI_LOG_I("PWN", "free uart");
-    // free uart
-    if(PWNAGOTCHI_UART_CHANNEL == FuriHalUartIdUSART1){
-      furi_hal_console_enable();
-    }
-    else if(PWNAGOTCHI_UART_CHANNEL == FuriHalUartIdLPUART1){
-      furi_hal_uart_deinit(PWNAGOTCHI_UART_CHANNEL);
-    }
-    furi_hal_uart_set_irq_cb(PWNAGOTCHI_UART_CHANNEL, NULL, NULL);
-
     return 0;
 }
 
-static int32_t flipagotchi_cmd_worker(void* context){
+static int32_t flipagotchi_io_worker(void* context){
     furi_assert(context);
     FlipagotchiUart* flipagotchi_uart = context;
 
-    FURI_LOG_I("PWN", "alloc rx stream buffert");
-    // alloc incoming stream for uart thread
-    flipagotchi_uart->rx_stream = furi_stream_buffer_alloc(RX_BUF_SIZE, 1);
-
-    FURI_LOG_I("PWN", "alloc uart thread");
-    // uart thread
-    flipagotchi_uart->uart_worker_thread = furi_thread_alloc();
-    furi_thread_set_stack_size(flipagotchi_uart->uart_worker_thread, 1024);
-    furi_thread_set_context(flipagotchi_uart->uart_worker_thread, flipagotchi_uart);
-    furi_thread_set_callback(flipagotchi_uart->uart_worker_thread, flipagotchi_uart_worker);
-    furi_thread_start(flipagotchi_uart->uart_worker_thread);
+    // the transport feeds the rx ring and wakes us directly, framing and dispatch both happen
+    // here. it is there before the tx worker can write to it
+    furi_mutex_acquire(flipagotchi_uart->transport_mutex, FuriWaitForever);
+    flipagotchi_transport_setup(flipagotchi_uart);
+    furi_mutex_release(flipagotchi_uart->transport_mutex);
+
+    FURI_LOG_I("PWN", "alloc tx thread");
+    // tx thread
+    flipagotchi_uart->tx_worker_thread = furi_thread_alloc();
+    furi_thread_set_stack_size(flipagotchi_uart->tx_worker_thread, FLIPAGOTCHI_TX_WORKER_STACK_SIZE);
+    furi_thread_set_context(flipagotchi_uart->tx_worker_thread, flipagotchi_uart);
+    furi_thread_set_callback(flipagotchi_uart->tx_worker_thread, flipagotchi_tx_worker);
+    furi_thread_start(flipagotchi_uart->tx_worker_thread);
+    flipagotchi_diag_heap_account(FlipagotchiDiagHeapUart, FLIPAGOTCHI_TX_WORKER_STACK_SIZE);
+    flipagotchi_diag_thread_add(
+        flipagotchi_uart_tx_names[flipagotchi_uart->unit],
+        furi_thread_get_id(flipagotchi_uart->tx_worker_thread),
+        FLIPAGOTCHI_TX_WORKER_STACK_SIZE);
+
+    View* view = pwnagotchi_get_view(flipagotchi_uart->pwnagotchi);
+    // the model may have been restored from the sd card, our first syn already tells the pwnagotchi
+    uint32_t animation_period = 0;
+    with_view_model(
+        view,
+        PwnagotchiModel * model,
+        {
+            memcpy(
+                flipagotchi_uart->field_hash, model->field_hash, sizeof(flipagotchi_uart->field_hash));
+            animation_period = pwnagotchi_animation_timer_period(model);
+        },
+        false);
+    pwnagotchi_run_animation_timer(flipagotchi_uart->pwnagotchi, animation_period);
 
     flipagotchi_uart_init(flipagotchi_uart);
 
-    FURI_LOG_I("PWN", "cmd_worker, starting loop");
+    uint32_t timeout = 0;
+
+    FURI_LOG_I("PWN", "io_worker, starting loop");
     while(true) {
         uint32_t events =
-            furi_thread_flags_wait(WORKER_EVENTS_MASK, FuriFlagWaitAny, FuriWaitForever);
+            furi_thread_flags_wait(WORKER_EVENTS_MASK, FuriFlagWaitAny, timeout);
+        if(events == (uint32_t)FuriFlagErrorTimeout) {
+            // nothing received, just keep the link state machine and the clock moving
+            timeout = flipagotchi_io_tick(flipagotchi_uart);
+            flipagotchi_uart_wake(flipagotchi_uart);
+            continue;
+        }
         furi_check((events & FuriFlagError) == 0);
 
         if(events & WorkerEventStop) {
-          FURI_LOG_I("PWN", "cmd_worker received stop");
+          FURI_LOG_I("PWN", "io_worker received stop");
           break;
         }
-        else if(events & WorkerEventRx) {
-            /* with_view_model( */
-            /*         flipagotchi_uart->view, */
-            /*         PwnDumpModel* model, */
-            /*         { */
-            /*             update = flipagotchi_exec_cmd(model, flipagotchi_uart); */
-            /*         }, */
-            /*         update); */
-            flipagotchi_exec_cmd(NULL, flipagotchi_uart);
+        if(events & WorkerEventTransport) {
+            flipagotchi_transport_switch(flipagotchi_uart);
+        }
+        if(events & WorkerEventIdle) {
+            flipagotchi_io_set_idle(flipagotchi_uart);
+        }
+        if(events & WorkerEventRx) {
+            // rx flags coalesce, so one wakeup can stand for any number of messages, more than the
+            // queue holds. frame what fits and dispatch a batch in turn until the ring is empty, a
+            // batch per model lock and redraw so the gui still gets a look in between
+            size_t dispatched = 0;
+            while(flipagotchi_rx_frame(flipagotchi_uart) > 0 ||
+                  protocol_queue_has_message(flipagotchi_uart->queue)) {
+                bool update = false;
+                with_view_model(
+                        view,
+                        PwnagotchiModel* model,
+                        {
+                            dispatched += flipagotchi_exec_batch(model, flipagotchi_uart, &update);
+                            animation_period = pwnagotchi_animation_timer_period(model);
+                        },
+                        update);
+
+                if(update) {
+                    flipagotchi_link_on_display(flipagotchi_uart);
+                    // the timer takes the model lock, so it is only touched once we let go. an idle
+                    // screen shows the face as it is
+                    pwnagotchi_run_animation_timer(
+                        flipagotchi_uart->pwnagotchi,
+                        flipagotchi_uart->idle ? 0 : animation_period);
+                }
+            }
+            flipagotchi_dispatch_stats_record(flipagotchi_uart, dispatched);
+            flipagotchi_uart_wake(flipagotchi_uart);
 
             // light up the screen and blink the led
             /* notification_message(flipagotchi_uart->notification, &sequence_notification); */
-            // with_view_model(
-            // flipagotchi_uart->view, PwnDumpModel * model, { UNUSED(model); }, true);
         }
 
+        timeout = flipagotchi_io_tick(flipagotchi_uart);
+        flipagotchi_uart_wake(flipagotchi_uart);
     }
 
-
-    FURI_LOG_I("PWN", "free uart worker");
-    furi_thread_flags_set(furi_thread_get_id(flipagotchi_uart->uart_worker_thread), WorkerEventStop);
-    FURI_LOG_I("PWN", "free uart worker: joining");
-    furi_thread_join(flipagotchi_uart->uart_worker_thread);
-    FURI_LOG_I("PWN", "free uart worker: freeing");
-    furi_thread_free(flipagotchi_uart->uart_worker_thread);
-    FURI_LOG_I("PWN", "free uart worker: setting NULL");
-    flipagotchi_uart->uart_worker_thread = NULL;
-
-    FURI_LOG_I("PWN", "free stream buffer");
-    furi_stream_buffer_free(flipagotchi_uart->rx_stream);
+    FURI_LOG_I(
+        "PWN",
+        "dispatched %lu messages in %lu wakeups, at most %lu per wakeup, %lu rx bytes dropped",
+        flipagotchi_uart->dispatch_stats.messages,
+        flipagotchi_uart->dispatch_stats.wakeups,
+        flipagotchi_uart->dispatch_stats.max_per_wakeup,
+        flipagotchi_uart->rx_overruns);
+
+    // no more chunks come in, and the offload worker may still have an ack for the tx worker
+    flipagotchi_offload_free(flipagotchi_uart->offload);
+
+    FURI_LOG_I("PWN", "free tx worker");
+    flipagotchi_diag_thread_remove(furi_thread_get_id(flipagotchi_uart->tx_worker_thread));
+    furi_thread_flags_set(furi_thread_get_id(flipagotchi_uart->tx_worker_thread), WorkerEventStop);
+    furi_thread_join(flipagotchi_uart->tx_worker_thread);
+    furi_thread_free(flipagotchi_uart->tx_worker_thread);
+    flipagotchi_uart->tx_worker_thread = NULL;
+    flipagotchi_diag_heap_account(FlipagotchiDiagHeapUart, -FLIPAGOTCHI_TX_WORKER_STACK_SIZE);
+
+    // nobody writes to it anymore
+    furi_mutex_acquire(flipagotchi_uart->transport_mutex, FuriWaitForever);
+    flipagotchi_transport_teardown(flipagotchi_uart);
+    furi_mutex_release(flipagotchi_uart->transport_mutex);
 
     return 0;
 }
@@ -402,35 +1478,83 @@ static int32_t flipagotchi_cmd_worker(void* context){
 /*   } */
 /* } */
 
-FlipagotchiUart* flipagotchi_uart_alloc(){
-    FlipagotchiUart* flipagotchi_uart = malloc(sizeof(FlipagotchiUart));
+FlipagotchiUart* flipagotchi_uart_alloc(
+    FlipagotchiArena* arena,
+    Pwnagotchi* pwnagotchi,
+    uint8_t unit,
+    const FlipagotchiTransportSettings* transport) {
+    // comes back zeroed, which is where both rings and the stats start
+    FlipagotchiUart* flipagotchi_uart =
+        flipagotchi_arena_carve(arena, FlipagotchiDiagHeapUart, sizeof(FlipagotchiUart));
+
+    flipagotchi_uart->pwnagotchi = pwnagotchi;
+    flipagotchi_uart->unit = unit;
+    flipagotchi_uart->link_state = FlipagotchiLinkLost;
+
+    // opened by the io worker once it is up, reads as the one asked for until then
+    flipagotchi_uart->transport_mutex = furi_mutex_alloc(FuriMutexTypeNormal);
+    flipagotchi_uart->transport_request = *transport;
+    flipagotchi_uart->transport_settings = *transport;
+
+    // outgoing bytes, drained by the tx worker
+    flipagotchi_uart->tx_mutex = furi_mutex_alloc(FuriMutexTypeNormal);
+
+    // nobody to wake until the app asks
+    flipagotchi_uart->wake_mutex = furi_mutex_alloc(FuriMutexTypeNormal);
 
-    flipagotchi_uart->synack_complete = false;
     FURI_LOG_I("PWN", "alloc queue");
     // Queue
-    flipagotchi_uart->queue = protocol_queue_alloc();
+    flipagotchi_uart->queue = protocol_queue_alloc(arena);
 
-    FURI_LOG_I("PWN", "alloc threads cmd parser thread");
-    // command parser thread
-    flipagotchi_uart->cmd_worker_thread = furi_thread_alloc();
-    furi_thread_set_stack_size(flipagotchi_uart->cmd_worker_thread, 1024);
-    furi_thread_set_context(flipagotchi_uart->cmd_worker_thread, flipagotchi_uart);
-    furi_thread_set_callback(flipagotchi_uart->cmd_worker_thread, flipagotchi_cmd_worker);
-    furi_thread_start(flipagotchi_uart->cmd_worker_thread);
+    // files from the pwnagotchi, freed by the io worker on its way out
+    flipagotchi_uart->offload = flipagotchi_offload_alloc(arena, flipagotchi_uart, unit);
+
+    flipagotchi_uart->handshakes = flipagotchi_handshakes_alloc(arena, flipagotchi_uart);
+
+    flipagotchi_uart->control = flipagotchi_control_alloc(arena, flipagotchi_uart);
+
+    flipagotchi_uart->clock = flipagotchi_clock_alloc(arena, flipagotchi_uart);
+
+    FURI_LOG_I("PWN", "alloc io thread");
+    // rx, framing and command dispatch thread
+    flipagotchi_uart->io_worker_thread = furi_thread_alloc();
+    furi_thread_set_stack_size(flipagotchi_uart->io_worker_thread, FLIPAGOTCHI_IO_WORKER_STACK_SIZE);
+    furi_thread_set_context(flipagotchi_uart->io_worker_thread, flipagotchi_uart);
+    furi_thread_set_callback(flipagotchi_uart->io_worker_thread, flipagotchi_io_worker);
+    furi_thread_start(flipagotchi_uart->io_worker_thread);
+    flipagotchi_diag_heap_account(FlipagotchiDiagHeapUart, FLIPAGOTCHI_IO_WORKER_STACK_SIZE);
+    flipagotchi_diag_thread_add(
+        flipagotchi_uart_io_names[unit],
+        furi_thread_get_id(flipagotchi_uart->io_worker_thread),
+        FLIPAGOTCHI_IO_WORKER_STACK_SIZE);
 
     return flipagotchi_uart;
 }
 
 void flipagotchi_uart_free(FlipagotchiUart* flipagotchi_uart){
-    FURI_LOG_I("PWN", "free cmd worker");
+    FURI_LOG_I("PWN", "free io worker");
     // free workers
+    flipagotchi_diag_thread_remove(furi_thread_get_id(flipagotchi_uart->io_worker_thread));
     furi_thread_flags_set(
-        furi_thread_get_id(flipagotchi_uart->cmd_worker_thread), WorkerEventStop);
-    furi_thread_join(flipagotchi_uart->cmd_worker_thread);
-    furi_thread_free(flipagotchi_uart->cmd_worker_thread);
-    flipagotchi_uart->cmd_worker_thread = NULL;
+        furi_thread_get_id(flipagotchi_uart->io_worker_thread), WorkerEventStop);
+    furi_thread_join(flipagotchi_uart->io_worker_thread);
+    furi_thread_free(flipagotchi_uart->io_worker_thread);
+    flipagotchi_uart->io_worker_thread = NULL;
+    flipagotchi_diag_heap_account(FlipagotchiDiagHeapUart, -FLIPAGOTCHI_IO_WORKER_STACK_SIZE);
 
     FURI_LOG_I("PWN", "free queue");
     // Free Queue
     protocol_queue_free(flipagotchi_uart->queue);
+
+    // no more pages come in
+    flipagotchi_handshakes_free(flipagotchi_uart->handshakes);
+    flipagotchi_control_free(flipagotchi_uart->control);
+    flipagotchi_clock_free(flipagotchi_uart->clock);
+
+    furi_mutex_free(flipagotchi_uart->tx_mutex);
+    flipagotchi_uart->tx_mutex = NULL;
+    furi_mutex_free(flipagotchi_uart->wake_mutex);
+    flipagotchi_uart->wake_mutex = NULL;
+    furi_mutex_free(flipagotchi_uart->transport_mutex);
+    flipagotchi_uart->transport_mutex = NULL;
 }
@@ -1,40 +1,257 @@
 #pragma once
 
 #include <furi.h>
-#include <furi_hal_uart.h>
 #include <notification/notification.h>
 #include <notification/notification_messages.h>
-#include <furi_hal_uart.h>
-#include <furi_hal_console.h>
+#include <furi_hal_random.h>
 
 #include "views/pwnagotchi.h"
 #include "protocol.h"
 #include "protocol_queue.h"
+#include "flipagotchi_state.h"
+#include "flipagotchi_diag.h"
+#include "flipagotchi_arena.h"
+#include "flipagotchi_offload.h"
+#include "flipagotchi_aps.h"
+#include "flipagotchi_channels.h"
+#include "flipagotchi_peers.h"
+#include "flipagotchi_handshakes.h"
+#include "flipagotchi_control.h"
+#include "flipagotchi_clock.h"
+#include "flipagotchi_transport.h"
 
-/// Defines the channel that the pwnagotchi uses
-// TX pin 15, RX pin 16
-#define PWNAGOTCHI_UART_CHANNEL FuriHalUartIdLPUART1
-// TX pin 13, RX pin 14
-/* #define PWNAGOTCHI_UART_CHANNEL FuriHalUartIdUSART1 */
+/// Size of the ring the transport's rx callback writes received bytes into, must be a power of two
+#define RX_BUF_SIZE 2048
 
-/// Defines the baudrate that the pwnagotchi will use
-#define PWNAGOTCHI_UART_BAUD 115200
+/// Stack of the io worker, which frames and dispatches everything we receive. 608 B of its own,
+/// see flipagotchi_diag.h for the margin
+#define FLIPAGOTCHI_IO_WORKER_STACK_SIZE 2048
 
-#define RX_BUF_SIZE 2048
+/// Stack of the tx worker. The transport write is an indirect call the chain can't follow, the
+/// host's watermark of 456 B stands in for it
+#define FLIPAGOTCHI_TX_WORKER_STACK_SIZE 1536
+
+/// Size of the transmit ring that outgoing packets are queued into, must be a power of two
+#define TX_BUF_SIZE 512
+
+/// Max number of bytes the tx worker hands to the transport in a single write
+/// Everything pending in the tx ring up to this size goes out as one batch
+#define TX_BATCH_SIZE 64
+
+/// Delay between the first few syn retries while probing for the pwnagotchi
+#define PWNAGOTCHI_LINK_PROBE_MIN_MS 50
+
+/// Number of retries at PWNAGOTCHI_LINK_PROBE_MIN_MS before we start backing off exponentially
+#define PWNAGOTCHI_LINK_PROBE_FAST_RETRIES 3
+
+/// Upper bound on the syn retry delay, this bounds time to display after the pwnagotchi restarts
+#define PWNAGOTCHI_LINK_PROBE_MAX_MS 2000
+
+/// Syn retry delay while the app is idle, a pwnagotchi coming up is still shown within this
+#define PWNAGOTCHI_LINK_IDLE_PROBE_MS 10000
+
+/// Silence after which a connected link is considered degraded and we start sending keepalive syns
+#define PWNAGOTCHI_LINK_DEGRADED_MS 5000
+
+/// Delay between keepalive syns while the link is degraded
+#define PWNAGOTCHI_LINK_KEEPALIVE_MS 1000
+
+/// Silence after which the link is considered lost and we go back to probing
+#define PWNAGOTCHI_LINK_LOST_MS 15000
+
+/// Time to display above this gets logged as a warning
+#define PWNAGOTCHI_LINK_DISPLAY_BOUND_MS 1000
+
+/// Max number of messages dispatched under a single lock of the view model
+/// The io worker keeps dispatching batches until the queue is empty, releasing the model in between
+#define PWNAGOTCHI_DISPATCH_BATCH_MAX 8
+
+/// Number of buckets in the dispatch batch size histogram
+#define PWNAGOTCHI_DISPATCH_HISTOGRAM_SIZE 8
+
+/**
+ * How many messages the io worker dispatched per rx wakeup
+ */
+typedef struct {
+    /// Rx wakeups of the io worker, including ones that only got part of a packet
+    uint32_t wakeups;
+    /// Messages dispatched over all wakeups
+    uint32_t messages;
+    /// Most messages dispatched in a single wakeup
+    uint32_t max_per_wakeup;
+    /// Wakeups by number of messages dispatched, the last bucket also counts every larger wakeup
+    uint32_t histogram[PWNAGOTCHI_DISPATCH_HISTOGRAM_SIZE];
+} FlipagotchiDispatchStats;
+
+/**
+ * State of the link to the pwnagotchi
+ */
+typedef enum {
+    /// Nothing heard from the pwnagotchi yet, sending syns with backoff
+    FlipagotchiLinkProbing,
+    /// Pwnagotchi is talking to us
+    FlipagotchiLinkConnected,
+    /// Pwnagotchi went quiet, sending keepalive syns to find out if it is still there
+    FlipagotchiLinkDegraded,
+    /// Pwnagotchi went quiet for too long, about to go back to probing
+    FlipagotchiLinkLost,
+} FlipagotchiLinkState;
 
 typedef enum {
     WorkerEventReserved = (1 << 0), // Reserved for StreamBuffer internal event
     WorkerEventStop = (1 << 1),
     WorkerEventRx = (1 << 2),
+    WorkerEventTx = (1 << 3),
+    WorkerEventTransport = (1 << 4),
+    WorkerEventIdle = (1 << 5),
 } WorkerEventFlags;
 
-#define WORKER_EVENTS_MASK (WorkerEventStop | WorkerEventRx)
+#define WORKER_EVENTS_MASK \
+    (WorkerEventStop | WorkerEventRx | WorkerEventTransport | WorkerEventIdle)
+#define TX_WORKER_EVENTS_MASK (WorkerEventStop | WorkerEventTx)
 
 typedef struct FlipagotchiUart FlipagotchiUart;
 
-FlipagotchiUart* flipagotchi_uart_alloc();
+/// Called from the io worker when something comes in worth waking an idle app up for
+typedef void (*FlipagotchiUartWakeCallback)(void* context);
+
+/**
+ * Carve the uart state out of the arena and start the io worker
+ *
+ * @param arena Arena to carve from, FLIPAGOTCHI_UART_ARENA_SIZE of it is used
+ * @param pwnagotchi View whose model received updates go into
+ * @param unit Which of the app's links this is, picks its state file and offload dir
+ * @param transport What to talk to the pwnagotchi over, LPUART1 is used if it can't be opened
+ * @return Pointer to the uart state
+ */
+FlipagotchiUart* flipagotchi_uart_alloc(
+    FlipagotchiArena* arena,
+    Pwnagotchi* pwnagotchi,
+    uint8_t unit,
+    const FlipagotchiTransportSettings* transport);
 
 void flipagotchi_uart_free(FlipagotchiUart* flip_uart);
 
 void flipagotchi_uart_init(FlipagotchiUart* app);
 
+/**
+ * Queue bytes for transmission to the pwnagotchi
+ *
+ * Copies the bytes into the tx ring and wakes the tx worker, returns without waiting
+ * for the bytes to go out on the wire. Either the whole buffer is queued or none of it is
+ *
+ * @param flip_uart FlipagotchiUart to send on
+ * @param data Bytes to send
+ * @param len Number of bytes in data
+ * @return If the bytes were queued, false if the tx ring did not have room for them
+ */
+bool flipagotchi_uart_tx(FlipagotchiUart* flip_uart, const uint8_t* data, size_t len);
+
+/**
+ * Switch to another transport or line rate, the io worker does it the next time it wakes up
+ *
+ * A new transport starts the link over, a new line rate on the same one doesn't
+ *
+ * @param flip_uart FlipagotchiUart to switch
+ * @param transport What to talk to the pwnagotchi over from now on
+ */
+void flipagotchi_uart_set_transport(
+    FlipagotchiUart* flip_uart,
+    const FlipagotchiTransportSettings* transport);
+
+/**
+ * Go idle or wake up, the io worker picks it up the next time it wakes up
+ *
+ * While idle the face stops animating and a lost link is probed every
+ * PWNAGOTCHI_LINK_IDLE_PROBE_MS, waking up probes it right away
+ *
+ * @param flip_uart FlipagotchiUart to switch
+ * @param idle If the app is idle
+ */
+void flipagotchi_uart_set_idle(FlipagotchiUart* flip_uart, bool idle);
+
+/**
+ * Get told about a new handshake or a pwnagotchi coming or going, idle or not
+ *
+ * @param flip_uart FlipagotchiUart to watch
+ * @param callback Called from the io worker, NULL to stop
+ * @param context Passed to the callback
+ */
+void flipagotchi_uart_set_wake_callback(
+    FlipagotchiUart* flip_uart,
+    FlipagotchiUartWakeCallback callback,
+    void* context);
+
+/**
+ * Get the transport in use, which is LPUART1 if the one asked for couldn't be opened
+ *
+ * @param flip_uart FlipagotchiUart to read
+ * @param transport Where the settings in use go
+ */
+void flipagotchi_uart_get_transport(
+    FlipagotchiUart* flip_uart,
+    FlipagotchiTransportSettings* transport);
+
+/**
+ * Get a snapshot of the dispatch batch statistics
+ *
+ * @param flip_uart FlipagotchiUart to read
+ * @param stats Where to copy the statistics to
+ */
+void flipagotchi_uart_get_dispatch_stats(FlipagotchiUart* flip_uart, FlipagotchiDispatchStats* stats);
+
+/**
+ * Get the current state of the link to the pwnagotchi
+ *
+ * @param flip_uart FlipagotchiUart to read
+ * @return Link state
+ */
+FlipagotchiLinkState flipagotchi_uart_get_link_state(FlipagotchiUart* flip_uart);
+
+/**
+ * Get the number of received bytes dropped because the rx ring was full
+ *
+ * @param flip_uart FlipagotchiUart to read
+ * @return Dropped bytes since the uart was allocated
+ */
+uint32_t flipagotchi_uart_get_rx_overruns(FlipagotchiUart* flip_uart);
+
+/**
+ * Get a snapshot of the file offload totals
+ *
+ * @param flip_uart FlipagotchiUart to read
+ * @param stats Where to copy the totals to
+ */
+void flipagotchi_uart_get_offload_stats(FlipagotchiUart* flip_uart, FlipagotchiOffloadStats* stats);
+
+/**
+ * Get the handshake page cache the browser reads from
+ *
+ * @param flip_uart FlipagotchiUart to read
+ * @return Page cache, lives as long as the uart
+ */
+FlipagotchiHandshakes* flipagotchi_uart_get_handshakes(FlipagotchiUart* flip_uart);
+
+/**
+ * Get the state of the commands the flipper sends to the pwnagotchi
+ *
+ * @param flip_uart FlipagotchiUart to read
+ * @return Command state, lives as long as the uart
+ */
+FlipagotchiControl* flipagotchi_uart_get_control(FlipagotchiUart* flip_uart);
+
+/**
+ * Get the clock whose time goes to the pwnagotchi
+ *
+ * @param flip_uart FlipagotchiUart to read
+ * @return Clock, lives as long as the uart
+ */
+FlipagotchiClock* flipagotchi_uart_get_clock(FlipagotchiUart* flip_uart);
+
+/**
+ * Get a printable name for a link state
+ *
+ * @param state State to name
+ * @return Name of the state
+ */
+const char* flipagotchi_link_state_name(FlipagotchiLinkState state);
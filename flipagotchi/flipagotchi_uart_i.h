@@ -0,0 +1,85 @@
+#pragma once
+
+#include "flipagotchi_uart.h"
+#include "flipagotchi_arena.h"
+#include "flipagotchi_offload_i.h"
+#include "flipagotchi_handshakes_i.h"
+#include "flipagotchi_control_i.h"
+#include "flipagotchi_clock_i.h"
+
+/// Scratch space of exec_cmd, a body is never longer than the escaped arguments it came in
+#define FLIPAGOTCHI_UART_SCRATCH_SIZE (PWNAGOTCHI_PROTOCOL_MAX_MESSAGE_SIZE - 1)
+
+struct FlipagotchiUart {
+    FuriThread* io_worker_thread;
+    FuriThread* tx_worker_thread;
+    // the wire, opened, switched and closed by the io worker. the tx worker only writes to it
+    // under transport_mutex, which also covers the settings
+    const FlipagotchiTransport* transport;
+    FuriMutex* transport_mutex;
+    // in use, and asked for through flipagotchi_uart_set_transport
+    FlipagotchiTransportSettings transport_settings;
+    FlipagotchiTransportSettings transport_request;
+    // rx ring, only the transport's rx callback moves rx_head and only the io worker moves rx_tail
+    // both count bytes since start and are masked on access, head - tail is the fill level
+    uint8_t rx_ring[RX_BUF_SIZE];
+    size_t rx_head;
+    size_t rx_tail;
+    // bytes the rx callback had to drop because the ring was full
+    uint32_t rx_overruns;
+    // tx ring, same scheme as rx. producers move tx_head and only the tx worker moves tx_tail
+    uint8_t tx_ring[TX_BUF_SIZE];
+    size_t tx_head;
+    size_t tx_tail;
+    // the ring only supports a single writer, serialize everyone queueing tx bytes
+    FuriMutex* tx_mutex;
+    ProtocolQueue* queue;
+    Pwnagotchi* pwnagotchi;
+    // which of the app's links this is
+    uint8_t unit;
+    // files from the pwnagotchi, chunks go in from the io worker
+    FlipagotchiOffload* offload;
+    // pages of the handshake list, asked for by the browser and filled in by the io worker
+    FlipagotchiHandshakes* handshakes;
+    // mode switches, reboots and shutdowns sent from the control scene, answered through the io worker
+    FlipagotchiControl* control;
+    // rtc time probes to the pwnagotchi, sent and answered on the io worker
+    FlipagotchiClock* clock;
+
+    FlipagotchiLinkState link_state;
+    // tick of the last valid message from the pwnagotchi
+    uint32_t last_rx_tick;
+    // tick at which the next syn goes out while probing or degraded
+    uint32_t next_probe_tick;
+    // syns sent since we started probing, drives the backoff
+    uint32_t probe_attempts;
+    // set by flipagotchi_uart_set_idle, acted on by the io worker
+    volatile bool idle;
+    // told about news worth waking up for, taken under wake_mutex. wake_pending is only touched
+    // by the io worker, which calls the callback once it holds no lock
+    FuriMutex* wake_mutex;
+    FlipagotchiUartWakeCallback wake_callback;
+    void* wake_context;
+    bool wake_pending;
+    // set when the link (re)starts, cleared once the first ui update after it is on screen
+    bool awaiting_display;
+    uint32_t display_start_tick;
+
+    // copy of the model's field hashes, kept current by the io worker so syns and refreshes
+    // don't need the model lock
+    uint32_t field_hash[PwnagotchiFieldNum];
+
+    // only written by the io worker
+    FlipagotchiDispatchStats dispatch_stats;
+
+    // a command's unescaped body or file chunk, only used by the io worker while it dispatches
+    // so it stays off the worker's stack
+    uint8_t scratch[FLIPAGOTCHI_UART_SCRATCH_SIZE];
+};
+
+/// Arena space flipagotchi_uart_alloc carves, both rings live inside the struct and the queue,
+/// offload, handshake pages, command state and clock are carved with it
+#define FLIPAGOTCHI_UART_ARENA_SIZE                                                     \
+    (FLIPAGOTCHI_ARENA_ALIGN(sizeof(FlipagotchiUart)) + PROTOCOL_QUEUE_ARENA_SIZE + \
+     FLIPAGOTCHI_OFFLOAD_ARENA_SIZE + FLIPAGOTCHI_HANDSHAKES_ARENA_SIZE +            \
+     FLIPAGOTCHI_CONTROL_ARENA_SIZE + FLIPAGOTCHI_CLOCK_ARENA_SIZE)
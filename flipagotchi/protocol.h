@@ -16,12 +16,18 @@
 #define PACKET_START 0x02
 /// End byte at the end of transmission
 #define PACKET_END 0x03
+/// Escapes the next byte in binary bodies, which can't hold PACKET_START, PACKET_END or 0
+#define PACKET_ESCAPE 0x10
+/// An escaped byte is sent xored with this
+#define PACKET_ESCAPE_XOR 0x20
 
 // Shared Commands
 // Used for basic communication
 #define CMD_SYN  0x16
 #define CMD_ACK  0x06
 #define CMD_NAK  0x15
+/// An ACK or NAK answering PWN_CMD_MODE, PWN_CMD_REBOOT, PWN_CMD_SHUTDOWN or PWN_CMD_CLOCK_SET
+/// carries the command's code as its body, every other one is bare
 
 // Flipper Zero Commands
 // These commands can be sent from the pwnagotchi to the flipper
@@ -34,14 +40,110 @@
 #define FLIPPER_CMD_UI_HANDSHAKES  0x0b
 #define FLIPPER_CMD_UI_STATUS      0x0c
 #define FLIPPER_CMD_UI_CHANNEL     0x0d
+#define FLIPPER_CMD_UI_FACE_ANIM   0x0e
+#define FLIPPER_CMD_UI_TILES       0x0f
+#define FLIPPER_CMD_UI_ELEMENT     0x11
+#define FLIPPER_CMD_UI_ELEMENT_SET 0x12
+#define FLIPPER_CMD_FILE_OPEN      0x13
+#define FLIPPER_CMD_FILE_CHUNK     0x14
+#define FLIPPER_CMD_AP_SET         0x17
+#define FLIPPER_CMD_AP_EVICT       0x18
+#define FLIPPER_CMD_HANDSHAKE_PAGE 0x19
+#define FLIPPER_CMD_CHANNEL_STATS  0x1a
+#define FLIPPER_CMD_PEER_SET       0x1b
+#define FLIPPER_CMD_PEER_EXPIRE    0x1c
+
+// First byte of a FLIPPER_CMD_UI_TILES body
+/// Tiles go on top of the framebuffer as it is
+#define TILES_UPDATE  0x04
+/// Framebuffer is cleared before the tiles go on, starts a full frame
+#define TILES_CLEAR   0x05
+/// Set in a tile's index byte when its rows follow as is rather than run length encoded
+#define TILE_RAW      0x80
+/// Tile bytes are xored with this before escaping, so blank rows, solid rows and run counts
+/// don't need escaping
+#define TILE_XOR      0x55
+
+/// Element ids and the numbers in an element declaration are sent this much above their value,
+/// which keeps them clear of 0 and the framing bytes
+#define ELEMENT_BYTE_OFFSET 0x04
+
+/// Data bytes in every chunk of a file but the last, sized so an escaped chunk always fits a message
+#define FILE_CHUNK_SIZE 88
+/// Bytes of a chunk around its data, the offset in front and the crc32 of offset and data after
+#define FILE_CHUNK_OVERHEAD 8
+/// Longest file name a FLIPPER_CMD_FILE_OPEN can carry
+#define FILE_NAME_MAX_LEN 48
+
+// First byte of a PWN_CMD_FILE_ACK body, 8 hex characters of file offset follow
+/// Everything before the offset is taken, send on from there
+#define FILE_ACK_OK     0x04
+/// A chunk was corrupted, out of order or didn't fit, go back and send on from the offset
+#define FILE_ACK_RESEND 0x05
+/// The whole file is on the sd card, the file's crc32 follows instead of an offset
+#define FILE_ACK_DONE   0x06
+/// The file can't be written, don't try it again. The file's crc32 follows instead of an offset
+#define FILE_ACK_FAILED 0x07
+
+/// Bytes of an access point record in a FLIPPER_CMD_AP_SET body in front of its ssid: bssid, rssi,
+/// channel, security, clients and the length of the ssid
+#define AP_RECORD_HEADER_SIZE 11
+/// Longest ssid an access point record carries
+#define AP_SSID_MAX_LEN 20
+/// Bytes at the end of a crc checked body, the crc32 of everything in front of it
+#define BODY_CRC_SIZE 4
+
+/// Bytes of a channel record in a FLIPPER_CMD_CHANNEL_STATS body: channel, traffic in KiB as 2 little
+/// endian bytes, access points seen and handshakes captured
+#define CHANNEL_RECORD_SIZE 5
+
+/// Bytes of a peer record in a FLIPPER_CMD_PEER_SET body in front of its name: key as 4 little
+/// endian bytes, face, rssi, pwned as 2 little endian bytes, seconds since it was last heard as 2
+/// little endian bytes and the length of the name
+#define PEER_RECORD_HEADER_SIZE 11
+/// Bytes of a peer key, a FLIPPER_CMD_PEER_EXPIRE body is a run of them
+#define PEER_KEY_SIZE 4
+/// Longest name a peer record carries
+#define PEER_NAME_MAX_LEN 10
+
+// Security of an access point, as an access point record carries it
+#define AP_SECURITY_OPEN 0x00
+#define AP_SECURITY_WEP  0x01
+#define AP_SECURITY_WPA  0x02
+#define AP_SECURITY_WPA2 0x03
+#define AP_SECURITY_WPA3 0x04
 
 // Pwnagotchi commands
 // These commands can be sent from the Flipper to the pwnagotchi
 #define PWN_CMD_REBOOT      0x04
 #define PWN_CMD_SHUTDOWN    0x05
+/// Body is the mode to switch to, coded like FLIPPER_CMD_UI_MODE's
 #define PWN_CMD_MODE        0x07
 #define PWN_CMD_UI_REFRESH  0x08
+/// Body is the flipper's rtc time and the round trip of the probe before it, in hex
 #define PWN_CMD_CLOCK_SET   0x09
+#define PWN_CMD_FILE_ACK    0x0a
+#define PWN_CMD_HANDSHAKE_LIST 0x0b
+
+// Modes, the body of a FLIPPER_CMD_UI_MODE or PWN_CMD_MODE
+#define MODE_MANUAL 0x04
+#define MODE_AUTO   0x05
+#define MODE_AI     0x06
+
+/// Handshakes in a full FLIPPER_CMD_HANDSHAKE_PAGE, sized so an escaped page always fits a message
+#define HANDSHAKE_PAGE_SIZE 4
+/// Bytes of a FLIPPER_CMD_HANDSHAKE_PAGE in front of its handshakes: generation of the list, number
+/// of handshakes in it and the page
+#define HANDSHAKE_PAGE_HEADER_SIZE 8
+/// Bytes of a handshake in a FLIPPER_CMD_HANDSHAKE_PAGE in front of its ssid: bssid, timestamp and
+/// the length of the ssid
+#define HANDSHAKE_RECORD_HEADER_SIZE 11
+/// Hex characters of the page number in a PWN_CMD_HANDSHAKE_LIST
+#define HANDSHAKE_LIST_HEX_LEN 4
+/// Hex characters of the milliseconds since the epoch in a PWN_CMD_CLOCK_SET
+#define CLOCK_SET_TIME_HEX_LEN 12
+/// Hex characters of the round trip in milliseconds following them
+#define CLOCK_SET_RTT_HEX_LEN 4
 
 
 
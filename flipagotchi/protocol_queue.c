@@ -1,11 +1,18 @@
 #include "protocol_queue.h"
 
-ProtocolQueue* protocol_queue_alloc() {
-    ProtocolQueue* instance = malloc(sizeof(ProtocolQueue));
-    instance->message_queue = furi_message_queue_alloc(PWNAGOTCHI_PROTOCOL_MESSAGE_QUEUE_SIZE, sizeof(PwnMessage));
+static uint8_t* protocol_queue_cur_message(ProtocolQueue* instance) {
+    return (uint8_t*)&instance->messages[instance->head % PROTOCOL_QUEUE_SLOTS];
+}
 
-    instance->cur_message = malloc(sizeof(PwnMessage));
+ProtocolQueue* protocol_queue_alloc(FlipagotchiArena* arena) {
+    // carves come back zeroed, arguments are copied out up to their max length
+    // so anything past the received bytes must be 0
+    ProtocolQueue* instance = flipagotchi_arena_carve(arena, FlipagotchiDiagHeapQueue, sizeof(ProtocolQueue));
+    instance->messages = flipagotchi_arena_carve(
+        arena, FlipagotchiDiagHeapQueue, sizeof(PwnMessage) * PROTOCOL_QUEUE_SLOTS);
 
+    instance->head = 0;
+    instance->tail = 0;
     instance->cur_message_len = 0;
     instance->cur_message_valid=false;
 
@@ -13,20 +20,17 @@ ProtocolQueue* protocol_queue_alloc() {
 }
 
 void protocol_queue_free(ProtocolQueue* instance) {
-    FURI_LOG_W("PWN", "freeing furi message queue");
-    furi_message_queue_free(instance->message_queue);
-    FURI_LOG_W("PWN", "cur message");
-    free(instance->cur_message);
-    FURI_LOG_W("PWN", "our instance");
-    free(instance);
-
-    FURI_LOG_W("PWN", "protocol_queue_free setting our instance NULL");
-    instance = NULL;
-    FURI_LOG_W("PWN", "protocol_queue_free done");
+    FURI_LOG_W("PWN", "protocol_queue_free dropping %u messages", (unsigned)protocol_queue_get_count(instance));
+    protocol_queue_wipe(instance);
+    instance->messages = NULL;
+}
+
+size_t protocol_queue_get_count(ProtocolQueue* instance) {
+    return instance->head - instance->tail;
 }
 
 bool protocol_queue_has_message(ProtocolQueue* instance) {
-    if (furi_message_queue_get_count(instance->message_queue) > 0) {
+    if (protocol_queue_get_count(instance) > 0) {
         return true;
     }
     else {
@@ -34,9 +38,17 @@ bool protocol_queue_has_message(ProtocolQueue* instance) {
     }
 }
 
+bool protocol_queue_is_full(ProtocolQueue* instance) {
+    return protocol_queue_get_count(instance) >= PWNAGOTCHI_PROTOCOL_MESSAGE_QUEUE_SIZE;
+}
+
 void protocol_queue_push_byte(ProtocolQueue* instance, uint8_t byte) {
+    uint8_t* cur_message = protocol_queue_cur_message(instance);
+
     if (PACKET_START == byte){
-        // we have a new message
+        // we have a new message, clear whatever an unfinished one left behind
+        // so its bytes can't end up in the arguments of this one
+        memset(cur_message, 0, instance->cur_message_len);
         instance->cur_message_len=0;
         instance->cur_message_valid=true;
         // don't copy packet control characters into the cur_message
@@ -52,18 +64,20 @@ void protocol_queue_push_byte(ProtocolQueue* instance, uint8_t byte) {
     }
 
     if (PACKET_END == byte){
-        // we have completed a message, put it on the message_queue
+        // we have completed a message, it is already in its slot
         // don't copy packet control characters into the cur_message
+        instance->cur_message_valid = false;
+        instance->cur_message_len = 0;
 
-        if (furi_message_queue_get_space(instance->message_queue) <= 0){
+        if (protocol_queue_is_full(instance)){
             // no space left, just drop the message
-            FURI_LOG_W("PWN", "message_queue is full! dropping message");
-            return;
+            FURI_LOG_W("PWN", "message queue is full! dropping message");
+            memset(cur_message, 0, sizeof(PwnMessage));
+        }
+        else {
+            // publish it, the next slot is free and still zeroed from its last pop
+            instance->head++;
         }
-        furi_message_queue_put(instance->message_queue, instance->cur_message, FuriWaitForever);
-        // now that its copied into the queue, clear cur_message
-        instance->cur_message_valid = false;
-        memset(instance->cur_message, 0, instance->cur_message_len);
         return;
     }
 
@@ -73,7 +87,7 @@ void protocol_queue_push_byte(ProtocolQueue* instance, uint8_t byte) {
     }
     else {
         // we good to append the byte to the current message
-        instance->cur_message[instance->cur_message_len] = byte;
+        cur_message[instance->cur_message_len] = byte;
         instance->cur_message_len++;
         return;
     }
@@ -81,9 +95,11 @@ void protocol_queue_push_byte(ProtocolQueue* instance, uint8_t byte) {
 
 void protocol_queue_wipe(ProtocolQueue* instance) {
     // Set everything to 0
-    memset(instance->cur_message, 0, sizeof(PwnMessage));
+    memset(instance->messages, 0, sizeof(PwnMessage) * PROTOCOL_QUEUE_SLOTS);
+    instance->head = 0;
+    instance->tail = 0;
     instance->cur_message_len = 0;
-    furi_message_queue_reset(instance->message_queue);
+    instance->cur_message_valid = false;
 }
 
 
@@ -94,6 +110,10 @@ bool protocol_queue_pop_message(ProtocolQueue* instance, PwnMessage* dest) {
     }
 
     FURI_LOG_I("PWN", "grabbing the message!");
-    furi_message_queue_get(instance->message_queue, dest, FuriWaitForever);
+    PwnMessage* message = &instance->messages[instance->tail % PROTOCOL_QUEUE_SLOTS];
+    memcpy(dest, message, sizeof(PwnMessage));
+    // the framer expects every slot it moves into to be zeroed
+    memset(message, 0, sizeof(PwnMessage));
+    instance->tail++;
     return true;
-}
\ No newline at end of file
+}
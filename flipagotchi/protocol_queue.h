@@ -1,33 +1,54 @@
 #pragma once
 
 #include <furi.h>
-#include <core/message_queue.h>
 
 #include "protocol.h"
+#include "flipagotchi_arena.h"
+
+/// Slots in the message ring, one more than the queue holds so the message being framed always has one
+#define PROTOCOL_QUEUE_SLOTS (PWNAGOTCHI_PROTOCOL_MESSAGE_QUEUE_SIZE + 1)
 
 typedef struct {
 
-    FuriMessageQueue* message_queue;
-    uint8_t* cur_message;
+    // ring of messages, only ever touched by the io worker
+    // head and tail count messages since start, head - tail are complete and waiting
+    // the slot at head is the one being framed
+    PwnMessage* messages;
+    size_t head;
+    size_t tail;
     size_t cur_message_len;
     bool cur_message_valid;
 
 } ProtocolQueue;
 
+/// Arena space protocol_queue_alloc carves
+#define PROTOCOL_QUEUE_ARENA_SIZE                 \
+    (FLIPAGOTCHI_ARENA_ALIGN(sizeof(ProtocolQueue)) + \
+     FLIPAGOTCHI_ARENA_ALIGN(sizeof(PwnMessage) * PROTOCOL_QUEUE_SLOTS))
+
 /**
- * Allocates memory to store the queue
+ * Carves the queue and its message ring out of the arena
  *
+ * @param arena Arena to carve from, PROTOCOL_QUEUE_ARENA_SIZE of it is used
  * @return Pointer to the newly created queue
  */
-ProtocolQueue* protocol_queue_alloc();
+ProtocolQueue* protocol_queue_alloc(FlipagotchiArena* arena);
 
 /**
- * Destructs all memory that is stored at the pointer and sets pointer to null
+ * Drops everything queued, the memory goes with the arena
  *
  * @param instance ProtocolQueue to operate on
  */
 void protocol_queue_free(ProtocolQueue* instance);
 
+/**
+ * Get how many complete messages are waiting
+ *
+ * @param instance ProtocolQueue to check
+ * @return Messages waiting to be popped
+ */
+size_t protocol_queue_get_count(ProtocolQueue* instance);
+
 /**
  * Decides if the queue has a full message available
  *
@@ -36,6 +57,14 @@ void protocol_queue_free(ProtocolQueue* instance);
  */
 bool protocol_queue_has_message(ProtocolQueue* instance);
 
+/**
+ * Decides if the queue has no room for another complete message
+ *
+ * @param instance ProtocolQueue to check
+ * @return If a message completed now would be dropped
+ */
+bool protocol_queue_is_full(ProtocolQueue* instance);
+
 /**
  * Add a byte to the message queue
  *
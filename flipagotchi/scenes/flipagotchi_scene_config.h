@@ -1,2 +1,8 @@
 ADD_SCENE(flipagotchi, pwnagotchi, Pwnagotchi)
-ADD_SCENE(flipagotchi, exit_confirm, ExitConfirm)
\ No newline at end of file
+ADD_SCENE(flipagotchi, exit_confirm, ExitConfirm)
+ADD_SCENE(flipagotchi, diagnostics, Diagnostics)
+ADD_SCENE(flipagotchi, handshakes, Handshakes)
+ADD_SCENE(flipagotchi, peers, Peers)
+ADD_SCENE(flipagotchi, control, Control)
+ADD_SCENE(flipagotchi, settings, Settings)
+ADD_SCENE(flipagotchi, units, Units)
\ No newline at end of file
@@ -0,0 +1,240 @@
+#include "../flipagotchi_app_i.h"
+
+#include <stdio.h>
+
+/// Reboot and shutdown have to be pressed twice within this long
+#define FLIPAGOTCHI_SCENE_CONTROL_CONFIRM_MS 3000
+
+static void flipagotchi_scene_control_submenu_callback(void* context, uint32_t index) {
+    FlipagotchiApp* app = context;
+
+    view_dispatcher_send_custom_event(app->view_dispatcher, index);
+}
+
+static void flipagotchi_scene_control_reply_callback(void* context) {
+    FlipagotchiApp* app = context;
+
+    // from the io worker, the header is updated on the gui thread
+    view_dispatcher_send_custom_event(app->view_dispatcher, FlipagotchiCustomEventControlReply);
+}
+
+static const char* flipagotchi_scene_control_name(const FlipagotchiControlResult* result) {
+    switch(result->cmd) {
+    case PWN_CMD_MODE:
+        return result->arg == MODE_MANUAL ? "Manual" : result->arg == MODE_AUTO ? "Auto" : "AI";
+    case PWN_CMD_REBOOT:
+        return "Reboot";
+    case PWN_CMD_SHUTDOWN:
+        return "Shutdown";
+    default:
+        return "Controls";
+    }
+}
+
+static void flipagotchi_scene_control_set_header(FlipagotchiApp* app, const char* text) {
+    snprintf(app->control_header, sizeof(app->control_header), "%s", text);
+    submenu_set_header(app->submenu, app->control_header);
+}
+
+/**
+ * Show how the last command went, and take back a mode the pwnagotchi didn't switch to
+ *
+ * Only a change of status is acted on, force shows the status again without
+ */
+static void flipagotchi_scene_control_update(FlipagotchiApp* app, bool force) {
+    FlipagotchiControlResult result;
+    flipagotchi_control_get(flipagotchi_uart_get_control(app->flipagotchi_uart), &result);
+    bool changed = result.status != app->control_shown;
+    if(!changed && !force) {
+        return;
+    }
+    app->control_shown = result.status;
+
+    const char* name = flipagotchi_scene_control_name(&result);
+    switch(result.status) {
+    case FlipagotchiControlIdle:
+        flipagotchi_scene_control_set_header(app, "Controls");
+        return;
+    case FlipagotchiControlPending:
+        snprintf(app->control_header, sizeof(app->control_header), "%s...", name);
+        break;
+    case FlipagotchiControlAcked:
+        snprintf(
+            app->control_header,
+            sizeof(app->control_header),
+            "%s: ok %lums",
+            name,
+            (unsigned long)result.rtt_ms);
+        if(changed) {
+            notification_message(app->notifications, &sequence_success);
+        }
+        break;
+    case FlipagotchiControlNaked:
+    case FlipagotchiControlTimedOut:
+        snprintf(
+            app->control_header,
+            sizeof(app->control_header),
+            "%s: %s",
+            name,
+            result.status == FlipagotchiControlNaked ? "refused" : "no answer");
+        if(changed) {
+            notification_message(app->notifications, &sequence_error);
+            if(result.cmd == PWN_CMD_MODE) {
+                pwnagotchi_set_mode(app->pwnagotchi, app->control_previous_mode);
+            }
+        }
+        break;
+    }
+    submenu_set_header(app->submenu, app->control_header);
+}
+
+/**
+ * Send a command and show it as out, the answer may already be in by the time it is shown
+ */
+static bool flipagotchi_scene_control_send(FlipagotchiApp* app, uint8_t cmd, uint8_t arg) {
+    if(!flipagotchi_control_send(flipagotchi_uart_get_control(app->flipagotchi_uart), cmd, arg)) {
+        // the header still shows the command that is out
+        notification_message(app->notifications, &sequence_error);
+        return false;
+    }
+    app->control_shown = FlipagotchiControlPending;
+    flipagotchi_scene_control_update(app, true);
+    return true;
+}
+
+static void flipagotchi_scene_control_mode(
+    FlipagotchiApp* app,
+    enum PwnagotchiMode mode,
+    uint8_t code) {
+    // shown right away, put back if the pwnagotchi doesn't take it
+    enum PwnagotchiMode previous = pwnagotchi_set_mode(app->pwnagotchi, mode);
+    app->control_previous_mode = previous;
+    if(!flipagotchi_scene_control_send(app, PWN_CMD_MODE, code)) {
+        pwnagotchi_set_mode(app->pwnagotchi, previous);
+    }
+}
+
+/**
+ * Reboot or shut down on the second press, the first one only asks for it
+ */
+static void flipagotchi_scene_control_confirm(
+    FlipagotchiApp* app,
+    uint32_t event,
+    uint8_t cmd,
+    const char* prompt) {
+    uint32_t armed = scene_manager_get_scene_state(app->scene_manager, FlipagotchiSceneControl);
+    if(armed == event && furi_get_tick() - app->control_armed_tick <
+                             furi_ms_to_ticks(FLIPAGOTCHI_SCENE_CONTROL_CONFIRM_MS)) {
+        scene_manager_set_scene_state(app->scene_manager, FlipagotchiSceneControl, 0);
+        flipagotchi_scene_control_send(app, cmd, 0);
+        return;
+    }
+    scene_manager_set_scene_state(app->scene_manager, FlipagotchiSceneControl, event);
+    app->control_armed_tick = furi_get_tick();
+    // an answer still coming in replaces the prompt
+    flipagotchi_scene_control_set_header(app, prompt);
+}
+
+void flipagotchi_scene_control_on_enter(void* context) {
+    FlipagotchiApp* app = context;
+    Submenu* submenu = app->submenu;
+    FlipagotchiControlResult result;
+
+    static const struct {
+        const char* label;
+        FlipagotchiCustomEvent event;
+    } items[] = {
+        {"Manual", FlipagotchiCustomEventControlManual},
+        {"Auto", FlipagotchiCustomEventControlAuto},
+        {"AI", FlipagotchiCustomEventControlAi},
+        {"Reboot", FlipagotchiCustomEventControlReboot},
+        {"Shut down", FlipagotchiCustomEventControlShutdown},
+        {"Settings", FlipagotchiCustomEventControlSettings},
+    };
+    for(size_t i = 0; i < COUNT_OF(items); i++) {
+        submenu_add_item(
+            submenu,
+            items[i].label,
+            items[i].event,
+            flipagotchi_scene_control_submenu_callback,
+            app);
+    }
+    // only worth a menu item with another unit to switch to
+    if(app->unit_count > 1) {
+        submenu_add_item(
+            submenu,
+            "Units",
+            FlipagotchiCustomEventControlUnits,
+            flipagotchi_scene_control_submenu_callback,
+            app);
+    }
+
+    flipagotchi_control_set_callback(
+        flipagotchi_uart_get_control(app->flipagotchi_uart),
+        flipagotchi_scene_control_reply_callback,
+        app);
+    scene_manager_set_scene_state(app->scene_manager, FlipagotchiSceneControl, 0);
+    // the last command is shown, whatever became of it while the scene was closed isn't acted on
+    flipagotchi_control_get(flipagotchi_uart_get_control(app->flipagotchi_uart), &result);
+    app->control_shown = result.status;
+    flipagotchi_scene_control_update(app, true);
+
+    view_dispatcher_switch_to_view(app->view_dispatcher, FlipagotchiAppViewControl);
+}
+
+bool flipagotchi_scene_control_on_event(void* context, SceneManagerEvent event) {
+    FlipagotchiApp* app = context;
+    bool consumed = false;
+
+    if(event.type == SceneManagerEventTypeCustom) {
+        switch(event.event) {
+        case FlipagotchiCustomEventControlManual:
+            flipagotchi_scene_control_mode(app, PwnMode_Manual, MODE_MANUAL);
+            break;
+        case FlipagotchiCustomEventControlAuto:
+            flipagotchi_scene_control_mode(app, PwnMode_Auto, MODE_AUTO);
+            break;
+        case FlipagotchiCustomEventControlAi:
+            flipagotchi_scene_control_mode(app, PwnMode_Ai, MODE_AI);
+            break;
+        case FlipagotchiCustomEventControlReboot:
+            flipagotchi_scene_control_confirm(app, event.event, PWN_CMD_REBOOT, "Again to reboot");
+            break;
+        case FlipagotchiCustomEventControlShutdown:
+            flipagotchi_scene_control_confirm(
+                app, event.event, PWN_CMD_SHUTDOWN, "Again to shut down");
+            break;
+        case FlipagotchiCustomEventControlSettings:
+            scene_manager_next_scene(app->scene_manager, FlipagotchiSceneSettings);
+            break;
+        case FlipagotchiCustomEventControlUnits:
+            scene_manager_next_scene(app->scene_manager, FlipagotchiSceneUnits);
+            break;
+        case FlipagotchiCustomEventControlReply:
+            flipagotchi_scene_control_update(app, false);
+            break;
+        }
+        consumed = true;
+    } else if(event.type == SceneManagerEventTypeTick) {
+        // times out a command that went unanswered
+        flipagotchi_scene_control_update(app, false);
+    }
+
+    return consumed;
+}
+
+void flipagotchi_scene_control_on_exit(void* context) {
+    FlipagotchiApp* app = context;
+    FlipagotchiControlResult result;
+
+    // nobody is left to take back a switch that doesn't go through, a switch that does restarts
+    // the pwnagotchi and it sends its mode again
+    flipagotchi_control_get(flipagotchi_uart_get_control(app->flipagotchi_uart), &result);
+    if(result.status == FlipagotchiControlPending && result.cmd == PWN_CMD_MODE) {
+        pwnagotchi_set_mode(app->pwnagotchi, app->control_previous_mode);
+    }
+
+    flipagotchi_control_set_callback(
+        flipagotchi_uart_get_control(app->flipagotchi_uart), NULL, NULL);
+    submenu_reset(app->submenu);
+}
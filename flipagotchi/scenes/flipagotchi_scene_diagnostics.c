@@ -0,0 +1,90 @@
+#include "../flipagotchi_app_i.h"
+
+static void flipagotchi_scene_diagnostics_button_callback(
+    GuiButtonType result,
+    InputType type,
+    void* context) {
+    FlipagotchiApp* app = context;
+
+    if(result == GuiButtonTypeCenter && type == InputTypeShort) {
+        view_dispatcher_send_custom_event(app->view_dispatcher, FlipagotchiCustomEventDiagnosticsLog);
+    }
+}
+
+static void flipagotchi_scene_diagnostics_show(FlipagotchiApp* app) {
+    FuriString* text = furi_string_alloc();
+
+    FlipagotchiDispatchStats stats;
+    flipagotchi_uart_get_dispatch_stats(app->flipagotchi_uart, &stats);
+    FlipagotchiTransportSettings transport;
+    flipagotchi_uart_get_transport(app->flipagotchi_uart, &transport);
+    FlipagotchiPowerStats power;
+    flipagotchi_power_get_stats(app->power, &power);
+
+    furi_string_printf(
+        text,
+        "link %s\nover %s\nrx dropped %lu\ndispatch %lu msgs\n%lu wakeups, max %lu\narena %u/%u\n",
+        flipagotchi_link_state_name(flipagotchi_uart_get_link_state(app->flipagotchi_uart)),
+        flipagotchi_transport_get(transport.id)->name,
+        flipagotchi_uart_get_rx_overruns(app->flipagotchi_uart),
+        stats.messages,
+        stats.wakeups,
+        stats.max_per_wakeup,
+        (unsigned)flipagotchi_arena_get_used(app->arena),
+        (unsigned)flipagotchi_arena_get_size(app->arena));
+    // drawn from the battery, the idle average is only known after waking up once
+    furi_string_cat_printf(
+        text,
+        "draw %ld mA\nawake %ld, idle %ld mA\nidle %lux, %lu s\n",
+        power.now_ma,
+        power.awake_ma,
+        power.idle_ma,
+        power.idle_count,
+        power.idle_ms / 1000);
+
+    flipagotchi_diag_sample();
+    flipagotchi_diag_report(text);
+
+    widget_reset(app->widget);
+#ifdef FLIPAGOTCHI_DIAG
+    widget_add_text_scroll_element(app->widget, 0, 0, 128, 52, furi_string_get_cstr(text));
+    widget_add_button_element(
+        app->widget,
+        GuiButtonTypeCenter,
+        "Log",
+        flipagotchi_scene_diagnostics_button_callback,
+        app);
+#else
+    UNUSED(flipagotchi_scene_diagnostics_button_callback);
+    widget_add_text_scroll_element(app->widget, 0, 0, 128, 64, furi_string_get_cstr(text));
+#endif
+
+    furi_string_free(text);
+}
+
+void flipagotchi_scene_diagnostics_on_enter(void* context) {
+    FlipagotchiApp* app = context;
+
+    flipagotchi_scene_diagnostics_show(app);
+    view_dispatcher_switch_to_view(app->view_dispatcher, FlipagotchiAppViewWidget);
+}
+
+bool flipagotchi_scene_diagnostics_on_event(void* context, SceneManagerEvent event) {
+    FlipagotchiApp* app = context;
+    bool consumed = false;
+
+    if(event.type == SceneManagerEventTypeCustom &&
+       event.event == FlipagotchiCustomEventDiagnosticsLog) {
+        flipagotchi_diag_log("diagnostics screen");
+        flipagotchi_scene_diagnostics_show(app);
+        consumed = true;
+    }
+
+    return consumed;
+}
+
+void flipagotchi_scene_diagnostics_on_exit(void* context) {
+    FlipagotchiApp* app = context;
+
+    widget_reset(app->widget);
+}
@@ -0,0 +1,74 @@
+#include "../flipagotchi_app_i.h"
+
+// scene state, set while rows on screen are still waiting for their page
+#define FLIPAGOTCHI_SCENE_HANDSHAKES_WAITING 1
+
+static void flipagotchi_scene_handshakes_list_callback(HandshakeListEvent event, void* context) {
+    FlipagotchiApp* app = context;
+
+    if(event == HandshakeListEventMoved) {
+        view_dispatcher_send_custom_event(app->view_dispatcher, FlipagotchiCustomEventHandshakesMoved);
+    }
+}
+
+static void flipagotchi_scene_handshakes_page_callback(void* context) {
+    FlipagotchiApp* app = context;
+
+    // from the io worker, the list is filled in on the gui thread
+    view_dispatcher_send_custom_event(app->view_dispatcher, FlipagotchiCustomEventHandshakesPage);
+}
+
+static void flipagotchi_scene_handshakes_fill(FlipagotchiApp* app) {
+    bool complete = handshake_list_fill(
+        app->handshake_list, flipagotchi_uart_get_handshakes(app->flipagotchi_uart));
+    scene_manager_set_scene_state(
+        app->scene_manager,
+        FlipagotchiSceneHandshakes,
+        complete ? 0 : FLIPAGOTCHI_SCENE_HANDSHAKES_WAITING);
+}
+
+void flipagotchi_scene_handshakes_on_enter(void* context) {
+    FlipagotchiApp* app = context;
+    FlipagotchiHandshakes* handshakes = flipagotchi_uart_get_handshakes(app->flipagotchi_uart);
+
+    handshake_list_set_callback(
+        app->handshake_list, flipagotchi_scene_handshakes_list_callback, app);
+    flipagotchi_handshakes_set_callback(
+        handshakes, flipagotchi_scene_handshakes_page_callback, app);
+
+    // only the first page is asked for, the rest as the cursor gets to them
+    handshake_list_reset(app->handshake_list);
+    flipagotchi_handshakes_open(handshakes);
+    scene_manager_set_scene_state(
+        app->scene_manager, FlipagotchiSceneHandshakes, FLIPAGOTCHI_SCENE_HANDSHAKES_WAITING);
+
+    view_dispatcher_switch_to_view(app->view_dispatcher, FlipagotchiAppViewHandshakes);
+}
+
+bool flipagotchi_scene_handshakes_on_event(void* context, SceneManagerEvent event) {
+    FlipagotchiApp* app = context;
+    bool consumed = false;
+
+    if(event.type == SceneManagerEventTypeCustom &&
+       (event.event == FlipagotchiCustomEventHandshakesMoved ||
+        event.event == FlipagotchiCustomEventHandshakesPage)) {
+        flipagotchi_scene_handshakes_fill(app);
+        consumed = true;
+    } else if(
+        event.type == SceneManagerEventTypeTick &&
+        scene_manager_get_scene_state(app->scene_manager, FlipagotchiSceneHandshakes) ==
+            FLIPAGOTCHI_SCENE_HANDSHAKES_WAITING) {
+        // asks again for pages whose request went unanswered
+        flipagotchi_scene_handshakes_fill(app);
+    }
+
+    return consumed;
+}
+
+void flipagotchi_scene_handshakes_on_exit(void* context) {
+    FlipagotchiApp* app = context;
+
+    flipagotchi_handshakes_set_callback(
+        flipagotchi_uart_get_handshakes(app->flipagotchi_uart), NULL, NULL);
+    handshake_list_set_callback(app->handshake_list, NULL, NULL);
+}
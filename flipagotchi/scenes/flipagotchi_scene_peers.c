@@ -0,0 +1,29 @@
+#include "../flipagotchi_app_i.h"
+
+static void flipagotchi_scene_peers_fill(FlipagotchiApp* app) {
+    PwnagotchiPeerTable peers;
+    pwnagotchi_get_peers(app->pwnagotchi, &peers);
+    peer_list_fill(app->peer_list, &peers);
+}
+
+void flipagotchi_scene_peers_on_enter(void* context) {
+    FlipagotchiApp* app = context;
+
+    peer_list_reset(app->peer_list);
+    flipagotchi_scene_peers_fill(app);
+    view_dispatcher_switch_to_view(app->view_dispatcher, FlipagotchiAppViewPeers);
+}
+
+bool flipagotchi_scene_peers_on_event(void* context, SceneManagerEvent event) {
+    FlipagotchiApp* app = context;
+
+    if(event.type == SceneManagerEventTypeTick) {
+        // the table lives in the pwnagotchi's model, the io worker changes it there
+        flipagotchi_scene_peers_fill(app);
+    }
+    return false;
+}
+
+void flipagotchi_scene_peers_on_exit(void* context) {
+    UNUSED(context);
+}
@@ -1,24 +1,53 @@
 #include "../flipagotchi_app_i.h"
 
+static void flipagotchi_scene_pwnagotchi_callback(PwnagotchiEvent event, void* context) {
+    FlipagotchiApp* app = context;
+
+    if(event == PwnagotchiEventOk) {
+        view_dispatcher_send_custom_event(app->view_dispatcher, FlipagotchiCustomEventDiagnostics);
+    } else if(event == PwnagotchiEventHandshakes) {
+        view_dispatcher_send_custom_event(app->view_dispatcher, FlipagotchiCustomEventHandshakes);
+    } else if(event == PwnagotchiEventPeers) {
+        view_dispatcher_send_custom_event(app->view_dispatcher, FlipagotchiCustomEventPeers);
+    } else if(event == PwnagotchiEventControl) {
+        view_dispatcher_send_custom_event(app->view_dispatcher, FlipagotchiCustomEventControl);
+    }
+}
+
 void flipagotchi_scene_pwnagotchi_on_enter(void* context) {
     FlipagotchiApp* app = context;
 
-    view_dispatcher_switch_to_view(app->view_dispatcher, FlipagotchiAppViewPwnagotchi);
+    pwnagotchi_set_callback(app->pwnagotchi, flipagotchi_scene_pwnagotchi_callback, app);
+    view_dispatcher_switch_to_view(
+        app->view_dispatcher, FlipagotchiAppViewPwnagotchi + app->unit);
 }
 
 bool flipagotchi_scene_pwnagotchi_on_event(void* context, SceneManagerEvent event) {
-    UNUSED(context);
-    /* FlipagotchiApp* app = context; */
+    FlipagotchiApp* app = context;
     bool consumed = false;
 
     if(event.type == SceneManagerEventTypeCustom) {
-        // TODO we can hop into other scenes using this
-        // which will be useful for menus/configs
+        if(event.event == FlipagotchiCustomEventDiagnostics) {
+            scene_manager_next_scene(app->scene_manager, FlipagotchiSceneDiagnostics);
+        } else if(event.event == FlipagotchiCustomEventHandshakes) {
+            scene_manager_next_scene(app->scene_manager, FlipagotchiSceneHandshakes);
+        } else if(event.event == FlipagotchiCustomEventPeers) {
+            scene_manager_next_scene(app->scene_manager, FlipagotchiScenePeers);
+        } else if(event.event == FlipagotchiCustomEventControl) {
+            scene_manager_next_scene(app->scene_manager, FlipagotchiSceneControl);
+        }
         consumed = true;
+    } else if(event.type == SceneManagerEventTypeTick) {
+        // the units off screen keep cooling down, so they are current once switched to
+        for(uint8_t unit = 0; unit < app->unit_count; unit++) {
+            pwnagotchi_decay_channels(app->units[unit].pwnagotchi);
+        }
     }
     return consumed;
 }
 
 void flipagotchi_scene_pwnagotchi_on_exit(void* context) {
-    UNUSED(context);
+    FlipagotchiApp* app = context;
+
+    pwnagotchi_set_callback(app->pwnagotchi, NULL, NULL);
 }
\ No newline at end of file
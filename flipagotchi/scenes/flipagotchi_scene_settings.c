@@ -0,0 +1,279 @@
+#include "../flipagotchi_app_i.h"
+
+/// Line rates offered for the uarts, the pwnagotchi has to be set to the same one
+static const uint32_t flipagotchi_scene_settings_rates[] = {115200, 230400, 460800, 921600};
+static const char* const flipagotchi_scene_settings_rate_names[] = {
+    "115200",
+    "230400",
+    "460800",
+    "921600",
+};
+
+_Static_assert(
+    COUNT_OF(flipagotchi_scene_settings_rates) == COUNT_OF(flipagotchi_scene_settings_rate_names),
+    "every rate needs a name");
+
+/// Delays offered before going idle, in seconds
+static const uint16_t flipagotchi_scene_settings_idle_delays[] = {0, 15, 30, 60, 300};
+static const char* const flipagotchi_scene_settings_idle_names[] = {
+    "Never",
+    "15 s",
+    "30 s",
+    "1 min",
+    "5 min",
+};
+
+_Static_assert(
+    COUNT_OF(flipagotchi_scene_settings_idle_delays) ==
+        COUNT_OF(flipagotchi_scene_settings_idle_names),
+    "every delay needs a name");
+
+static const char* const
+    flipagotchi_scene_settings_backlight_names[FlipagotchiPowerBacklightCount] = {"Off", "Dim"};
+
+/// What changed while the scene was up, each is saved once the scene is left
+#define FLIPAGOTCHI_SCENE_SETTINGS_TRANSPORT (1 << 0)
+#define FLIPAGOTCHI_SCENE_SETTINGS_POWER (1 << 1)
+
+/// Units the app can run, and how they read while the app still runs a different number
+static const char* const flipagotchi_scene_settings_unit_names[FLIPAGOTCHI_UNITS_MAX] = {"1", "2"};
+static const char* const flipagotchi_scene_settings_unit_next_names[FLIPAGOTCHI_UNITS_MAX] = {
+    "1 next",
+    "2 next",
+};
+
+/// Labels of the rows for the unit on screen, numbered once there is more than one
+static const char* const flipagotchi_scene_settings_link_labels[FLIPAGOTCHI_UNITS_MAX] = {
+    "Link 1",
+    "Link 2",
+};
+static const char* const flipagotchi_scene_settings_rate_labels[FLIPAGOTCHI_UNITS_MAX] = {
+    "Baud 1",
+    "Baud 2",
+};
+
+/**
+ * Settings of the unit on screen
+ */
+static FlipagotchiTransportSettings* flipagotchi_scene_settings_unit(FlipagotchiApp* app) {
+    return &app->transport.unit[app->unit];
+}
+
+static void flipagotchi_scene_settings_show_rate(FlipagotchiApp* app) {
+    FlipagotchiTransportSettings* transport = flipagotchi_scene_settings_unit(app);
+    if(!flipagotchi_transport_get(transport->id)->has_rate) {
+        // usb goes as fast as it goes, whatever is picked here
+        variable_item_set_current_value_text(app->settings_rate_item, "-");
+        return;
+    }
+    for(size_t i = 0; i < COUNT_OF(flipagotchi_scene_settings_rates); i++) {
+        if(flipagotchi_scene_settings_rates[i] == transport->rate) {
+            variable_item_set_current_value_index(app->settings_rate_item, i);
+            variable_item_set_current_value_text(
+                app->settings_rate_item, flipagotchi_scene_settings_rate_names[i]);
+            return;
+        }
+    }
+    // written into the settings file by hand
+    variable_item_set_current_value_text(app->settings_rate_item, "custom");
+}
+
+static void flipagotchi_scene_settings_changed(FlipagotchiApp* app, uint32_t changed) {
+    uint32_t state = scene_manager_get_scene_state(app->scene_manager, FlipagotchiSceneSettings);
+    scene_manager_set_scene_state(app->scene_manager, FlipagotchiSceneSettings, state | changed);
+}
+
+/**
+ * Hand the settings to the uart right away, they are saved once the scene is left
+ */
+static void flipagotchi_scene_settings_apply(FlipagotchiApp* app) {
+    flipagotchi_uart_set_transport(app->flipagotchi_uart, flipagotchi_scene_settings_unit(app));
+    flipagotchi_scene_settings_changed(app, FLIPAGOTCHI_SCENE_SETTINGS_TRANSPORT);
+}
+
+/**
+ * Move a second unit that doesn't run yet off the first one's transport
+ *
+ * Only a unit that starts next time can clash, the list never offers what a running one has
+ */
+static void flipagotchi_scene_settings_settle(FlipagotchiApp* app) {
+    FlipagotchiTransportConfig* config = &app->transport;
+    if(config->units < 2 || config->unit[1].id != config->unit[0].id) {
+        return;
+    }
+    config->unit[1].id = flipagotchi_transport_config_free(config, 1);
+    if(config->unit[1].id == FlipagotchiTransportNum) {
+        // nothing left for it to talk over
+        config->unit[1].id = config->unit[0].id;
+        config->units = 1;
+    }
+}
+
+static void flipagotchi_scene_settings_show_units(FlipagotchiApp* app, VariableItem* item) {
+    uint8_t index = app->transport.units - 1;
+    // a count the app doesn't run yet is only taken on the next start
+    bool pending = app->transport.units != app->unit_count;
+    variable_item_set_current_value_index(item, index);
+    variable_item_set_current_value_text(
+        item,
+        pending ? flipagotchi_scene_settings_unit_next_names[index] :
+                  flipagotchi_scene_settings_unit_names[index]);
+}
+
+static void flipagotchi_scene_settings_units_changed(VariableItem* item) {
+    FlipagotchiApp* app = variable_item_get_context(item);
+
+    // the arena is sized for the units at start, a new count waits for the next one
+    app->transport.units = variable_item_get_current_value_index(item) + 1;
+    flipagotchi_scene_settings_settle(app);
+    flipagotchi_scene_settings_show_units(app, item);
+    flipagotchi_scene_settings_changed(app, FLIPAGOTCHI_SCENE_SETTINGS_TRANSPORT);
+}
+
+static void flipagotchi_scene_settings_show_idle(FlipagotchiApp* app, VariableItem* item) {
+    for(size_t i = 0; i < COUNT_OF(flipagotchi_scene_settings_idle_delays); i++) {
+        if(flipagotchi_scene_settings_idle_delays[i] == app->power_settings.idle_s) {
+            variable_item_set_current_value_index(item, i);
+            variable_item_set_current_value_text(item, flipagotchi_scene_settings_idle_names[i]);
+            return;
+        }
+    }
+    // written into the settings file by hand
+    variable_item_set_current_value_text(item, "custom");
+}
+
+/**
+ * Idle settings take effect right away, they are saved once the scene is left
+ */
+static void flipagotchi_scene_settings_apply_power(FlipagotchiApp* app) {
+    flipagotchi_power_set_settings(app->power, &app->power_settings);
+    flipagotchi_scene_settings_changed(app, FLIPAGOTCHI_SCENE_SETTINGS_POWER);
+}
+
+static void flipagotchi_scene_settings_idle_changed(VariableItem* item) {
+    FlipagotchiApp* app = variable_item_get_context(item);
+    uint8_t index = variable_item_get_current_value_index(item);
+
+    app->power_settings.idle_s = flipagotchi_scene_settings_idle_delays[index];
+    variable_item_set_current_value_text(item, flipagotchi_scene_settings_idle_names[index]);
+    flipagotchi_scene_settings_apply_power(app);
+}
+
+static void flipagotchi_scene_settings_backlight_changed(VariableItem* item) {
+    FlipagotchiApp* app = variable_item_get_context(item);
+    uint8_t index = variable_item_get_current_value_index(item);
+
+    app->power_settings.backlight = index;
+    variable_item_set_current_value_text(item, flipagotchi_scene_settings_backlight_names[index]);
+    flipagotchi_scene_settings_apply_power(app);
+}
+
+static void flipagotchi_scene_settings_transport_changed(VariableItem* item) {
+    FlipagotchiApp* app = variable_item_get_context(item);
+    FlipagotchiTransportSettings* transport = flipagotchi_scene_settings_unit(app);
+
+    transport->id = app->settings_transports[variable_item_get_current_value_index(item)];
+    variable_item_set_current_value_text(item, flipagotchi_transport_get(transport->id)->name);
+    flipagotchi_scene_settings_show_rate(app);
+    flipagotchi_scene_settings_apply(app);
+}
+
+static void flipagotchi_scene_settings_rate_changed(VariableItem* item) {
+    FlipagotchiApp* app = variable_item_get_context(item);
+    uint8_t index = variable_item_get_current_value_index(item);
+    FlipagotchiTransportSettings* transport = flipagotchi_scene_settings_unit(app);
+
+    if(!flipagotchi_transport_get(transport->id)->has_rate) {
+        flipagotchi_scene_settings_show_rate(app);
+        return;
+    }
+    transport->rate = flipagotchi_scene_settings_rates[index];
+    variable_item_set_current_value_text(item, flipagotchi_scene_settings_rate_names[index]);
+    flipagotchi_scene_settings_apply(app);
+}
+
+void flipagotchi_scene_settings_on_enter(void* context) {
+    FlipagotchiApp* app = context;
+    VariableItemList* list = app->variable_item_list;
+    FlipagotchiTransportSettings* transport = flipagotchi_scene_settings_unit(app);
+    bool numbered = app->unit_count > 1;
+
+    // only the transports this build has that no other running unit talks over
+    uint8_t count = 0;
+    uint8_t current = 0;
+    for(FlipagotchiTransportId id = 0; id < FlipagotchiTransportNum; id++) {
+        bool taken = flipagotchi_transport_get(id) == NULL;
+        for(uint8_t other = 0; other < app->unit_count && !taken; other++) {
+            taken = other != app->unit && app->transport.unit[other].id == id;
+        }
+        if(taken) {
+            continue;
+        }
+        if(id == transport->id) {
+            current = count;
+        }
+        app->settings_transports[count++] = id;
+    }
+    VariableItem* item = variable_item_list_add(
+        list,
+        numbered ? flipagotchi_scene_settings_link_labels[app->unit] : "Link",
+        count,
+        flipagotchi_scene_settings_transport_changed,
+        app);
+    variable_item_set_current_value_index(item, current);
+    variable_item_set_current_value_text(item, flipagotchi_transport_get(transport->id)->name);
+
+    app->settings_rate_item = variable_item_list_add(
+        list,
+        numbered ? flipagotchi_scene_settings_rate_labels[app->unit] : "Baud",
+        COUNT_OF(flipagotchi_scene_settings_rates),
+        flipagotchi_scene_settings_rate_changed,
+        app);
+    flipagotchi_scene_settings_show_rate(app);
+
+    item = variable_item_list_add(
+        list, "Units", FLIPAGOTCHI_UNITS_MAX, flipagotchi_scene_settings_units_changed, app);
+    flipagotchi_scene_settings_show_units(app, item);
+
+    item = variable_item_list_add(
+        list,
+        "Idle after",
+        COUNT_OF(flipagotchi_scene_settings_idle_delays),
+        flipagotchi_scene_settings_idle_changed,
+        app);
+    flipagotchi_scene_settings_show_idle(app, item);
+
+    item = variable_item_list_add(
+        list,
+        "Idle light",
+        FlipagotchiPowerBacklightCount,
+        flipagotchi_scene_settings_backlight_changed,
+        app);
+    variable_item_set_current_value_index(item, app->power_settings.backlight);
+    variable_item_set_current_value_text(
+        item, flipagotchi_scene_settings_backlight_names[app->power_settings.backlight]);
+
+    scene_manager_set_scene_state(app->scene_manager, FlipagotchiSceneSettings, 0);
+    view_dispatcher_switch_to_view(app->view_dispatcher, FlipagotchiAppViewSettings);
+}
+
+bool flipagotchi_scene_settings_on_event(void* context, SceneManagerEvent event) {
+    UNUSED(context);
+    UNUSED(event);
+    return false;
+}
+
+void flipagotchi_scene_settings_on_exit(void* context) {
+    FlipagotchiApp* app = context;
+
+    uint32_t changed = scene_manager_get_scene_state(app->scene_manager, FlipagotchiSceneSettings);
+    if(changed & FLIPAGOTCHI_SCENE_SETTINGS_TRANSPORT) {
+        flipagotchi_scene_settings_settle(app);
+        flipagotchi_transport_settings_save(&app->transport);
+    }
+    if(changed & FLIPAGOTCHI_SCENE_SETTINGS_POWER) {
+        flipagotchi_power_settings_save(&app->power_settings);
+    }
+    variable_item_list_reset(app->variable_item_list);
+    app->settings_rate_item = NULL;
+}
@@ -0,0 +1,119 @@
+#include "../flipagotchi_app_i.h"
+
+#include <stdio.h>
+
+/// Ticks between refreshes of the summary
+#define FLIPAGOTCHI_SCENE_UNITS_REFRESH_TICKS 10
+
+/// Width of a unit's column, each holds about ten characters
+#define FLIPAGOTCHI_SCENE_UNITS_COLUMN_WIDTH 64
+
+static void flipagotchi_scene_units_button_callback(
+    GuiButtonType result,
+    InputType type,
+    void* context) {
+    FlipagotchiApp* app = context;
+
+    if(type != InputTypeShort) {
+        return;
+    }
+    if(result == GuiButtonTypeLeft) {
+        view_dispatcher_send_custom_event(
+            app->view_dispatcher, FlipagotchiCustomEventUnitsPickFirst);
+    } else if(result == GuiButtonTypeRight) {
+        view_dispatcher_send_custom_event(
+            app->view_dispatcher, FlipagotchiCustomEventUnitsPickSecond);
+    }
+}
+
+static const char* flipagotchi_scene_units_mode_name(enum PwnagotchiMode mode) {
+    return mode == PwnMode_Manual ? "Manual" : mode == PwnMode_Auto ? "Auto" : "AI";
+}
+
+/**
+ * Write a unit's column, the unit on screen is marked
+ */
+static void flipagotchi_scene_units_column(FlipagotchiApp* app, uint8_t unit, FuriString* text) {
+    FlipagotchiUnit* shown = &app->units[unit];
+    FlipagotchiLinkState link = flipagotchi_uart_get_link_state(shown->flipagotchi_uart);
+
+    with_view_model(
+        pwnagotchi_get_view(shown->pwnagotchi),
+        PwnagotchiModel * model,
+        {
+            furi_string_printf(
+                text,
+                "%s%.9s\n%s\n%s\nCH %.6s\nAPS %.5s\nPWND %.4s",
+                unit == app->unit ? ">" : "",
+                model->hostname[0] ? model->hostname : (unit == 0 ? "unit 1" : "unit 2"),
+                flipagotchi_link_state_name(link),
+                flipagotchi_scene_units_mode_name(model->mode),
+                model->channel,
+                model->apStat,
+                model->handshakes);
+        },
+        false);
+}
+
+static void flipagotchi_scene_units_show(FlipagotchiApp* app) {
+    FuriString* text = furi_string_alloc();
+
+    widget_reset(app->widget);
+    for(uint8_t unit = 0; unit < app->unit_count; unit++) {
+        flipagotchi_scene_units_column(app, unit, text);
+        widget_add_string_multiline_element(
+            app->widget,
+            unit * FLIPAGOTCHI_SCENE_UNITS_COLUMN_WIDTH,
+            0,
+            AlignLeft,
+            AlignTop,
+            FontSecondary,
+            furi_string_get_cstr(text));
+    }
+    widget_add_button_element(
+        app->widget, GuiButtonTypeLeft, "1", flipagotchi_scene_units_button_callback, app);
+    if(app->unit_count > 1) {
+        widget_add_button_element(
+            app->widget, GuiButtonTypeRight, "2", flipagotchi_scene_units_button_callback, app);
+    }
+
+    furi_string_free(text);
+}
+
+void flipagotchi_scene_units_on_enter(void* context) {
+    FlipagotchiApp* app = context;
+
+    scene_manager_set_scene_state(app->scene_manager, FlipagotchiSceneUnits, 0);
+    flipagotchi_scene_units_show(app);
+    view_dispatcher_switch_to_view(app->view_dispatcher, FlipagotchiAppViewWidget);
+}
+
+bool flipagotchi_scene_units_on_event(void* context, SceneManagerEvent event) {
+    FlipagotchiApp* app = context;
+    bool consumed = false;
+
+    if(event.type == SceneManagerEventTypeCustom) {
+        uint8_t unit = event.event - FlipagotchiCustomEventUnitsPickFirst;
+        if(unit < app->unit_count) {
+            flipagotchi_app_show_unit(app, unit);
+            scene_manager_search_and_switch_to_previous_scene(
+                app->scene_manager, FlipagotchiScenePwnagotchi);
+        }
+        consumed = true;
+    } else if(event.type == SceneManagerEventTypeTick) {
+        uint32_t ticks = scene_manager_get_scene_state(app->scene_manager, FlipagotchiSceneUnits);
+        if(++ticks >= FLIPAGOTCHI_SCENE_UNITS_REFRESH_TICKS) {
+            ticks = 0;
+            flipagotchi_scene_units_show(app);
+        }
+        scene_manager_set_scene_state(app->scene_manager, FlipagotchiSceneUnits, ticks);
+    }
+
+    return consumed;
+}
+
+void flipagotchi_scene_units_on_exit(void* context) {
+    FlipagotchiApp* app = context;
+
+    widget_reset(app->widget);
+}
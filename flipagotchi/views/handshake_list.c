@@ -0,0 +1,217 @@
+#include "handshake_list.h"
+
+#include <gui/elements.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pwnagotchi.h"
+#include "../flipagotchi_diag.h"
+
+/// Height of a row, the header's included
+#define HANDSHAKE_LIST_ROW_HEIGHT 9
+
+/// Longest ssid drawn in a row, leaves room for the date
+#define HANDSHAKE_LIST_SSID_CHARS 18
+
+/**
+ * Split a timestamp into its month, day, hour and minute, in UTC
+ */
+static void handshake_list_civil(uint32_t timestamp, uint8_t* month, uint8_t* day, uint8_t* hour, uint8_t* minute) {
+    uint32_t days = timestamp / 86400;
+    uint32_t seconds = timestamp % 86400;
+    *hour = seconds / 3600;
+    *minute = seconds / 60 % 60;
+
+    // days since 0000-03-01, so the leap day is the last day of the year
+    uint32_t z = days + 719468;
+    uint32_t era = z / 146097;
+    uint32_t day_of_era = z - era * 146097;
+    uint32_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    uint32_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    uint32_t month_from_march = (5 * day_of_year + 2) / 153;
+    *day = day_of_year - (153 * month_from_march + 2) / 5 + 1;
+    *month = month_from_march < 10 ? month_from_march + 3 : month_from_march - 9;
+}
+
+static void handshake_list_draw_callback(Canvas* canvas, void* _model) {
+    HandshakeListModel* model = _model;
+    char text[32];
+
+    canvas_set_font(canvas, PWNAGOTCHI_FONT);
+    canvas_draw_str_aligned(canvas, 0, 0, AlignLeft, AlignTop, "Handshakes");
+    if(!model->loaded) {
+        canvas_draw_str_aligned(canvas, FLIPPER_SCREEN_WIDTH - 1, 0, AlignRight, AlignTop, "...");
+    } else if(model->total > 0) {
+        snprintf(text, sizeof(text), "%u/%u", (unsigned)(model->cursor + 1), (unsigned)model->total);
+        canvas_draw_str_aligned(canvas, FLIPPER_SCREEN_WIDTH - 1, 0, AlignRight, AlignTop, text);
+    }
+    canvas_draw_line(canvas, 0, 8, FLIPPER_SCREEN_WIDTH - 1, 8);
+
+    if(model->loaded && model->total == 0) {
+        canvas_draw_str_aligned(
+            canvas, FLIPPER_SCREEN_WIDTH / 2, 32, AlignCenter, AlignCenter, "No handshakes yet");
+        return;
+    }
+
+    uint8_t month, day, hour, minute;
+    for(size_t row = 0; row < HANDSHAKE_LIST_ROWS && model->top + row < model->total; row++) {
+        const FlipagotchiHandshake* handshake = &model->rows[row];
+        uint8_t y = (row + 1) * HANDSHAKE_LIST_ROW_HEIGHT + 1;
+        bool selected = model->top + row == model->cursor;
+        if(selected) {
+            canvas_draw_box(canvas, 0, y - 1, FLIPPER_SCREEN_WIDTH, HANDSHAKE_LIST_ROW_HEIGHT);
+            canvas_set_color(canvas, ColorWhite);
+        }
+        if(!model->row_loaded[row]) {
+            canvas_draw_str_aligned(canvas, 2, y, AlignLeft, AlignTop, "...");
+        } else {
+            snprintf(
+                text,
+                sizeof(text),
+                "%.*s",
+                HANDSHAKE_LIST_SSID_CHARS,
+                handshake->ssid[0] != '\0' ? handshake->ssid : "<hidden>");
+            canvas_draw_str_aligned(canvas, 2, y, AlignLeft, AlignTop, text);
+            handshake_list_civil(handshake->timestamp, &month, &day, &hour, &minute);
+            snprintf(text, sizeof(text), "%02u-%02u", month, day);
+            canvas_draw_str_aligned(canvas, FLIPPER_SCREEN_WIDTH - 2, y, AlignRight, AlignTop, text);
+        }
+        canvas_set_color(canvas, ColorBlack);
+    }
+
+    // the selected handshake's bssid and time go under the list
+    size_t selected = model->cursor - model->top;
+    if(selected < HANDSHAKE_LIST_ROWS && model->row_loaded[selected]) {
+        const FlipagotchiHandshake* handshake = &model->rows[selected];
+        handshake_list_civil(handshake->timestamp, &month, &day, &hour, &minute);
+        snprintf(
+            text,
+            sizeof(text),
+            "%02x:%02x:%02x:%02x:%02x:%02x %02u:%02u",
+            handshake->bssid[0],
+            handshake->bssid[1],
+            handshake->bssid[2],
+            handshake->bssid[3],
+            handshake->bssid[4],
+            handshake->bssid[5],
+            hour,
+            minute);
+        canvas_draw_str_aligned(
+            canvas, 0, FLIPPER_SCREEN_HEIGHT, AlignLeft, AlignBottom, text);
+    }
+}
+
+static bool handshake_list_input_callback(InputEvent* event, void* context) {
+    HandshakeList* list = context;
+
+    if(event->type != InputTypeShort && event->type != InputTypeRepeat) {
+        return false;
+    }
+    if(event->key != InputKeyUp && event->key != InputKeyDown) {
+        return false;
+    }
+
+    bool moved = false;
+    with_view_model(
+        list->view,
+        HandshakeListModel * model,
+        {
+            if(event->key == InputKeyUp && model->cursor > 0) {
+                model->cursor--;
+                moved = true;
+            } else if(event->key == InputKeyDown && model->cursor + 1 < model->total) {
+                model->cursor++;
+                moved = true;
+            }
+            // the window follows the cursor
+            if(model->cursor < model->top) {
+                model->top = model->cursor;
+            } else if(model->cursor >= model->top + HANDSHAKE_LIST_ROWS) {
+                model->top = model->cursor - HANDSHAKE_LIST_ROWS + 1;
+            }
+        },
+        moved);
+
+    if(moved && list->callback) {
+        list->callback(HandshakeListEventMoved, list->context);
+    }
+    return true;
+}
+
+HandshakeList* handshake_list_alloc(FlipagotchiArena* arena) {
+    HandshakeList* list =
+        flipagotchi_arena_carve(arena, FlipagotchiDiagHeapHandshakes, sizeof(HandshakeList));
+    list->view = view_alloc();
+    // comes back zeroed, nothing loaded
+    view_allocate_model(list->view, ViewModelTypeLocking, sizeof(HandshakeListModel));
+    flipagotchi_diag_heap_account(FlipagotchiDiagHeapHandshakes, sizeof(HandshakeListModel));
+    view_set_context(list->view, list);
+    view_set_draw_callback(list->view, handshake_list_draw_callback);
+    view_set_input_callback(list->view, handshake_list_input_callback);
+    return list;
+}
+
+void handshake_list_free(HandshakeList* list) {
+    furi_assert(list);
+    view_free(list->view);
+    list->view = NULL;
+    flipagotchi_diag_heap_account(
+        FlipagotchiDiagHeapHandshakes, -(int32_t)sizeof(HandshakeListModel));
+}
+
+View* handshake_list_get_view(HandshakeList* list) {
+    furi_assert(list);
+    return list->view;
+}
+
+void handshake_list_set_callback(HandshakeList* list, HandshakeListCallback callback, void* context) {
+    furi_assert(list);
+    list->callback = callback;
+    list->context = context;
+}
+
+void handshake_list_reset(HandshakeList* list) {
+    furi_assert(list);
+    with_view_model(
+        list->view,
+        HandshakeListModel * model,
+        { memset(model, 0, sizeof(HandshakeListModel)); },
+        true);
+}
+
+bool handshake_list_fill(HandshakeList* list, FlipagotchiHandshakes* handshakes) {
+    furi_assert(list);
+    size_t total = 0;
+    bool loaded = flipagotchi_handshakes_get_total(handshakes, &total);
+    if(!loaded) {
+        // nothing came in since the browser opened, asks for the first page again once it is overdue
+        FlipagotchiHandshake first;
+        flipagotchi_handshakes_get(handshakes, 0, &first);
+    }
+    bool complete = loaded;
+
+    with_view_model(
+        list->view,
+        HandshakeListModel * model,
+        {
+            model->loaded = loaded;
+            model->total = total;
+            // the list may have gotten shorter under the cursor
+            if(model->cursor >= total) {
+                model->cursor = total > 0 ? total - 1 : 0;
+            }
+            if(model->top > model->cursor) {
+                model->top = model->cursor;
+            }
+            for(size_t row = 0; row < HANDSHAKE_LIST_ROWS; row++) {
+                model->row_loaded[row] =
+                    model->top + row < total &&
+                    flipagotchi_handshakes_get(handshakes, model->top + row, &model->rows[row]);
+                if(model->top + row < total && !model->row_loaded[row]) {
+                    complete = false;
+                }
+            }
+        },
+        true);
+    return complete;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <furi.h>
+#include <gui/view.h>
+
+#include "../flipagotchi_arena.h"
+#include "../flipagotchi_handshakes.h"
+
+/// Handshakes on screen at once
+#define HANDSHAKE_LIST_ROWS 5
+
+/**
+ * What the handshake browser shows, a window of HANDSHAKE_LIST_ROWS handshakes around the cursor
+ */
+typedef struct {
+    /// If the number of handshakes is known yet
+    bool loaded;
+    size_t total;
+    /// Index of the selected handshake, 0 is the newest
+    size_t cursor;
+    /// Index of the first row on screen
+    size_t top;
+    FlipagotchiHandshake rows[HANDSHAKE_LIST_ROWS];
+    /// Rows whose page hasn't come in yet are drawn as placeholders
+    bool row_loaded[HANDSHAKE_LIST_ROWS];
+} HandshakeListModel;
+
+/**
+ * Input events the handshake list hands to its owner
+ */
+typedef enum {
+    /// The cursor moved, the rows need filling in again
+    HandshakeListEventMoved,
+} HandshakeListEvent;
+
+typedef void (*HandshakeListCallback)(HandshakeListEvent event, void* context);
+
+typedef struct {
+    View* view;
+    void* context;
+    HandshakeListCallback callback;
+} HandshakeList;
+
+/// Arena space handshake_list_alloc carves, the view and its model stay on the furi heap
+#define HANDSHAKE_LIST_ARENA_SIZE FLIPAGOTCHI_ARENA_ALIGN(sizeof(HandshakeList))
+
+/**
+ * Carve a handshake list out of the arena and construct it
+ *
+ * @param arena Arena to carve from, HANDSHAKE_LIST_ARENA_SIZE of it is used
+ * @return Constructed handshake list
+ */
+HandshakeList* handshake_list_alloc(FlipagotchiArena* arena);
+
+/**
+ * Destruct the handshake list, its memory goes with the arena
+ *
+ * @param list Handshake list to destruct
+ */
+void handshake_list_free(HandshakeList* list);
+
+View* handshake_list_get_view(HandshakeList* list);
+
+/**
+ * Set the callback for input events
+ *
+ * @param list Handshake list to configure
+ * @param callback Called from the gui thread on each event
+ * @param context Passed to the callback
+ */
+void handshake_list_set_callback(HandshakeList* list, HandshakeListCallback callback, void* context);
+
+/**
+ * Put the cursor back on the newest handshake and forget the rows, done when the browser opens
+ *
+ * @param list Handshake list to reset
+ */
+void handshake_list_reset(HandshakeList* list);
+
+/**
+ * Fill the rows on screen in from the page cache, which asks for whatever page it doesn't have
+ *
+ * @param list Handshake list to fill
+ * @param handshakes Page cache to read
+ * @return If every row on screen is filled in, it needs filling again later otherwise
+ */
+bool handshake_list_fill(HandshakeList* list, FlipagotchiHandshakes* handshakes);
@@ -0,0 +1,147 @@
+#include "peer_list.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../flipagotchi_diag.h"
+
+/// Height of a row, the header's included
+#define PEER_LIST_ROW_HEIGHT 9
+
+/**
+ * First index the list shows, scrolled no further than a full page from the end
+ */
+static size_t peer_list_first(const PeerListModel* model) {
+    size_t count = model->peers.count;
+    size_t last_page = count > PEER_LIST_ROWS ? count - PEER_LIST_ROWS : 0;
+    return MIN(model->top, last_page);
+}
+
+/**
+ * Write how long ago a peer was heard, in the largest unit that isn't 0
+ */
+static void peer_list_age(char* text, size_t size, uint32_t ticks) {
+    uint32_t seconds = ticks / furi_ms_to_ticks(1000);
+    if(seconds < 60) {
+        snprintf(text, size, "%lus", (unsigned long)seconds);
+    } else if(seconds < 3600) {
+        snprintf(text, size, "%lum", (unsigned long)(seconds / 60));
+    } else {
+        snprintf(text, size, "%luh", (unsigned long)(seconds / 3600));
+    }
+}
+
+static void peer_list_draw_callback(Canvas* canvas, void* _model) {
+    PeerListModel* model = _model;
+    const PwnagotchiPeerTable* peers = &model->peers;
+    size_t first = peer_list_first(model);
+    char text[16];
+
+    canvas_set_font(canvas, PWNAGOTCHI_FONT);
+    snprintf(text, sizeof(text), "Peers %u", (unsigned)peers->count);
+    canvas_draw_str_aligned(canvas, 0, 0, AlignLeft, AlignTop, text);
+    if(peers->count > 0) {
+        snprintf(
+            text,
+            sizeof(text),
+            "%u-%u",
+            (unsigned)(first + 1),
+            (unsigned)MIN(first + PEER_LIST_ROWS, peers->count));
+        canvas_draw_str_aligned(canvas, FLIPPER_SCREEN_WIDTH - 1, 0, AlignRight, AlignTop, text);
+    }
+    canvas_draw_line(canvas, 0, 8, FLIPPER_SCREEN_WIDTH - 1, 8);
+
+    if(peers->count == 0) {
+        canvas_draw_str_aligned(
+            canvas, FLIPPER_SCREEN_WIDTH / 2, 36, AlignCenter, AlignCenter, "No friends around");
+        return;
+    }
+
+    for(size_t row = 0; row < PEER_LIST_ROWS && first + row < peers->count; row++) {
+        const PwnagotchiPeer* peer = &peers->peers[first + row];
+        uint8_t y = (row + 1) * PEER_LIST_ROW_HEIGHT + 1;
+        canvas_draw_str_aligned(canvas, 0, y, AlignLeft, AlignTop, peer->name);
+        snprintf(text, sizeof(text), "%d", peer->rssi);
+        canvas_draw_str_aligned(canvas, 72, y, AlignRight, AlignTop, text);
+        snprintf(text, sizeof(text), "%u", (unsigned)peer->pwned);
+        canvas_draw_str_aligned(canvas, 102, y, AlignRight, AlignTop, text);
+        peer_list_age(text, sizeof(text), model->now - peer->seen_tick);
+        canvas_draw_str_aligned(canvas, FLIPPER_SCREEN_WIDTH - 1, y, AlignRight, AlignTop, text);
+    }
+}
+
+static bool peer_list_input_callback(InputEvent* event, void* context) {
+    PeerList* list = context;
+
+    if(event->type != InputTypeShort && event->type != InputTypeRepeat) {
+        return false;
+    }
+    if(event->key != InputKeyUp && event->key != InputKeyDown) {
+        return false;
+    }
+
+    with_view_model(
+        list->view,
+        PeerListModel * model,
+        {
+            // the table may have shrunk under a scroll position past its end
+            model->top = peer_list_first(model);
+            if(event->key == InputKeyUp && model->top > 0) {
+                model->top--;
+            } else if(
+                event->key == InputKeyDown && model->top + PEER_LIST_ROWS < model->peers.count) {
+                model->top++;
+            }
+        },
+        true);
+    return true;
+}
+
+PeerList* peer_list_alloc(FlipagotchiArena* arena) {
+    PeerList* list = flipagotchi_arena_carve(arena, FlipagotchiDiagHeapView, sizeof(PeerList));
+    list->view = view_alloc();
+    // comes back zeroed, no peers
+    view_allocate_model(list->view, ViewModelTypeLocking, sizeof(PeerListModel));
+    flipagotchi_diag_heap_account(FlipagotchiDiagHeapView, sizeof(PeerListModel));
+    view_set_context(list->view, list);
+    view_set_draw_callback(list->view, peer_list_draw_callback);
+    view_set_input_callback(list->view, peer_list_input_callback);
+    return list;
+}
+
+void peer_list_free(PeerList* list) {
+    furi_assert(list);
+    view_free(list->view);
+    list->view = NULL;
+    flipagotchi_diag_heap_account(FlipagotchiDiagHeapView, -(int32_t)sizeof(PeerListModel));
+}
+
+View* peer_list_get_view(PeerList* list) {
+    furi_assert(list);
+    return list->view;
+}
+
+void peer_list_reset(PeerList* list) {
+    furi_assert(list);
+    with_view_model(
+        list->view, PeerListModel * model, { model->top = 0; }, false);
+}
+
+void peer_list_fill(PeerList* list, const PwnagotchiPeerTable* peers) {
+    furi_assert(list);
+    uint32_t now = furi_get_tick();
+    bool update = false;
+    with_view_model(
+        list->view,
+        PeerListModel * model,
+        {
+            // ages are drawn in whole seconds, a redraw a second keeps them current
+            update = memcmp(&model->peers, peers, sizeof(PwnagotchiPeerTable)) != 0 ||
+                     now / furi_ms_to_ticks(1000) != model->now / furi_ms_to_ticks(1000);
+            if(update) {
+                memcpy(&model->peers, peers, sizeof(PwnagotchiPeerTable));
+                model->now = now;
+            }
+        },
+        update);
+}
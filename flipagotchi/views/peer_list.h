@@ -0,0 +1,60 @@
+#pragma once
+
+#include <furi.h>
+#include <gui/view.h>
+
+#include "pwnagotchi.h"
+#include "../flipagotchi_arena.h"
+
+/// Peers on screen at once
+#define PEER_LIST_ROWS 6
+
+/**
+ * What the peer list shows, a copy of the peer table taken on the gui thread
+ */
+typedef struct {
+    PwnagotchiPeerTable peers;
+    /// Tick the copy was taken at, ages are drawn against it
+    uint32_t now;
+    /// Index of the first peer on screen, only changed by scrolling
+    size_t top;
+} PeerListModel;
+
+typedef struct {
+    View* view;
+} PeerList;
+
+/// Arena space peer_list_alloc carves, the view and its model stay on the furi heap
+#define PEER_LIST_ARENA_SIZE FLIPAGOTCHI_ARENA_ALIGN(sizeof(PeerList))
+
+/**
+ * Carve a peer list out of the arena and construct it
+ *
+ * @param arena Arena to carve from, PEER_LIST_ARENA_SIZE of it is used
+ * @return Constructed peer list
+ */
+PeerList* peer_list_alloc(FlipagotchiArena* arena);
+
+/**
+ * Destruct the peer list, its memory goes with the arena
+ *
+ * @param list Peer list to destruct
+ */
+void peer_list_free(PeerList* list);
+
+View* peer_list_get_view(PeerList* list);
+
+/**
+ * Scroll back to the closest peer, done when the list opens
+ *
+ * @param list Peer list to reset
+ */
+void peer_list_reset(PeerList* list);
+
+/**
+ * Show a copy of the peer table, redrawing only if it changed or an age on screen ticked over
+ *
+ * @param list Peer list to fill
+ * @param peers Peer table to show
+ */
+void peer_list_fill(PeerList* list, const PwnagotchiPeerTable* peers);
@@ -1,131 +1,269 @@
 #include "pwnagotchi.h"
 
+#include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
 #include <furi.h>
 
-void pwnagotchi_draw_face(PwnagotchiModel* model, Canvas* canvas) {
-    FURI_LOG_I("PWN", "drawing face %d", model->face);
+#include "../flipagotchi_diag.h"
+#include "../flipagotchi_aps.h"
+#include "../flipagotchi_channels.h"
+#include "../flipagotchi_peers.h"
+#include "../protocol.h"
+
+/// Access points the list page shows at once
+#define PWNAGOTCHI_AP_LIST_ROWS 6
+/// Height of a row of the list page, its header included
+#define PWNAGOTCHI_AP_LIST_ROW_HEIGHT 9
+
+/// Tallest bar of the channel page, the busiest channel of the counter on show
+#define PWNAGOTCHI_CHANNEL_BAR_HEIGHT 21
+/// Left edge of the first bar, the band names go in front
+#define PWNAGOTCHI_CHANNEL_BARS_X 16
+/// Bottom row of the 2.4 GHz and the 5 GHz bars, the current channel is marked 2 below
+#define PWNAGOTCHI_CHANNEL_2GHZ_BASE 33
+#define PWNAGOTCHI_CHANNEL_5GHZ_BASE 61
+
+typedef struct {
+    uint8_t count;
+    enum PwnagotchiFace frames[PWNAGOTCHI_ANIMATION_MAX_FRAMES];
+} PwnagotchiAnimationFrames;
+
+// indexed like PwnagotchiFaceIcons, 4 below the PwnagotchiAnimation value
+static const PwnagotchiAnimationFrames pwnagotchi_animations[PwnAnimation_End - PwnAnimation_Look] = {
+    {2, {Look_r, Look_l}},
+    {2, {Look_r_happy, Look_l_happy}},
+    {2, {Sleep, Sleep2}},
+    {3, {Upload, Upload1, Upload2}},
+};
+
+bool pwnagotchi_animation_is_valid(uint8_t animation, uint32_t period_ms) {
+    return animation >= PwnAnimation_Look && animation < PwnAnimation_End &&
+           period_ms >= PWNAGOTCHI_ANIMATION_MIN_PERIOD_MS &&
+           period_ms <= PWNAGOTCHI_ANIMATION_MAX_PERIOD_MS;
+}
 
-    if(model->face < 4 || model->face >= EndFace) {
-        FURI_LOG_W("PWN", "asked to draw invalid face %d", model->face);
+void pwnagotchi_start_animation(
+    PwnagotchiModel* model,
+    enum PwnagotchiAnimation animation,
+    uint32_t period_ms) {
+    furi_assert(pwnagotchi_animation_is_valid(animation, period_ms));
+    model->animation = animation;
+    model->animation_frame = 0;
+    model->animation_period_ms = period_ms;
+    model->face = pwnagotchi_animations[animation - PwnAnimation_Look].frames[0];
+}
+
+uint32_t pwnagotchi_animation_timer_period(const PwnagotchiModel* model) {
+    return model->animation == PwnAnimation_None ? 0 : model->animation_period_ms;
+}
+
+/**
+ * Move the animation on a frame
+ *
+ * @param model Model to step, the caller holds its lock
+ * @return If the face changed
+ */
+static bool pwnagotchi_step_animation(PwnagotchiModel* model) {
+    if(model->animation < PwnAnimation_Look || model->animation >= PwnAnimation_End) {
+        return false;
+    }
+
+    const PwnagotchiAnimationFrames* animation =
+        &pwnagotchi_animations[model->animation - PwnAnimation_Look];
+    model->animation_frame = (model->animation_frame + 1) % animation->count;
+    model->face = animation->frames[model->animation_frame];
+    return true;
+}
+
+static void pwnagotchi_animation_timer_callback(void* context) {
+    Pwnagotchi* pwn = context;
+
+    // runs on the timer thread, the frames are stepped here so link jitter never shows
+    bool update = false;
+    with_view_model(
+        pwn->view, PwnagotchiModel * model, { update = pwnagotchi_step_animation(model); }, update);
+}
+
+void pwnagotchi_run_animation_timer(Pwnagotchi* pwn, uint32_t period_ms) {
+    furi_assert(pwn);
+    if(period_ms == pwn->animation_timer_period_ms) {
         return;
     }
 
-    // subtract 4 from our PwnagotchiFace value to skip over the reserved values
-    // since PwnagotchiFaceIcons is 0 indexed, while PwnagotchiFace is 4 indexed
-    canvas_draw_icon(
-        canvas, PWNAGOTCHI_FACE_J, PWNAGOTCHI_FACE_I, PwnagotchiFaceIcons[model->face - 4]);
+    pwn->animation_timer_period_ms = period_ms;
+    if(period_ms == 0) {
+        furi_timer_stop(pwn->animation_timer);
+    } else {
+        furi_timer_start(pwn->animation_timer, furi_ms_to_ticks(period_ms));
+    }
 }
 
-void pwnagotchi_draw_name(PwnagotchiModel* model, Canvas* canvas) {
-    char* formatName = malloc(sizeof(char) * (PWNAGOTCHI_MAX_HOSTNAME_LEN + 2));
-    strncpy(formatName, model->hostname, PWNAGOTCHI_MAX_HOSTNAME_LEN);
-    strncat(formatName, ">", 2);
-    canvas_set_font(canvas, PWNAGOTCHI_FONT);
-    canvas_draw_str(canvas, PWNAGOTCHI_NAME_J, PWNAGOTCHI_NAME_I, formatName);
-    free(formatName);
+void pwnagotchi_decay_channels(Pwnagotchi* pwn) {
+    furi_assert(pwn);
+    bool update = false;
+    with_view_model(
+        pwn->view,
+        PwnagotchiModel * model,
+        {
+            update = flipagotchi_channels_decay(model->channels, furi_get_tick()) &&
+                     model->page == PwnagotchiPageChannels;
+        },
+        update);
 }
 
-void pwnagotchi_draw_channel(PwnagotchiModel* model, Canvas* canvas) {
-    char* formatChannel = malloc(sizeof(char) * (PWNAGOTCHI_MAX_CHANNEL_LEN + 4));
-    strncpy(formatChannel, "CH", 3);
-    strcat(formatChannel, model->channel);
-    canvas_set_font(canvas, PWNAGOTCHI_FONT);
-    canvas_draw_str(canvas, PWNAGOTCHI_CHANNEL_J, PWNAGOTCHI_CHANNEL_I, formatChannel);
-    free(formatChannel);
+void pwnagotchi_get_peers(Pwnagotchi* pwn, PwnagotchiPeerTable* peers) {
+    furi_assert(pwn);
+    with_view_model(
+        pwn->view,
+        PwnagotchiModel * model,
+        { memcpy(peers, model->peers, sizeof(PwnagotchiPeerTable)); },
+        false);
 }
 
-void pwnagotchi_draw_aps(PwnagotchiModel* model, Canvas* canvas) {
-    char* formatAP = malloc(sizeof(char) * (PWNAGOTCHI_MAX_APS_LEN + 5));
-    strncpy(formatAP, "APS", 4);
-    strcat(formatAP, model->apStat);
-    canvas_set_font(canvas, PWNAGOTCHI_FONT);
-    canvas_draw_str(canvas, PWNAGOTCHI_APS_J, PWNAGOTCHI_APS_I, formatAP);
-    free(formatAP);
+enum PwnagotchiMode pwnagotchi_set_mode(Pwnagotchi* pwn, enum PwnagotchiMode mode) {
+    furi_assert(pwn);
+    enum PwnagotchiMode previous = mode;
+    with_view_model(
+        pwn->view,
+        PwnagotchiModel * model,
+        {
+            previous = model->mode;
+            model->mode = mode;
+            model->field_hash[PwnagotchiFieldMode] = 0;
+        },
+        true);
+    return previous;
 }
 
-void pwnagotchi_draw_uptime(PwnagotchiModel* model, Canvas* canvas) {
-    char* formatUp = malloc(sizeof(char) * (PWNAGOTCHI_MAX_UPTIME_LEN + 4));
-    strncpy(formatUp, "UP", 3);
-    strcat(formatUp, model->uptime);
-    canvas_set_font(canvas, PWNAGOTCHI_FONT);
-    canvas_draw_str(canvas, PWNAGOTCHI_UPTIME_J, PWNAGOTCHI_UPTIME_I, formatUp);
-    free(formatUp);
+void pwnagotchi_blit_tile(
+    PwnagotchiModel* model,
+    uint8_t index,
+    const uint8_t rows[PWNAGOTCHI_TILE_SIZE]) {
+    furi_assert(index < PWNAGOTCHI_TILE_COUNT);
+    size_t x = index % PWNAGOTCHI_TILES_X;
+    size_t y = index / PWNAGOTCHI_TILES_X * PWNAGOTCHI_TILE_SIZE;
+    for(size_t row = 0; row < PWNAGOTCHI_TILE_SIZE; row++) {
+        model->framebuffer[(y + row) * (FLIPPER_SCREEN_WIDTH / 8) + x] = rows[row];
+    }
 }
 
-void pwnagotchi_draw_lines(PwnagotchiModel* model, Canvas* canvas) {
-    UNUSED(model);
-    // Line 1
-    canvas_draw_line(
-        canvas,
-        PWNAGOTCHI_LINE1_START_J,
-        PWNAGOTCHI_LINE1_START_I,
-        PWNAGOTCHI_LINE1_END_J,
-        PWNAGOTCHI_LINE1_END_I);
+static void pwnagotchi_layout_draw_face(
+    Canvas* canvas,
+    const PwnagotchiModel* model,
+    const PwnagotchiLayoutEntry* entry) {
+    FURI_LOG_I("PWN", "drawing face %d", model->face);
 
-    // Line 2
-    canvas_draw_line(
+    if(model->face < 4 || model->face >= EndFace) {
+        FURI_LOG_W("PWN", "asked to draw invalid face %d", model->face);
+        return;
+    }
+
+    // subtract 4 from our PwnagotchiFace value to skip over the reserved values
+    // since PwnagotchiFaceIcons is 0 indexed, while PwnagotchiFace is 4 indexed
+    canvas_draw_icon(canvas, entry->x, entry->y, PwnagotchiFaceIcons[model->face - 4]);
+}
+
+static void pwnagotchi_layout_draw_text(
+    Canvas* canvas,
+    const PwnagotchiModel* model,
+    const PwnagotchiLayoutEntry* entry) {
+    // prefix and suffix come out of the one text, together they are shorter than it
+    char text[PWNAGOTCHI_LAYOUT_TEXT_LEN + PWNAGOTCHI_MAX_SSID_LEN];
+    const char* field = (const char*)model + entry->field;
+    snprintf(text, sizeof(text), "%s%s%s", entry->prefix, field, entry->suffix);
+    canvas_set_font(canvas, entry->font);
+    canvas_draw_str_aligned(
+        canvas, entry->anchor_x, entry->anchor_y, entry->horizontal, entry->vertical, text);
+}
+
+static void pwnagotchi_layout_draw_mode(
+    Canvas* canvas,
+    const PwnagotchiModel* model,
+    const PwnagotchiLayoutEntry* entry) {
+    static const char* const mode_names[] = {
+        [PwnMode_Manual] = "MANU",
+        [PwnMode_Auto] = "AUTO",
+        [PwnMode_Ai] = "AI",
+    };
+    canvas_set_font(canvas, entry->font);
+    canvas_draw_str_aligned(
         canvas,
-        PWNAGOTCHI_LINE2_START_J,
-        PWNAGOTCHI_LINE2_START_I,
-        PWNAGOTCHI_LINE2_END_J,
-        PWNAGOTCHI_LINE2_END_I);
+        entry->anchor_x,
+        entry->anchor_y,
+        entry->horizontal,
+        entry->vertical,
+        mode_names[model->mode]);
 }
 
-void pwnagotchi_draw_handshakes(PwnagotchiModel* model, Canvas* canvas) {
-    char* formatShakes = malloc(sizeof(char) * (PWNAGOTCHI_MAX_HANDSHAKES_LEN + 5));
-    strncpy(formatShakes, "PWND ", 6);
-    strcat(formatShakes, model->handshakes);
-    canvas_set_font(canvas, PWNAGOTCHI_FONT);
-    canvas_draw_str(canvas, PWNAGOTCHI_HANDSHAKES_J, PWNAGOTCHI_HANDSHAKES_I, formatShakes);
-    free(formatShakes);
+static void pwnagotchi_layout_draw_line(
+    Canvas* canvas,
+    const PwnagotchiModel* model,
+    const PwnagotchiLayoutEntry* entry) {
+    UNUSED(model);
+    canvas_draw_line(
+        canvas, entry->x, entry->y, entry->x + entry->width - 1, entry->y + entry->height - 1);
 }
 
-void pwnagotchi_draw_mode(PwnagotchiModel* model, Canvas* canvas) {
-    canvas_set_font(canvas, PWNAGOTCHI_FONT);
-    switch(model->mode) {
-    case PwnMode_Manual:
-        canvas_draw_str(canvas, PWNAGOTCHI_MODE_MANU_J, PWNAGOTCHI_MODE_MANU_I, "MANU");
-        break;
-    case PwnMode_Auto:
-        canvas_draw_str(canvas, PWNAGOTCHI_MODE_AUTO_J, PWNAGOTCHI_MODE_AUTO_I, "AUTO");
-        break;
-    case PwnMode_Ai:
-        canvas_draw_str(canvas, PWNAGOTCHI_MODE_AI_J, PWNAGOTCHI_MODE_AI_I, "AI");
-        break;
+static void pwnagotchi_layout_draw_friend(
+    Canvas* canvas,
+    const PwnagotchiModel* model,
+    const PwnagotchiLayoutEntry* entry) {
+    const PwnagotchiPeer* peer = flipagotchi_peers_closest(model->peers);
+    if(peer == NULL) {
+        return;
     }
+    char text[PWNAGOTCHI_LAYOUT_TEXT_LEN * 2 + PWNAGOTCHI_MAX_HOSTNAME_LEN + 8];
+    snprintf(
+        text,
+        sizeof(text),
+        "%s%s %u%s",
+        entry->prefix,
+        peer->name,
+        (unsigned)peer->pwned,
+        entry->suffix);
+    canvas_set_font(canvas, entry->font);
+    canvas_draw_str_aligned(
+        canvas, entry->anchor_x, entry->anchor_y, entry->horizontal, entry->vertical, text);
 }
 
-void pwnagotchi_draw_status(PwnagotchiModel* model, Canvas* canvas) {
+static void pwnagotchi_layout_draw_status(
+    Canvas* canvas,
+    const PwnagotchiModel* model,
+    const PwnagotchiLayoutEntry* entry) {
     // we don't use a monospace font like FontKeyboard because we can fit a lot more characters on average
     // using FontSecondary. This is a bummer for figuring out how many characters we can fit on screen
 
     // TODO figure out how to make the multi-line status fit properly
 
-    canvas_set_font(canvas, FontSecondary);
+    canvas_set_font(canvas, entry->font);
     int fontHeight = canvas_current_font_height(canvas);
 
     // Apparently W is the widest character (USING a for a more average approach)
     size_t charLength = canvas_string_width(canvas, "a");
 
-    size_t horizSpace = FLIPPER_SCREEN_WIDTH - PWNAGOTCHI_STATUS_J;
+    size_t horizSpace = entry->width;
     size_t charSpaces = floor(((double)horizSpace) / charLength);
+    size_t statusLen = strlen(model->status);
     size_t statusPixLen = canvas_string_width(canvas, model->status);
-    size_t maxLines = floor((PWNAGOTCHI_STATUS_I - PWNAGOTCHI_LINE2_END_I) / ((double)fontHeight));
+    // lines that fit in the rect, stacked from its top
+    size_t maxLines = entry->height / fontHeight;
 
     size_t requiredLines = ceil(((double)statusPixLen) / horizSpace);
 
     size_t charIndex = 0;
-    for(size_t i = 0; i < requiredLines && i < maxLines - 1; i++) {
+    for(size_t i = 0; i < requiredLines && i < maxLines && charIndex < statusLen; i++) {
         // Allocate the line with room for two more characters (a space and then another char)
+        // plus the terminator
         size_t allocSize = charSpaces + 2;
-        char* line = malloc(sizeof(char) * allocSize);
+        char* line = FLIPAGOTCHI_DIAG_MALLOC(FlipagotchiDiagHeapView, sizeof(char) * (allocSize + 1));
+        memset(line, 0, allocSize + 1);
 
-        // Copy the allotted characters into line
-        memcpy(line, (model->status + charIndex), allocSize);
+        // Copy the allotted characters into line, the last line may be shorter
+        memcpy(line, (model->status + charIndex), MIN(allocSize, statusLen - charIndex));
 
         // Now loop backwards and cut it off at a space if we end with a letter
         size_t backspaceCount = 0;
@@ -144,38 +282,414 @@ void pwnagotchi_draw_status(PwnagotchiModel* model, Canvas* canvas) {
             backspaceCount = 0;
         }
 
-        canvas_draw_str(canvas, PWNAGOTCHI_STATUS_J, PWNAGOTCHI_STATUS_I + (i * fontHeight), line);
+        canvas_draw_str_aligned(
+            canvas, entry->anchor_x, entry->y + (i * fontHeight), entry->horizontal, AlignTop, line);
 
         charIndex += (charSpaces - backspaceCount + 1);
-        free(line);
+        FLIPAGOTCHI_DIAG_FREE(FlipagotchiDiagHeapView, line);
+    }
+}
+
+typedef struct {
+    PwnagotchiLayoutDraw draw;
+    /// Offset of the model string shown, only for pwnagotchi_layout_draw_text
+    uint16_t field;
+} PwnagotchiLayoutKindInfo;
+
+static const PwnagotchiLayoutKindInfo pwnagotchi_layout_kinds[PwnagotchiLayoutKindNum] = {
+    [PwnagotchiLayoutFace] = {pwnagotchi_layout_draw_face, 0},
+    [PwnagotchiLayoutName] = {pwnagotchi_layout_draw_text, offsetof(PwnagotchiModel, hostname)},
+    [PwnagotchiLayoutChannel] = {pwnagotchi_layout_draw_text, offsetof(PwnagotchiModel, channel)},
+    [PwnagotchiLayoutAps] = {pwnagotchi_layout_draw_text, offsetof(PwnagotchiModel, apStat)},
+    [PwnagotchiLayoutUptime] = {pwnagotchi_layout_draw_text, offsetof(PwnagotchiModel, uptime)},
+    [PwnagotchiLayoutMode] = {pwnagotchi_layout_draw_mode, 0},
+    [PwnagotchiLayoutHandshakes] =
+        {pwnagotchi_layout_draw_text, offsetof(PwnagotchiModel, handshakes)},
+    [PwnagotchiLayoutStatus] = {pwnagotchi_layout_draw_status, 0},
+    [PwnagotchiLayoutLine] = {pwnagotchi_layout_draw_line, 0},
+    [PwnagotchiLayoutFriend] = {pwnagotchi_layout_draw_friend, 0},
+};
+
+#define PWNAGOTCHI_LAYOUT_ALIGN(horizontal, vertical) \
+    (PwnagotchiLayoutAlign##horizontal | PwnagotchiLayoutAlign##vertical << 4)
+
+// the built in layout, tools/layout/default.json matches it. text sits on the bottom of its rect,
+// which puts the baseline on the last row
+static const PwnagotchiLayoutItem pwnagotchi_layout_default_items[] = {
+    {PwnagotchiLayoutFace, 0, 25, 60, 14, PWNAGOTCHI_FONT, 0, ""},
+    {PwnagotchiLayoutName, 0, 11, 60, 7, PWNAGOTCHI_FONT, PWNAGOTCHI_LAYOUT_ALIGN(Start, End), "%>"},
+    {PwnagotchiLayoutChannel, 0, 1, 25, 7, PWNAGOTCHI_FONT, PWNAGOTCHI_LAYOUT_ALIGN(Start, End), "CH"},
+    {PwnagotchiLayoutAps, 25, 1, 52, 7, PWNAGOTCHI_FONT, PWNAGOTCHI_LAYOUT_ALIGN(Start, End), "APS"},
+    {PwnagotchiLayoutUptime, 77, 1, 51, 7, PWNAGOTCHI_FONT, PWNAGOTCHI_LAYOUT_ALIGN(Start, End), "UP"},
+    {PwnagotchiLayoutLine, 0, 8, 128, 1, PWNAGOTCHI_FONT, 0, ""},
+    {PwnagotchiLayoutLine, 0, 54, 128, 1, PWNAGOTCHI_FONT, 0, ""},
+    {PwnagotchiLayoutMode, 100, 57, 28, 7, PWNAGOTCHI_FONT, PWNAGOTCHI_LAYOUT_ALIGN(End, End), ""},
+    {PwnagotchiLayoutHandshakes,
+     0,
+     57,
+     100,
+     7,
+     PWNAGOTCHI_FONT,
+     PWNAGOTCHI_LAYOUT_ALIGN(Start, End),
+     "PWND "},
+    {PwnagotchiLayoutStatus, 60, 10, 68, 36, PWNAGOTCHI_FONT, PWNAGOTCHI_LAYOUT_ALIGN(Start, Start), ""},
+    {PwnagotchiLayoutFriend, 0, 44, 60, 7, PWNAGOTCHI_FONT, PWNAGOTCHI_LAYOUT_ALIGN(Start, End), "<3 "},
+};
+
+bool pwnagotchi_layout_item_is_valid(const PwnagotchiLayoutItem* item) {
+    uint8_t horizontal = item->align & 0x0f;
+    uint8_t vertical = item->align >> 4;
+    return item->kind < PwnagotchiLayoutKindNum && item->width > 0 && item->height > 0 &&
+           item->x + item->width <= FLIPPER_SCREEN_WIDTH &&
+           item->y + item->height <= FLIPPER_SCREEN_HEIGHT && item->font < FontTotalNumber &&
+           horizontal < PwnagotchiLayoutAlignNum && vertical < PwnagotchiLayoutAlignNum &&
+           memchr(item->text, '\0', sizeof(item->text)) != NULL;
+}
+
+/**
+ * Point of a rect text is aligned to along one axis
+ */
+static uint8_t pwnagotchi_layout_anchor(uint8_t start, uint8_t size, PwnagotchiLayoutAlign align) {
+    switch(align) {
+    case PwnagotchiLayoutAlignCenter:
+        return start + size / 2;
+    case PwnagotchiLayoutAlignEnd:
+        return start + size - 1;
+    default:
+        return start;
     }
 }
 
+static void pwnagotchi_layout_entry_init(PwnagotchiLayoutEntry* entry, const PwnagotchiLayoutItem* item) {
+    static const Align horizontal[PwnagotchiLayoutAlignNum] = {AlignLeft, AlignCenter, AlignRight};
+    static const Align vertical[PwnagotchiLayoutAlignNum] = {AlignTop, AlignCenter, AlignBottom};
+
+    memset(entry, 0, sizeof(PwnagotchiLayoutEntry));
+    entry->draw = pwnagotchi_layout_kinds[item->kind].draw;
+    entry->field = pwnagotchi_layout_kinds[item->kind].field;
+    entry->x = item->x;
+    entry->y = item->y;
+    entry->width = item->width;
+    entry->height = item->height;
+    entry->anchor_x = pwnagotchi_layout_anchor(item->x, item->width, item->align & 0x0f);
+    entry->anchor_y = pwnagotchi_layout_anchor(item->y, item->height, item->align >> 4);
+    entry->horizontal = horizontal[item->align & 0x0f];
+    entry->vertical = vertical[item->align >> 4];
+    entry->font = item->font;
+
+    // split the text at the field mark once here, rather than on every draw
+    const char* mark = strchr(item->text, PWNAGOTCHI_LAYOUT_FIELD_MARK);
+    if(mark == NULL) {
+        strlcpy(entry->prefix, item->text, sizeof(entry->prefix));
+    } else {
+        memcpy(entry->prefix, item->text, mark - item->text);
+        strlcpy(entry->suffix, mark + 1, sizeof(entry->suffix));
+    }
+}
+
+bool pwnagotchi_layout_compile(
+    PwnagotchiLayout* layout,
+    const PwnagotchiLayoutItem* items,
+    size_t count) {
+    if(count > PWNAGOTCHI_LAYOUT_MAX_ENTRIES) {
+        return false;
+    }
+    for(size_t i = 0; i < count; i++) {
+        if(!pwnagotchi_layout_item_is_valid(&items[i])) {
+            return false;
+        }
+    }
+
+    for(size_t i = 0; i < count; i++) {
+        pwnagotchi_layout_entry_init(&layout->entries[i], &items[i]);
+    }
+    layout->count = count;
+    return true;
+}
+
+void pwnagotchi_layout_default(PwnagotchiLayout* layout) {
+    bool compiled = pwnagotchi_layout_compile(
+        layout, pwnagotchi_layout_default_items, COUNT_OF(pwnagotchi_layout_default_items));
+    furi_check(compiled);
+}
+
+void pwnagotchi_draw_elements(const PwnagotchiModel* model, Canvas* canvas) {
+    for(size_t i = 0; i < PWNAGOTCHI_MAX_ELEMENTS; i++) {
+        const PwnagotchiElement* element = &model->elements[i];
+        if(!element->declared) {
+            continue;
+        }
+
+        canvas_set_font(canvas, element->font);
+        uint8_t x = element->x;
+        if(element->label[0] != '\0') {
+            canvas_draw_str_aligned(canvas, x, element->y, AlignLeft, AlignTop, element->label);
+            x += canvas_string_width(canvas, element->label);
+        }
+        canvas_draw_str_aligned(canvas, x, element->y, AlignLeft, AlignTop, element->value);
+    }
+}
+
+/**
+ * First rank the list page shows, scrolled no further than a full page from the end
+ */
+static size_t pwnagotchi_ap_list_first(const PwnagotchiModel* model) {
+    size_t count = model->aps->count;
+    size_t last_page = count > PWNAGOTCHI_AP_LIST_ROWS ? count - PWNAGOTCHI_AP_LIST_ROWS : 0;
+    return MIN((size_t)model->ap_scroll, last_page);
+}
+
+static void pwnagotchi_draw_ap_list(Canvas* canvas, const PwnagotchiModel* model) {
+    static const char* const security_names[] = {
+        [AP_SECURITY_OPEN] = "OPN",
+        [AP_SECURITY_WEP] = "WEP",
+        [AP_SECURITY_WPA] = "WPA",
+        [AP_SECURITY_WPA2] = "WP2",
+        [AP_SECURITY_WPA3] = "WP3",
+    };
+    const PwnagotchiApTable* table = model->aps;
+    size_t first = pwnagotchi_ap_list_first(model);
+    char text[16];
+
+    canvas_set_font(canvas, PWNAGOTCHI_FONT);
+    snprintf(text, sizeof(text), "APs %u", (unsigned)table->count);
+    canvas_draw_str_aligned(canvas, 0, 0, AlignLeft, AlignTop, text);
+    if(table->count > 0) {
+        snprintf(
+            text,
+            sizeof(text),
+            "%u-%u",
+            (unsigned)(first + 1),
+            (unsigned)MIN(first + PWNAGOTCHI_AP_LIST_ROWS, table->count));
+        canvas_draw_str_aligned(canvas, FLIPPER_SCREEN_WIDTH - 1, 0, AlignRight, AlignTop, text);
+    }
+    canvas_draw_line(canvas, 0, 8, FLIPPER_SCREEN_WIDTH - 1, 8);
+
+    for(size_t row = 0; row < PWNAGOTCHI_AP_LIST_ROWS && first + row < table->count; row++) {
+        const PwnagotchiAp* ap = flipagotchi_aps_get(table, first + row);
+        uint8_t y = (row + 1) * PWNAGOTCHI_AP_LIST_ROW_HEIGHT + 1;
+        snprintf(text, sizeof(text), "%d", ap->rssi);
+        canvas_draw_str_aligned(canvas, 16, y, AlignRight, AlignTop, text);
+        snprintf(text, sizeof(text), "%u", ap->channel);
+        canvas_draw_str_aligned(canvas, 30, y, AlignRight, AlignTop, text);
+        canvas_draw_str_aligned(canvas, 33, y, AlignLeft, AlignTop, security_names[ap->security]);
+        canvas_draw_str_aligned(
+            canvas, 52, y, AlignLeft, AlignTop, ap->ssid[0] != '\0' ? ap->ssid : "<hidden>");
+    }
+}
+
+/**
+ * Draw one band of the channel page, a bar per channel scaled against the busiest one
+ */
+static void pwnagotchi_draw_channel_band(
+    Canvas* canvas,
+    const uint32_t* heat,
+    size_t first,
+    size_t count,
+    uint8_t bar_width,
+    uint8_t base,
+    uint32_t busiest,
+    int current) {
+    for(size_t i = 0; i < count; i++) {
+        uint8_t x = PWNAGOTCHI_CHANNEL_BARS_X + i * (bar_width + 1);
+        uint32_t value = heat[first + i];
+        if(value > 0) {
+            uint8_t height = MAX(
+                (uint64_t)value * PWNAGOTCHI_CHANNEL_BAR_HEIGHT / busiest, (uint64_t)1);
+            canvas_draw_box(canvas, x, base - height + 1, bar_width, height);
+        }
+        if((int)(first + i) == current) {
+            canvas_draw_line(canvas, x, base + 2, x + bar_width - 1, base + 2);
+        }
+    }
+}
+
+static void pwnagotchi_draw_channels(Canvas* canvas, const PwnagotchiModel* model) {
+    static const char* const heat_names[PwnagotchiHeatNum] = {
+        [PwnagotchiHeatTraffic] = "Traffic",
+        [PwnagotchiHeatAps] = "APs",
+        [PwnagotchiHeatHandshakes] = "Handshakes",
+    };
+    const uint32_t* heat = model->channels->heat[model->heat];
+    uint32_t busiest = 0;
+    for(size_t slot = 0; slot < PWNAGOTCHI_CHANNEL_SLOTS; slot++) {
+        busiest = MAX(busiest, heat[slot]);
+    }
+    // the channel field is the hop channel as text, * while it hops too fast to say
+    int current = flipagotchi_channels_slot(strtoul(model->channel, NULL, 10));
+    char text[16];
+
+    canvas_set_font(canvas, PWNAGOTCHI_FONT);
+    canvas_draw_str_aligned(canvas, 0, 0, AlignLeft, AlignTop, heat_names[model->heat]);
+    if(current >= 0) {
+        snprintf(
+            text,
+            sizeof(text),
+            "ch%u %lu",
+            flipagotchi_channels_number(current),
+            (unsigned long)(heat[current] >> FLIPAGOTCHI_CHANNELS_FRACTION_BITS));
+        canvas_draw_str_aligned(canvas, FLIPPER_SCREEN_WIDTH - 1, 0, AlignRight, AlignTop, text);
+    }
+    canvas_draw_line(canvas, 0, 8, FLIPPER_SCREEN_WIDTH - 1, 8);
+
+    canvas_draw_str_aligned(canvas, 0, PWNAGOTCHI_CHANNEL_2GHZ_BASE, AlignLeft, AlignBottom, "2G");
+    canvas_draw_str_aligned(canvas, 0, PWNAGOTCHI_CHANNEL_5GHZ_BASE, AlignLeft, AlignBottom, "5G");
+    if(busiest == 0) {
+        busiest = 1;
+    }
+    pwnagotchi_draw_channel_band(
+        canvas, heat, 0, PWNAGOTCHI_CHANNEL_SLOTS_2GHZ, 6, PWNAGOTCHI_CHANNEL_2GHZ_BASE, busiest, current);
+    pwnagotchi_draw_channel_band(
+        canvas,
+        heat,
+        PWNAGOTCHI_CHANNEL_SLOTS_2GHZ,
+        PWNAGOTCHI_CHANNEL_SLOTS_5GHZ,
+        3,
+        PWNAGOTCHI_CHANNEL_5GHZ_BASE,
+        busiest,
+        current);
+}
+
 static void pwnagotchi_draw_callback(Canvas* canvas, void* _model) {
     PwnagotchiModel* model = _model;
 
-    pwnagotchi_draw_face(model, canvas);
-    pwnagotchi_draw_name(model, canvas);
-    pwnagotchi_draw_channel(model, canvas);
-    pwnagotchi_draw_aps(model, canvas);
-    pwnagotchi_draw_uptime(model, canvas);
-    pwnagotchi_draw_lines(model, canvas);
-    pwnagotchi_draw_mode(model, canvas);
-    pwnagotchi_draw_handshakes(model, canvas);
-    pwnagotchi_draw_status(model, canvas);
+    if(model->page == PwnagotchiPageAps) {
+        pwnagotchi_draw_ap_list(canvas, model);
+        return;
+    }
+    if(model->page == PwnagotchiPageChannels) {
+        pwnagotchi_draw_channels(canvas, model);
+        return;
+    }
+
+    if(model->mirror) {
+        // the pwnagotchi drew the whole screen itself
+        canvas_draw_xbm(
+            canvas, 0, 0, FLIPPER_SCREEN_WIDTH, FLIPPER_SCREEN_HEIGHT, model->framebuffer);
+        return;
+    }
+
+    const PwnagotchiLayout* layout = model->layout;
+    for(size_t i = 0; i < layout->count; i++) {
+        layout->entries[i].draw(canvas, model, &layout->entries[i]);
+    }
+    pwnagotchi_draw_elements(model, canvas);
+}
+
+/**
+ * Flip pages and scroll, all of it local to the view
+ *
+ * @param model Model to move around in, the caller holds its lock
+ * @param key Key that was pressed
+ * @return If the key was used
+ */
+static bool pwnagotchi_navigate(PwnagotchiModel* model, InputKey key) {
+    switch(key) {
+    case InputKeyRight:
+        if(model->page + 1 < PwnagotchiPageNum) {
+            model->page++;
+        }
+        return true;
+    case InputKeyLeft:
+        if(model->page > 0) {
+            model->page--;
+        }
+        return true;
+    case InputKeyUp:
+        if(model->page == PwnagotchiPageChannels) {
+            model->heat = (model->heat + PwnagotchiHeatNum - 1) % PwnagotchiHeatNum;
+            return true;
+        }
+        if(model->page != PwnagotchiPageAps) {
+            return false;
+        }
+        // the table may have shrunk under a scroll position past its end
+        model->ap_scroll = pwnagotchi_ap_list_first(model);
+        if(model->ap_scroll > 0) {
+            model->ap_scroll--;
+        }
+        return true;
+    case InputKeyDown:
+        if(model->page == PwnagotchiPageChannels) {
+            model->heat = (model->heat + 1) % PwnagotchiHeatNum;
+            return true;
+        }
+        if(model->page != PwnagotchiPageAps) {
+            return false;
+        }
+        model->ap_scroll = pwnagotchi_ap_list_first(model);
+        if((size_t)model->ap_scroll + PWNAGOTCHI_AP_LIST_ROWS < model->aps->count) {
+            model->ap_scroll++;
+        }
+        return true;
+    default:
+        return false;
+    }
 }
 
 static bool pwnagotchi_input_callback(InputEvent* event, void* context) {
-    UNUSED(context);
-    UNUSED(event);
+    Pwnagotchi* pwn = context;
+
+    if(event->type == InputTypeShort && event->key == InputKeyOk && pwn->callback) {
+        pwn->callback(PwnagotchiEventOk, pwn->context);
+        return true;
+    }
+    if(event->type == InputTypeLong && event->key == InputKeyOk && pwn->callback) {
+        pwn->callback(PwnagotchiEventControl, pwn->context);
+        return true;
+    }
+
+    if(event->type == InputTypeShort || event->type == InputTypeRepeat) {
+        bool consumed = false;
+        with_view_model(
+            pwn->view,
+            PwnagotchiModel * model,
+            { consumed = pwnagotchi_navigate(model, event->key); },
+            consumed);
+        if(!consumed && event->type == InputTypeShort && event->key == InputKeyDown &&
+           pwn->callback) {
+            pwn->callback(PwnagotchiEventHandshakes, pwn->context);
+            consumed = true;
+        } else if(
+            !consumed && event->type == InputTypeShort && event->key == InputKeyUp &&
+            pwn->callback) {
+            pwn->callback(PwnagotchiEventPeers, pwn->context);
+            consumed = true;
+        }
+        return consumed;
+    }
     return false;
 }
 
-Pwnagotchi* pwnagotchi_alloc() {
-    Pwnagotchi* pwn = malloc(sizeof(Pwnagotchi));
+Pwnagotchi* pwnagotchi_alloc(FlipagotchiArena* arena) {
+    Pwnagotchi* pwn = flipagotchi_arena_carve(arena, FlipagotchiDiagHeapView, sizeof(Pwnagotchi));
+    pwn->context = NULL;
+    pwn->callback = NULL;
+    pwn->animation_timer =
+        furi_timer_alloc(pwnagotchi_animation_timer_callback, FuriTimerTypePeriodic, pwn);
+    pwn->animation_timer_period_ms = 0;
+    uint8_t* framebuffer =
+        flipagotchi_arena_carve(arena, FlipagotchiDiagHeapView, PWNAGOTCHI_FRAMEBUFFER_SIZE);
+    // comes back zeroed, so every slot starts out undeclared
+    PwnagotchiElement* elements = flipagotchi_arena_carve(
+        arena, FlipagotchiDiagHeapView, sizeof(PwnagotchiElement) * PWNAGOTCHI_MAX_ELEMENTS);
+    // the built in layout until one is loaded from the sd card
+    PwnagotchiLayout* layout =
+        flipagotchi_arena_carve(arena, FlipagotchiDiagHeapView, sizeof(PwnagotchiLayout));
+    pwnagotchi_layout_default(layout);
+    // zeroed, which is an empty table
+    PwnagotchiApTable* aps =
+        flipagotchi_arena_carve(arena, FlipagotchiDiagHeapView, sizeof(PwnagotchiApTable));
+    PwnagotchiChannelTable* channels =
+        flipagotchi_arena_carve(arena, FlipagotchiDiagHeapView, sizeof(PwnagotchiChannelTable));
+    flipagotchi_channels_clear(channels, furi_get_tick());
+    // zeroed, which is an empty table
+    PwnagotchiPeerTable* peers =
+        flipagotchi_arena_carve(arena, FlipagotchiDiagHeapView, sizeof(PwnagotchiPeerTable));
 
     pwn->view = view_alloc();
     view_allocate_model(pwn->view, ViewModelTypeLocking, sizeof(PwnagotchiModel));
+    flipagotchi_diag_heap_account(FlipagotchiDiagHeapView, sizeof(PwnagotchiModel));
 
     with_view_model(
         pwn->view,
@@ -190,6 +704,17 @@ Pwnagotchi* pwnagotchi_alloc() {
             strlcpy(model->status, "Hack the planet!", sizeof(model->status));
             strlcpy(model->handshakes, "0 (0)", sizeof(model->handshakes));
             model->mode = PwnMode_Manual;
+            model->animation = PwnAnimation_None;
+            model->mirror = false;
+            model->framebuffer = framebuffer;
+            model->elements = elements;
+            model->layout = layout;
+            model->aps = aps;
+            model->page = PwnagotchiPageFace;
+            model->ap_scroll = 0;
+            model->channels = channels;
+            model->heat = PwnagotchiHeatTraffic;
+            model->peers = peers;
         },
         false);
 
@@ -202,8 +727,19 @@ Pwnagotchi* pwnagotchi_alloc() {
 
 void pwnagotchi_free(Pwnagotchi* pwn) {
     furi_assert(pwn);
+    // stop the animation first, its callback uses the view
+    furi_timer_stop(pwn->animation_timer);
+    furi_timer_free(pwn->animation_timer);
+    pwn->animation_timer = NULL;
     view_free(pwn->view);
-    free(pwn);
+    pwn->view = NULL;
+    flipagotchi_diag_heap_account(FlipagotchiDiagHeapView, -(int32_t)sizeof(PwnagotchiModel));
+}
+
+void pwnagotchi_set_callback(Pwnagotchi* pwn, PwnagotchiCallback callback, void* context) {
+    furi_assert(pwn);
+    pwn->callback = callback;
+    pwn->context = context;
 }
 
 View* pwnagotchi_get_view(Pwnagotchi* pwn) {
@@ -11,6 +11,7 @@ Icons from RogueMaster at:
 https://github.com/RogueMaster/flipperzero-firmware-wPlugins/commit/8c45f8e9a921f61cda78ecdb2e58a244041d3e05
 */
 #include "flipagotchi_icons.h"
+#include "../flipagotchi_arena.h"
 
 /// Max length of channel data at top left
 #define PWNAGOTCHI_MAX_CHANNEL_LEN 4
@@ -41,37 +42,55 @@ https://github.com/RogueMaster/flipperzero-firmware-wPlugins/commit/8c45f8e9a921
 
 #define PWNAGOTCHI_HEIGHT FLIPPER_SCREEN_HEIGHT
 #define PWNAGOTCHI_WIDTH FLIPPER_SCREEN_WIDTH
-#define PWNAGOTCHI_FACE_I 25
-#define PWNAGOTCHI_FACE_J 0
-#define PWNAGOTCHI_NAME_I 17
-#define PWNAGOTCHI_NAME_J 0
-#define PWNAGOTCHI_CHANNEL_I 7
-#define PWNAGOTCHI_CHANNEL_J 0
-#define PWNAGOTCHI_APS_I 7
-#define PWNAGOTCHI_APS_J 25
-#define PWNAGOTCHI_UPTIME_I 7
-#define PWNAGOTCHI_UPTIME_J 77
-#define PWNAGOTCHI_LINE1_START_I 8
-#define PWNAGOTCHI_LINE1_START_J 0
-#define PWNAGOTCHI_LINE1_END_I 8
-#define PWNAGOTCHI_LINE1_END_J 127
-#define PWNAGOTCHI_LINE2_START_I 54
-#define PWNAGOTCHI_LINE2_START_J 0
-#define PWNAGOTCHI_LINE2_END_I 54
-#define PWNAGOTCHI_LINE2_END_J 127
-#define PWNAGOTCHI_HANDSHAKES_I 63
-#define PWNAGOTCHI_HANDSHAKES_J 0
-#define PWNAGOTCHI_MODE_AI_I 63
-#define PWNAGOTCHI_MODE_AI_J 121
-#define PWNAGOTCHI_MODE_AUTO_I 63
-#define PWNAGOTCHI_MODE_AUTO_J 105
-#define PWNAGOTCHI_MODE_MANU_I 63
-#define PWNAGOTCHI_MODE_MANU_J 103
-#define PWNAGOTCHI_STATUS_I 17
-#define PWNAGOTCHI_STATUS_J 60
-
 #define PWNAGOTCHI_FONT FontSecondary
 
+/// Most entries in a screen layout
+#define PWNAGOTCHI_LAYOUT_MAX_ENTRIES 16
+
+/// Longest text around the field of a layout entry, terminator included
+#define PWNAGOTCHI_LAYOUT_TEXT_LEN 8
+
+/// Marks where the field goes in the text of a layout entry, text without one goes in front
+#define PWNAGOTCHI_LAYOUT_FIELD_MARK '%'
+
+/// Bytes in the 1 bpp mirrored framebuffer, rows of XBM bytes with the leftmost pixel in bit 0
+#define PWNAGOTCHI_FRAMEBUFFER_SIZE (FLIPPER_SCREEN_WIDTH * FLIPPER_SCREEN_HEIGHT / 8)
+
+/// Side of a framebuffer tile in pixels, a tile row is one byte
+#define PWNAGOTCHI_TILE_SIZE 8
+
+/// Tiles in a framebuffer row
+#define PWNAGOTCHI_TILES_X (FLIPPER_SCREEN_WIDTH / PWNAGOTCHI_TILE_SIZE)
+
+/// Tiles in the framebuffer, numbered left to right then top to bottom
+#define PWNAGOTCHI_TILE_COUNT (PWNAGOTCHI_TILES_X * (FLIPPER_SCREEN_HEIGHT / PWNAGOTCHI_TILE_SIZE))
+
+/// Plugin elements the view holds at once
+#define PWNAGOTCHI_MAX_ELEMENTS 8
+
+/// Maximum length of a plugin element's label
+#define PWNAGOTCHI_MAX_ELEMENT_LABEL_LEN 9
+
+/// Maximum length of a plugin element's value
+#define PWNAGOTCHI_MAX_ELEMENT_VALUE_LEN 21
+
+/// Access points the table holds at once, the pwnagotchi only sends the strongest this many
+#define PWNAGOTCHI_MAX_APS 48
+/// Slots of the bssid index, a power of two well above PWNAGOTCHI_MAX_APS to keep probes short
+#define PWNAGOTCHI_AP_SLOTS 64
+/// Bytes in a bssid
+#define PWNAGOTCHI_BSSID_LEN 6
+/// Maximum length of an access point's ssid as it is kept, longer ones are cut on the pwnagotchi
+#define PWNAGOTCHI_MAX_AP_SSID_LEN 21
+
+/// Channels the heatmap keeps, 1 to 14 on 2.4 GHz then the 5 GHz ones, see flipagotchi_channels.h
+#define PWNAGOTCHI_CHANNEL_SLOTS_2GHZ 14
+#define PWNAGOTCHI_CHANNEL_SLOTS_5GHZ 25
+#define PWNAGOTCHI_CHANNEL_SLOTS (PWNAGOTCHI_CHANNEL_SLOTS_2GHZ + PWNAGOTCHI_CHANNEL_SLOTS_5GHZ)
+
+/// Peers the table holds at once, the pwnagotchi only sends the closest this many
+#define PWNAGOTCHI_MAX_PEERS 8
+
 /**
  * Enum to represent possible faces to save them locally rather than transmit every time  Faces are loaded from assets/faces/ which gets complied as flipagotchi_icons.h
    THE NUMBERING MUST MATCH the order in PwnagotchiFaceIcons
@@ -118,11 +137,213 @@ static const Icon* const PwnagotchiFaceIcons[25] = {
     &I_upload2_flipagotchi,
 };
 
+/**
+ * Face animations the view steps through by itself, numbered from 4 like the faces
+ */
+enum PwnagotchiAnimation {
+    PwnAnimation_None = 0,
+    PwnAnimation_Look = 4,
+    PwnAnimation_LookHappy,
+    PwnAnimation_Sleep,
+    PwnAnimation_Upload,
+    PwnAnimation_End // a marker to denote the end of the animations enum
+};
+
+/// Most frames in any face animation
+#define PWNAGOTCHI_ANIMATION_MAX_FRAMES 3
+
+/// Fastest frame rate the pwnagotchi can ask for
+#define PWNAGOTCHI_ANIMATION_MIN_PERIOD_MS 50
+
+/// Slowest frame rate the pwnagotchi can ask for
+#define PWNAGOTCHI_ANIMATION_MAX_PERIOD_MS 60000
+
 /**
  * Enum for current mode of the pwnagotchi
  */
 enum PwnagotchiMode { PwnMode_Manual, PwnMode_Auto, PwnMode_Ai };
 
+/**
+ * Model fields the pwnagotchi sets, in the order their hashes go into the state hash
+ */
+typedef enum {
+    PwnagotchiFieldFace,
+    PwnagotchiFieldName,
+    PwnagotchiFieldChannel,
+    PwnagotchiFieldAps,
+    PwnagotchiFieldUptime,
+    PwnagotchiFieldMode,
+    PwnagotchiFieldHandshakes,
+    PwnagotchiFieldStatus,
+    PwnagotchiFieldNum,
+} PwnagotchiField;
+
+/**
+ * What a layout entry draws
+ */
+typedef enum {
+    PwnagotchiLayoutFace,
+    PwnagotchiLayoutName,
+    PwnagotchiLayoutChannel,
+    PwnagotchiLayoutAps,
+    PwnagotchiLayoutUptime,
+    PwnagotchiLayoutMode,
+    PwnagotchiLayoutHandshakes,
+    PwnagotchiLayoutStatus,
+    /// Line from the top left to the bottom right of the rect
+    PwnagotchiLayoutLine,
+    /// Name and pwned count of the closest peer, nothing while there is none
+    PwnagotchiLayoutFriend,
+    PwnagotchiLayoutKindNum,
+} PwnagotchiLayoutKind;
+
+/**
+ * Where text sits in its rect, on either axis
+ */
+typedef enum {
+    PwnagotchiLayoutAlignStart,
+    PwnagotchiLayoutAlignCenter,
+    PwnagotchiLayoutAlignEnd,
+    PwnagotchiLayoutAlignNum,
+} PwnagotchiLayoutAlign;
+
+/**
+ * A layout entry as it is stored, see flipagotchi_layout.h for the file it comes from
+ */
+typedef struct {
+    /// PwnagotchiLayoutKind
+    uint8_t kind;
+    /// Rect the entry is drawn in, all of it on screen
+    uint8_t x;
+    uint8_t y;
+    uint8_t width;
+    uint8_t height;
+    /// Font of text entries
+    uint8_t font;
+    /// PwnagotchiLayoutAlign horizontally in the low nibble, vertically in the high nibble
+    uint8_t align;
+    /// Drawn around the field, see PWNAGOTCHI_LAYOUT_FIELD_MARK
+    char text[PWNAGOTCHI_LAYOUT_TEXT_LEN];
+} PwnagotchiLayoutItem;
+
+typedef struct PwnagotchiLayout PwnagotchiLayout;
+
+/**
+ * A ui element a pwnagotchi plugin added, declared once and then only its value is sent
+ */
+typedef struct {
+    /// Slot holds a declared element, free slots aren't drawn
+    bool declared;
+    /// Left edge
+    uint8_t x;
+    /// Top edge
+    uint8_t y;
+    Font font;
+    /// Most characters of the value that are kept
+    uint8_t max_len;
+    /// Drawn in front of the value, may be empty
+    char label[PWNAGOTCHI_MAX_ELEMENT_LABEL_LEN];
+    char value[PWNAGOTCHI_MAX_ELEMENT_VALUE_LEN];
+} PwnagotchiElement;
+
+/**
+ * An access point in range of the pwnagotchi
+ */
+typedef struct {
+    uint8_t bssid[PWNAGOTCHI_BSSID_LEN];
+    /// Signal in dBm
+    int8_t rssi;
+    uint8_t channel;
+    /// One of the AP_SECURITY_* codes
+    uint8_t security;
+    /// Stations seen talking to it, capped at 255
+    uint8_t clients;
+    char ssid[PWNAGOTCHI_MAX_AP_SSID_LEN];
+} PwnagotchiAp;
+
+/**
+ * Access points keyed by bssid, with an index of them by signal kept up to date as they change
+ *
+ * Everything is fixed size, a zeroed table is empty. See flipagotchi_aps.h for the operations
+ */
+typedef struct {
+    /// Access points in no particular order, the first count are used
+    PwnagotchiAp aps[PWNAGOTCHI_MAX_APS];
+    size_t count;
+    /// Open addressing on the bssid hash, holds an index into aps plus one, 0 for a free slot
+    uint8_t slots[PWNAGOTCHI_AP_SLOTS];
+    /// Index into aps of every access point, strongest first
+    uint8_t order[PWNAGOTCHI_MAX_APS];
+    /// Where each access point is in order, indexed like aps
+    uint8_t rank[PWNAGOTCHI_MAX_APS];
+} PwnagotchiApTable;
+
+/**
+ * Counters the channel heatmap keeps for every channel
+ */
+typedef enum {
+    /// KiB bettercap saw go by
+    PwnagotchiHeatTraffic,
+    /// Access points seen, once per wifi update
+    PwnagotchiHeatAps,
+    /// Handshakes captured
+    PwnagotchiHeatHandshakes,
+    PwnagotchiHeatNum,
+} PwnagotchiHeat;
+
+/**
+ * Activity per channel, each counter decaying over time so it shows what happens lately
+ *
+ * Zeroed is all quiet. See flipagotchi_channels.h for the operations
+ */
+typedef struct {
+    /// Counters by slot, fixed point with FLIPAGOTCHI_CHANNELS_FRACTION_BITS
+    uint32_t heat[PwnagotchiHeatNum][PWNAGOTCHI_CHANNEL_SLOTS];
+    /// Tick the last decay step was taken at
+    uint32_t decay_tick;
+} PwnagotchiChannelTable;
+
+/**
+ * Another pwnagotchi the unit can hear
+ */
+typedef struct {
+    /// Hash of the peer's fingerprint
+    uint32_t key;
+    /// enum PwnagotchiFace it shows
+    uint8_t face;
+    /// Signal in dBm
+    int8_t rssi;
+    /// Handshakes it captured in total, capped at 65535
+    uint16_t pwned;
+    /// Tick it was last heard at
+    uint32_t seen_tick;
+    char name[PWNAGOTCHI_MAX_HOSTNAME_LEN];
+} PwnagotchiPeer;
+
+/**
+ * Peers keyed by fingerprint hash, kept closest first
+ *
+ * Zeroed is empty. See flipagotchi_peers.h for the operations
+ */
+typedef struct {
+    /// Closest first, the first count are used
+    PwnagotchiPeer peers[PWNAGOTCHI_MAX_PEERS];
+    size_t count;
+} PwnagotchiPeerTable;
+
+/**
+ * Screens the view flips between with left and right
+ */
+typedef enum {
+    /// The pwnagotchi's face and fields
+    PwnagotchiPageFace,
+    /// Access points in range, strongest first
+    PwnagotchiPageAps,
+    /// Activity per channel
+    PwnagotchiPageChannels,
+    PwnagotchiPageNum,
+} PwnagotchiPage;
+
 typedef struct {
     /// Current face
     enum PwnagotchiFace face;
@@ -141,23 +362,118 @@ typedef struct {
     char handshakes[PWNAGOTCHI_MAX_SSID_LEN];
     /// Current mode the pwnagotchi is in
     enum PwnagotchiMode mode;
+    /// Hash of the message each field was last set from, 0 while it still holds its default
+    uint32_t field_hash[PwnagotchiFieldNum];
+    /// Animation face is a frame of, PwnAnimation_None for a still face
+    enum PwnagotchiAnimation animation;
+    /// Frame of the animation on screen
+    uint8_t animation_frame;
+    /// Time each frame stays on screen
+    uint32_t animation_period_ms;
+    /// Draw the mirrored framebuffer instead of the fields
+    bool mirror;
+    /// Pwnagotchi's own screen, rendered and downscaled on its side, PWNAGOTCHI_FRAMEBUFFER_SIZE bytes
+    uint8_t* framebuffer;
+    /// Plugin elements by id, PWNAGOTCHI_MAX_ELEMENTS of them
+    PwnagotchiElement* elements;
+    /// Draw list the fields are drawn from
+    PwnagotchiLayout* layout;
+    /// Access points in range of the pwnagotchi
+    PwnagotchiApTable* aps;
+    /// Screen on show
+    PwnagotchiPage page;
+    /// Rank of the first access point on the list page, only changed by scrolling
+    uint8_t ap_scroll;
+    /// Activity per channel
+    PwnagotchiChannelTable* channels;
+    /// Counter the channel page shows, switched with up and down
+    PwnagotchiHeat heat;
+    /// Other pwnagotchis in range
+    PwnagotchiPeerTable* peers;
 
 } PwnagotchiModel;
 
+typedef struct PwnagotchiLayoutEntry PwnagotchiLayoutEntry;
+
+typedef void (*PwnagotchiLayoutDraw)(
+    Canvas* canvas,
+    const PwnagotchiModel* model,
+    const PwnagotchiLayoutEntry* entry);
+
+/**
+ * A layout item made ready to draw, everything the draw callback needs is worked out up front
+ */
+struct PwnagotchiLayoutEntry {
+    /// Draws the entry, picked by its kind
+    PwnagotchiLayoutDraw draw;
+    /// Offset of the string a text entry shows in PwnagotchiModel
+    uint16_t field;
+    uint8_t x;
+    uint8_t y;
+    uint8_t width;
+    uint8_t height;
+    /// Point in the rect text is aligned to
+    uint8_t anchor_x;
+    uint8_t anchor_y;
+    Align horizontal;
+    Align vertical;
+    Font font;
+    /// Text before and after the field
+    char prefix[PWNAGOTCHI_LAYOUT_TEXT_LEN];
+    char suffix[PWNAGOTCHI_LAYOUT_TEXT_LEN];
+};
+
+struct PwnagotchiLayout {
+    size_t count;
+    PwnagotchiLayoutEntry entries[PWNAGOTCHI_LAYOUT_MAX_ENTRIES];
+};
+
+/**
+ * Input events the pwnagotchi view hands to its owner
+ */
+typedef enum {
+    /// OK was pressed, the owner may want to open a menu
+    PwnagotchiEventOk,
+    /// Down was pressed on the pwnagotchi's screen, the owner may want to open the handshakes
+    PwnagotchiEventHandshakes,
+    /// Up was pressed on the pwnagotchi's screen, the owner may want to open the peers
+    PwnagotchiEventPeers,
+    /// OK was held, the owner may want to open the controls
+    PwnagotchiEventControl,
+} PwnagotchiEvent;
+
+typedef void (*PwnagotchiCallback)(PwnagotchiEvent event, void* context);
+
 typedef struct {
     View* view;
     void* context;
+    PwnagotchiCallback callback;
+    /// Steps the face animation, only runs while one is playing
+    FuriTimer* animation_timer;
+    /// Period the animation timer runs at, 0 while it is stopped
+    uint32_t animation_timer_period_ms;
 } Pwnagotchi;
 
+/// Arena space pwnagotchi_alloc carves, the view and its model stay on the furi heap
+#define PWNAGOTCHI_ARENA_SIZE \
+    (FLIPAGOTCHI_ARENA_ALIGN(sizeof(Pwnagotchi)) +                               \
+     FLIPAGOTCHI_ARENA_ALIGN(PWNAGOTCHI_FRAMEBUFFER_SIZE) +                      \
+     FLIPAGOTCHI_ARENA_ALIGN(sizeof(PwnagotchiElement) * PWNAGOTCHI_MAX_ELEMENTS) + \
+     FLIPAGOTCHI_ARENA_ALIGN(sizeof(PwnagotchiLayout)) +                        \
+     FLIPAGOTCHI_ARENA_ALIGN(sizeof(PwnagotchiApTable)) +                       \
+     FLIPAGOTCHI_ARENA_ALIGN(sizeof(PwnagotchiChannelTable)) +                  \
+     FLIPAGOTCHI_ARENA_ALIGN(sizeof(PwnagotchiPeerTable)))
+
 /**
- * @brief Allocates and constructs a pwnagotchi struct
+ * @brief Carves a pwnagotchi struct out of the arena and constructs it
  * 
+ * @param arena Arena to carve from, PWNAGOTCHI_ARENA_SIZE of it is used
  * @return Pwnagotchi* Constructed pwnagotchi pointer
  */
-Pwnagotchi* pwnagotchi_alloc();
+Pwnagotchi* pwnagotchi_alloc(FlipagotchiArena* arena);
 
 /**
- * @brief Destruct and free pwnagotchi
+ * @brief Destruct pwnagotchi, its memory goes with the arena
  * 
  * @param pwn Pwnagotchi to destruct
  */
@@ -166,81 +482,131 @@ void pwnagotchi_free(Pwnagotchi* pwn);
 View* pwnagotchi_get_view(Pwnagotchi* pwn);
 
 /**
- * Draw the default display with no additional information provided
- * 
- * @param pwn Pwnagotchi device to draw
- * @param canvas Canvas to draw on
+ * Set the callback for input events the view doesn't handle itself
+ *
+ * @param pwn Pwnagotchi to configure
+ * @param callback Called from the gui thread on each event
+ * @param context Passed to the callback
  */
-void pwnagotchi_draw_blank(PwnagotchiModel* model, Canvas* canvas);
+void pwnagotchi_set_callback(Pwnagotchi* pwn, PwnagotchiCallback callback, void* context);
 
 /**
- * Draw the stored pwnagotchi's face on the device
- * 
- * @param pwn Pwnagotchi to draw
- * @param canvas Canvas to draw on
+ * Check the pwnagotchi asked for an animation and frame rate we can play
+ *
+ * @param animation Animation code from the pwnagotchi
+ * @param period_ms Time each frame should stay on screen
+ * @return If the animation can be played
  */
-void pwnagotchi_draw_face(PwnagotchiModel* model, Canvas* canvas);
+bool pwnagotchi_animation_is_valid(uint8_t animation, uint32_t period_ms);
 
 /**
- * Draw the name of the pwnagotchi
- * 
- * @param pwn Pwnagotchi to draw
- * @param canvas Canvas to draw on
+ * Start playing a face animation from its first frame
+ *
+ * @note The timer only picks it up once pwnagotchi_run_animation_timer is called
+ *
+ * @param model Model to animate, the caller holds its lock
+ * @param animation Animation to play, checked with pwnagotchi_animation_is_valid
+ * @param period_ms Time each frame stays on screen
  */
-void pwnagotchi_draw_name(PwnagotchiModel* model, Canvas* canvas);
+void pwnagotchi_start_animation(
+    PwnagotchiModel* model,
+    enum PwnagotchiAnimation animation,
+    uint32_t period_ms);
 
 /**
- * Draw channel on pwnagotchi
- * 
- * @param pwn Pwnagotchi to draw
- * @param canvas Canvas to draw on
+ * Period the animation timer should run at for a model
+ *
+ * @param model Model to check, the caller holds its lock
+ * @return Frame period, 0 if nothing is playing
  */
-void pwnagotchi_draw_channel(PwnagotchiModel* model, Canvas* canvas);
+uint32_t pwnagotchi_animation_timer_period(const PwnagotchiModel* model);
 
 /**
- * Draw aps on pwnagotchi
- * 
- * @param pwn Pwnagotchi to draw
- * @param canvas Canvas to draw on
+ * Start, retime or stop the timer stepping the face animation
+ *
+ * @note Must not be called with the model locked, the timer callback takes the lock
+ *
+ * @param pwn Pwnagotchi to animate
+ * @param period_ms From pwnagotchi_animation_timer_period, 0 stops the timer
  */
-void pwnagotchi_draw_aps(PwnagotchiModel* model, Canvas* canvas);
+void pwnagotchi_run_animation_timer(Pwnagotchi* pwn, uint32_t period_ms);
 
 /**
- * Draw uptime on pwnagotchi
- * 
- * @param pwn Pwnagotchi to draw
- * @param canvas Canvas to draw on
+ * Copy a tile into the mirrored framebuffer
+ *
+ * @param model Model to draw into, the caller holds its lock
+ * @param index Tile to replace, below PWNAGOTCHI_TILE_COUNT
+ * @param rows Tile rows top to bottom, leftmost pixel in bit 0
  */
-void pwnagotchi_draw_uptime(PwnagotchiModel* model, Canvas* canvas);
+void pwnagotchi_blit_tile(
+    PwnagotchiModel* model,
+    uint8_t index,
+    const uint8_t rows[PWNAGOTCHI_TILE_SIZE]);
 
 /**
- * Draw lines on pwnagotchi
- * 
- * @param pwn Pwnagotchi to draw
- * @param canvas Canvas to draw on
+ * Check a layout item fits on the screen and names a kind, font and alignment we have
+ *
+ * @param item Item to check
+ * @return If the item can be drawn
  */
-void pwnagotchi_draw_lines(PwnagotchiModel* model, Canvas* canvas);
+bool pwnagotchi_layout_item_is_valid(const PwnagotchiLayoutItem* item);
 
 /**
- * Draw current mode of pwnagotchi
- * 
- * @param pwn Pwnagotchi to draw
- * @param canvas Canvas to draw on
+ * Turn layout items into the draw list, all or nothing
+ *
+ * @param layout Draw list to replace, left alone if any item isn't valid
+ * @param items Items in the order they are drawn
+ * @param count Number of items, at most PWNAGOTCHI_LAYOUT_MAX_ENTRIES
+ * @return If the layout was replaced
  */
-void pwnagotchi_draw_mode(PwnagotchiModel* model, Canvas* canvas);
+bool pwnagotchi_layout_compile(
+    PwnagotchiLayout* layout,
+    const PwnagotchiLayoutItem* items,
+    size_t count);
 
 /**
- * Draw the number of handshakes in the PWND portion as well as the last handshake
- * 
- * @param pwn Pwnagotchi to draw
- * @param canvas Canvas to draw on
+ * Put the built in layout in a draw list
+ *
+ * @param layout Draw list to replace
  */
-void pwnagotchi_draw_handshakes(PwnagotchiModel* model, Canvas* canvas);
+void pwnagotchi_layout_default(PwnagotchiLayout* layout);
 
 /**
- * Draw the status that the pwnagotchi is showing on the screen
- * 
- * @param pwn Pwnagotchi to draw
+ * Draw every declared plugin element, label then value
+ *
+ * @param model Model to draw, locked by the caller
  * @param canvas Canvas to draw on
  */
-void pwnagotchi_draw_status(PwnagotchiModel* model, Canvas* canvas);
+void pwnagotchi_draw_elements(const PwnagotchiModel* model, Canvas* canvas);
+
+/**
+ * Let the channel heatmap cool down by the time gone by, redrawing if the page shows it
+ *
+ * @note Must not be called with the model locked
+ *
+ * @param pwn Pwnagotchi to update
+ */
+void pwnagotchi_decay_channels(Pwnagotchi* pwn);
+
+/**
+ * Copy the peer table out of the model
+ *
+ * @note Must not be called with the model locked
+ *
+ * @param pwn Pwnagotchi to read
+ * @param peers Where the copy goes
+ */
+void pwnagotchi_get_peers(Pwnagotchi* pwn, PwnagotchiPeerTable* peers);
+
+/**
+ * Show a mode the pwnagotchi hasn't confirmed yet
+ *
+ * The mode's field hash is dropped, so the next resync sends the mode the pwnagotchi really is in
+ *
+ * @note Must not be called with the model locked
+ *
+ * @param pwn Pwnagotchi to update
+ * @param mode Mode to show
+ * @return Mode it replaced
+ */
+enum PwnagotchiMode pwnagotchi_set_mode(Pwnagotchi* pwn, enum PwnagotchiMode mode);
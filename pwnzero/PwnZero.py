@@ -1,11 +1,20 @@
+import collections
+import json
 import logging
+import os
+import queue
+import random
+import re
 import serial
+import threading
 import time
+import zlib
 from enum import Enum
 
 import pwnagotchi
 import pwnagotchi.plugins as plugins
 import pwnagotchi.ui.faces as faces
+from PIL import Image
 
 
 class Packet(Enum):
@@ -15,6 +24,7 @@ class Packet(Enum):
     """
     START   = 0x02
     END     = 0x03
+    ESCAPE  = 0x10 # binary bodies escape the bytes above and 0, see _escape
 
 class FlipperCommand(Enum):
     """
@@ -36,6 +46,18 @@ class FlipperCommand(Enum):
     UI_HANDSHAKES  = 0x0B
     UI_STATUS      = 0x0C
     UI_CHANNEL     = 0x0D
+    UI_FACE_ANIM   = 0x0E # the flipper steps the frames itself
+    UI_TILES       = 0x0F # framebuffer tiles, for the tiles render option
+    UI_ELEMENT     = 0x11 # declare or remove a plugin element
+    UI_ELEMENT_SET = 0x12 # value of a declared plugin element
+    FILE_OPEN      = 0x13 # start or resume sending a file to the flipper's sd card
+    FILE_CHUNK     = 0x14 # piece of that file, acked a window at a time with FILE_ACK
+    AP_SET         = 0x17 # access points that showed up or changed
+    AP_EVICT       = 0x18 # access points that went away, an empty one clears the table
+    HANDSHAKE_PAGE = 0x19 # a page of the captured handshakes, answers a HANDSHAKE_LIST
+    CHANNEL_STATS  = 0x1A # what was seen on each channel since the last one, for the heatmap
+    PEER_SET       = 0x1B # peers that showed up or changed
+    PEER_EXPIRE    = 0x1C # peers that went away, an empty one clears the table
 
 
 class PwnCommand(Enum):
@@ -51,9 +73,11 @@ class PwnCommand(Enum):
     # pwnagotchi commands
     REBOOT         = 0x04
     SHUTDOWN       = 0x05
-    MODE           = 0x07
+    MODE           = 0x07 # switch to the PwnMode in the body
     UI_REFRESH     = 0x08 # request a ui refresh from the pwnagotchi
-    CLOCK_SET      = 0x09 # flipper has a hardware clock, pwnagotchi does not. lets leverage that
+    CLOCK_SET      = 0x09 # flipper has a hardware clock, pwnagotchi does not. its time, see ClockSync
+    FILE_ACK       = 0x0A # how far the flipper got with the file we are sending
+    HANDSHAKE_LIST = 0x0B # page of the captured handshakes the flipper wants, 4 hex characters
 
     #TODO add ability to send commands to bettercap
 
@@ -95,6 +119,160 @@ class PwnFace(Enum):
     UPLOAD1         = 0x1B
     UPLOAD2         = 0x1C
 
+class PwnAnimation(Enum):
+    """
+    Face animations the flipper can play by itself
+    """
+    LOOK            = 0x04
+    LOOK_HAPPY      = 0x05
+    SLEEP           = 0x06
+    UPLOAD          = 0x07
+
+# (animation, names of its frames in faces and PwnFace, ms each frame stays on screen)
+# the pwnagotchi flips between these faces by itself, so the flipper is told the animation once
+# instead of getting a face packet for every frame
+FACE_ANIMATIONS = [
+    (PwnAnimation.LOOK, ('LOOK_R', 'LOOK_L'), 1000),
+    (PwnAnimation.LOOK_HAPPY, ('LOOK_R_HAPPY', 'LOOK_L_HAPPY'), 1000),
+    (PwnAnimation.SLEEP, ('SLEEP', 'SLEEP2'), 1000),
+    (PwnAnimation.UPLOAD, ('UPLOAD', 'UPLOAD1', 'UPLOAD2'), 300),
+]
+
+class Tiles(Enum):
+    """
+    First byte of a tiles packet
+    """
+    UPDATE  = 0x04 # tiles go on top of what the flipper has
+    CLEAR   = 0x05 # the flipper clears its framebuffer first
+
+# set in a tile's index byte when its rows follow as is instead of run length encoded
+TILE_RAW = 0x80
+
+# tile bytes are xored with this before escaping, it moves blank and solid rows, run counts and
+# nearly every index off the bytes that need escaping
+TILE_XOR = 0x55
+
+# escaped bytes go out as Packet.ESCAPE then the byte xored with this
+ESCAPE_XOR = 0x20
+ESCAPED_BYTES = {0x00, Packet.START.value, Packet.END.value, Packet.ESCAPE.value}
+
+# the flipper's screen, mirrored as 1 bpp rows of XBM bytes with the leftmost pixel in bit 0
+FRAMEBUFFER_WIDTH = 128
+FRAMEBUFFER_HEIGHT = 64
+TILE_SIZE = 8
+TILES_X = FRAMEBUFFER_WIDTH // TILE_SIZE
+TILE_COUNT = TILES_X * (FRAMEBUFFER_HEIGHT // TILE_SIZE)
+
+# the flipper keeps 200 bytes of a packet, the command included
+MAX_BODY_SIZE = 199
+
+class ElementFont(Enum):
+    """
+    Flipper fonts a plugin element can be drawn in, sent ELEMENT_BYTE_OFFSET above their value
+    """
+    PRIMARY     = 0x00
+    SECONDARY   = 0x01
+
+# element ids and the numbers in a declaration go out this much above their value, clear of 0
+# and the framing bytes
+ELEMENT_BYTE_OFFSET = 0x04
+
+# the flipper's element table, the label and value lengths leave out the terminator
+MAX_ELEMENTS = 8
+MAX_ELEMENT_LABEL_LEN = 8
+MAX_ELEMENT_VALUE_LEN = 20
+
+# rough width of a FontSecondary character, sizes the value to the room left on the flipper
+ELEMENT_CHAR_WIDTH = 5
+
+# pwnagotchi fonts from this size on are drawn in ElementFont.PRIMARY
+ELEMENT_PRIMARY_FONT_SIZE = 20
+
+# files go to the flipper this many bytes at a time, the last chunk can be shorter. an escaped
+# chunk with its offset and crc always fits MAX_BODY_SIZE
+FILE_CHUNK_SIZE = 88
+FILE_NAME_MAX_LEN = 48
+
+class FileAck(Enum):
+    """
+    First byte of a FILE_ACK from the flipper, the offset it is about follows in 8 hex characters.
+    DONE and FAILED carry the crc32 of the file instead, so a stale one can't end the next transfer
+    """
+    OK      = 0x04 # the flipper has everything before the offset
+    RESEND  = 0x05 # go back to the offset and send on from there
+    DONE    = 0x06 # the whole file is on the flipper's sd card
+    FAILED  = 0x07 # the flipper can't write the file
+
+class ApSecurity(Enum):
+    """
+    Security byte of an access point record, the strongest the access point offers
+    """
+    OPEN    = 0x00
+    WEP     = 0x01
+    WPA     = 0x02
+    WPA2    = 0x03
+    WPA3    = 0x04
+
+# the flipper's access point table. only the strongest MAX_APS are kept, so it never fills up
+MAX_APS = 48
+AP_SSID_MAX_LEN = 20
+BSSID_LEN = 6
+
+# crc checked bodies end in the crc32 of what is in front of it
+BODY_CRC_SIZE = 4
+
+# signal changes smaller than this many dB aren't worth a packet
+AP_RSSI_STEP = 3
+
+# the channel heatmap gets at most one CHANNEL_STATS this often, in seconds
+CHANNEL_STATS_INTERVAL = 1
+# channel, KiB of traffic as 2 bytes, access points seen and handshakes captured
+CHANNEL_RECORD_SIZE = 5
+# CHANNEL_STATS in a row the flipper has to NAK before it is taken to not know them
+CHANNEL_STATS_MAX_NAKS = 3
+
+# the flipper's peer table. only the closest MAX_PEERS are kept, so it never fills up
+MAX_PEERS = 8
+PEER_NAME_MAX_LEN = 10
+# a peer's last seen only goes out again once it moved this many seconds
+PEER_SEEN_STEP = 30
+
+# captured handshakes on a HANDSHAKE_PAGE, a page with every byte but the ssids escaped still fits
+HANDSHAKE_PAGE_SIZE = 4
+MAX_HANDSHAKES = 0xffff
+
+# commands from the flipper's control scene, their ACK or NAK carries the command's code
+CONTROL_COMMANDS = (PwnCommand.MODE.value, PwnCommand.REBOOT.value, PwnCommand.SHUTDOWN.value)
+# mode pwnagotchi.restart takes for each PwnMode. AI is auto with the AI enabled in the config, so
+# whether asking for it gets the AI is up to the config, the flipper hears which after the restart
+CONTROL_MODES = {PwnMode.MANU.value: 'MANU', PwnMode.AUTO.value: 'AUTO', PwnMode.AI.value: 'AUTO'}
+
+# a CLOCK_SET is the flipper's rtc time in milliseconds in 12 hex characters, then the round trip
+# of the probe before it in 4, CLOCK_NO_RTT when that one wasn't answered. its ACK carries the code
+CLOCK_TIME_HEX_LEN = 12
+CLOCK_RTT_HEX_LEN = 4
+CLOCK_NO_RTT = 0xffff
+# the pi's clock is stepped onto the flipper's once it is further off than this, in seconds
+CLOCK_STEP = 0.1
+# the offset is taken from the sample with the shortest round trip of the last CLOCK_FILTER, the
+# drift from a line through the last CLOCK_SAMPLES once they span CLOCK_DRIFT_SPAN seconds
+CLOCK_FILTER = 8
+CLOCK_SAMPLES = 16
+CLOCK_DRIFT_SPAN = 10
+# only samples with a delay up to this many times the shortest one's, plus a ms, go into the drift
+CLOCK_DELAY_SPREAD = 2
+# a flipper whose clock reads before 2024 has lost it, it isn't followed
+CLOCK_MIN_TIME = 1704067200
+
+class LinkState(Enum):
+    """
+    State of the link to the flipper, driven by the writer thread
+    """
+    PROBING     = 0 # no flipper yet, sending syns with backoff
+    CONNECTED   = 1
+    DEGRADED    = 2 # connected, but packets have started failing
+    LOST        = 3 # too many failures, about to go back to probing
+
 class SerialConnException(Exception):
     pass
 
@@ -120,6 +298,9 @@ class ReceivedNak(PwnZeroSerialException):
 class ReceivedInvalidAck(PwnZeroSerialException):
     pass
 
+class AckTimeout(PwnZeroSerialException):
+    pass
+
 # helper functions
 def _str_to_bytes(s: str):
     """
@@ -134,6 +315,75 @@ def _str_to_bytes(s: str):
 
     return retVal
 
+# ui elements the Flipper setters read, snapshotted on every ui update
+UI_KEYS = ['face', 'name', 'channel', 'aps', 'uptime', 'friend_face', 'friend_name', 'mode', 'shakes', 'status']
+
+def _ui_snapshot(ui):
+    """
+    Copies the values we care about out of the pwnagotchi view
+
+    The view passed to on_ui_update is the same object every time, so it can't be
+    kept around and compared against later
+
+    :param: ui: pwnagotchi View
+    :return: Dict of UI_KEYS to their current value
+    """
+    return {key: ui.get(key) for key in UI_KEYS}
+
+# elements of the pwnagotchi view the flipper draws by itself, everything else came from a plugin
+BUILTIN_ELEMENTS = set(UI_KEYS) | {'line1', 'line2'}
+
+def _ascii(text: str):
+    # anything the flipper's fonts can't draw, and the framing bytes, become ?
+    return ''.join(c if ' ' <= c <= '~' else '?' for c in text)
+
+def _element_snapshot(ui, ids: dict, names=None):
+    """
+    Copies the plugin elements out of the pwnagotchi view, as they are declared to the flipper
+
+    Positions are scaled from the pwnagotchi's display to the flipper's. Elements are given ids in
+    the order they are first seen and keep them, once the flipper's table is full the rest are left out
+
+    :param: ui: pwnagotchi View
+    :param: ids: Element name to flipper id, or None if it didn't fit. Updated with new elements
+    :param: names: Only mirror these elements, None for every plugin element
+    :return: Dict of element name to [id, x, y, font, max length, label, value]
+    """
+    elements = {}
+    for name, widget in ui._state.items():
+        if name in BUILTIN_ELEMENTS or (names is not None and name not in names):
+            continue
+        # lines, bitmaps and the like have no text to send
+        if not hasattr(widget, 'value') or not hasattr(widget, 'xy'):
+            continue
+
+        if name not in ids:
+            used = [element_id for element_id in ids.values() if element_id is not None]
+            ids[name] = len(used) + ELEMENT_BYTE_OFFSET if len(used) < MAX_ELEMENTS else None
+            if ids[name] is None:
+                logging.warning(f"[PwnZero] no room on the flipper for element {name}")
+        if ids[name] is None:
+            continue
+
+        x = min(int(widget.xy[0] * FRAMEBUFFER_WIDTH / ui.width()), FRAMEBUFFER_WIDTH - 1)
+        y = min(int(widget.xy[1] * FRAMEBUFFER_HEIGHT / ui.height()), FRAMEBUFFER_HEIGHT - 1)
+        font = getattr(widget, 'text_font', None) or getattr(widget, 'font', None)
+        font = ElementFont.PRIMARY if getattr(font, 'size', 0) >= ELEMENT_PRIMARY_FONT_SIZE else ElementFont.SECONDARY
+        label = getattr(widget, 'label', None)
+        label = _ascii(f"{label} ")[:MAX_ELEMENT_LABEL_LEN] if label else ''
+        max_len = max(1, min((FRAMEBUFFER_WIDTH - x) // ELEMENT_CHAR_WIDTH - len(label), MAX_ELEMENT_VALUE_LEN))
+        value = _ascii(str(widget.value if widget.value is not None else ''))[:max_len]
+
+        elements[name] = [ids[name], x, y, font.value, max_len, label, value]
+    return elements
+
+def _encode_element(element):
+    """
+    :return: Body of the packet declaring an element from _element_snapshot
+    """
+    element_id, x, y, font, max_len, label, _ = element
+    return [element_id] + [n + ELEMENT_BYTE_OFFSET for n in (x, y, font, max_len)] + _str_to_bytes(label)
+
 def _ui_diff(current_ui, new_ui, key):
     if current_ui is not None:
         if current_ui.get(key) == new_ui.get(key):
@@ -142,6 +392,549 @@ def _ui_diff(current_ui, new_ui, key):
     return True
 
 
+# encoders for the body of each ui packet, the flipper hashes exactly these bytes
+# so they double as the input to the state hash
+
+def _encode_face(ui):
+    face = ui.get('face')
+    faceEnum = None
+    if face == faces.LOOK_R:
+        faceEnum = PwnFace.LOOK_R
+    elif face == faces.LOOK_L:
+        faceEnum = PwnFace.LOOK_L
+    elif face == faces.LOOK_R_HAPPY:
+        faceEnum = PwnFace.LOOK_R_HAPPY
+    elif face == faces.LOOK_L_HAPPY:
+        faceEnum = PwnFace.LOOK_L_HAPPY
+    elif face == faces.SLEEP:
+        faceEnum = PwnFace.SLEEP
+    elif face == faces.SLEEP2:
+        faceEnum = PwnFace.SLEEP2
+    elif face == faces.AWAKE:
+        faceEnum = PwnFace.AWAKE
+    elif face == faces.BORED:
+        faceEnum = PwnFace.BORED
+    elif face == faces.INTENSE:
+        faceEnum = PwnFace.INTENSE
+    elif face == faces.COOL:
+        faceEnum = PwnFace.COOL
+    elif face == faces.HAPPY:
+        faceEnum = PwnFace.HAPPY
+    elif face == faces.GRATEFUL:
+        faceEnum = PwnFace.GRATEFUL
+    elif face == faces.EXCITED:
+        faceEnum = PwnFace.EXCITED
+    elif face == faces.MOTIVATED:
+        faceEnum = PwnFace.MOTIVATED
+    elif face == faces.DEMOTIVATED:
+        faceEnum = PwnFace.DEMOTIVATED
+    elif face == faces.SMART:
+        faceEnum = PwnFace.SMART
+    elif face == faces.LONELY:
+        faceEnum = PwnFace.LONELY
+    elif face == faces.SAD:
+        faceEnum = PwnFace.SAD
+    elif face == faces.ANGRY:
+        faceEnum = PwnFace.ANGRY
+    elif face == faces.FRIEND:
+        faceEnum = PwnFace.FRIEND
+    elif face == faces.BROKEN:
+        faceEnum = PwnFace.BROKEN
+    elif face == faces.DEBUG:
+        faceEnum = PwnFace.DEBUG
+    elif face == faces.UPLOAD:
+        faceEnum = PwnFace.UPLOAD
+    elif face == faces.UPLOAD1:
+        faceEnum = PwnFace.UPLOAD1
+    elif face == faces.UPLOAD2:
+        faceEnum = PwnFace.UPLOAD2
+
+    return [faceEnum.value]
+
+def _face_animation(face):
+    """
+    :return: (animation, frame ms) a face is a frame of, None for a still face
+    """
+    # faces can be changed in the pwnagotchi config, look them up every time
+    for animation, frames, period_ms in FACE_ANIMATIONS:
+        if face in [getattr(faces, frame) for frame in frames]:
+            return animation, period_ms
+    return None
+
+def _face_packet(ui):
+    """
+    :return: (command, body) that puts the face on the flipper, every frame of an animation
+             gives the same packet
+    """
+    animation = _face_animation(ui.get('face'))
+    if animation is not None:
+        animation, period_ms = animation
+        return FlipperCommand.UI_FACE_ANIM, [animation.value] + _str_to_bytes(str(period_ms))
+    return FlipperCommand.UI_FACE, _encode_face(ui)
+
+def _encode_name(ui):
+    return _str_to_bytes(ui.get('name').replace(">", ""))
+
+def _encode_channel(ui):
+    return _str_to_bytes(ui.get('channel'))
+
+def _encode_uptime(ui):
+    """
+    :return: Body for the uptime packet, None if the uptime can't be shown
+    """
+    uptimeSplit = ui.get('uptime').split(':')
+
+    hh = int(uptimeSplit[0])
+    mm = int(uptimeSplit[1])
+    ss = int(uptimeSplit[2])
+
+    # Make sure all values are less than 100 and greater than 0
+    if not (0 <= hh < 100 and 0 <= mm < 100 and 0 <= ss < 100):
+        return None
+
+    # A stands for adjusted
+    hhA = str(hh).zfill(2)
+    mmA = str(mm).zfill(2)
+    ssA = str(ss).zfill(2)
+
+    return _str_to_bytes("{}:{}:{}".format(hhA, mmA, ssA))
+
+def _encode_mode(ui):
+    mode = None
+    if ui.get('mode') == 'AI':
+        mode = PwnMode.AI
+    elif ui.get('mode') == 'MANU':
+        mode = PwnMode.MANU
+    elif ui.get('mode') == 'AUTO':
+        mode = PwnMode.AUTO
+
+    return [mode.value]
+
+def _encode_status(ui):
+    return _str_to_bytes(ui.get('status'))
+
+def _encode_unsent(ui):
+    # fields we don't send yet, the flipper keeps its default and a hash of 0 for them
+    return None
+
+def _packet(cmd, encode):
+    """
+    Pairs an encoder with the one command its body always goes out with
+    """
+    return lambda ui: (cmd, encode(ui))
+
+# (ui key, packet) in the order of PwnagotchiField on the flipper, packet gives (command, body)
+SYNC_FIELDS = [
+    ('face', _face_packet),
+    ('name', _packet(FlipperCommand.UI_NAME, _encode_name)),
+    ('channel', _packet(FlipperCommand.UI_CHANNEL, _encode_channel)),
+    ('aps', _packet(FlipperCommand.UI_APS, _encode_unsent)),
+    ('uptime', _packet(FlipperCommand.UI_UPTIME, _encode_uptime)),
+    ('mode', _packet(FlipperCommand.UI_MODE, _encode_mode)),
+    ('shakes', _packet(FlipperCommand.UI_HANDSHAKES, _encode_unsent)),
+    ('status', _packet(FlipperCommand.UI_STATUS, _encode_status)),
+]
+
+FNV_OFFSET_BASIS = 2166136261
+FNV_PRIME = 16777619
+
+def _fnv1a(data, h=FNV_OFFSET_BASIS):
+    for b in data:
+        h ^= b
+        h = (h * FNV_PRIME) & 0xffffffff
+    return h
+
+def _field_hash(cmd: int, body):
+    """
+    Hash of a ui packet as the flipper stores it, 0 for a field that isn't sent
+    """
+    if body is None:
+        return 0
+    return _fnv1a([cmd] + body) or 1
+
+def _state_hash(ui):
+    """
+    Hash of the ui fields as the flipper would have them after a full resync
+
+    :param: ui: Snapshot from _ui_snapshot
+    :return: State hash, None if some field can't be encoded
+    """
+    h = FNV_OFFSET_BASIS
+    for key, packet in SYNC_FIELDS:
+        try:
+            cmd, body = packet(ui)
+        except Exception:
+            return None
+        h = _fnv1a(_field_hash(cmd.value, body).to_bytes(4, 'little'), h)
+    return h
+
+def _flipper_ui(ui, field_hashes: [int]):
+    """
+    Works out which fields of a ui snapshot the flipper already shows, from its field hashes
+
+    :param: ui: Snapshot about to be sent
+    :param: field_hashes: Hash of every field on the flipper, in SYNC_FIELDS order
+    :return: Dict with just the keys of ui the flipper already has, usable as current_ui
+    """
+    known = {}
+    for (key, packet), flipper_hash in zip(SYNC_FIELDS, field_hashes):
+        try:
+            cmd, body = packet(ui)
+        except Exception:
+            continue
+        if body is not None and _field_hash(cmd.value, body) == flipper_hash:
+            known[key] = ui.get(key)
+    return known
+
+def _parse_hashes(body: [int]):
+    """
+    Reads the hashes the flipper puts in SYN and UI_REFRESH, 8 hex characters each
+
+    :return: List of hashes, None for a flipper that doesn't send any
+    """
+    if len(body) == 0 or len(body) % 8 != 0:
+        return None
+    try:
+        text = bytes(body).decode('ascii')
+        return [int(text[i:i + 8], 16) for i in range(0, len(text), 8)]
+    except ValueError:
+        return None
+
+
+# access point table, kept on the flipper through deltas
+
+def _ap_security(encryption) -> ApSecurity:
+    encryption = (encryption or '').upper()
+    for security in (ApSecurity.WPA3, ApSecurity.WPA2, ApSecurity.WPA, ApSecurity.WEP):
+        if security.name in encryption:
+            return security
+    return ApSecurity.OPEN
+
+def _bssid(mac: str):
+    """
+    :return: The bytes of a mac address like aa:bb:cc:dd:ee:ff, None if it isn't one
+    """
+    try:
+        bssid = bytes.fromhex((mac or '').replace(':', ''))
+    except ValueError:
+        return None
+    return list(bssid) if len(bssid) == BSSID_LEN else None
+
+def _ap_snapshot(access_points, previous: dict):
+    """
+    Picks the access points the flipper keeps out of bettercap's list
+
+    The strongest MAX_APS are kept. A signal that moved less than AP_RSSI_STEP keeps its previous
+    value, so an access point only goes out again when something about it really changed
+
+    :param: access_points: Access points as the pwnagotchi passes them to on_wifi_update
+    :param: previous: The last snapshot
+    :return: Dict of mac to [rssi, channel, security, clients, ssid]
+    """
+    aps = {}
+    for ap in access_points:
+        mac = (ap.get('mac') or '').lower()
+        if _bssid(mac) is None:
+            continue
+        rssi = max(min(int(ap.get('rssi', 0)), 127), -128)
+        known = previous.get(mac)
+        if known is not None and abs(known[0] - rssi) < AP_RSSI_STEP:
+            rssi = known[0]
+        ssid = ap.get('hostname') or ''
+        ssid = '' if ssid == '<hidden>' else _ascii(ssid)[:AP_SSID_MAX_LEN]
+        aps[mac] = [
+            rssi,
+            max(min(int(ap.get('channel', 0)), 255), 0),
+            _ap_security(ap.get('encryption')).value,
+            min(len(ap.get('clients') or []), 255),
+            ssid,
+        ]
+    strongest = sorted(aps, key=lambda mac: (-aps[mac][0], mac))[:MAX_APS]
+    return {mac: aps[mac] for mac in strongest}
+
+def _encode_ap(mac: str, ap):
+    """
+    :return: AP_SET record, the bssid, rssi, channel, security, clients and ssid
+    """
+    rssi, channel, security, clients, ssid = ap
+    return _bssid(mac) + [rssi & 0xff, channel, security, clients, len(ssid)] + _str_to_bytes(ssid)
+
+def _crc_body(items: [[int]]):
+    """
+    :return: Escaped crc checked body of the items, like AP_SET records or AP_EVICT bssids
+    """
+    raw = [b for item in items for b in item]
+    return _escape(raw + list(zlib.crc32(bytes(raw)).to_bytes(BODY_CRC_SIZE, 'little')))
+
+def _ap_bodies(items: [[int]]):
+    """
+    :return: The records or bssids run together into as few bodies as they fit in
+    """
+    # the crc could need escaping all the way
+    room = MAX_BODY_SIZE - 2 * BODY_CRC_SIZE
+    bodies = []
+    group = []
+    used = 0
+    for item in items:
+        size = len(_escape(item))
+        if group and used + size > room:
+            bodies.append(_crc_body(group))
+            group = []
+            used = 0
+        group.append(item)
+        used += size
+    if group:
+        bodies.append(_crc_body(group))
+    return bodies
+
+# control commands from the flipper
+
+def _agent_mode(ui_mode) -> str:
+    """
+    :param: ui_mode: Mode as the view shows it
+    :return: Mode pwnagotchi.restart and pwnagotchi.reboot take for it
+    """
+    return 'MANU' if ui_mode == 'MANU' else 'AUTO'
+
+# peer table, kept on the flipper through deltas like the access point table
+
+def _peer_face(face) -> int:
+    """
+    :return: Face code of a peer's face, the friend face for one the flipper has no icon for
+    """
+    try:
+        return _encode_face({'face': face})[0]
+    except AttributeError:
+        return PwnFace.FRIEND.value
+
+def _peer_seen(last_seen) -> float:
+    """
+    :return: Seconds since the epoch a peer was last heard, from whatever the mesh keeps it as
+    """
+    if hasattr(last_seen, 'timestamp'):
+        return last_seen.timestamp()
+    if isinstance(last_seen, (int, float)):
+        return float(last_seen)
+    return time.time()
+
+def _peer_snapshot(peers, previous: dict):
+    """
+    Picks the peers the flipper keeps out of the ones the mesh knows
+
+    The closest MAX_PEERS are kept. Signal moves smaller than AP_RSSI_STEP keep the previous signal
+    and the last seen time only moves in PEER_SEEN_STEP, so a peer that is simply still around
+    doesn't go out on every update
+
+    :param: peers: Peer objects as the pwnagotchi passes them to on_peer_detected
+    :param: previous: The last snapshot
+    :return: Dict of key to [face, rssi, pwned, last seen, name], the key is the crc32 of the
+             peer's fingerprint in hex
+    """
+    table = {}
+    for peer in peers:
+        try:
+            identity = str(peer.identity())
+            key = f"{zlib.crc32(identity.encode()):08x}"
+            rssi = max(min(int(peer.rssi), 127), -128)
+            seen = _peer_seen(peer.last_seen)
+            known = previous.get(key)
+            if known is not None and abs(known[1] - rssi) < AP_RSSI_STEP:
+                rssi = known[1]
+            if known is not None and abs(seen - known[3]) < PEER_SEEN_STEP:
+                seen = known[3]
+            table[key] = [
+                _peer_face(peer.face()),
+                rssi,
+                max(min(int(peer.pwnd_total()), 0xffff), 0),
+                seen,
+                _ascii(str(peer.name()))[:PEER_NAME_MAX_LEN],
+            ]
+        except Exception as e:
+            logging.debug(f"[PwnZero] skipping peer: {type(e).__name__}:{e.args}")
+    closest = sorted(table, key=lambda key: (-table[key][1], key))[:MAX_PEERS]
+    return {key: table[key] for key in closest}
+
+def _encode_peer(key: str, peer, now: float):
+    """
+    :return: PEER_SET record, the key, face, rssi, pwned, seconds since last seen and name
+    """
+    face, rssi, pwned, seen, name = peer
+    ago = max(min(int(now - seen), 0xffff), 0)
+    return (list(int(key, 16).to_bytes(4, 'little')) + [face, rssi & 0xff]
+            + list(pwned.to_bytes(2, 'little')) + list(ago.to_bytes(2, 'little'))
+            + [len(name)] + _str_to_bytes(name))
+
+# pwnagotchi names its captures after the ssid and the bssid of the access point
+HANDSHAKE_NAME = re.compile(r'^(.*)_([0-9a-fA-F]{12})\.pcap$')
+
+def _handshake_entry(name: str, mtime: float):
+    """
+    :return: HANDSHAKE_PAGE record of a capture, the bssid, timestamp and ssid
+    """
+    match = HANDSHAKE_NAME.match(name)
+    if match is None:
+        # not one of ours, it still shows up under its name
+        bssid = [0] * BSSID_LEN
+        ssid = os.path.splitext(name)[0]
+    else:
+        bssid = list(bytes.fromhex(match.group(2)))
+        ssid = match.group(1)
+    ssid = _ascii(ssid)[:AP_SSID_MAX_LEN]
+    timestamp = max(min(int(mtime), 0xffffffff), 0)
+    return bssid + list(timestamp.to_bytes(4, 'little')) + [len(ssid)] + _str_to_bytes(ssid)
+
+def _encode_handshake_page(generation: int, entries: [[int]], page: int):
+    """
+    :return: Escaped crc checked HANDSHAKE_PAGE body, the generation, total and page then the records
+    """
+    header = list(generation.to_bytes(4, 'little')) + list(len(entries).to_bytes(2, 'little')) + list(page.to_bytes(2, 'little'))
+    first = page * HANDSHAKE_PAGE_SIZE
+    return _crc_body([header] + entries[first:first + HANDSHAKE_PAGE_SIZE])
+
+def _parse_handshake_list(body: [int]):
+    """
+    :return: The page a HANDSHAKE_LIST asks for, None if the body doesn't read as one
+    """
+    if len(body) != 4:
+        return None
+    try:
+        return int(bytes(body).decode('ascii'), 16)
+    except ValueError:
+        return None
+
+
+# framebuffer mirroring, used instead of the field packets with the tiles render option
+
+def _framebuffer(image) -> bytes:
+    """
+    Downscales what the pwnagotchi rendered to the flipper's screen
+
+    :param: image: PIL image of the pwnagotchi's display, black on white
+    :return: Framebuffer with a set bit for every black pixel
+    """
+    small = image.convert('L').resize((FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT), Image.BOX)
+    # '1;IR' packs black as 1 with the leftmost pixel in the low bit, which is XBM
+    return small.point(lambda p: 255 if p >= 128 else 0, '1').tobytes('raw', '1;IR')
+
+def _tile_rows(framebuffer: bytes, index: int):
+    x = index % TILES_X
+    y = index // TILES_X * TILE_SIZE
+    return bytes(framebuffer[(y + row) * (FRAMEBUFFER_WIDTH // 8) + x] for row in range(TILE_SIZE))
+
+def _escape(body: [int]):
+    """
+    Escapes a binary body so none of its bytes can be taken for packet framing
+    """
+    escaped = []
+    for b in body:
+        if b in ESCAPED_BYTES:
+            escaped += [Packet.ESCAPE.value, b ^ ESCAPE_XOR]
+        else:
+            escaped.append(b)
+    return escaped
+
+def _encode_tile(index: int, rows: bytes):
+    """
+    :return: Escaped tile, as (count, value) runs or raw rows whichever is shorter
+    """
+    runs = []
+    for value in rows:
+        if runs and runs[-1][1] == value:
+            runs[-1][0] += 1
+        else:
+            runs.append([1, value])
+    rle = _escape([b ^ TILE_XOR for b in [index] + [b for run in runs for b in run]])
+    raw = _escape([b ^ TILE_XOR for b in [index | TILE_RAW] + list(rows)])
+    return rle if len(rle) <= len(raw) else raw
+
+def _tile_packets(current_fb, new_fb):
+    """
+    Bodies of the tile packets that turn what the flipper shows into new_fb
+
+    :param: current_fb: Framebuffer the flipper has, None to start over from a cleared one
+    :param: new_fb: Framebuffer to show
+    :return: List of packet bodies, empty if nothing changed
+    """
+    clear = current_fb is None
+    packets = []
+    body = [Tiles.CLEAR.value if clear else Tiles.UPDATE.value]
+    for index in range(TILE_COUNT):
+        rows = _tile_rows(new_fb, index)
+        if clear and not any(rows):
+            continue
+        if not clear and rows == _tile_rows(current_fb, index):
+            continue
+
+        tile = _encode_tile(index, rows)
+        if len(body) + len(tile) > MAX_BODY_SIZE:
+            packets.append(body)
+            body = [Tiles.UPDATE.value]
+        body += tile
+
+    if clear or len(body) > 1:
+        packets.append(body)
+    return packets
+
+
+# file offload, handshakes and anything else the pwnagotchi wants on the flipper's sd card
+
+def _file_name(path: str) -> str:
+    """
+    Name a file goes by on the flipper, its base name cut down to characters the sd card takes
+    """
+    name = re.sub(r'[^A-Za-z0-9._-]', '_', os.path.basename(path)).lstrip('.')
+    if len(name) > FILE_NAME_MAX_LEN:
+        # keep the extension, the flipper's file browser goes by it
+        root, ext = os.path.splitext(name)
+        name = root[:max(FILE_NAME_MAX_LEN - len(ext), 1)] + ext[:FILE_NAME_MAX_LEN - 1]
+    return name or 'file'
+
+def _encode_file_open(name: str, data: bytes):
+    """
+    :return: Body of a FILE_OPEN, size and crc32 of the file in hex then its name
+    """
+    return _str_to_bytes(f"{len(data):08x}{zlib.crc32(data):08x}{name}")
+
+def _encode_chunk(offset: int, data: bytes):
+    """
+    :return: Escaped body of a FILE_CHUNK, the offset, the data and the crc32 of both
+    """
+    raw = offset.to_bytes(4, 'little') + data
+    return _escape(list(raw + zlib.crc32(raw).to_bytes(4, 'little')))
+
+def _parse_file_ack(body: [int]):
+    """
+    :return: (FileAck, offset or crc32), None if the body doesn't read as one
+    """
+    if len(body) != 9:
+        return None
+    try:
+        return FileAck(body[0]), int(bytes(body[1:]).decode('ascii'), 16)
+    except ValueError:
+        return None
+
+
+# clock sync, the pi takes the flipper's rtc time
+
+def _parse_clock_set(body: [int]):
+    """
+    :return: (flipper's time, round trip of the probe before it or None) in seconds, None if the
+             body doesn't read as a CLOCK_SET
+    """
+    if len(body) != CLOCK_TIME_HEX_LEN + CLOCK_RTT_HEX_LEN:
+        return None
+    try:
+        text = bytes(body).decode('ascii')
+        flipper_ms = int(text[:CLOCK_TIME_HEX_LEN], 16)
+        rtt_ms = int(text[CLOCK_TIME_HEX_LEN:], 16)
+    except ValueError:
+        return None
+    return flipper_ms / 1000, None if rtt_ms == CLOCK_NO_RTT else rtt_ms / 1000
+
+def _set_realtime(t: float):
+    time.clock_settime(time.CLOCK_REALTIME, t)
+
+
 class Flipper():
 
     def __init__(self, port: str = "/dev/serial0", baud: int = 115200, timeout: float = 1):
@@ -161,6 +954,12 @@ class Flipper():
 
         self._serial_conn = None
 
+        # the reader and writer threads both write to the port, ACK/NAK replies
+        # from the reader must never land in the middle of a packet from the writer
+        self._write_lock = threading.Lock()
+        # ACK/NAK bodies handed from the reader thread to whoever is waiting in _send_bytes
+        self._replies = queue.Queue()
+
 
     def _send_string(self, cmd: int, msg_string: str) -> bool:
         ascii_encoded_string = _str_to_bytes(msg_string)
@@ -170,6 +969,9 @@ class Flipper():
         """
         Sends a packet using protocol v3 over the serial port to the Flipper Zero
 
+        The reply is read by the reader thread and handed over through deliver_reply,
+        this only waits for it
+
         :param: cmd: Parameter that is being changed
         :param: body: Arguments to pass to the flipper. Must be a list of bytes
         :return: If transmission was successful
@@ -177,25 +979,57 @@ class Flipper():
         # Build the packet to send
         packet = [Packet.START.value, cmd] + body + [Packet.END.value]
 
+        # if we are sending, we don't expect an ACK back. file chunks are acked a window at a time
+        # with a FILE_ACK, which the reader hands to the offload instead
+        expect_reply = cmd not in (FlipperCommand.ACK.value, FlipperCommand.NAK.value, FlipperCommand.FILE_CHUNK.value)
+
+        if expect_reply:
+            # anything still sitting here is a late reply to a packet we already gave up on
+            self._drain_replies()
+
         # Send data to flipper
         logging.info(f"[PwnZero] sending bytes {packet}")
-        if not self._serial_conn.write(packet) == len(packet):
-            raise SendLengthIncorrect()
+        with self._write_lock:
+            if not self._serial_conn.write(packet) == len(packet):
+                raise SendLengthIncorrect()
 
-        # if we are sending, we don't expect an ACK back
-        if cmd == FlipperCommand.ACK.value or cmd == FlipperCommand.NAK.value:
+        if not expect_reply:
             return
 
         # expect an ACK reply
-        rec = self.receive_bytes()
+        try:
+            rec = self._replies.get(timeout=self._timeout)
+        except queue.Empty:
+            raise AckTimeout(f"no reply to {cmd} within {self._timeout}s")
+
+        if rec == [PwnCommand.NAK.value]:
+            raise ReceivedNak(f"NAK: {rec}")
         if rec != [PwnCommand.ACK.value]:
             logging.error(f"[PwnZero] received non-ack response to syn: {rec}, expected: {[FlipperCommand.ACK.value]}")
             raise ReceivedInvalidAck(f"Expceted {[FlipperCommand.ACK.value]}, received: {rec}")
 
+    def _drain_replies(self):
+        try:
+            while True:
+                self._replies.get_nowait()
+        except queue.Empty:
+            pass
+
+    def deliver_reply(self, body: [int]):
+        """
+        Hands an ACK/NAK received by the reader thread to the packet waiting on it
+
+        :param: body: Received packet body, without the packet control characters
+        """
+        self._replies.put(body)
+
     def receive_bytes(self):
 
         def cleanup_and_raise(e):
-            self._serial_conn.reset_input_buffer()
+            try:
+                self._serial_conn.reset_input_buffer()
+            except Exception as reset_error:
+                logging.error(f"[PwnZero] failed resetting serial input {reset_error}")
             raise e
 
         try:
@@ -244,8 +1078,8 @@ class Flipper():
             # self._serial_conn = serial.Serial(self._port, self._baud, self._timeout)
             self._serial_conn = serial.Serial(self._port, self._baud, timeout=self._timeout)
             self._serial_conn.reset_input_buffer()
-        except:
-            raise "Cannot bind to port ({}) with baud ({})".format(self._port, self._baud)
+        except Exception as e:
+            raise SerialConnException("Cannot bind to port ({}) with baud ({}): {}".format(self._port, self._baud, e))
         logging.info(f"[PwnZero] opened serial connection")
 
     def close_serial(self):
@@ -261,32 +1095,71 @@ class Flipper():
         self._send_bytes(FlipperCommand.SYN.value, [])
 
 
-    def send_ack(self):
+    def send_ack(self, cmd: int = None):
         """
         Sends a ack packet to the flipper
+
+        :param: cmd: Code of the command it answers, only sent for MODE, REBOOT, SHUTDOWN and CLOCK_SET
         """
-        self._send_bytes(FlipperCommand.ACK.value, [])
+        self._send_bytes(FlipperCommand.ACK.value, [] if cmd is None else [cmd])
 
 
-    def send_nak(self):
+    def send_nak(self, cmd: int = None):
         """
         Sends a nak packet to the flipper
+
+        :param: cmd: Code of the command it answers, only sent for MODE, REBOOT, SHUTDOWN and CLOCK_SET
         """
-        self._send_bytes(FlipperCommand.NAK.value, [])
+        self._send_bytes(FlipperCommand.NAK.value, [] if cmd is None else [cmd])
 
     def update_ui(self, current_ui, new_ui) -> bool:
         """
         Set the ui elements of the Pwnagotchi
         Calls all Flipper methods that start with "set_"
 
-        :return: If any ui setter fails, log the failure and return False
+        :return: If any ui setter fails to get its packet acked, log the failure and return False
         """
+        if 'framebuffer' in new_ui:
+            current_fb = current_ui.get('framebuffer') if current_ui is not None else None
+            if not self.update_framebuffer(current_fb, new_ui['framebuffer']):
+                return False
+            # the list page and the peer list aren't part of the mirrored screen, the flipper draws them itself
+            try:
+                self.set_ap_table(current_ui, new_ui)
+                self.set_friend(current_ui, new_ui)
+            except PwnZeroSerialException as e:
+                logging.error(f"[PwnZero] error when sending access points or peers: {type(e).__name__}:{e.args}")
+                return False
+            return True
+
+        success = True
         for method in self._ui_setters:
             try:
                 ret = getattr(self, method)(current_ui, new_ui)  # call
+            except PwnZeroSerialException as e:
+                # the link failed, the caller has to send this again
+                logging.error(f"[PwnZero] error when calling ui setter {method}: {type(e).__name__}:{e.args}")
+                success = False
             except Exception as e:
                 logging.error(f"[PwnZero] error when calling ui setter {method}: {type(e).__name__}:{e.args}")
 
+        return success
+
+    def update_framebuffer(self, current_fb, new_fb) -> bool:
+        """
+        Send the tiles of new_fb that differ from what the flipper shows
+
+        :param: current_fb: Framebuffer the flipper has, None to send a full frame
+        :return: If every tile packet was acked
+        """
+        for body in _tile_packets(current_fb, new_fb):
+            try:
+                self._send_bytes(FlipperCommand.UI_TILES.value, body)
+            except PwnZeroSerialException as e:
+                logging.error(f"[PwnZero] error when sending tiles: {type(e).__name__}:{e.args}")
+                return False
+        return True
+
     def set_face(self, current_ui, new_ui) -> bool:
         """
         Set the face of the Pwnagotchi
@@ -294,65 +1167,18 @@ class Flipper():
         :return: If the command was sent successfully
         """
 
-        face = new_ui.get('face')
         if not _ui_diff(current_ui=current_ui, new_ui=new_ui, key='face'):
             return True
 
-        logging.info(f"[PwnZero] ui differs, setting face")
+        animation = _face_animation(new_ui.get('face'))
+        if animation is not None and current_ui is not None and \
+                _face_animation(current_ui.get('face')) == animation:
+            # just the next frame of the animation the flipper is already playing
+            return True
 
-        faceEnum = None
-        if face == faces.LOOK_R:
-            faceEnum = PwnFace.LOOK_R
-        elif face == faces.LOOK_L:
-            faceEnum = PwnFace.LOOK_L
-        elif face == faces.LOOK_R_HAPPY:
-            faceEnum = PwnFace.LOOK_R_HAPPY
-        elif face == faces.LOOK_L_HAPPY:
-            faceEnum = PwnFace.LOOK_L_HAPPY
-        elif face == faces.SLEEP:
-            faceEnum = PwnFace.SLEEP
-        elif face == faces.SLEEP2:
-            faceEnum = PwnFace.SLEEP2
-        elif face == faces.AWAKE:
-            faceEnum = PwnFace.AWAKE
-        elif face == faces.BORED:
-            faceEnum = PwnFace.BORED
-        elif face == faces.INTENSE:
-            faceEnum = PwnFace.INTENSE
-        elif face == faces.COOL:
-            faceEnum = PwnFace.COOL
-        elif face == faces.HAPPY:
-            faceEnum = PwnFace.HAPPY
-        elif face == faces.GRATEFUL:
-            faceEnum = PwnFace.GRATEFUL
-        elif face == faces.EXCITED:
-            faceEnum = PwnFace.EXCITED
-        elif face == faces.MOTIVATED:
-            faceEnum = PwnFace.MOTIVATED
-        elif face == faces.DEMOTIVATED:
-            faceEnum = PwnFace.DEMOTIVATED
-        elif face == faces.SMART:
-            faceEnum = PwnFace.SMART
-        elif face == faces.LONELY:
-            faceEnum = PwnFace.LONELY
-        elif face == faces.SAD:
-            faceEnum = PwnFace.SAD
-        elif face == faces.ANGRY:
-            faceEnum = PwnFace.ANGRY
-        elif face == faces.FRIEND:
-            faceEnum = PwnFace.FRIEND
-        elif face == faces.BROKEN:
-            faceEnum = PwnFace.BROKEN
-        elif face == faces.DEBUG:
-            faceEnum = PwnFace.DEBUG
-        elif face == faces.UPLOAD:
-            faceEnum = PwnFace.UPLOAD
-        elif face == faces.UPLOAD1:
-            faceEnum = PwnFace.UPLOAD1
-        elif face == faces.UPLOAD2:
-            faceEnum = PwnFace.UPLOAD2
-
-        return self._send_bytes(FlipperCommand.UI_FACE.value, [faceEnum.value])
+        logging.info(f"[PwnZero] ui differs, setting face")
+        cmd, body = _face_packet(new_ui)
+        return self._send_bytes(cmd.value, body)
 
     def set_name(self, current_ui, new_ui) -> bool:
         """
@@ -364,8 +1190,7 @@ class Flipper():
             return True
 
         logging.info(f"[PwnZero] ui differs, setting name")
-        name = new_ui.get('name').replace(">", "")
-        return self._send_string(FlipperCommand.UI_NAME.value, name)
+        return self._send_bytes(FlipperCommand.UI_NAME.value, _encode_name(new_ui))
 
     def set_channel(self, current_ui, new_ui) -> bool:
         """
@@ -377,8 +1202,38 @@ class Flipper():
         if not _ui_diff(current_ui=current_ui, new_ui=new_ui, key='channel'):
             return True
         logging.info(f"[PwnZero] ui differs, setting channel")
-        channel = new_ui.get('channel')
-        return self._send_string(FlipperCommand.UI_CHANNEL.value, channel)
+        return self._send_bytes(FlipperCommand.UI_CHANNEL.value, _encode_channel(new_ui))
+
+    def set_ap_table(self, current_ui, new_ui) -> bool:
+        """
+        Brings the flipper's access point table in line with the snapshot
+
+        Only access points that went away, showed up or changed go out. When the flipper's table
+        isn't known it is cleared and sent whole. Evictions go first so the table never fills
+
+        :return: If the commands were sent successfully
+        """
+        if 'ap_table' not in new_ui:
+            return True
+
+        current = (current_ui or {}).get('ap_table')
+        new = new_ui['ap_table']
+        if current is None:
+            logging.info(f"[PwnZero] clearing the access point table")
+            self._send_bytes(FlipperCommand.AP_EVICT.value, _crc_body([]))
+            current = {}
+
+        gone = [_bssid(mac) for mac in current if mac not in new]
+        for body in _ap_bodies(gone):
+            self._send_bytes(FlipperCommand.AP_EVICT.value, body)
+
+        changed = [_encode_ap(mac, ap) for mac, ap in new.items() if current.get(mac) != ap]
+        for body in _ap_bodies(changed):
+            self._send_bytes(FlipperCommand.AP_SET.value, body)
+
+        if gone or changed:
+            logging.info(f"[PwnZero] access points: {len(gone)} gone, {len(changed)} set")
+        return True
 
     def set_aps(self, current_ui, new_ui) -> bool:
         """
@@ -411,33 +1266,43 @@ class Flipper():
             return True
 
         logging.info(f"[PwnZero] ui differs, setting uptime")
-        uptime = new_ui.get('uptime')
-        uptimeSplit = uptime.split(':')
-
-        hh = int(uptimeSplit[0])
-        mm = int(uptimeSplit[1])
-        ss = int(uptimeSplit[2])
-
-        # Make sure all values are less than 100 and greater than 0
-        if not (0 <= hh < 100 and 0 <= mm < 100 and 0 <= ss < 100):
+        body = _encode_uptime(new_ui)
+        if body is None:
             return False
 
-        # A stands for adjusted
-        hhA = str(hh).zfill(2)
-        mmA = str(mm).zfill(2)
-        ssA = str(ss).zfill(2)
-
-        return self._send_string(FlipperCommand.UI_UPTIME.value, "{}:{}:{}".format(hhA, mmA, ssA))
+        return self._send_bytes(FlipperCommand.UI_UPTIME.value, body)
 
     def set_friend(self, current_ui, new_ui) -> bool:
         """
-        Friend is currently not supported
+        Brings the flipper's peer table in line with the snapshot, the closest peer is the friend on
+        its main screen
 
-        :return: False
+        Like the access point table only peers that went away, showed up or changed go out. When
+        the flipper's table isn't known it is cleared and sent whole
+
+        :return: If the commands were sent successfully
         """
-        # if not _ui_diff(current_ui=current_ui, new_ui=new_ui, key='friend'):
-        #     return True
-        # logging.info(f"[PwnZero] ui differs, setting friend")
+        if 'peer_table' not in new_ui:
+            return True
+
+        current = (current_ui or {}).get('peer_table')
+        new = new_ui['peer_table']
+        if current is None:
+            logging.info(f"[PwnZero] clearing the peer table")
+            self._send_bytes(FlipperCommand.PEER_EXPIRE.value, _crc_body([]))
+            current = {}
+
+        gone = [list(int(key, 16).to_bytes(4, 'little')) for key in current if key not in new]
+        for body in _ap_bodies(gone):
+            self._send_bytes(FlipperCommand.PEER_EXPIRE.value, body)
+
+        now = time.time()
+        changed = [_encode_peer(key, peer, now) for key, peer in new.items() if current.get(key) != peer]
+        for body in _ap_bodies(changed):
+            self._send_bytes(FlipperCommand.PEER_SET.value, body)
+
+        if gone or changed:
+            logging.info(f"[PwnZero] peers: {len(gone)} gone, {len(changed)} set")
         return True
 
     def set_mode(self, current_ui, new_ui) -> bool:
@@ -451,15 +1316,7 @@ class Flipper():
             return True
 
         logging.info(f"[PwnZero] ui differs, setting mode")
-        mode = None
-        if new_ui.get('mode') == 'AI':
-            mode = PwnMode.AI
-        elif new_ui.get('mode') == 'MANU':
-            mode = PwnMode.MANU
-        elif new_ui.get('mode') == 'AUTO':
-            mode = PwnMode.AUTO
-
-        return self._send_bytes(FlipperCommand.UI_MODE.value, [mode.value])
+        return self._send_bytes(FlipperCommand.UI_MODE.value, _encode_mode(new_ui))
 
     def set_handshakes(self, current_ui, new_ui) -> bool:
         """
@@ -485,6 +1342,34 @@ class Flipper():
 
         return True
 
+    def set_elements(self, current_ui, new_ui) -> bool:
+        """
+        Declares, updates and removes plugin elements on the flipper
+
+        Each element is declared once, after that only its id and value go out when the value changes
+
+        :return: If the commands were sent successfully
+        """
+        current = (current_ui or {}).get('elements') or {}
+        new = new_ui.get('elements') or {}
+
+        for name, element in new.items():
+            known = current.get(name)
+            if known is None or known[:-1] != element[:-1]:
+                logging.info(f"[PwnZero] declaring element {name}")
+                self._send_bytes(FlipperCommand.UI_ELEMENT.value, _encode_element(element))
+                # a declaration starts the value out empty
+                known = None
+            if known is None or known[-1] != element[-1]:
+                self._send_bytes(FlipperCommand.UI_ELEMENT_SET.value, [element[0]] + _str_to_bytes(element[-1]))
+
+        for name, element in current.items():
+            if name not in new:
+                logging.info(f"[PwnZero] removing element {name}")
+                self._send_bytes(FlipperCommand.UI_ELEMENT.value, [element[0]])
+
+        return True
+
     def set_status(self, current_ui, new_ui) -> bool:
         """
         Sets the displayed status ui element of the Pwnagotchi on the flipper ui
@@ -495,10 +1380,594 @@ class Flipper():
         if not _ui_diff(current_ui=current_ui, new_ui=new_ui, key='status'):
             return True
         logging.info(f"[PwnZero] ui differs, setting status")
-        status = new_ui.get('status')
-        logging.info(f"[PwnZero] status: {status}")
+        logging.info(f"[PwnZero] status: {new_ui.get('status')}")
         #TODO reformat to fix flipper screen size restrictions first?
-        return self._send_string(FlipperCommand.UI_STATUS.value, status)
+        return self._send_bytes(FlipperCommand.UI_STATUS.value, _encode_status(new_ui))
+
+
+class Backoff():
+    """
+    Retry delays for probing: a few fast attempts, then exponential up to a cap, all jittered
+    """
+
+    def __init__(self, fast_delay: float = 0.05, fast_attempts: int = 3, max_delay: float = 5):
+        self.fast_delay = fast_delay
+        self.fast_attempts = fast_attempts
+        self.max_delay = max_delay
+        self.attempts = 0
+
+    def reset(self):
+        self.attempts = 0
+
+    def next_delay(self) -> float:
+        """
+        :return: Seconds to wait before the next attempt
+        """
+        delay = self.fast_delay
+        if self.attempts >= self.fast_attempts:
+            exponent = min(self.attempts - self.fast_attempts + 1, 16)
+            delay = min(self.fast_delay * (2 ** exponent), self.max_delay)
+        self.attempts += 1
+
+        # somewhere in the upper half, keeps both ends from retrying in lockstep
+        return random.uniform(delay / 2, delay)
+
+
+class Mailbox():
+    """
+    Hands work from the pwnagotchi hooks and the reader thread to the writer thread
+
+    Holds the latest ui snapshot, where a newer snapshot replaces one the writer has
+    not picked up yet, plus a fifo of packets that must all be sent. Every put wakes
+    the writer immediately
+    """
+
+    def __init__(self):
+        self._cond = threading.Condition()
+        self._latest = None
+        self._latest_fresh = False
+        self._packets = collections.deque()
+
+    def put_latest(self, value):
+        with self._cond:
+            self._latest = value
+            self._latest_fresh = True
+            self._cond.notify()
+
+    def amend_latest(self, **values):
+        """
+        Replace the latest snapshot with a copy that has values set, if there is one yet
+        """
+        with self._cond:
+            if self._latest is None:
+                return
+            self._latest = dict(self._latest, **values)
+            self._latest_fresh = True
+            self._cond.notify()
+
+    def put_packet(self, cmd: int, body: [int]):
+        with self._cond:
+            self._packets.append((cmd, body))
+            self._cond.notify()
+
+    def wake(self):
+        with self._cond:
+            self._cond.notify()
+
+    def latest(self):
+        with self._cond:
+            return self._latest
+
+    def wait(self, timeout: float):
+        """
+        Block until there is something to send or timeout expires
+
+        :param: timeout: Max seconds to wait
+        :return: (list of (cmd, body) packets, latest value or None if it hasn't changed)
+        """
+        with self._cond:
+            if not self._packets and not self._latest_fresh:
+                self._cond.wait(timeout)
+
+            packets = list(self._packets)
+            self._packets.clear()
+            latest = self._latest if self._latest_fresh else None
+            self._latest_fresh = False
+            return packets, latest
+
+
+class OffloadState(Enum):
+    """
+    Where the file being sent to the flipper is at
+    """
+    IDLE        = 0 # nothing to send
+    OPEN        = 1 # a FILE_OPEN is due
+    OPENING     = 2 # waiting for the flipper to say where the file picks up
+    SENDING     = 3
+
+
+class Offload():
+    """
+    Sends files to the flipper's sd card FILE_CHUNK_SIZE bytes at a time, with up to window chunks
+    unacked
+
+    The flipper acks every few chunks with the offset it has everything up to, and answers a bad
+    or out of order chunk with the offset to go back to. Without an ack for ack_timeout everything
+    unacked goes out again. A file whose transfer was cut short is opened again once the link is
+    back, and the flipper says where it picks up.
+
+    A chunk is held back until the one before it has left the serial port, so a ui update only ever
+    queues behind a single chunk instead of the whole window.
+
+    The writer thread asks for packets with next_packet, the reader thread hands over FILE_ACKs
+    with on_ack
+    """
+
+    def __init__(self, baud: int, window: int = 8, ack_timeout: float = 1, open_timeout: float = 5):
+        self._lock = threading.Lock()
+        self._baud = baud
+        self.window = window
+        # monotonic time the last chunk sent will have left the serial port
+        self._wire_free = 0
+        self.ack_timeout = ack_timeout
+        # the flipper reads back whatever it has of the file before it answers an open
+        self.open_timeout = open_timeout
+
+        self._pending = collections.deque()
+        self._queued = set()
+        self.state = OffloadState.IDLE
+        self.path = None
+        self.name = None
+        self.data = None
+        self.crc = None
+        # the flipper has everything before acked, the next chunk goes out from next
+        self.acked = 0
+        self.next = 0
+        # monotonic time at which waiting for an ack gives up, None while not waiting
+        self._deadline = None
+
+        # throughput of the transfer in progress
+        self._start = None
+        self._start_offset = 0
+        self._wire_bytes = 0
+
+        # called with the path of every file the flipper has whole
+        self.on_done = None
+        # most recent transfers, dicts of name, bytes, seconds and line_rate percentage
+        self.results = collections.deque(maxlen=32)
+
+    def add(self, path: str):
+        with self._lock:
+            if path in self._queued:
+                return
+            self._queued.add(path)
+            self._pending.append(path)
+            if self.state == OffloadState.IDLE:
+                self._next_file()
+
+    def stop(self):
+        """
+        Give up on every file, the flipper doesn't take them
+        """
+        with self._lock:
+            self._pending.clear()
+            self.state = OffloadState.IDLE
+
+    def link_lost(self):
+        """
+        Whatever was in flight is gone, the flipper says where to pick up once the link is back
+        """
+        with self._lock:
+            if self.state in (OffloadState.OPENING, OffloadState.SENDING):
+                self.state = OffloadState.OPEN
+
+    def _next_file(self):
+        self.state = OffloadState.IDLE
+        while self._pending:
+            path = self._pending.popleft()
+            try:
+                with open(path, 'rb') as f:
+                    self.data = f.read()
+            except OSError as e:
+                logging.error(f"[PwnZero] can't offload {path}: {e}")
+                self._queued.discard(path)
+                continue
+            self.path = path
+            self.name = _file_name(path)
+            self.crc = zlib.crc32(self.data)
+            self.state = OffloadState.OPEN
+            return
+
+    def _window_open(self) -> bool:
+        return self.next < len(self.data) and self.next < self.acked + self.window * FILE_CHUNK_SIZE
+
+    def timeout(self, now: float):
+        """
+        :return: Seconds until next_packet has something to send, None if that is up to on_ack
+        """
+        with self._lock:
+            if self.state == OffloadState.OPEN:
+                return 0
+            if self.state == OffloadState.SENDING and self._window_open():
+                return max(self._wire_free - now, 0)
+            if self._deadline is None or self.state == OffloadState.IDLE:
+                return None
+            return max(self._deadline - now, 0)
+
+    def next_packet(self, now: float):
+        """
+        :return: (cmd, body) of the packet to send next, None if nothing is due
+        """
+        with self._lock:
+            if self._deadline is not None and now >= self._deadline:
+                self._deadline = None
+                if self.state == OffloadState.OPENING:
+                    self.state = OffloadState.OPEN
+                elif self.state == OffloadState.SENDING:
+                    # go back n, the flipper drops everything after a chunk it didn't get
+                    logging.info(f"[PwnZero] no file ack from the flipper, resending {self.name} from {self.acked}")
+                    self.next = self.acked
+
+            if self.state == OffloadState.OPEN:
+                self.state = OffloadState.OPENING
+                self._deadline = now + self.open_timeout
+                return FlipperCommand.FILE_OPEN.value, _encode_file_open(self.name, self.data)
+
+            if self.state != OffloadState.SENDING or not self._window_open():
+                return None
+            if now < self._wire_free:
+                return None
+            body = _encode_chunk(self.next, self.data[self.next:self.next + FILE_CHUNK_SIZE])
+            self.next = min(self.next + FILE_CHUNK_SIZE, len(self.data))
+            self._wire_bytes += len(body) + 3
+            # 10 bits on the wire for every byte
+            self._wire_free = max(self._wire_free, now) + (len(body) + 3) * 10 / self._baud
+            if self._deadline is None:
+                self._deadline = now + self.ack_timeout
+            return FlipperCommand.FILE_CHUNK.value, body
+
+    def on_ack(self, body: [int]) -> bool:
+        """
+        Takes a FILE_ACK from the flipper
+
+        :return: If the writer has something new to send
+        """
+        ack = _parse_file_ack(body)
+        if ack is None:
+            logging.info(f"[PwnZero] malformed file ack {body}")
+            return False
+        status, offset = ack
+        now = time.monotonic()
+
+        with self._lock:
+            if self.state not in (OffloadState.OPENING, OffloadState.SENDING):
+                return False
+
+            if status == FileAck.DONE or status == FileAck.FAILED:
+                if offset != self.crc:
+                    logging.info(f"[PwnZero] file ack {status} isn't about {self.name}, ignoring it")
+                    return False
+                self._finish(status, now)
+                return True
+
+            if offset > len(self.data):
+                logging.error(f"[PwnZero] flipper acked {offset} of {self.name}, which is {len(self.data)} bytes")
+                return False
+
+            if self.state == OffloadState.OPENING:
+                if status != FileAck.OK:
+                    return False
+                logging.info(f"[PwnZero] offloading {self.name}, {len(self.data)} bytes from {offset}")
+                self.state = OffloadState.SENDING
+                self.acked = self.next = offset
+                self._deadline = None
+                self._start = now
+                self._start_offset = offset
+                self._wire_bytes = 0
+                return True
+
+            if status == FileAck.RESEND:
+                self.acked = self.next = offset
+                self._deadline = None
+                return True
+
+            # the flipper acks a few chunks at a time, anything older than what we know is stale
+            if offset > self.acked:
+                self.acked = offset
+                self._deadline = now + self.ack_timeout if self.next > self.acked else None
+            if self.next < self.acked:
+                self.next = self.acked
+            return True
+
+    def _finish(self, status: FileAck, now: float):
+        if status == FileAck.FAILED:
+            logging.error(f"[PwnZero] flipper couldn't store {self.name}")
+        elif self._start is None or self.state == OffloadState.OPENING:
+            logging.info(f"[PwnZero] flipper already has {self.name}")
+        else:
+            sent = len(self.data) - self._start_offset
+            seconds = max(now - self._start, 1e-6)
+            rate = sent / seconds
+            # 10 bits on the wire for every byte
+            line_rate = self._baud / 10
+            result = {
+                'name': self.name,
+                'bytes': sent,
+                'seconds': seconds,
+                'line_rate': rate / line_rate * 100,
+                'wire_bytes': self._wire_bytes,
+            }
+            self.results.append(result)
+            logging.info(
+                f"[PwnZero] offloaded {self.name}, {sent} bytes in {seconds:.2f}s, {rate:.0f} B/s, "
+                f"{result['line_rate']:.1f}% of the line rate at {self._baud} baud")
+
+        if status == FileAck.DONE:
+            # bettercap appends later handshakes to the same capture, so it can come round again.
+            # a failed one isn't tried again until the plugin is reloaded
+            self._queued.discard(self.path)
+            if self.on_done is not None:
+                self.on_done(self.path)
+        self._start = None
+        self._deadline = None
+        self._next_file()
+
+
+class ChannelStats():
+    """
+    Counts what the pwnagotchi sees on each channel in between CHANNEL_STATS packets
+
+    The hooks add to it, the writer takes what there is at most once every interval seconds and no
+    more than fits one packet, so the heatmap costs a small fixed share of the line whatever goes on.
+    What didn't fit, or didn't make it, stays for the next one
+    """
+
+    def __init__(self, interval: float = CHANNEL_STATS_INTERVAL):
+        self._lock = threading.Lock()
+        self._interval = interval
+        self._last = None
+        # channel to [traffic bytes, access points, handshakes] not sent yet
+        self._counts = {}
+        # sent plus received bytes of each access point at the last wifi update
+        self._traffic = {}
+
+    @staticmethod
+    def _record(channel: int, counts: [int]):
+        return [channel] + list(min(counts[0] // 1024, 0xffff).to_bytes(2, 'little')) + [min(counts[1], 0xff), min(counts[2], 0xff)]
+
+    @staticmethod
+    def _has_any(record: [int]):
+        return any(record[1:])
+
+    def on_wifi_update(self, access_points):
+        traffic = {}
+        with self._lock:
+            for ap in access_points:
+                channel = int(ap.get('channel', 0))
+                if not 0 < channel <= 0xff:
+                    continue
+                mac = (ap.get('mac') or '').lower()
+                total = int(ap.get('sent') or 0) + int(ap.get('received') or 0)
+                traffic[mac] = total
+                counts = self._counts.setdefault(channel, [0, 0, 0])
+                # an access point seen for the first time brings no traffic, its counters go way back
+                counts[0] += max(total - self._traffic.get(mac, total), 0)
+                counts[1] += 1
+            self._traffic = traffic
+
+    def on_handshake(self, channel: int):
+        if not 0 < channel <= 0xff:
+            return
+        with self._lock:
+            self._counts.setdefault(channel, [0, 0, 0])[2] += 1
+
+    def timeout(self, now: float):
+        """
+        :return: Seconds until a packet is due, None if there is nothing worth sending
+        """
+        with self._lock:
+            if not any(self._has_any(self._record(channel, counts)) for channel, counts in self._counts.items()):
+                return None
+            if self._last is None:
+                return 0
+            return max(self._last + self._interval - now, 0)
+
+    def take(self, now: float):
+        """
+        :return: Escaped CHANNEL_STATS body and the records in it if one is due, None otherwise
+        """
+        with self._lock:
+            if self._last is not None and now < self._last + self._interval:
+                return None
+            # the crc could need escaping all the way
+            room = MAX_BODY_SIZE - 2 * BODY_CRC_SIZE
+            records = []
+            for channel in sorted(self._counts):
+                record = self._record(channel, self._counts[channel])
+                if not self._has_any(record):
+                    continue
+                size = len(_escape(record))
+                if size > room:
+                    break
+                room -= size
+                records.append(record)
+            if not records:
+                return None
+
+            self._last = now
+            for record in records:
+                self._take_record(record, -1)
+            return _crc_body(records), records
+
+    def put_back(self, records: [[int]]):
+        """
+        Count records that didn't make it again
+        """
+        with self._lock:
+            for record in records:
+                self._take_record(record, 1)
+
+    def _take_record(self, record: [int], sign: int):
+        counts = self._counts.setdefault(record[0], [0, 0, 0])
+        counts[0] += sign * int.from_bytes(bytes(record[1:3]), 'little') * 1024
+        counts[1] += sign * record[3]
+        counts[2] += sign * record[4]
+        if not any(counts):
+            del self._counts[record[0]]
+
+
+class HandshakeIndex():
+    """
+    The captures in a directory as the flipper's handshake browser pages through them, newest first
+
+    The listing is only read again when the directory changed, so paging through a few thousand
+    captures doesn't stat every one of them for each page. Its generation is the crc32 of the names
+    in order, a page from a different listing tells the flipper to drop the ones it has
+    """
+
+    def __init__(self, directory: str):
+        self._directory = directory
+        self._mtime = None
+        self._entries = []
+        self._generation = 0
+
+    def _refresh(self):
+        try:
+            mtime = os.stat(self._directory).st_mtime_ns
+        except OSError:
+            mtime = None
+        if mtime == self._mtime:
+            return
+        self._mtime = mtime
+
+        captures = []
+        try:
+            with os.scandir(self._directory) as listing:
+                for entry in listing:
+                    if entry.name.endswith('.pcap') and entry.is_file():
+                        captures.append((entry.stat().st_mtime, entry.name))
+        except OSError as e:
+            logging.error(f"[PwnZero] can't list {self._directory}: {e}")
+        captures.sort(key=lambda capture: (-capture[0], capture[1]))
+        captures = captures[:MAX_HANDSHAKES]
+
+        self._entries = [_handshake_entry(name, mtime) for mtime, name in captures]
+        self._generation = zlib.crc32("\n".join(name for _, name in captures).encode('utf-8', 'replace'))
+        logging.info(f"[PwnZero] {len(captures)} handshakes in {self._directory}")
+
+    def page(self, page: int):
+        """
+        :return: Escaped HANDSHAKE_PAGE body, an empty page past the end of the listing
+        """
+        self._refresh()
+        return _encode_handshake_page(self._generation, self._entries, page)
+
+
+class ClockSync():
+    """
+    Works out how far the pi's clock is off the flipper's rtc from its CLOCK_SET probes, and steps
+    it onto the flipper's
+
+    A probe carries the flipper's time t1 when it went out and the round trip t4 - t1 of the probe
+    before it. With the pi's times t2 when that one came in and t3 when it was acked, the probe
+    before makes an NTP sample: offset ((t1 - t2) + (t4 - t3)) / 2 and delay (t4 - t1) - (t3 - t2).
+    The sample with the shortest delay of the last CLOCK_FILTER waited least in either end's
+    queues, its offset is taken. The very first probe only gives the one way offset t1 - t2, which
+    is enough to step a pi that came up with its clock hours off
+    """
+
+    def __init__(self, clock=time.time, set_clock=_set_realtime):
+        """
+        :param: clock: Reads the pi's clock in seconds since the epoch
+        :param: set_clock: Sets it
+        """
+        self._clock = clock
+        self._set_clock = set_clock
+        # with stepping off the offset and drift are only worked out, the clock_sync option
+        self.stepping = True
+        self.step = CLOCK_STEP
+        # seconds the flipper's clock is ahead of UTC, qFlipper sets it to local time
+        self.utc_offset = 0
+        # (t1, t2, t3) of the last probe, its round trip comes with the next one
+        self._last = None
+        # (pi time, offset, delay) in seconds, the offset is the flipper's time minus the pi's
+        self._samples = collections.deque(maxlen=CLOCK_SAMPLES)
+        # seconds the offset grows by each second, None until the samples span CLOCK_DRIFT_SPAN
+        self.drift = None
+        self.probes = 0
+        self.steps = 0
+
+    def now(self) -> float:
+        return self._clock()
+
+    def offset(self, at: float = None):
+        """
+        :param: at: Pi time to give the offset at, the drift is taken into account
+        :return: Seconds the flipper's clock is ahead of the pi's, None before the first sample
+        """
+        if not self._samples:
+            return None
+        t, offset, _ = min(list(self._samples)[-CLOCK_FILTER:], key=lambda sample: sample[2])
+        if at is not None and self.drift is not None:
+            offset += self.drift * (at - t)
+        return offset
+
+    def _fit_drift(self):
+        # a sample that waited in a queue is off by up to half the wait, those are left out
+        shortest = min(sample[2] for sample in self._samples)
+        samples = [sample for sample in self._samples if sample[2] <= CLOCK_DELAY_SPREAD * shortest + 0.001]
+        times = [sample[0] for sample in samples]
+        if times[-1] - times[0] < CLOCK_DRIFT_SPAN:
+            return
+        offsets = [sample[1] for sample in samples]
+        mean_t = sum(times) / len(times)
+        mean_offset = sum(offsets) / len(offsets)
+        spread = sum((t - mean_t) ** 2 for t in times)
+        self.drift = sum((t - mean_t) * (offset - mean_offset) for t, offset in zip(times, offsets)) / spread
+
+    def _step_clock(self, offset: float):
+        try:
+            self._set_clock(self._clock() + offset)
+        except OSError as e:
+            logging.error(f"[PwnZero] can't set the clock, only estimating from now on: {e}")
+            self.stepping = False
+            return
+        self.steps += 1
+        logging.info(f"[PwnZero] stepped the clock {offset:+.3f}s onto the flipper's")
+        # everything so far was measured on the old clock
+        self._samples = collections.deque(((t + offset, sample_offset - offset, delay) for t, sample_offset, delay in self._samples), maxlen=CLOCK_SAMPLES)
+        if self._last is not None:
+            t1, t2, t3 = self._last
+            self._last = (t1, t2 + offset, t3 + offset)
+
+    def on_probe(self, flipper_time: float, rtt, t2: float, t3: float):
+        """
+        :param: flipper_time: Time the probe went out by the flipper's clock
+        :param: rtt: Round trip of the probe before it, None if that one wasn't answered
+        :param: t2: Pi time the probe came in
+        :param: t3: Pi time it was acked
+        """
+        if flipper_time < CLOCK_MIN_TIME:
+            logging.info(f"[PwnZero] flipper's clock isn't set, not following it")
+            return
+        self.probes += 1
+        t1 = flipper_time - self.utc_offset
+        last, self._last = self._last, (t1, t2, t3)
+
+        if last is not None and rtt is not None:
+            p1, p2, p3 = last
+            p4 = p1 + rtt
+            self._samples.append(((p2 + p3) / 2, ((p1 - p2) + (p4 - p3)) / 2, max(rtt - (p3 - p2), 0)))
+            self._fit_drift()
+            offset = self.offset(t3)
+            logging.info(f"[PwnZero] clock {offset:+.3f}s off the flipper's, drift {'unknown' if self.drift is None else f'{self.drift * 1e6:+.1f} ppm'}")
+        elif not self._samples:
+            offset = t1 - t2
+        else:
+            return
+
+        if self.stepping and abs(offset) > self.step:
+            self._step_clock(offset)
 
 
 class PwnZero(plugins.Plugin):
@@ -513,98 +1982,574 @@ class PwnZero(plugins.Plugin):
         # when running is True, we should continue looking for a flipper to chat with
         # when false, we should shut down
         self.running = False
-        self.connected = False
-        # when receiving bytes, if error_count reaches
-        # max_error, we leave the connected loop and
-        # return to trying to synack
+        self.link_state = LinkState.PROBING
+        # when sending or receiving, if error_count reaches
+        # max_error, the link is lost and we go back to probing
         self.error_count = 0
         self.max_error = 5
 
+        # cap on the delay between syns while probing
         self.synack_sleep = 5
+        self._backoff = Backoff(max_delay=self.synack_sleep)
+        # set by the reader when the flipper syns us while we are probing, so we probe right away
+        self._probe_now = threading.Event()
+
+        # how long the writer sleeps when there is nothing to send
+        # nothing needs it to wake up, this only bounds how stale running/link_state can get
+        self.idle_timeout = 1
+
+        # all serial io happens on these, the pwnagotchi hooks only ever touch the mailbox
+        self._mailbox = Mailbox()
+        self._reader_thread = None
+        self._writer_thread = None
+
+        # set by the reader when the flipper asks for every ui element again
+        self._resync = threading.Event()
+        # hashes from the flipper's last SYN or UI_REFRESH, the state hash or one per field.
+        # they let a resync skip whatever the flipper already has, consumed by the writer on the next one
+        self._flipper_hashes = None
+
+        # owned by the writer thread, the last ui snapshot the flipper acked
+        self.current_ui = None
 
+        # time from either end (re)starting to the full ui being on the flipper
+        # monotonic start time while a measurement is running, None otherwise
+        self._display_start = None
+        self.time_to_display = collections.deque(maxlen=32)
+        self.max_time_to_display = 1
 
-        self.new_ui = None
-        self.current_ui = None
+        # access points from the last wifi update as _ap_snapshot keeps them, replaced whole on
+        # every update so a snapshot holding it never changes under the writer
+        self._aps = {}
+
+        # peers the mesh told us about by identity, and the table the flipper keeps of them as
+        # _peer_snapshot picks it, replaced whole like the access points
+        self._peer_objects = {}
+        self._peers = {}
 
+        # plugin element name to its id on the flipper, ids are handed out once and never reused
+        self._element_ids = {}
+        # the elements option limits which plugin elements are mirrored, all of them by default
+        self.element_names = None
+
+        # with the render option set to 'tiles' the flipper mirrors the pwnagotchi's own display
+        # instead of drawing the fields itself, so anything on it shows up. costs more bytes
+        self.render_tiles = False
+
+        # with the offload option set, captures in offload_dir are copied to the flipper's sd card
+        # in the background. the paths that made it are kept in offload_log so they go only once
+        self._offload = None
+        self._offload_log = None
+
+        # captures in handshakes_dir, paged through on the flipper. the last page it asked for is
+        # set by the reader and sent by the writer, a newer request replaces one not answered yet
+        self._handshakes = None
+        self._handshake_page = None
+
+        # the last MODE, REBOOT or SHUTDOWN from the flipper and the thread carrying it out
+        self._control_msg = None
+        self._control_thread = None
+
+        # the flipper's rtc time, the pi's clock is stepped onto it unless the clock_sync option is
+        # off. clock_step is how far off it may be and clock_utc_offset the seconds the flipper's
+        # clock is ahead of UTC
+        self.clock_sync = ClockSync()
+
+        # activity per channel for the flipper's heatmap, dropped once the flipper NAKs it
+        # CHANNEL_STATS_MAX_NAKS times in a row
+        self._channels = ChannelStats()
+        self._channel_naks = 0
+
+        # when the trace_path option is set every ui snapshot is appended there as a json line,
+        # tools/bench/replay_bench.py replays these against a host build of the flipper app
+        self._trace_file = None
+        self._trace_start = None
+
+
+    @property
+    def connected(self) -> bool:
+        return self.link_state in (LinkState.CONNECTED, LinkState.DEGRADED)
 
     def on_loaded(self):
         logging.info(f"[PwnZero] plugin loaded")
+        # /dev/ttyACM0 when the flipper's link is set to USB, the baud has to match its setting
+        port = getattr(self, 'options', {}).get('port')
+        baud = getattr(self, 'options', {}).get('baud')
+        if port or baud:
+            self._flipper = Flipper(port or self._flipper._port, int(baud or self._flipper._baud))
+        logging.info(f"[PwnZero] talking to the flipper over {self._flipper._port} at {self._flipper._baud}")
         self._flipper.open_serial()
 
         self.running = True
+        self._display_start = time.monotonic()
+
+        self.render_tiles = getattr(self, 'options', {}).get('render', 'fields') == 'tiles'
+        logging.info(f"[PwnZero] rendering {'tiles' if self.render_tiles else 'fields'}")
+        self.element_names = getattr(self, 'options', {}).get('elements')
+
+        if getattr(self, 'options', {}).get('offload', False):
+            self._start_offload()
+        self._handshakes = HandshakeIndex(getattr(self, 'options', {}).get('handshakes_dir', '/root/handshakes'))
+
+        self.clock_sync.stepping = getattr(self, 'options', {}).get('clock_sync', True)
+        self.clock_sync.step = getattr(self, 'options', {}).get('clock_step', CLOCK_STEP)
+        self.clock_sync.utc_offset = getattr(self, 'options', {}).get('clock_utc_offset', 0)
+
+        trace_path = getattr(self, 'options', {}).get('trace_path')
+        if trace_path:
+            logging.info(f"[PwnZero] recording ui trace to {trace_path}")
+            self._trace_file = open(trace_path, 'a')
+            self._trace_start = time.monotonic()
+
+        logging.info(f"[PwnZero] starting reader and writer threads")
+        self._reader_thread = threading.Thread(target=self._reader_loop, name="PwnZeroReader", daemon=True)
+        self._writer_thread = threading.Thread(target=self._writer_loop, name="PwnZeroWriter", daemon=True)
+        self._reader_thread.start()
+        self._writer_thread.start()
+
+    def _start_offload(self):
+        options = getattr(self, 'options', {})
+        offload_dir = options.get('offload_dir', '/root/handshakes')
+        self._offload_log = options.get('offload_log', '/root/.pwnzero_offloaded')
+        self._offload = Offload(self._flipper._baud)
+        self._offload.on_done = self._on_offloaded
+
+        done = set()
+        try:
+            with open(self._offload_log) as log:
+                done = {line.rstrip("\n") for line in log}
+        except OSError:
+            pass
+
+        try:
+            paths = [os.path.join(offload_dir, name) for name in os.listdir(offload_dir)]
+        except OSError as e:
+            logging.error(f"[PwnZero] can't list {offload_dir}: {e}")
+            paths = []
+        # oldest first, the newest captures are the ones most likely to still grow
+        paths = sorted((path for path in paths if os.path.isfile(path) and path not in done), key=os.path.getmtime)
+        logging.info(f"[PwnZero] {len(paths)} files in {offload_dir} to offload")
+        for path in paths:
+            self._offload.add(path)
+
+    def _on_offloaded(self, path: str):
+        try:
+            with open(self._offload_log, 'a') as log:
+                log.write(path + "\n")
+        except OSError as e:
+            logging.error(f"[PwnZero] can't record {path} in {self._offload_log}: {e}")
+
+    def _send_offload(self):
+        """
+        Send the next file packet that is due, if any
+        """
+        packet = self._offload.next_packet(time.monotonic())
+        if packet is None:
+            return
+        cmd, body = packet
+        try:
+            self._flipper._send_bytes(cmd, body)
+        except ReceivedNak:
+            # only a FILE_OPEN gets a NAK, from a flipper that doesn't know it
+            logging.warning(f"[PwnZero] flipper doesn't take files, not offloading")
+            self._offload.stop()
+        except PwnZeroSerialException as e:
+            logging.info(f"[PwnZero] failed sending {cmd}: {type(e).__name__}:{e.args}")
+            self._count_error()
+        else:
+            if cmd == FlipperCommand.FILE_OPEN.value:
+                self._count_success()
+
+    def _send_handshake_page(self, page: int):
+        """
+        Answer the flipper's HANDSHAKE_LIST. A page that didn't make it isn't sent again, the flipper
+        asks again for what it still wants
+        """
+        try:
+            self._flipper._send_bytes(FlipperCommand.HANDSHAKE_PAGE.value, self._handshakes.page(page))
+        except PwnZeroSerialException as e:
+            logging.info(f"[PwnZero] failed sending handshake page {page}: {type(e).__name__}:{e.args}")
+            self._count_error()
+        else:
+            self._count_success()
+
+    def _send_channel_stats(self):
+        """
+        Send the channel counts if a packet is due, what doesn't make it goes with the next one
+        """
+        packet = self._channels.take(time.monotonic())
+        if packet is None:
+            return
+        body, records = packet
+        try:
+            self._flipper._send_bytes(FlipperCommand.CHANNEL_STATS.value, body)
+        except ReceivedNak:
+            self._channels.put_back(records)
+            self._channel_naks += 1
+            if self._channel_naks >= CHANNEL_STATS_MAX_NAKS:
+                logging.warning(f"[PwnZero] flipper doesn't take channel stats, not sending them")
+                self._channels = None
+        except PwnZeroSerialException as e:
+            logging.info(f"[PwnZero] failed sending channel stats: {type(e).__name__}:{e.args}")
+            self._channels.put_back(records)
+            self._count_error()
+        else:
+            self._channel_naks = 0
+            self._count_success()
+
+    def _writer_timeout(self) -> float:
+        """
+        :return: Seconds the writer can wait for the mailbox before the offload or the channel
+                 stats need it
+        """
+        if self._handshake_page is not None:
+            # asked for while the writer was busy, the wake went by unseen
+            return 0
+        if not self.connected:
+            return self.idle_timeout
+        now = time.monotonic()
+        timeouts = [self.idle_timeout]
+        if self._offload is not None:
+            timeouts.append(self._offload.timeout(now))
+        if self._channels is not None:
+            timeouts.append(self._channels.timeout(now))
+        return min(timeout for timeout in timeouts if timeout is not None)
+
+    def _set_link_state(self, state: LinkState):
+        if state == self.link_state:
+            return
+
+        logging.info(f"[PwnZero] link {self.link_state.name} -> {state.name}")
+        previous = self.link_state
+        self.link_state = state
+
+        if state == LinkState.PROBING:
+            self._backoff.reset()
+            if self._offload is not None:
+                self._offload.link_lost()
+            self.error_count = 0
+            if self._display_start is None:
+                self._display_start = time.monotonic()
+        elif state == LinkState.CONNECTED and previous == LinkState.PROBING:
+            # whatever the flipper had on screen before is stale, resend everything
+            self.error_count = 0
+            self._resync.set()
+        elif state == LinkState.LOST:
+            self._mailbox.wake()
+
+    def _count_error(self):
+        self.error_count += 1
+        if self.error_count >= self.max_error:
+            logging.info(f"[PwnZero] max_error count {self.max_error} reached, link lost")
+            self._set_link_state(LinkState.LOST)
+        elif self.link_state == LinkState.CONNECTED:
+            self._set_link_state(LinkState.DEGRADED)
+
+    def _count_success(self):
+        self.error_count = 0
+        if self.link_state == LinkState.DEGRADED:
+            self._set_link_state(LinkState.CONNECTED)
+
+    def _probe(self):
+        """
+        Send one syn, after waiting out the backoff unless the flipper just synced us
+        """
+        delay = self._backoff.next_delay()
+        if self._probe_now.wait(delay):
+            self._probe_now.clear()
+        if not self.running:
+            return
+
+        # synack
+        try:
+            self._flipper.send_syn()
+        except Exception as e:
+            # we don't care much about exceptions when initialy trying to establish communication
+            logging.info(f"[PwnZero] error while attemption to synack: {type(e).__name__}:{e.args}")
+        else:
+            logging.info(f"[PwnZero] synack complete, flipper connected!")
+            self._set_link_state(LinkState.CONNECTED)
 
+    def _on_display(self):
+        """
+        Note a full ui update made it to the flipper
+        """
+        if self._display_start is None:
+            return
+
+        elapsed = time.monotonic() - self._display_start
+        self._display_start = None
+        self.time_to_display.append(elapsed)
+        if elapsed > self.max_time_to_display:
+            logging.warning(f"[PwnZero] time to display {elapsed:.3f}s, over bound of {self.max_time_to_display}s")
+        else:
+            logging.info(f"[PwnZero] time to display {elapsed:.3f}s")
+
+    def _writer_loop(self):
+        """
+        Owns every packet that expects an ACK: syn, ui updates and anything queued by the reader
+        """
         logging.info(f"[PwnZero] starting syn loop")
         while self.running:
-            # TODO backoff how aggressively we syn over time
-            time.sleep(self.synack_sleep)
-            # synack
+            if self.link_state == LinkState.LOST:
+                self._set_link_state(LinkState.PROBING)
+
+            if self.link_state == LinkState.PROBING:
+                self._probe()
+                continue
+
+            # main communication loop. ui updates go out first, file chunks only in between, one
+            # per pass so a new snapshot never waits behind more than a single chunk
+            packets, new_ui = self._mailbox.wait(self._writer_timeout())
+
+            for cmd, body in packets:
+                try:
+                    self._flipper._send_bytes(cmd, body)
+                except PwnZeroSerialException as e:
+                    logging.info(f"[PwnZero] failed sending {cmd}: {type(e).__name__}:{e.args}")
+                    self._count_error()
+                else:
+                    self._count_success()
+
+            page, self._handshake_page = self._handshake_page, None
+            if page is not None and self.connected:
+                self._send_handshake_page(page)
+
+            resync = self._resync.is_set()
+            # what the flipper is known to show, only becomes current_ui once the update is acked
+            known_ui = self.current_ui
+            if resync:
+                self._resync.clear()
+                self.current_ui = None
+                known_ui = None
+                if new_ui is None:
+                    new_ui = self._mailbox.latest()
+
+                flipper_hashes = self._flipper_hashes
+                self._flipper_hashes = None
+                # the hashes only cover the fields, a mirrored framebuffer always goes out in full
+                if new_ui is not None and flipper_hashes is not None and 'framebuffer' not in new_ui:
+                    if len(flipper_hashes) == len(SYNC_FIELDS):
+                        # only the fields that differ go out again
+                        known_ui = _flipper_ui(new_ui, flipper_hashes)
+                        logging.info(f"[PwnZero] flipper already has {sorted(known_ui)}")
+                    elif len(flipper_hashes) == 1 and flipper_hashes[0] == _state_hash(new_ui):
+                        # the flipper restored or kept exactly these fields, nothing of them to resend.
+                        # plugin elements, access points and peers aren't in the hash, they always go out again
+                        logging.info(f"[PwnZero] flipper state hash matches, skipping resync of the fields")
+                        known_ui = {key: value for key, value in new_ui.items() if key not in ('elements', 'ap_table', 'peer_table')}
+
+            if new_ui is not None and self.connected:
+                # send ui updates
+                if self._flipper.update_ui(known_ui, new_ui):
+                    self._count_success()
+                    self.current_ui = new_ui
+                    if resync:
+                        self._on_display()
+                else:
+                    self._count_error()
+                    # whatever failed has to go out again
+                    self._resync.set()
+
+            # the screen comes first, nothing else until a pending resync is done
+            if self._channels is not None and self.connected and not self._resync.is_set():
+                self._send_channel_stats()
+            if self._offload is not None and self.connected and not self._resync.is_set():
+                self._send_offload()
+
+    def _reader_loop(self):
+        """
+        Reads every packet the flipper sends, never blocks on anything but the serial port
+        """
+        while self.running:
+            # receive commands from flipper
             try:
-                self._flipper.send_syn()
-            except Exception as e:
-                # we don't care much about exceptions when initialy trying to establish communication
-                logging.info(f"[PwnZero] error while attemption to synack: {type(e).__name__}:{e.args}")
+                msg = self._flipper.receive_bytes()
+            except ReceivedNone:
+                # nothing to do
+                continue
+            except ReceivedNak as e:
+                logging.info(f"[PwnZero] received NAK")
+                self._flipper.deliver_reply([PwnCommand.NAK.value])
+                continue
+            except PwnZeroSerialException as e:
+                logging.info(f"[PwnZero] receive exception in main loop: {type(e).__name__}:{e.args}")
+                continue
+            except SerialConnException as e:
+                logging.error(f"[PwnZero] serial connection error: {e.args}")
+                time.sleep(self.idle_timeout)
+                continue
+
+            # we have some command to handle!
+            logging.info(f"[PwnZero] received flipper message: {msg}")
+            self._handle_message(msg)
+
+    def _handle_message(self, msg):
+        if msg[0] == PwnCommand.ACK.value:
+            self._flipper.deliver_reply(msg)
+        elif msg[0] == PwnCommand.SYN.value:
+            self._flipper_hashes = _parse_hashes(msg[1:])
+            self._flipper.send_ack()
+            if self.link_state == LinkState.PROBING:
+                # the flipper is up, no point waiting out the backoff
+                self._probe_now.set()
+            elif self._display_start is None:
+                # a syn on a live link means the flipper restarted, it asks for a refresh once
+                # it sees our ack. time how long until it has the full ui again
+                self._display_start = time.monotonic()
+        elif msg[0] == PwnCommand.FILE_ACK.value:
+            # acks the chunks, nothing goes back
+            if self._offload is not None and self._offload.on_ack(msg[1:]):
+                self._mailbox.wake()
+        elif msg[0] == PwnCommand.HANDSHAKE_LIST.value:
+            page = _parse_handshake_list(msg[1:])
+            if page is None or self._handshakes is None:
+                self._flipper.send_nak()
+                return
+            self._flipper.send_ack()
+            # listing the captures can take a while, the writer does it
+            self._handshake_page = page
+            self._mailbox.wake()
+        elif msg[0] in CONTROL_COMMANDS:
+            self._on_control(msg)
+        elif msg[0] == PwnCommand.CLOCK_SET.value:
+            self._on_clock(msg)
+        elif msg[0] == PwnCommand.UI_REFRESH.value:
+            self._flipper_hashes = _parse_hashes(msg[1:])
+            self._flipper.send_ack()
+            self._resync.set()
+            self._mailbox.wake()
+        else:
+            logging.info(f"[PwnZero] received flipper message, but not able to handle command.: {msg}")
+            self._flipper.send_nak()
+
+    def _control_action(self, msg):
+        """
+        :param: msg: MODE, REBOOT or SHUTDOWN from the flipper
+        :return: What to run for it, None if it doesn't make sense
+        """
+        current = _agent_mode((self.current_ui or {}).get('mode'))
+        if msg[0] == PwnCommand.MODE.value and len(msg) == 2 and msg[1] in CONTROL_MODES:
+            mode = CONTROL_MODES[msg[1]]
+            if mode == current:
+                # already there, the flipper only needs the ack
+                return lambda: None
+            return lambda: pwnagotchi.restart(mode)
+        if msg[0] == PwnCommand.REBOOT.value and len(msg) == 1:
+            return lambda: pwnagotchi.reboot(mode=current)
+        if msg[0] == PwnCommand.SHUTDOWN.value and len(msg) == 1:
+            return pwnagotchi.shutdown
+        return None
+
+    def _on_control(self, msg):
+        """
+        Answers a MODE, REBOOT or SHUTDOWN right away and leaves the doing to a thread of its own, a
+        restart or reboot takes seconds and the reader has to stay free until then
+        """
+        if self._control_thread is not None and self._control_thread.is_alive():
+            # only the flipper asking again because our ack got lost gets one
+            if msg == self._control_msg:
+                self._flipper.send_ack(msg[0])
             else:
-                logging.info(f"[PwnZero] synack complete, flipper connected!")
-                self.connected = True
-                self.error_count = 0
-                self.current_ui = None
-                while self.connected:
-                    # main communication loop
-
-                    # send ui updates
-                    self._flipper.update_ui(self.current_ui, self.new_ui)
-                    self.current_ui = self.new_ui
-
-                    # receive commands from flipper
-                    try:
-                        msg = self._flipper.receive_bytes()
-                    except PwnZeroSerialException as e:
-                        logging.info(f"[PwnZero] receive exception in main loop: {type(e).__name__}:{e.args}")
-                        self.error_count += 1
-                        if self.error_count == self.max_error:
-                            logging.info(f"[PwnZero] max_error count {self.max_error} reached, disconnecting")
-                            self.connected = False
-                    except ReceivedNone:
-                        # nothing to do
-                        pass
-                    else:
-                        # we have some command to handle!
-                        logging.info(f"[PwnZero] received flipper message: {msg}")
-
-                        if msg[0] == PwnCommand.SYN.value:
-                            self._flipper.send_ack()
-                        elif msg[0] == PwnCommand.UI_REFRESH.value:
-                            self.current_ui = None
-                            self._flipper.send_ack()
-                        elif msg[0] == PwnCommand.ACK.value:
-                            pass
-                        elif msg[0] == PwnCommand.NAK.value:
-                            logging.info(f"[PwnZero] received NAK")
-                            pass
-                        else:
-                            logging.info(f"[PwnZero] received flipper message, but not able to handle command.: {msg}")
-                            self._flipper.send_nak()
+                self._flipper.send_nak(msg[0])
+            return
+        action = self._control_action(msg)
+        if action is None:
+            self._flipper.send_nak(msg[0])
+            return
+        self._flipper.send_ack(msg[0])
+        logging.info(f"[PwnZero] flipper asked for {PwnCommand(msg[0]).name}: {msg[1:]}")
+        self._control_msg = msg
+        self._control_thread = threading.Thread(target=action, daemon=True)
+        self._control_thread.start()
+
+    def _on_clock(self, msg):
+        """
+        Acks a CLOCK_SET right away, the pi's clock is read on either side of that
+        """
+        t2 = self.clock_sync.now()
+        probe = _parse_clock_set(msg[1:])
+        if probe is None:
+            self._flipper.send_nak(msg[0])
+            return
+        self._flipper.send_ack(msg[0])
+        t3 = self.clock_sync.now()
+        self.clock_sync.on_probe(probe[0], probe[1], t2, t3)
 
     def on_unload(self):
-        self.connected = False
         self.running = False
+        self._probe_now.set()
+        self._mailbox.wake()
+
+        for thread in (self._writer_thread, self._reader_thread):
+            if thread is not None:
+                thread.join(timeout=self._flipper._timeout + self.synack_sleep)
 
         self._flipper.close_serial()
 
+        if self._trace_file is not None:
+            self._trace_file.close()
+            self._trace_file = None
+
     def on_ui_setup(self, ui):
-        pass
+        if self.render_tiles:
+            ui.on_render(self.on_render)
+
+    def on_render(self, canvas):
+        """
+        Called by the view with every frame it renders, when mirroring it
+        """
+        self._mailbox.put_latest({'framebuffer': _framebuffer(canvas), 'ap_table': self._aps, 'peer_table': self._refresh_peers()})
 
     def on_ui_update(self, ui):
         logging.debug("[PwnZero] on_ui_update")
-        self.new_ui = ui
+        snapshot = _ui_snapshot(ui)
+        if not self.render_tiles:
+            # the tiles carry plugin elements already
+            snapshot['elements'] = _element_snapshot(ui, self._element_ids, self.element_names)
+            snapshot['ap_table'] = self._aps
+            snapshot['peer_table'] = self._refresh_peers()
+            self._mailbox.put_latest(snapshot)
+
+        if self._trace_file is not None:
+            self._trace_file.write(json.dumps({'t': time.monotonic() - self._trace_start, 'ui': snapshot}) + "\n")
+
+    def on_wifi_update(self, agent, access_points):
+        channels = self._channels
+        if channels is not None:
+            channels.on_wifi_update(access_points)
+        self._aps = _ap_snapshot(access_points, self._aps)
+        # the screen may not change with it, so the table goes out on the last snapshot too
+        self._mailbox.amend_latest(ap_table=self._aps)
+
+    def on_handshake(self, agent, filename, access_point, client_station):
+        if self._offload is not None:
+            self._offload.add(filename)
+        channels = self._channels
+        if channels is not None:
+            channels.on_handshake(int((access_point or {}).get('channel', 0)))
+            self._mailbox.wake()
+
+    def _refresh_peers(self) -> dict:
+        """
+        The mesh updates the peer objects in place, so their signal and last seen are read again
+        on every snapshot
+
+        :return: The peer table as it is now
+        """
+        self._peers = _peer_snapshot(list(self._peer_objects.values()), self._peers)
+        return self._peers
+
+    def on_peer_detected(self, agent, peer):
+        self._peer_objects[peer.identity()] = peer
+        self._mailbox.amend_latest(peer_table=self._refresh_peers())
+
+    def on_peer_lost(self, agent, peer):
+        self._peer_objects.pop(peer.identity(), None)
+        self._mailbox.amend_latest(peer_table=self._refresh_peers())
 
     def on_rebooting(self):
         pass
 
     def _receive_command(self):
-        pass
-
-    def cmd_reboot(self):
-        # mode = 'MANU' if agent.mode == 'manual' else 'AUTO'
-        # pwnagotchi.reboot(mode=mode)
         pass
\ No newline at end of file
@@ -0,0 +1,147 @@
+"""
+Walks a made up neighbourhood of access points through PwnZero's wifi updates into a host build
+of the flipagotchi app and reports what keeping the flipper's access point table in sync costs on
+the wire, next to resending the whole table on every update
+
+Access points come and go and their signal drifts on every update. Once the walk is done the
+table the host app ends up with is compared with the one PwnZero kept
+
+Build the host app first with `make -C tools/hostsim`
+"""
+import argparse
+import json
+import logging
+import random
+import tempfile
+import time
+from pathlib import Path
+
+from replay_bench import TOOLS_DIR, load_trace, pz
+from offload_bench import Session
+
+
+def walk(rng, population, updates, churn):
+    """
+    :return: bettercap's access point list for each update
+    """
+    neighbourhood = []
+    for index in range(population):
+        mac = ':'.join(f"{rng.randrange(256):02x}" for _ in range(6))
+        neighbourhood.append({
+            'mac': mac,
+            'hostname': rng.choice(['<hidden>', f"net-{index}", f"HomeNetwork_{index:04d}_5G"]),
+            'encryption': rng.choice(['', 'WEP', 'WPA', 'WPA2', 'WPA2 WPA3', 'WPA3']),
+            'channel': rng.choice([1, 6, 11, 36, 44, 149]),
+            'rssi': rng.randrange(-95, -30),
+            'clients': [],
+        })
+
+    in_range = set(rng.sample(range(population), population // 2))
+    for _ in range(updates):
+        for index in range(population):
+            if rng.random() < churn:
+                in_range ^= {index}
+        for ap in neighbourhood:
+            ap['rssi'] = max(-100, min(-20, ap['rssi'] + rng.randint(-3, 3)))
+            if rng.random() < churn:
+                ap['clients'] = ap['clients'][:-1] if ap['clients'] and rng.random() < 0.5 else ap['clients'] + ['client']
+        yield [dict(neighbourhood[index]) for index in sorted(in_range)]
+
+
+def full_resend_bytes(aps):
+    # clearing the table, then every access point in as few packets as they fit
+    bodies = [pz._crc_body([])] + pz._ap_bodies([pz._encode_ap(mac, ap) for mac, ap in aps.items()])
+    return sum(len(body) + 3 for body in bodies)
+
+
+def flipper_table(host_errors):
+    table = []
+    for line in host_errors.splitlines():
+        if line.startswith("AP\t"):
+            mac, rssi, channel, security, clients, ssid = (line.split("\t", 6)[1:] + [''])[:6]
+            table.append((mac, [int(rssi), int(channel), int(security), int(clients), ssid]))
+    return table
+
+
+def run(args):
+    trace = load_trace(TOOLS_DIR / "bench" / "traces" / "sample.jsonl")
+
+    with tempfile.TemporaryDirectory() as sd:
+        session = Session(args, Path(sd), {})
+        session.wait_connected(trace[0]['ui'], args.connect_timeout)
+        plugin = session.plugin
+        # the channel heatmap rides on the same wifi updates, channel_bench.py costs it
+        plugin._channels = None
+        flipper = plugin._flipper
+
+        bytes_before = flipper.bytes_sent
+        packets_before = flipper.packets_sent
+        full = 0
+        sizes = []
+        rng = random.Random(args.seed)
+        for access_points in walk(rng, args.population, args.updates, args.churn):
+            plugin.on_wifi_update(None, access_points)
+            full += full_resend_bytes(plugin._aps)
+            sizes.append(len(plugin._aps))
+            time.sleep(args.interval)
+
+        deadline = time.monotonic() + args.drain_timeout
+        while (plugin.current_ui or {}).get('ap_table') is not plugin._aps and time.monotonic() < deadline:
+            time.sleep(0.01)
+        expected = plugin._aps
+        session.stop()
+
+    table = flipper_table(session.host_errors)
+    rssis = [ap[0] for _, ap in table]
+    wire = flipper.bytes_sent - bytes_before
+    return {
+        'updates': args.updates,
+        'mean_aps': sum(sizes) / len(sizes),
+        'in_sync': dict(table) == expected and len(table) == len(expected),
+        'sorted': rssis == sorted(rssis, reverse=True),
+        'flipper_aps': len(table),
+        'bytes_per_update': wire / args.updates,
+        'full_bytes_per_update': full / args.updates,
+        'packets': flipper.packets_sent - packets_before,
+        'failed': flipper.packets_failed,
+        'baud': args.baud,
+        'noise': args.noise,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default=str(TOOLS_DIR / "hostsim" / "build" / "flipagotchi_host"), help="host build of the flipper app")
+    parser.add_argument("--population", type=int, default=80, help="access points that can come into range")
+    parser.add_argument("--updates", type=int, default=100, help="wifi updates to send")
+    parser.add_argument("--churn", type=float, default=0.05, help="chance per update of an access point coming or going")
+    parser.add_argument("--interval", type=float, default=0.05, help="seconds between wifi updates")
+    parser.add_argument("--baud", type=int, default=115200, help="emulated baudrate")
+    parser.add_argument("--noise", type=float, default=0, help="probability per byte of a bit flip on the wire")
+    parser.add_argument("--seed", type=int, default=1, help="seed for the walk and the line noise")
+    parser.add_argument("--ack-timeout", type=float, default=0.2, help="seconds PwnZero waits for an ack")
+    parser.add_argument("--connect-timeout", type=float, default=10)
+    parser.add_argument("--drain-timeout", type=float, default=10)
+    parser.add_argument("--json", action="store_true", help="print the report as json")
+    parser.add_argument("--verbose", action="store_true", help="show PwnZero's logging")
+    args = parser.parse_args()
+    if args.updates <= 0:
+        parser.error("--updates has to be above 0")
+
+    logging.basicConfig(level=logging.INFO if args.verbose else logging.CRITICAL)
+
+    report = run(args)
+    if args.json:
+        print(json.dumps(report))
+    else:
+        print(f"table            {report['flipper_aps']} access points on the flipper, {'in sync' if report['in_sync'] else 'OUT OF SYNC'}, {'sorted' if report['sorted'] else 'NOT SORTED'}")
+        print(f"wire             {report['bytes_per_update']:.0f} B per update, {report['full_bytes_per_update']:.0f} B resending the whole table")
+        print(f"packets          {report['packets']} over {report['updates']} updates of {report['mean_aps']:.1f} access points, {report['failed']} failed")
+        print(f"line             {report['baud']} baud, noise {report['noise']}")
+
+    if not (report['in_sync'] and report['sorted']):
+        raise SystemExit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,149 @@
+"""
+Writes bursts of frames back to back into a host build of the flipagotchi app, more of them than its
+message queue holds, and checks every one of them was dispatched and acked. The app frames only as
+many as the queue takes and leaves the rest in the rx ring until they are dispatched, so a burst of
+any length goes through whole
+
+There is no PwnZero on the wire, the frames are written straight to the pty so nothing waits for an
+ack in between
+
+Build the host app first with `make -C tools/hostsim`
+"""
+import argparse
+import json
+import os
+import pty
+import subprocess
+import tempfile
+import threading
+import time
+import tty
+
+from replay_bench import TOOLS_DIR
+
+PACKET_START = 0x02
+PACKET_END = 0x03
+CMD_ACK = 0x06
+CMD_SYN = 0x16
+FLIPPER_CMD_UI_STATUS = 0x0c
+# frames the flipper's message queue holds, PWNAGOTCHI_PROTOCOL_MESSAGE_QUEUE_SIZE
+QUEUE_SIZE = 15
+
+
+def frame(cmd, body=b""):
+    return bytes([PACKET_START, cmd]) + body + bytes([PACKET_END])
+
+
+def run(args):
+    master, slave = pty.openpty()
+    tty.setraw(master)
+    tty.setraw(slave)
+    with tempfile.TemporaryDirectory() as sd:
+        host = subprocess.Popen(
+            [args.host, "--fd", str(master), "--baud", str(args.baud)],
+            stdin=subprocess.PIPE,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.PIPE,
+            pass_fds=(master,),
+            encoding="utf-8",
+            errors="replace",
+            env=dict(os.environ, HOSTSIM_SD=sd),
+        )
+        os.close(master)
+
+        acks = [0]
+        acked = threading.Condition()
+
+        def read_wire():
+            previous = []
+            while True:
+                try:
+                    data = os.read(slave, 256)
+                except OSError:
+                    return
+                if not data:
+                    return
+                for byte in data:
+                    previous = (previous + [byte])[-3:]
+                    if previous == [PACKET_START, CMD_ACK, PACKET_END]:
+                        with acked:
+                            acks[0] += 1
+                            acked.notify_all()
+
+        statuses = []
+
+        def read_screen():
+            for line in host.stdout:
+                columns = line.rstrip("\n").split("\t")
+                if columns[0] == "DRAW":
+                    statuses.append(columns[-1])
+
+        threading.Thread(target=read_wire, daemon=True).start()
+        threading.Thread(target=read_screen, daemon=True).start()
+
+        # the syn's ack connects the link, the bursts go out on top of it
+        expected = 1
+        os.write(slave, frame(CMD_SYN))
+        sent = 0
+        for burst in range(args.bursts):
+            with acked:
+                if not acked.wait_for(lambda: acks[0] >= expected, timeout=args.timeout):
+                    break
+            payload = b"".join(
+                frame(FLIPPER_CMD_UI_STATUS, f"burst {burst} frame {index}".encode())
+                for index in range(args.frames))
+            os.write(slave, payload)
+            sent += args.frames
+            expected += args.frames
+        with acked:
+            acked.wait_for(lambda: acks[0] >= expected, timeout=args.timeout)
+
+        host.stdin.close()
+        host.wait(timeout=10)
+        errors = host.stderr.read()
+        os.close(slave)
+
+    dispatched = 0
+    for line in errors.splitlines():
+        if line.startswith("DISPATCH\t"):
+            dispatched = int(line.split("\t")[2])
+    return {
+        'frames': sent,
+        # the syn's ack isn't one of the burst's
+        'acked': acks[0] - 1,
+        'dispatched': dispatched,
+        'last_status': statuses[-1] if statuses else None,
+        'expected_status': f"burst {args.bursts - 1} frame {args.frames - 1}",
+        'baud': args.baud,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default=str(TOOLS_DIR / "hostsim" / "build" / "flipagotchi_host"), help="host build of the flipper app")
+    parser.add_argument("--frames", type=int, default=4 * QUEUE_SIZE, help="frames in each burst")
+    parser.add_argument("--bursts", type=int, default=20, help="bursts to write, each once the last one is acked")
+    parser.add_argument("--baud", type=int, default=0, help="emulated baudrate of the uart, 0 for unpaced")
+    parser.add_argument("--timeout", type=float, default=10, help="seconds to wait for a burst's acks")
+    parser.add_argument("--json", action="store_true", help="print the report as json")
+    args = parser.parse_args()
+    if args.frames <= QUEUE_SIZE:
+        parser.error(f"a burst needs more than the queue's {QUEUE_SIZE} frames")
+
+    report = run(args)
+    if args.json:
+        print(json.dumps(report))
+    else:
+        print(f"frames           {report['frames']} sent, {report['acked']} acked, {report['dispatched']} dispatched")
+        print(f"screen           {report['last_status']!r} last, {report['expected_status']!r} sent last")
+        print(f"line             {report['baud']} baud")
+
+    # everything the flipper dispatched is a burst frame or the syn
+    if report['acked'] != report['frames'] or report['dispatched'] != report['frames'] + 1:
+        raise SystemExit("frames of a burst were lost")
+    if report['last_status'] != report['expected_status']:
+        raise SystemExit("the screen doesn't show the last frame of the last burst")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,133 @@
+"""
+Feeds a made up stream of wifi updates and handshakes through PwnZero into a host build of the
+flipagotchi app and reports what the channel heatmap costs on the wire
+
+Access points sit on a few channels, one of them much busier than the rest. Whatever the rate of
+updates, the heatmap should cost at most one packet a second, and once the walk is done the busiest
+channel on the flipper should be the busiest one in the walk
+
+Build the host app first with `make -C tools/hostsim`
+"""
+import argparse
+import json
+import logging
+import random
+import tempfile
+import time
+from pathlib import Path
+
+from replay_bench import TOOLS_DIR, load_trace, pz
+from offload_bench import Session
+
+CHANNELS = [1, 6, 11, 36, 44, 149]
+
+
+def walk(rng, population, updates, busiest):
+    """
+    :return: bettercap's access point list for each update, with its traffic counters going up
+    """
+    neighbourhood = []
+    for index in range(population):
+        # a third of them on the busy channel, the rest spread over the others
+        channel = busiest if index % 3 == 0 else rng.choice([channel for channel in CHANNELS if channel != busiest])
+        neighbourhood.append({
+            'mac': ':'.join(f"{rng.randrange(256):02x}" for _ in range(6)),
+            'channel': channel,
+            'sent': 0,
+            'received': 0,
+        })
+    for _ in range(updates):
+        for ap in neighbourhood:
+            rate = 8 if ap['channel'] == busiest else 1
+            ap['sent'] += rng.randrange(1024 * rate)
+            ap['received'] += rng.randrange(2048 * rate)
+        yield [dict(ap) for ap in neighbourhood]
+
+
+def flipper_channels(host_errors):
+    channels = {}
+    for line in host_errors.splitlines():
+        if line.startswith("CHANNEL\t"):
+            channel, traffic, aps, handshakes = (int(value) for value in line.split("\t")[1:5])
+            channels[channel] = (traffic, aps, handshakes)
+    return channels
+
+
+def run(args):
+    trace = load_trace(TOOLS_DIR / "bench" / "traces" / "sample.jsonl")
+    rng = random.Random(args.seed)
+    busiest = rng.choice(CHANNELS)
+
+    with tempfile.TemporaryDirectory() as sd:
+        session = Session(args, Path(sd), {})
+        session.wait_connected(trace[0]['ui'], args.connect_timeout)
+        plugin = session.plugin
+        flipper = plugin._flipper
+        cmd = pz.FlipperCommand.CHANNEL_STATS.value
+
+        start = time.monotonic()
+        for access_points in walk(rng, args.population, args.updates, busiest):
+            plugin.on_wifi_update(None, access_points)
+            if rng.random() < args.handshakes:
+                plugin.on_handshake(None, "capture.pcap", rng.choice(access_points), None)
+            time.sleep(args.interval)
+        # whatever is left over goes out within an interval
+        time.sleep(pz.CHANNEL_STATS_INTERVAL * 1.5)
+        seconds = time.monotonic() - start
+        packets = flipper.command_packets[cmd]
+        wire = flipper.command_bytes[cmd]
+        session.stop()
+
+    channels = flipper_channels(session.host_errors)
+    hottest = max(channels, key=lambda channel: channels[channel][0]) if channels else None
+    return {
+        'updates': args.updates,
+        'seconds': seconds,
+        'packets': packets,
+        'packets_per_second': packets / seconds,
+        'bytes_per_second': wire / seconds,
+        'line_share': wire / seconds / (args.baud / 10) * 100,
+        'busiest': busiest,
+        'hottest': hottest,
+        'channels': len(channels),
+        'baud': args.baud,
+        'noise': args.noise,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default=str(TOOLS_DIR / "hostsim" / "build" / "flipagotchi_host"), help="host build of the flipper app")
+    parser.add_argument("--population", type=int, default=30, help="access points in range")
+    parser.add_argument("--updates", type=int, default=100, help="wifi updates to send")
+    parser.add_argument("--interval", type=float, default=0.05, help="seconds between wifi updates")
+    parser.add_argument("--handshakes", type=float, default=0.1, help="chance per update of a handshake")
+    parser.add_argument("--baud", type=int, default=115200, help="emulated baudrate")
+    parser.add_argument("--noise", type=float, default=0, help="probability per byte of a bit flip on the wire")
+    parser.add_argument("--seed", type=int, default=1, help="seed for the walk and the line noise")
+    parser.add_argument("--ack-timeout", type=float, default=0.2, help="seconds PwnZero waits for an ack")
+    parser.add_argument("--connect-timeout", type=float, default=10)
+    parser.add_argument("--json", action="store_true", help="print the report as json")
+    parser.add_argument("--verbose", action="store_true", help="show PwnZero's logging")
+    args = parser.parse_args()
+    if args.updates <= 0:
+        parser.error("--updates has to be above 0")
+
+    logging.basicConfig(level=logging.INFO if args.verbose else logging.CRITICAL)
+
+    report = run(args)
+    if args.json:
+        print(json.dumps(report))
+    else:
+        print(f"heatmap          {report['channels']} channels on the flipper, busiest {report['hottest']}, walk's busiest {report['busiest']}")
+        print(f"wire             {report['packets']} packets in {report['seconds']:.1f} s, {report['packets_per_second']:.2f} per second, {report['bytes_per_second']:.1f} B/s, {report['line_share']:.2f}% of the line")
+        print(f"updates          {report['updates']} wifi updates, {report['updates'] / report['seconds']:.1f} per second with the drain")
+        print(f"line             {report['baud']} baud, noise {report['noise']}")
+
+    # the first packet goes out right away, then one an interval at most
+    if report['hottest'] != report['busiest'] or report['packets'] > report['seconds'] / pz.CHANNEL_STATS_INTERVAL + 1:
+        raise SystemExit(1)
+
+
+if __name__ == "__main__":
+    main()
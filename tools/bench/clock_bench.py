@@ -0,0 +1,183 @@
+"""
+Runs a host build of the flipagotchi app with its rtc off from and drifting against the pi's clock,
+and reports how well PwnZero works out the offset and drift from the clock probes and steps the pi's
+clock onto the flipper's
+
+The pi's clock is a virtual one the plugin reads and sets, the machine's own is never touched. Both
+it and the host app's rtc run off the monotonic clock, so how far apart they are at any moment is
+known exactly. The host app probes every `--period` ms instead of every minute so the drift shows
+within a short run, what the probes cost is reported for both
+
+Build the host app first with `make -C tools/hostsim`
+"""
+import argparse
+import json
+import logging
+import queue
+import tempfile
+import time
+from pathlib import Path
+
+from replay_bench import TOOLS_DIR, load_trace, percentile, pz
+from offload_bench import Session
+
+# the flipper's probe period once the fast ones are out, FLIPAGOTCHI_CLOCK_PERIOD_MS
+FLIPPER_PERIOD_MS = 60000
+# ACK carrying the CLOCK_SET code
+ACK_BYTES = 4
+# how far off the estimated offset and the flipper's own time may be, in ms
+BOUND_MS = 5
+# how far off the estimated drift may be, in ppm
+DRIFT_BOUND_PPM = 30
+
+
+class VirtualClock():
+    """
+    The pi's clock, the monotonic clock plus whatever it was stepped by
+    """
+
+    def __init__(self, base: float):
+        self.base = base
+
+    def at(self, monotonic: float) -> float:
+        return monotonic + self.base
+
+    def now(self) -> float:
+        return self.at(time.monotonic())
+
+    def set(self, t: float):
+        self.base += t - self.now()
+
+
+class Rtc():
+    """
+    The host app's rtc as hostsim runs it with --rtc-offset and --rtc-drift
+    """
+
+    def __init__(self, offset_ms: int, drift_ppm: float):
+        self.offset_ms = offset_ms
+        self.drift_ppm = drift_ppm
+
+    def at_ns(self, monotonic_ns: int) -> float:
+        """
+        :return: Its time in seconds
+        """
+        return (monotonic_ns + self.offset_ms * 1000000 + int(monotonic_ns * self.drift_ppm / 1e6)) / 1e9
+
+
+def run(args):
+    trace = load_trace(args.trace or TOOLS_DIR / "bench" / "traces" / "sample.jsonl")
+    pi = VirtualClock(time.time() - time.monotonic())
+    rtc = Rtc(round((pi.base + args.offset) * 1000), args.drift)
+    host_args = ["--rtc-offset", str(rtc.offset_ms), "--rtc-drift", str(args.drift), "--clock-period", str(args.period)]
+    lines = queue.Queue()
+    probes = []
+
+    def on_line(columns):
+        if columns[0] == "CLOCK":
+            lines.put(columns)
+
+    def setup(plugin):
+        plugin.clock_sync = pz.ClockSync(clock=pi.now, set_clock=pi.set)
+        on_clock = plugin._on_clock
+
+        def counting_on_clock(msg):
+            # the packet with its framing
+            probes.append(len(msg) + 2)
+            on_clock(msg)
+
+        plugin._on_clock = counting_on_clock
+
+    with tempfile.TemporaryDirectory() as sd:
+        session = Session(args, Path(sd), {'clock_sync': True, 'clock_step': args.step}, on_line, host_args, setup)
+        session.wait_connected(trace[0]['ui'], args.connect_timeout)
+        sync = session.plugin.clock_sync
+        time.sleep(args.seconds)
+
+        # how far the estimate is from the truth, and what is left to correct
+        offset_errors = []
+        flipper_errors = []
+        remaining = []
+        for _ in range(args.checks):
+            session.host.stdin.write("CLOCK\n")
+            session.host.stdin.flush()
+            columns = lines.get(timeout=args.timeout)
+            monotonic_ns = int(columns[1])
+            actual = rtc.at_ns(monotonic_ns) - pi.at(monotonic_ns / 1e9)
+            offset_errors.append(abs(sync.offset(pi.at(monotonic_ns / 1e9)) - actual) * 1000)
+            flipper_errors.append(abs(int(columns[2]) / 1000 - rtc.at_ns(monotonic_ns)) * 1000)
+            remaining.append(abs(actual) * 1000)
+            time.sleep(0.05)
+        flipper_probes = int(columns[4])
+        session.stop()
+
+    probe_bytes = sum(probes) / max(len(probes), 1) + ACK_BYTES
+    return {
+        'seconds': args.seconds,
+        'probes': len(probes),
+        'flipper_probes': flipper_probes,
+        'steps': sync.steps,
+        'offset_error_p50_ms': percentile(offset_errors, 50),
+        'offset_error_max_ms': max(offset_errors),
+        'flipper_error_max_ms': max(flipper_errors),
+        'remaining_max_ms': max(remaining),
+        'drift_ppm': args.drift,
+        'drift_estimate_ppm': None if sync.drift is None else sync.drift * 1e6,
+        'probe_bytes': probe_bytes,
+        'bytes_per_minute': probe_bytes * 60000 / FLIPPER_PERIOD_MS,
+        'bench_bytes_per_minute': probe_bytes * 60000 / args.period,
+        'step_ms': args.step * 1000,
+        'baud': args.baud,
+        'noise': args.noise,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default=str(TOOLS_DIR / "hostsim" / "build" / "flipagotchi_host"), help="host build of the flipper app")
+    parser.add_argument("--seconds", type=float, default=40, help="seconds to let the clocks sync")
+    parser.add_argument("--offset", type=float, default=3600.5, help="seconds the flipper's rtc is ahead of the pi's clock at the start")
+    parser.add_argument("--drift", type=float, default=200, help="parts per million the flipper's rtc runs faster than the pi's clock")
+    parser.add_argument("--period", type=int, default=2000, help="ms between the flipper's probes after the first few")
+    parser.add_argument("--step", type=float, default=pz.CLOCK_STEP, help="seconds off before PwnZero steps the pi's clock")
+    parser.add_argument("--checks", type=int, default=20, help="times to compare the clocks at the end")
+    parser.add_argument("--trace", help="ui trace to start the screen from")
+    parser.add_argument("--baud", type=int, default=115200, help="emulated baudrate")
+    parser.add_argument("--noise", type=float, default=0, help="probability per byte of a bit flip on the wire")
+    parser.add_argument("--seed", type=int, default=1, help="seed for the line noise")
+    parser.add_argument("--ack-timeout", type=float, default=0.2, help="seconds PwnZero waits for an ack")
+    parser.add_argument("--connect-timeout", type=float, default=10)
+    parser.add_argument("--timeout", type=float, default=2, help="seconds to wait for an answer")
+    parser.add_argument("--json", action="store_true", help="print the report as json")
+    parser.add_argument("--verbose", action="store_true", help="show PwnZero's logging")
+    args = parser.parse_args()
+    if args.seconds <= 0 or args.period <= 0:
+        parser.error("--seconds and --period have to be above 0")
+
+    logging.basicConfig(level=logging.INFO if args.verbose else logging.CRITICAL)
+
+    report = run(args)
+    if args.json:
+        print(json.dumps(report))
+    else:
+        drift = 'unknown' if report['drift_estimate_ppm'] is None else f"{report['drift_estimate_ppm']:+.1f} ppm"
+        print(f"offset           p50 {report['offset_error_p50_ms']:.2f} ms, max {report['offset_error_max_ms']:.2f} ms off the true offset, flipper's own time max {report['flipper_error_max_ms']:.2f} ms off its rtc")
+        print(f"pi clock         max {report['remaining_max_ms']:.2f} ms off the flipper's after {report['steps']} steps, stepped past {report['step_ms']:.0f} ms")
+        print(f"drift            {drift} estimated, {report['drift_ppm']:+.1f} ppm injected")
+        print(f"probes           {report['probes']} in {report['seconds']:.0f}s, {report['probe_bytes']:.0f} bytes each with the ack, {report['bytes_per_minute']:.1f} B/min at the flipper's period ({report['bench_bytes_per_minute']:.0f} B/min here)")
+        print(f"line             {report['baud']} baud, noise {report['noise']}")
+
+    if report['probes'] == 0 or report['steps'] == 0:
+        raise SystemExit("the pi's clock was never set")
+    # on a noisy line probes get lost, that is only reported
+    if args.noise == 0:
+        if not report['offset_error_max_ms'] < BOUND_MS or not report['flipper_error_max_ms'] < BOUND_MS:
+            raise SystemExit(f"clock estimate is over {BOUND_MS} ms off")
+        if not report['remaining_max_ms'] < report['step_ms'] + BOUND_MS:
+            raise SystemExit("the pi's clock was left further off than it steps at")
+        if report['drift_estimate_ppm'] is None or not abs(report['drift_estimate_ppm'] - args.drift) < DRIFT_BOUND_PPM:
+            raise SystemExit(f"drift estimate is over {DRIFT_BOUND_PPM} ppm off")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,174 @@
+"""
+Presses the control scene's buttons on a host build of the flipagotchi app with PwnZero on the other
+end, and reports how long the flipper takes to show a mode switch and to hear it was taken
+
+Each press switches to a mode other than the one shown, so every one goes out and comes back.
+`--trace` replays a ui trace alongside, so the acks have to get past the screen updates. The
+restarts, reboots and shutdowns PwnZero asks pwnagotchi for are collected by the stub package and
+compared with the presses
+
+Build the host app first with `make -C tools/hostsim`
+"""
+import argparse
+import json
+import logging
+import queue
+import random
+import tempfile
+import threading
+import time
+from pathlib import Path
+
+from replay_bench import TOOLS_DIR, load_trace, percentile, pz
+from offload_bench import Session, replay
+
+import pwnagotchi
+
+# the round trip from pressing to the pwnagotchi's ack is kept under this
+BOUND_MS = 100
+# the host app's mode names, to the view's name for the mode and the enum PwnagotchiMode value its
+# DRAW lines carry
+MODES = {'manual': ('MANU', 0), 'auto': ('AUTO', 1), 'ai': ('AI', 2)}
+
+
+class Controls():
+    """
+    Presses the host app's control commands and waits for their answers
+    """
+
+    def __init__(self, session, timeout):
+        self._session = session
+        self._timeout = timeout
+        self._lines = queue.Queue()
+
+    def on_line(self, columns):
+        if columns[0] == "CONTROL":
+            self._lines.put(columns)
+
+    def _send(self, command):
+        self._session.host.stdin.write(command + "\n")
+        self._session.host.stdin.flush()
+
+    def press(self, command):
+        """
+        :return: The CONTROL line that answered it
+        """
+        self._send(command)
+        try:
+            return self._lines.get(timeout=self._timeout)
+        except queue.Empty:
+            # a command that timed out is only reported when asked for
+            self._send("CONTROL")
+            return self._lines.get(timeout=self._timeout)
+
+
+def run(args):
+    trace = load_trace(args.trace or TOOLS_DIR / "bench" / "traces" / "sample.jsonl")
+    rng = random.Random(args.seed)
+
+    with tempfile.TemporaryDirectory() as sd:
+        controls = None
+
+        def on_line(columns):
+            if controls is not None:
+                controls.on_line(columns)
+
+        session = Session(args, Path(sd), {}, on_line)
+        controls = Controls(session, args.timeout)
+        session.wait_connected(trace[0]['ui'], args.connect_timeout)
+        plugin = session.plugin
+        screen = session.screen
+        pwnagotchi.calls.clear()
+        stop = threading.Event()
+        if args.trace:
+            threading.Thread(target=replay, args=(session, trace, args.speed, stop), daemon=True).start()
+
+        rtts = []
+        flipper_rtts = []
+        failed = 0
+        expected = []
+        current = pz._agent_mode(plugin.current_ui.get('mode'))
+        shown = 'manual' if current == 'MANU' else 'auto'
+        for _ in range(args.presses):
+            mode = rng.choice([name for name in MODES if name != shown])
+            ui_mode, enum_mode = MODES[mode]
+            # what the pwnagotchi is in doesn't change under the stub, only a switch between manual
+            # and auto restarts it
+            if pz._agent_mode(ui_mode) != current:
+                expected.append(('restart', pz._agent_mode(ui_mode)))
+            pressed = time.monotonic_ns()
+            screen.expect(pressed, {'mode': str(enum_mode)})
+            columns = controls.press(f"MODE {mode}")
+            if columns[2] != "acked":
+                failed += 1
+            else:
+                rtts.append((int(columns[1]) - pressed) / 1e6)
+                flipper_rtts.append(int(columns[4]))
+            shown = mode
+            time.sleep(args.interval)
+
+        # reboot and shutdown go out the same way, the stub keeps them from doing anything
+        for command in ("REBOOT", "SHUTDOWN"):
+            columns = controls.press(command)
+            failed += columns[2] != "acked"
+            # a command is refused while the last one is still being carried out
+            time.sleep(args.interval)
+        expected += [('reboot', current), ('shutdown', None)]
+
+        stop.set()
+        session.stop()
+
+    return {
+        'presses': args.presses,
+        'failed': failed,
+        'rtt_p50_ms': percentile(rtts, 50),
+        'rtt_p99_ms': percentile(rtts, 99),
+        'rtt_max_ms': max(rtts, default=float('nan')),
+        'flipper_p99_ms': percentile(flipper_rtts, 99),
+        'shown_p50_ms': percentile(screen.latencies, 50),
+        'shown_p99_ms': percentile(screen.latencies, 99),
+        'actions_match': pwnagotchi.calls == expected,
+        'baud': args.baud,
+        'noise': args.noise,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default=str(TOOLS_DIR / "hostsim" / "build" / "flipagotchi_host"), help="host build of the flipper app")
+    parser.add_argument("--presses", type=int, default=200, help="mode switches to press")
+    parser.add_argument("--interval", type=float, default=0.02, help="seconds between presses")
+    parser.add_argument("--trace", help="ui trace to replay alongside")
+    parser.add_argument("--speed", type=float, default=1, help="replay speed multiplier for the trace")
+    parser.add_argument("--baud", type=int, default=115200, help="emulated baudrate")
+    parser.add_argument("--noise", type=float, default=0, help="probability per byte of a bit flip on the wire")
+    parser.add_argument("--seed", type=int, default=1, help="seed for the presses and the line noise")
+    parser.add_argument("--ack-timeout", type=float, default=0.2, help="seconds PwnZero waits for an ack")
+    parser.add_argument("--connect-timeout", type=float, default=10)
+    parser.add_argument("--timeout", type=float, default=2, help="seconds to wait for an answer")
+    parser.add_argument("--json", action="store_true", help="print the report as json")
+    parser.add_argument("--verbose", action="store_true", help="show PwnZero's logging")
+    args = parser.parse_args()
+    if args.presses <= 0:
+        parser.error("--presses has to be above 0")
+
+    logging.basicConfig(level=logging.INFO if args.verbose else logging.CRITICAL)
+
+    report = run(args)
+    if args.json:
+        print(json.dumps(report))
+    else:
+        print(f"round trip       p50 {report['rtt_p50_ms']:.2f} ms, p99 {report['rtt_p99_ms']:.2f} ms, max {report['rtt_max_ms']:.2f} ms, p99 {report['flipper_p99_ms']} ms by the flipper's clock")
+        print(f"shown            p50 {report['shown_p50_ms']:.2f} ms, p99 {report['shown_p99_ms']:.2f} ms from press to the new mode on screen")
+        print(f"presses          {report['presses']} mode switches, {report['failed']} not acked, actions {'match' if report['actions_match'] else 'DO NOT MATCH'}")
+        print(f"line             {report['baud']} baud, noise {report['noise']}")
+
+    # on a noisy line commands and acks get lost, that is only reported
+    if args.noise == 0 and (report['failed'] or not report['actions_match']):
+        raise SystemExit(1)
+    if not report['rtt_p99_ms'] < BOUND_MS:
+        raise SystemExit(f"p99 round trip is over {BOUND_MS} ms")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,216 @@
+"""
+Fills a directory with made up captures and browses them through PwnZero from a host build of
+the flipagotchi app the way the handshake browser does, then reports how long opening the browser
+takes and what scrolling costs on the wire, next to sending the whole list up front
+
+The cursor goes down one entry at a time and back up again, every entry the host app shows is
+compared with the directory listing
+
+Build the host app first with `make -C tools/hostsim`
+"""
+import argparse
+import json
+import logging
+import os
+import queue
+import random
+import tempfile
+import time
+from pathlib import Path
+
+from replay_bench import TOOLS_DIR, load_trace, percentile, pz
+from offload_bench import Session
+
+# rows the browser shows at once, HANDSHAKE_LIST_ROWS in views/handshake_list.h
+ROWS = 5
+# a request still out goes again after FLIPAGOTCHI_HANDSHAKES_RETRY_MS, give it that and a bit
+RETRY = 1.1
+
+
+def make_captures(directory, count, seed):
+    """
+    :return: (bssid, timestamp, ssid) of each capture, newest first like the browser lists them
+    """
+    rng = random.Random(seed)
+    captures = []
+    for index in range(count):
+        mac = ''.join(f"{rng.randrange(256):02x}" for _ in range(6))
+        ssid = rng.choice([f"net-{index}", f"HomeNetwork_{index:04d}_5G", f"Cafe Free WiFi {index}"])
+        path = directory / f"{ssid}_{mac}.pcap"
+        path.write_bytes(b"")
+        timestamp = 1700000000 + index * 60
+        os.utime(path, (timestamp, timestamp))
+        bssid = ':'.join(mac[i:i + 2] for i in range(0, 12, 2))
+        captures.append((bssid, str(timestamp), pz._ascii(ssid)[:pz.AP_SSID_MAX_LEN]))
+    captures.reverse()
+    return captures
+
+
+class Browser():
+    """
+    Drives the host app's handshake commands and waits for the pages they ask for
+    """
+
+    def __init__(self, session, timeout):
+        self._session = session
+        self._timeout = timeout
+        self._lines = queue.Queue()
+        self.pages = []
+
+    def on_line(self, columns):
+        if columns[0] in ("HANDSHAKE", "HANDSHAKE_PAGE"):
+            self._lines.put(columns)
+
+    def _send(self, command):
+        self._session.host.stdin.write(command + "\n")
+        self._session.host.stdin.flush()
+
+    def _next(self, deadline):
+        """
+        :return: The next handshake line, None once deadline passed
+        """
+        try:
+            return self._lines.get(timeout=max(deadline - time.monotonic(), 0))
+        except queue.Empty:
+            return None
+
+    def wait_page(self, deadline):
+        """
+        :return: The total the page came with, None if none came in by deadline
+        """
+        while True:
+            columns = self._next(deadline)
+            if columns is None:
+                return None
+            if columns[0] == "HANDSHAKE_PAGE":
+                self.pages.append(int(columns[1]))
+                return int(columns[2])
+
+    def open(self):
+        """
+        :return: Milliseconds until the first page came in, the total it came with
+        """
+        start = time.monotonic_ns()
+        self._send("HANDSHAKES")
+        total = self.wait_page(time.monotonic() + self._timeout)
+        if total is None:
+            raise SystemExit("the first page never came in")
+        return (self.pages[-1] - start) / 1e6, total
+
+    def get(self, index):
+        """
+        :return: The entry as (bssid, timestamp, ssid) and the milliseconds it waited for its page,
+                 None if it was cached
+        """
+        deadline = time.monotonic() + self._timeout
+        start = time.monotonic_ns()
+        waited = None
+        while time.monotonic() < deadline:
+            self._send(f"HANDSHAKE {index}")
+            columns = self._next(deadline)
+            while columns is not None and columns[0] == "HANDSHAKE_PAGE":
+                # answers an earlier request that went out again
+                self.pages.append(int(columns[1]))
+                columns = self._next(deadline)
+            if columns is None:
+                break
+            if columns[2] != "-":
+                return tuple(columns[2:5]), waited
+            # the miss asked for the page, or one is still out and gets asked again once it is overdue
+            if self.wait_page(min(deadline, time.monotonic() + RETRY)) is not None:
+                waited = (self.pages[-1] - start) / 1e6
+        raise SystemExit(f"handshake {index} never came in")
+
+
+def run(args):
+    trace = load_trace(TOOLS_DIR / "bench" / "traces" / "sample.jsonl")
+
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp = Path(tmp)
+        sd = tmp / "sd"
+        captures_dir = tmp / "handshakes"
+        sd.mkdir()
+        captures_dir.mkdir()
+        captures = make_captures(captures_dir, args.captures, args.seed)
+
+        browser = None
+
+        def on_line(columns):
+            if browser is not None:
+                browser.on_line(columns)
+
+        session = Session(args, sd, {'handshakes_dir': str(captures_dir)}, on_line)
+        browser = Browser(session, args.timeout)
+        session.wait_connected(trace[0]['ui'], args.connect_timeout)
+        sent_before = session.plugin._flipper.bytes_sent
+
+        open_ms, total = browser.open()
+        shown = {}
+        waits = []
+        # down to the end of the scroll, then back to the top, rows below the cursor are on screen too
+        path = list(range(min(args.scroll, total))) + list(range(min(args.scroll, total) - 1, -1, -1))
+        for cursor in path:
+            for index in range(cursor, min(cursor + ROWS, total)):
+                entry, waited = browser.get(index)
+                shown[index] = entry
+                if waited is not None:
+                    waits.append(waited)
+
+        wire = session.plugin._flipper.bytes_sent - sent_before
+        session.stop()
+
+    mismatched = sum(entry != captures[index] for index, entry in shown.items())
+    entries = [pz._handshake_entry(f"{ssid}_{bssid.replace(':', '')}.pcap", int(timestamp)) for bssid, timestamp, ssid in captures]
+    # every record in as few packets as they fit, like the access point table goes out in full
+    full = sum(len(body) + 3 for body in pz._ap_bodies(entries))
+
+    return {
+        'captures': len(captures),
+        'total': total,
+        'shown': len(shown),
+        'mismatched': mismatched,
+        'open_ms': open_ms,
+        'page_p50_ms': percentile(waits, 50),
+        'page_p99_ms': percentile(waits, 99),
+        'pages': len(browser.pages),
+        'misses': len(waits),
+        'wire_bytes': wire,
+        'full_bytes': full,
+        'baud': args.baud,
+        'noise': args.noise,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default=str(TOOLS_DIR / "hostsim" / "build" / "flipagotchi_host"), help="host build of the flipper app")
+    parser.add_argument("--captures", type=int, default=2000, help="number of captures in the directory")
+    parser.add_argument("--scroll", type=int, default=40, help="entries to scroll down before going back up")
+    parser.add_argument("--baud", type=int, default=115200, help="emulated baudrate")
+    parser.add_argument("--noise", type=float, default=0, help="probability per byte of a bit flip on the wire")
+    parser.add_argument("--seed", type=int, default=1, help="seed for the line noise and the captures")
+    parser.add_argument("--ack-timeout", type=float, default=0.2, help="seconds PwnZero waits for an ack")
+    parser.add_argument("--connect-timeout", type=float, default=10)
+    parser.add_argument("--timeout", type=float, default=10, help="seconds to give a single entry")
+    parser.add_argument("--json", action="store_true", help="print the report as json")
+    parser.add_argument("--verbose", action="store_true", help="show PwnZero's logging")
+    args = parser.parse_args()
+
+    logging.basicConfig(level=logging.INFO if args.verbose else logging.CRITICAL)
+
+    report = run(args)
+    if args.json:
+        print(json.dumps(report))
+    else:
+        print(f"handshakes       {report['shown']} shown of {report['total']}, {report['mismatched']} differ from the directory")
+        print(f"open             {report['open_ms']:.2f} ms to the first page")
+        print(f"scrolling        {report['misses']} waits for a page, p50 {report['page_p50_ms']:.2f} ms, p99 {report['page_p99_ms']:.2f} ms, {report['pages']} pages in")
+        print(f"wire             {report['wire_bytes']} bytes, the whole list up front would be {report['full_bytes']}")
+        print(f"line             {report['baud']} baud, noise {report['noise']}")
+
+    if report['mismatched'] or report['total'] != report['captures']:
+        raise SystemExit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,245 @@
+"""
+Offloads generated capture files through PwnZero into a host build of the flipagotchi app and
+reports the throughput as a share of the line rate, optionally while replaying a ui trace so the
+cost of the transfer to screen latency shows
+
+With --interrupt the host app is stopped that many seconds in and started again on the same sd
+card, which shows how much of a cut short transfer has to go out again. Every file is compared
+byte for byte with what ended up on the sd card
+
+Build the host app first with `make -C tools/hostsim`
+"""
+import argparse
+import json
+import logging
+import os
+import pty
+import random
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import tty
+from pathlib import Path
+
+from replay_bench import TOOLS_DIR, CountingFlipper, Screen, TraceView, expected_screen, load_trace, percentile, pz
+
+OFFLOAD_DIR = Path("apps_data") / "flipagotchi" / "offload"
+
+
+class Session():
+    """
+    One run of the host app with PwnZero connected to it
+    """
+
+    def __init__(self, args, sd, options, other=None, host_args=(), setup=None, pass_fds=()):
+        """
+        :param: host_args: Further arguments to the host app
+        :param: setup: Called with the plugin before it is loaded
+        :param: pass_fds: Further fds the host app inherits, for the ones named in host_args
+        """
+        master, slave = pty.openpty()
+        tty.setraw(master)
+        tty.setraw(slave)
+
+        self.host = subprocess.Popen(
+            [args.host, "--fd", str(master), "--baud", str(args.baud), "--noise", str(args.noise), "--seed", str(args.seed), *host_args],
+            stdin=subprocess.PIPE,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.PIPE,
+            pass_fds=(master, *pass_fds),
+            encoding="utf-8",
+            errors="replace",
+            env=dict(os.environ, HOSTSIM_SD=str(sd)),
+        )
+        os.close(master)
+        self.screen = Screen(self.host.stdout, other)
+
+        self.plugin = pz.PwnZero()
+        self.plugin._flipper = CountingFlipper(port=os.ttyname(slave), baud=args.baud, timeout=args.ack_timeout)
+        # the host app's rtc is the machine's own clock, the plugin must never set that
+        self.plugin.options = dict({'clock_sync': False}, **options)
+        if setup is not None:
+            setup(self.plugin)
+        self.plugin.on_loaded()
+
+    def wait_connected(self, ui, timeout):
+        self.plugin.on_ui_update(TraceView(ui))
+        deadline = time.monotonic() + timeout
+        while not (self.plugin.connected and self.plugin.current_ui is not None):
+            if time.monotonic() > deadline:
+                raise SystemExit("flipper host never connected")
+            time.sleep(0.01)
+
+    def stop(self):
+        """
+        :return: The OFFLOAD totals of the host app
+        """
+        self.plugin.on_unload()
+        self.host.stdin.close()
+        self.host.wait(timeout=10)
+        host_errors = self.host.stderr.read()
+        self.host_errors = host_errors
+        if self.host.returncode != 0:
+            sys.stderr.write(host_errors)
+            raise SystemExit(f"flipper host exited with {self.host.returncode}")
+        for line in host_errors.splitlines():
+            if line.startswith("OFFLOAD\t"):
+                return [int(value) for value in line.split("\t")[1:]]
+        return [0, 0, 0, 0]
+
+
+def make_files(directory, count, size, seed):
+    rng = random.Random(seed)
+    files = {}
+    for index in range(count):
+        path = directory / f"capture_{index:02d}.pcap"
+        data = rng.randbytes(size)
+        path.write_bytes(data)
+        # the plugin sends the oldest first
+        os.utime(path, (index, index))
+        files[path] = data
+    return files
+
+
+def replay(session, trace, speed, stop):
+    start = time.monotonic()
+    t0 = trace[0]['t']
+    for entry in trace[1:]:
+        wait = start + (entry['t'] - t0) / speed - time.monotonic()
+        if wait > 0 and stop.wait(wait):
+            return
+        session.screen.expect(time.monotonic_ns(), expected_screen(entry['ui']))
+        session.plugin.on_ui_update(TraceView(entry['ui']))
+
+
+def offload(args, sd, options, trace, files, until, host_args=()):
+    """
+    Runs a session until every file is offloaded or until seconds have gone by
+
+    :param: host_args: Further arguments to the host app
+
+    :return: The session, the totals of the host app and how long the transfers took
+    """
+    session = Session(args, sd, options, host_args=host_args)
+    session.wait_connected(trace[0]['ui'], args.connect_timeout)
+
+    stop = threading.Event()
+    replayer = None
+    if args.trace is not None:
+        replayer = threading.Thread(target=replay, args=(session, trace, args.speed, stop), daemon=True)
+        replayer.start()
+
+    start = time.monotonic()
+    deadline = start + until
+    log = Path(options['offload_log'])
+    while time.monotonic() < deadline:
+        if log.exists() and len(log.read_text().splitlines()) >= len(files):
+            break
+        time.sleep(0.01)
+    seconds = time.monotonic() - start
+
+    stop.set()
+    if replayer is not None:
+        replayer.join()
+    totals = session.stop()
+    return session, totals, seconds
+
+
+def run(args):
+    trace = load_trace(args.trace or TOOLS_DIR / "bench" / "traces" / "sample.jsonl")
+
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp = Path(tmp)
+        sd = tmp / "sd"
+        captures = tmp / "handshakes"
+        sd.mkdir()
+        captures.mkdir()
+        files = make_files(captures, args.files, args.size, args.seed)
+        options = {
+            'offload': True,
+            'offload_dir': str(captures),
+            'offload_log': str(tmp / "offloaded"),
+        }
+
+        sessions = []
+        if args.interrupt is not None:
+            sessions.append(offload(args, sd, options, trace, files, args.interrupt))
+        sessions.append(offload(args, sd, options, trace, files, args.timeout))
+
+        stored = {}
+        for path in files:
+            target = sd / OFFLOAD_DIR / path.name
+            stored[path] = target.read_bytes() if target.exists() else None
+
+    payload = len(files) * args.size
+    # the wire bytes of the first session were spent on the file too
+    wire = sum(session.plugin._flipper.bytes_sent for session, _, _ in sessions)
+    seconds = sum(seconds for _, _, seconds in sessions)
+    totals = [sum(column) for column in zip(*(totals for _, totals, _ in sessions))]
+    results = [result for session, _, _ in sessions for result in session.plugin._offload.results]
+    latencies = [latency for session, _, _ in sessions for latency in session.screen.latencies]
+    line_rate = args.baud / 10
+
+    return {
+        'files': len(files),
+        'intact': sum(stored[path] == data for path, data in files.items()),
+        'bytes': payload,
+        'seconds': seconds,
+        'bytes_per_second': payload / seconds,
+        'line_rate': payload / seconds / line_rate * 100,
+        # the per transfer figure leaves out the opens and the gaps between files
+        'transfer_line_rate': sum(result['line_rate'] for result in results) / len(results) if results else 0,
+        'wire_overhead': wire / payload - 1,
+        'resent_bytes': totals[1] - payload if len(totals) > 1 else 0,
+        'crc_errors': totals[2] if len(totals) > 2 else 0,
+        'resends': totals[3] if len(totals) > 3 else 0,
+        'ui_p50_ms': percentile(latencies, 50),
+        'ui_p99_ms': percentile(latencies, 99),
+        'ui_updates': len(latencies) if args.trace is not None else None,
+        'baud': args.baud,
+        'noise': args.noise,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default=str(TOOLS_DIR / "hostsim" / "build" / "flipagotchi_host"), help="host build of the flipper app")
+    parser.add_argument("--files", type=int, default=4, help="number of files to offload")
+    parser.add_argument("--size", type=int, default=16384, help="bytes in each file")
+    parser.add_argument("--trace", default=None, help="ui trace to replay during the transfer")
+    parser.add_argument("--interrupt", type=float, default=None, help="restart the host app after this many seconds")
+    parser.add_argument("--baud", type=int, default=115200, help="emulated baudrate")
+    parser.add_argument("--noise", type=float, default=0, help="probability per byte of a bit flip on the wire")
+    parser.add_argument("--seed", type=int, default=1, help="seed for the line noise and the file contents")
+    parser.add_argument("--speed", type=float, default=10, help="replay speed multiplier")
+    parser.add_argument("--ack-timeout", type=float, default=0.2, help="seconds PwnZero waits for an ack")
+    parser.add_argument("--connect-timeout", type=float, default=10)
+    parser.add_argument("--timeout", type=float, default=120, help="seconds to give the transfers")
+    parser.add_argument("--json", action="store_true", help="print the report as json")
+    parser.add_argument("--verbose", action="store_true", help="show PwnZero's logging")
+    args = parser.parse_args()
+    if args.baud <= 0:
+        parser.error("the line rate needs a --baud above 0")
+
+    logging.basicConfig(level=logging.INFO if args.verbose else logging.CRITICAL)
+
+    report = run(args)
+    if args.json:
+        print(json.dumps(report))
+    else:
+        print(f"files            {report['intact']} of {report['files']} intact on the sd card")
+        print(f"throughput       {report['bytes_per_second']:.0f} B/s, {report['line_rate']:.1f}% of the line rate ({report['transfer_line_rate']:.1f}% while sending)")
+        print(f"wire overhead    {report['wire_overhead'] * 100:.1f}% over {report['bytes']} bytes in {report['seconds']:.2f} s")
+        print(f"resent           {report['resent_bytes']} bytes, {report['resends']} resends, {report['crc_errors']} crc errors")
+        if report['ui_updates'] is not None:
+            print(f"ui latency       p50 {report['ui_p50_ms']:.2f} ms, p99 {report['ui_p99_ms']:.2f} ms over {report['ui_updates']} updates")
+        print(f"line             {report['baud']} baud, noise {report['noise']}")
+
+    if report['intact'] != report['files']:
+        raise SystemExit(1)
+
+
+if __name__ == "__main__":
+    main()
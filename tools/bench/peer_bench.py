@@ -0,0 +1,172 @@
+"""
+Walks a made up crowd of pwnagotchis through PwnZero's peer hooks into a host build of the
+flipagotchi app and reports what keeping the flipper's peer table in sync costs on the wire, next
+to resending the whole table on every update
+
+Peers come and go, their signal drifts and they keep capturing handshakes. Once the walk is done
+the table the host app ends up with is compared with the one PwnZero kept
+
+Build the host app first with `make -C tools/hostsim`
+"""
+import argparse
+import json
+import logging
+import random
+import tempfile
+import time
+from datetime import datetime
+from pathlib import Path
+
+from replay_bench import TOOLS_DIR, TraceView, load_trace, pz
+from offload_bench import Session
+
+# the flipper's ages are whole seconds counted from when the record went out
+SEEN_SLACK = 2
+
+
+class FakePeer():
+    """
+    The parts of pwnagotchi's mesh Peer PwnZero reads
+    """
+
+    def __init__(self, rng, index):
+        self._identity = ''.join(f"{rng.randrange(256):02x}" for _ in range(32))
+        self._name = rng.choice([f"pwn{index}", f"gotchi_{index:03d}", f"friend-of-{index}"])
+        self._face = rng.choice([pz.faces.FRIEND, pz.faces.HAPPY, pz.faces.COOL, pz.faces.BORED, "(x_x)"])
+        self.pwnd = rng.randrange(500)
+        self.rssi = rng.randrange(-90, -30)
+        self.last_seen = datetime.now()
+
+    def identity(self):
+        return self._identity
+
+    def name(self):
+        return self._name
+
+    def face(self):
+        return self._face
+
+    def pwnd_total(self):
+        return self.pwnd
+
+
+def full_resend_bytes(peers, now):
+    # clearing the table, then every peer in as few packets as they fit
+    bodies = [pz._crc_body([])] + pz._ap_bodies([pz._encode_peer(key, peer, now) for key, peer in peers.items()])
+    return sum(len(body) + 3 for body in bodies)
+
+
+def flipper_table(host_errors):
+    table = []
+    for line in host_errors.splitlines():
+        if line.startswith("PEER\t"):
+            key, face, rssi, pwned, seen, name = (line.split("\t", 6)[1:] + [''])[:6]
+            table.append((key, [int(face), int(rssi), int(pwned), int(seen), name]))
+    return table
+
+
+def run(args):
+    trace = load_trace(TOOLS_DIR / "bench" / "traces" / "sample.jsonl")
+    rng = random.Random(args.seed)
+    crowd = [FakePeer(rng, index) for index in range(args.population)]
+
+    with tempfile.TemporaryDirectory() as sd:
+        session = Session(args, Path(sd), {})
+        session.wait_connected(trace[0]['ui'], args.connect_timeout)
+        plugin = session.plugin
+        # nothing but the peers changes, so they are all that goes out
+        plugin._channels = None
+        flipper = plugin._flipper
+        ui = TraceView(trace[0]['ui'])
+
+        bytes_before = flipper.bytes_sent
+        packets_before = flipper.packets_sent
+        full = 0
+        sizes = []
+        near = set()
+        for _ in range(args.updates):
+            for index, peer in enumerate(crowd):
+                if rng.random() < args.churn:
+                    if index in near:
+                        near.discard(index)
+                        plugin.on_peer_lost(None, peer)
+                    else:
+                        near.add(index)
+                        plugin.on_peer_detected(None, peer)
+                peer.rssi = max(-100, min(-20, peer.rssi + rng.randint(-3, 3)))
+                if index in near:
+                    peer.last_seen = datetime.now()
+                    if rng.random() < args.churn:
+                        peer.pwnd += 1
+            # the mesh changes the peers in place, the next ui update picks that up
+            plugin.on_ui_update(ui)
+            full += full_resend_bytes(plugin._peers, time.time())
+            sizes.append(len(plugin._peers))
+            time.sleep(args.interval)
+
+        deadline = time.monotonic() + args.drain_timeout
+        while (plugin.current_ui or {}).get('peer_table') is not plugin._peers and time.monotonic() < deadline:
+            time.sleep(0.01)
+        expected = plugin._peers
+        session.stop()
+        end = time.time()
+
+    table = flipper_table(session.host_errors)
+    rssis = [peer[1] for _, peer in table]
+    in_sync = len(table) == len(expected)
+    for key, (face, rssi, pwned, seen, name) in table:
+        want = expected.get(key)
+        in_sync &= want is not None and [face, rssi, pwned, name] == [want[0], want[1], want[2], want[4]]
+        in_sync &= want is not None and abs(seen - (end - want[3])) <= SEEN_SLACK
+    wire = flipper.bytes_sent - bytes_before
+    return {
+        'updates': args.updates,
+        'mean_peers': sum(sizes) / len(sizes),
+        'in_sync': in_sync,
+        'sorted': rssis == sorted(rssis, reverse=True),
+        'flipper_peers': len(table),
+        'bytes_per_update': wire / args.updates,
+        'full_bytes_per_update': full / args.updates,
+        'packets': flipper.packets_sent - packets_before,
+        'failed': flipper.packets_failed,
+        'baud': args.baud,
+        'noise': args.noise,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default=str(TOOLS_DIR / "hostsim" / "build" / "flipagotchi_host"), help="host build of the flipper app")
+    parser.add_argument("--population", type=int, default=20, help="pwnagotchis that can come into range")
+    parser.add_argument("--updates", type=int, default=100, help="ui updates to send")
+    parser.add_argument("--churn", type=float, default=0.05, help="chance per update of a peer coming or going")
+    parser.add_argument("--interval", type=float, default=0.05, help="seconds between ui updates")
+    parser.add_argument("--baud", type=int, default=115200, help="emulated baudrate")
+    parser.add_argument("--noise", type=float, default=0, help="probability per byte of a bit flip on the wire")
+    parser.add_argument("--seed", type=int, default=1, help="seed for the walk and the line noise")
+    parser.add_argument("--ack-timeout", type=float, default=0.2, help="seconds PwnZero waits for an ack")
+    parser.add_argument("--connect-timeout", type=float, default=10)
+    parser.add_argument("--drain-timeout", type=float, default=10)
+    parser.add_argument("--json", action="store_true", help="print the report as json")
+    parser.add_argument("--verbose", action="store_true", help="show PwnZero's logging")
+    args = parser.parse_args()
+    if args.updates <= 0:
+        parser.error("--updates has to be above 0")
+
+    logging.basicConfig(level=logging.INFO if args.verbose else logging.CRITICAL)
+
+    report = run(args)
+    if args.json:
+        print(json.dumps(report))
+    else:
+        print(f"table            {report['flipper_peers']} peers on the flipper, {'in sync' if report['in_sync'] else 'OUT OF SYNC'}, {'sorted' if report['sorted'] else 'NOT SORTED'}")
+        print(f"wire             {report['bytes_per_update']:.0f} B per update, {report['full_bytes_per_update']:.0f} B resending the whole table")
+        print(f"packets          {report['packets']} over {report['updates']} updates of {report['mean_peers']:.1f} peers, {report['failed']} failed")
+        print(f"line             {report['baud']} baud, noise {report['noise']}")
+
+    if not (report['in_sync'] and report['sorted']):
+        raise SystemExit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,295 @@
+"""
+Runs a host build of the flipagotchi app with idle mode on and reports what going idle saves and how
+fast the app wakes up again
+
+With no PwnZero on the wire the app probes for one, the SYNs it sends are counted while a key is
+kept pressed and again while it is left alone to go idle. Then a PwnZero connects and the app is
+left to go idle. Screen and wifi updates shouldn't wake it, a captured handshake should, and the
+time from PwnZero hearing of the capture to the app waking up is the wake latency
+
+Last the tick is moved ahead by more than an hour while the app is idle, the time it reports idle
+has to take all of it in
+
+There is no fuel gauge on the host, the current draw is only shown on a flipper
+
+Build the host app first with `make -C tools/hostsim`
+"""
+import argparse
+import copy
+import json
+import logging
+import os
+import pty
+import queue
+import subprocess
+import tempfile
+import threading
+import time
+import tty
+from pathlib import Path
+
+from replay_bench import TOOLS_DIR, TraceView, load_trace, percentile, pz
+from offload_bench import Session
+
+# flipper side cmd of the link probe
+CMD_SYN = 0x16
+# the idle probe rate has to be at most this share of the awake one
+PROBE_RATIO_BOUND = 0.5
+# how long a captured handshake may take to wake the app up, in ms
+WAKE_BOUND_MS = 500
+# idle stretch the tick is moved ahead by, past where ms in 32 bits times 1000 wraps
+LONG_IDLE_MS = 75 * 60 * 1000
+
+
+def count_probes(args, idle):
+    """
+    Runs the host app with nobody on the other end of the wire
+
+    :param idle: Leave the app alone to go idle, or keep pressing a key
+    :return: SYNs sent per minute once the backoff settled
+    """
+    master, slave = pty.openpty()
+    tty.setraw(master)
+    tty.setraw(slave)
+    with tempfile.TemporaryDirectory() as sd:
+        host = subprocess.Popen(
+            [args.host, "--fd", str(master), "--baud", str(args.baud), "--idle-after", str(args.idle_after)],
+            stdin=subprocess.PIPE,
+            stdout=subprocess.DEVNULL,
+            stderr=subprocess.DEVNULL,
+            pass_fds=(master,),
+            encoding="utf-8",
+            env=dict(os.environ, HOSTSIM_SD=sd),
+        )
+        os.close(master)
+
+        counting = threading.Event()
+        probes = [0]
+
+        def read():
+            previous = None
+            while True:
+                try:
+                    data = os.read(slave, 256)
+                except OSError:
+                    return
+                if not data:
+                    return
+                for byte in data:
+                    if previous == 0x02 and byte == CMD_SYN and counting.is_set():
+                        probes[0] += 1
+                    previous = byte
+
+        threading.Thread(target=read, daemon=True).start()
+        # past going idle and the first few fast probes
+        settle = args.idle_after + 1
+        start = time.monotonic()
+        while time.monotonic() - start < settle + args.window:
+            if time.monotonic() - start >= settle:
+                counting.set()
+            if not idle:
+                host.stdin.write("KEY\n")
+                host.stdin.flush()
+            time.sleep(0.25)
+        counting.clear()
+        host.stdin.close()
+        host.wait(timeout=10)
+        os.close(slave)
+    return probes[0] * 60 / args.window
+
+
+def wakes(args, trace):
+    """
+    :return: Ms from each captured handshake to the app waking up, None where it didn't, and how
+             many rounds of updates without one woke it anyway
+    """
+    idle = queue.Queue()
+
+    def on_line(columns):
+        if columns[0] == "IDLE":
+            idle.put((int(columns[1]), columns[2] == "1"))
+
+    def wait_idle(until):
+        while True:
+            try:
+                _, state = idle.get(timeout=max(0, until - time.monotonic()))
+            except queue.Empty:
+                return None
+            if state:
+                return True
+
+    latencies = []
+    false_wakes = 0
+    ui = copy.deepcopy(trace[0]['ui'])
+    access_points = [
+        {'mac': f"02:00:00:00:00:{index:02x}", 'channel': channel, 'sent': 0, 'received': 0}
+        for index, channel in enumerate([1, 6, 11])
+    ]
+    with tempfile.TemporaryDirectory() as sd:
+        session = Session(args, Path(sd), {}, on_line, host_args=["--idle-after", str(args.idle_after)])
+        session.wait_connected(ui, args.connect_timeout)
+        for index in range(args.wakes):
+            if not wait_idle(time.monotonic() + args.idle_after + args.connect_timeout):
+                raise SystemExit("the app never went idle")
+
+            # the screen and the channel heatmap move on, nothing is captured
+            for update in range(args.quiet_updates):
+                ui['status'] = f"quiet {index} {update}"
+                ui['uptime'] = f"00:{index:02d}:{update:02d}"
+                session.plugin.on_ui_update(TraceView(ui))
+                for ap in access_points:
+                    ap['sent'] += 4096
+                    ap['received'] += 8192
+                session.plugin.on_wifi_update(None, [dict(ap) for ap in access_points])
+                time.sleep(0.05)
+            # long enough for the last heatmap to go out, and for the capture's to go out right away
+            try:
+                _, state = idle.get(timeout=pz.CHANNEL_STATS_INTERVAL * 1.5)
+                false_wakes += not state
+            except queue.Empty:
+                pass
+            # a false wake-up leaves the app awake, let it go idle again
+            if false_wakes and not wait_idle(time.monotonic() + args.idle_after + args.connect_timeout):
+                raise SystemExit("the app never went idle")
+
+            sent = time.monotonic_ns()
+            session.plugin.on_handshake(None, "capture.pcap", access_points[index % len(access_points)], None)
+            try:
+                woke_ns, state = idle.get(timeout=args.connect_timeout)
+                latencies.append((woke_ns - sent) / 1e6 if not state else None)
+            except queue.Empty:
+                latencies.append(None)
+        session.stop()
+    return latencies, false_wakes
+
+
+def long_idle(args):
+    """
+    Lets the app go idle, moves the tick ahead by LONG_IDLE_MS and wakes it up
+
+    :return: Ms the app reports idle before and after waking up, None where it didn't answer
+    """
+    master, slave = pty.openpty()
+    tty.setraw(master)
+    tty.setraw(slave)
+    with tempfile.TemporaryDirectory() as sd:
+        host = subprocess.Popen(
+            [args.host, "--fd", str(master), "--baud", str(args.baud), "--idle-after", str(args.idle_after)],
+            stdin=subprocess.PIPE,
+            stdout=subprocess.PIPE,
+            stderr=subprocess.DEVNULL,
+            pass_fds=(master,),
+            encoding="utf-8",
+            env=dict(os.environ, HOSTSIM_SD=sd),
+        )
+        os.close(master)
+        lines = queue.Queue()
+
+        def read():
+            for line in host.stdout:
+                lines.put(line.rstrip("\n").split("\t"))
+
+        def wait_for(kind, until=None):
+            deadline = time.monotonic() + args.connect_timeout
+            while True:
+                try:
+                    columns = lines.get(timeout=max(0, deadline - time.monotonic()))
+                except queue.Empty:
+                    return None
+                if columns[0] == kind and (until is None or columns[2] == until):
+                    return columns
+
+        def command(line):
+            host.stdin.write(line + "\n")
+            host.stdin.flush()
+
+        threading.Thread(target=read, daemon=True).start()
+        idle_ms = [None, None]
+        if wait_for("IDLE", "1"):
+            command(f"SKIP {LONG_IDLE_MS}")
+            command("POWER")
+            power = wait_for("POWER")
+            idle_ms[0] = int(power[2]) if power else None
+            command("KEY")
+            if wait_for("IDLE", "0"):
+                command("POWER")
+                power = wait_for("POWER")
+                idle_ms[1] = int(power[2]) if power else None
+        host.stdin.close()
+        host.wait(timeout=10)
+        os.close(slave)
+    return idle_ms
+
+
+def run(args):
+    trace = load_trace(args.trace or TOOLS_DIR / "bench" / "traces" / "sample.jsonl")
+    awake = count_probes(args, False)
+    idle = count_probes(args, True)
+    latencies, false_wakes = wakes(args, trace)
+    idle_ms, woke_idle_ms = long_idle(args)
+    woke = [latency for latency in latencies if latency is not None]
+    return {
+        'awake_probes_per_minute': awake,
+        'idle_probes_per_minute': idle,
+        'wakes': len(latencies),
+        'woke': len(woke),
+        'wake_p50_ms': percentile(woke, 50),
+        'wake_max_ms': max(woke) if woke else None,
+        'false_wakes': false_wakes,
+        'long_idle_ms': LONG_IDLE_MS,
+        'idle_ms': idle_ms,
+        'woke_idle_ms': woke_idle_ms,
+        'idle_after': args.idle_after,
+        'baud': args.baud,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default=str(TOOLS_DIR / "hostsim" / "build" / "flipagotchi_host"), help="host build of the flipper app")
+    parser.add_argument("--idle-after", type=int, default=1, help="seconds without activity before the app goes idle")
+    parser.add_argument("--window", type=float, default=30, help="seconds to count probes over, awake and idle")
+    parser.add_argument("--wakes", type=int, default=5, help="captured handshakes to wake the app up with")
+    parser.add_argument("--quiet-updates", type=int, default=5, help="screen and wifi updates before each")
+    parser.add_argument("--trace", default=None, help="ui trace to take the first screen from")
+    parser.add_argument("--baud", type=int, default=115200, help="emulated baudrate of the uart")
+    parser.add_argument("--ack-timeout", type=float, default=0.2, help="seconds PwnZero waits for an ack")
+    parser.add_argument("--connect-timeout", type=float, default=10)
+    parser.add_argument("--json", action="store_true", help="print the report as json")
+    parser.add_argument("--verbose", action="store_true", help="show PwnZero's logging")
+    args = parser.parse_args()
+    if args.idle_after <= 0:
+        parser.error("the app needs an --idle-after above 0 to go idle")
+    # the wire noise the other benches take, this one runs on a clean line
+    args.noise = 0
+    args.seed = 1
+
+    logging.basicConfig(level=logging.INFO if args.verbose else logging.CRITICAL)
+
+    report = run(args)
+    if args.json:
+        print(json.dumps(report))
+    else:
+        print(f"probes           {report['awake_probes_per_minute']:.1f}/min awake, {report['idle_probes_per_minute']:.1f}/min idle")
+        if report['woke']:
+            print(f"wake             {report['woke']} of {report['wakes']} handshakes woke the app, p50 {report['wake_p50_ms']:.1f} ms, max {report['wake_max_ms']:.1f} ms")
+        else:
+            print(f"wake             none of {report['wakes']} handshakes woke the app")
+        print(f"false wakes      {report['false_wakes']}")
+        print(f"long idle        {report['idle_ms']} ms idle, {report['woke_idle_ms']} ms after waking, {report['long_idle_ms']} ms skipped")
+        print(f"idle after       {report['idle_after']} s at {report['baud']} baud")
+
+    if report['idle_probes_per_minute'] > report['awake_probes_per_minute'] * PROBE_RATIO_BOUND:
+        raise SystemExit("going idle didn't slow the probes down")
+    if report['woke'] != report['wakes'] or report['wake_max_ms'] > WAKE_BOUND_MS:
+        raise SystemExit(f"a captured handshake didn't wake the app within {WAKE_BOUND_MS} ms")
+    if report['false_wakes']:
+        raise SystemExit("updates without a captured handshake woke the app")
+    # what really went by is a few seconds at most on top of the skip
+    for idle_ms in (report['idle_ms'], report['woke_idle_ms']):
+        if idle_ms is None or not LONG_IDLE_MS <= idle_ms < LONG_IDLE_MS + args.connect_timeout * 1000:
+            raise SystemExit("an idle stretch over an hour wasn't counted whole")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,294 @@
+"""
+Replays recorded pwnagotchi ui traces through PwnZero into a host build of the flipagotchi app
+and reports how long it takes for each update to reach the flipper's screen
+
+The two ends talk over a pty pair, the host build paces bytes at the emulated baud and can
+flip bits on the wire to simulate a noisy line. Traces are json lines of {"t": seconds, "ui": {...}}
+as written by PwnZero's trace_path option
+
+Build the host app first with `make -C tools/hostsim`
+"""
+import argparse
+import collections
+import json
+import logging
+import os
+import pty
+import statistics
+import subprocess
+import sys
+import threading
+import time
+import tty
+from pathlib import Path
+
+TOOLS_DIR = Path(__file__).resolve().parent.parent
+REPO_DIR = TOOLS_DIR.parent
+
+sys.path.insert(0, str(TOOLS_DIR / "bench" / "stubs"))
+sys.path.insert(0, str(REPO_DIR / "pwnzero"))
+
+import PwnZero as pz
+import pwnagotchi.ui.faces as faces
+
+# flipper side enum PwnagotchiMode
+FLIPPER_MODES = {'MANU': 0, 'AUTO': 1, 'AI': 2}
+
+FACES = {getattr(faces, face.name): face.value for face in pz.PwnFace}
+
+# the flipper steps animations by itself, any frame of one is on screen as far as we can tell
+ANIMATION_FRAMES = {
+    animation: {str(pz.PwnFace[frame].value) for frame in frames}
+    for animation, frames, _ in pz.FACE_ANIMATIONS
+}
+
+
+def expected_screen(ui):
+    """
+    What the flipper should show for a ui snapshot, keyed like the DRAW columns
+    Only fields PwnZero actually sends are included, a set holds every value that counts as shown
+    """
+    expected = {}
+    animation = pz._face_animation(ui.get('face'))
+    if animation is not None:
+        expected['face'] = ANIMATION_FRAMES[animation[0]]
+    elif ui.get('face') in FACES:
+        expected['face'] = str(FACES[ui['face']])
+    if ui.get('mode') in FLIPPER_MODES:
+        expected['mode'] = str(FLIPPER_MODES[ui['mode']])
+    if ui.get('name') is not None:
+        expected['hostname'] = ui['name'].replace(">", "")[:10]
+    if ui.get('channel') is not None:
+        expected['channel'] = ui['channel'][:3]
+    if ui.get('uptime') is not None:
+        expected['uptime'] = ":".join(part.zfill(2) for part in ui['uptime'].split(':'))
+    if ui.get('status') is not None:
+        expected['status'] = ui['status'][:100]
+    return expected
+
+
+class TraceView(dict):
+    """
+    Stands in for the pwnagotchi view passed to on_ui_update, a trace snapshot without plugin elements
+    """
+    _state = {}
+
+
+DRAW_COLUMNS = ['t', 'face', 'mode', 'hostname', 'channel', 'aps', 'uptime', 'handshakes', 'status']
+
+
+class CountingFlipper(pz.Flipper):
+    """
+    Flipper that keeps wire statistics for the report
+    """
+
+    def __init__(self, *args, **kwargs):
+        super().__init__(*args, **kwargs)
+        self.bytes_sent = 0
+        self.packets_sent = 0
+        self.packets_failed = 0
+        # bytes and packets by command
+        self.command_bytes = collections.Counter()
+        self.command_packets = collections.Counter()
+
+    def _send_bytes(self, cmd, body):
+        self.bytes_sent += len(body) + 3
+        self.packets_sent += 1
+        self.command_bytes[cmd] += len(body) + 3
+        self.command_packets[cmd] += 1
+        try:
+            return super()._send_bytes(cmd, body)
+        except pz.PwnZeroSerialException:
+            self.packets_failed += 1
+            raise
+
+
+class Screen():
+    """
+    Follows the host app's redraws and matches them against the updates we sent, any other line
+    goes to other
+    """
+
+    def __init__(self, stream, other=None):
+        self._stream = stream
+        self._other = other
+        self._lock = threading.Lock()
+        self._pending = []
+        self.latencies = []
+        self.superseded = 0
+        self.draws = 0
+        self.first_draw = threading.Event()
+        threading.Thread(target=self._read, daemon=True).start()
+
+    def expect(self, sent_ns, expected):
+        with self._lock:
+            self._pending.append((sent_ns, expected))
+
+    def outstanding(self):
+        with self._lock:
+            return len(self._pending)
+
+    def _read(self):
+        for line in self._stream:
+            columns = line.rstrip("\n").split("\t")
+            if columns[0] != "DRAW" or len(columns) != len(DRAW_COLUMNS) + 1:
+                if self._other is not None:
+                    self._other(columns)
+                continue
+            draw = dict(zip(DRAW_COLUMNS, columns[1:]))
+            self.draws += 1
+            self.first_draw.set()
+            self._match(int(draw['t']), draw)
+
+    def _match(self, draw_ns, draw):
+        with self._lock:
+            # the newest update fully on screen wins, anything older never got its own frame
+            for index in range(len(self._pending) - 1, -1, -1):
+                sent_ns, expected = self._pending[index]
+                if all(draw.get(key) in value if isinstance(value, set) else draw.get(key) == value
+                       for key, value in expected.items()):
+                    self.latencies.append((draw_ns - sent_ns) / 1e6)
+                    self.superseded += index
+                    del self._pending[:index + 1]
+                    return
+
+
+def percentile(values, pct):
+    if not values:
+        return float('nan')
+    ordered = sorted(values)
+    index = min(len(ordered) - 1, max(0, round(pct / 100 * len(ordered)) - 1))
+    return ordered[index]
+
+
+def load_trace(path):
+    with open(path) as trace:
+        return [json.loads(line) for line in trace if line.strip()]
+
+
+def run(args):
+    master, slave = pty.openpty()
+    tty.setraw(master)
+    tty.setraw(slave)
+
+    host = subprocess.Popen(
+        [args.host, "--fd", str(master), "--baud", str(args.baud), "--noise", str(args.noise), "--seed", str(args.seed)],
+        stdin=subprocess.PIPE,
+        stdout=subprocess.PIPE,
+        stderr=subprocess.PIPE,
+        pass_fds=(master,),
+        encoding="utf-8",
+        errors="replace",
+    )
+    os.close(master)
+    screen = Screen(host.stdout)
+
+    plugin = pz.PwnZero()
+    plugin._flipper = CountingFlipper(port=os.ttyname(slave), baud=args.baud, timeout=args.ack_timeout)
+    # the host app's rtc is the machine's own clock, the plugin must never set that
+    plugin.options = {'clock_sync': False}
+
+    trace = load_trace(args.trace)
+    plugin.on_loaded()
+
+    # get through the handshake and initial full resync before timing anything
+    plugin.on_ui_update(TraceView(trace[0]['ui']))
+    deadline = time.monotonic() + args.connect_timeout
+    while not (plugin.connected and plugin.current_ui is not None):
+        if time.monotonic() > deadline:
+            raise SystemExit("flipper host never connected")
+        time.sleep(0.01)
+
+    bytes_before = plugin._flipper.bytes_sent
+    sent_before = plugin._flipper.packets_sent
+    failed_before = plugin._flipper.packets_failed
+
+    start = time.monotonic()
+    t0 = trace[0]['t']
+    for entry in trace[1:]:
+        wait = start + (entry['t'] - t0) / args.speed - time.monotonic()
+        if wait > 0:
+            time.sleep(wait)
+        screen.expect(time.monotonic_ns(), expected_screen(entry['ui']))
+        plugin.on_ui_update(TraceView(entry['ui']))
+
+    # let the last updates land
+    deadline = time.monotonic() + args.drain_timeout
+    while screen.outstanding() and time.monotonic() < deadline:
+        time.sleep(0.01)
+
+    plugin.on_unload()
+    host.stdin.close()
+    host.wait(timeout=10)
+    corrupted = 0
+    dispatch = [0, 0, 0]
+    host_errors = host.stderr.read()
+    for line in host_errors.splitlines():
+        if line.startswith("CORRUPTED\t"):
+            corrupted = int(line.split("\t")[1])
+        elif line.startswith("DISPATCH\t"):
+            dispatch = [int(value) for value in line.split("\t")[1:]]
+    if host.returncode != 0:
+        sys.stderr.write(host_errors)
+        raise SystemExit(f"flipper host exited with {host.returncode}")
+
+    updates = len(trace) - 1
+    packets = plugin._flipper.packets_sent - sent_before
+    failed = plugin._flipper.packets_failed - failed_before
+    return {
+        'updates': updates,
+        'delivered': len(screen.latencies),
+        'superseded': screen.superseded,
+        'lost': screen.outstanding(),
+        'p50_ms': percentile(screen.latencies, 50),
+        'p99_ms': percentile(screen.latencies, 99),
+        'max_ms': max(screen.latencies) if screen.latencies else float('nan'),
+        'bytes_per_update': (plugin._flipper.bytes_sent - bytes_before) / updates,
+        'packets': packets,
+        'retransmit_rate': failed / packets if packets else 0,
+        'corrupted_bytes': corrupted,
+        'dispatch_wakeups': dispatch[0],
+        # wakeups that only got part of a packet land in the first bucket
+        'dispatch_partial_wakeups': dispatch[3] if len(dispatch) > 3 else 0,
+        'dispatch_mean_batch': dispatch[1] / (dispatch[0] - dispatch[3]) if len(dispatch) > 3 and dispatch[0] > dispatch[3] else 0,
+        'dispatch_max_batch': dispatch[2],
+        'dispatch_histogram': dispatch[3:],
+        'baud': args.baud,
+        'noise': args.noise,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--trace", default=str(TOOLS_DIR / "bench" / "traces" / "sample.jsonl"), help="ui trace to replay")
+    parser.add_argument("--host", default=str(TOOLS_DIR / "hostsim" / "build" / "flipagotchi_host"), help="host build of the flipper app")
+    parser.add_argument("--baud", type=int, default=115200, help="emulated baudrate")
+    parser.add_argument("--noise", type=float, default=0, help="probability per byte of a bit flip on the wire")
+    parser.add_argument("--seed", type=int, default=1, help="seed for the line noise")
+    parser.add_argument("--speed", type=float, default=10, help="replay speed multiplier")
+    parser.add_argument("--ack-timeout", type=float, default=0.2, help="seconds PwnZero waits for an ack")
+    parser.add_argument("--connect-timeout", type=float, default=10)
+    parser.add_argument("--drain-timeout", type=float, default=5)
+    parser.add_argument("--json", action="store_true", help="print the report as json")
+    parser.add_argument("--verbose", action="store_true", help="show PwnZero's logging")
+    args = parser.parse_args()
+
+    logging.basicConfig(level=logging.INFO if args.verbose else logging.CRITICAL)
+
+    report = run(args)
+    if args.json:
+        print(json.dumps(report))
+        return
+
+    print(f"updates          {report['updates']} ({report['delivered']} drawn, {report['superseded']} superseded, {report['lost']} lost)")
+    print(f"latency p50      {report['p50_ms']:.2f} ms")
+    print(f"latency p99      {report['p99_ms']:.2f} ms")
+    print(f"latency max      {report['max_ms']:.2f} ms")
+    print(f"bytes per update {report['bytes_per_update']:.1f}")
+    print(f"retransmit rate  {report['retransmit_rate'] * 100:.2f} % of {report['packets']} packets")
+    print(f"dispatch         {report['dispatch_mean_batch']:.2f} messages per wakeup, max {report['dispatch_max_batch']}, {report['dispatch_partial_wakeups']} of {report['dispatch_wakeups']} wakeups on partial packets")
+    print(f"line             {report['baud']} baud, noise {report['noise']} ({report['corrupted_bytes']} bytes corrupted)")
+
+
+if __name__ == "__main__":
+    main()
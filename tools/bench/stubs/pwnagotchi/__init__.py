@@ -0,0 +1,16 @@
+# Minimal stand-in for the pwnagotchi package so PwnZero.py can be imported on a host
+
+# restarts, reboots and shutdowns asked for, as (name, mode), instead of doing them
+calls = []
+
+
+def restart(mode):
+    calls.append(('restart', mode))
+
+
+def reboot(mode=None):
+    calls.append(('reboot', mode))
+
+
+def shutdown():
+    calls.append(('shutdown', None))
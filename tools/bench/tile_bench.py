@@ -0,0 +1,220 @@
+"""
+Measures the tiles render mode: bytes per frame and the frame rate the link can keep up with
+
+Every snapshot of a ui trace is rendered roughly the way the pwnagotchi lays out a 250x122 display,
+downscaled with PwnZero's own _framebuffer and diffed into tile packets with _tile_packets. The
+offline part of the report is the wire cost of those frames, the live part pushes them one at a
+time through PwnZero into a host build of the flipper app at each baudrate and times how long
+each takes to show up whole on the flipper's screen.
+
+Needs Pillow. Build the host app first with `make -C tools/hostsim`
+"""
+import argparse
+import json
+import logging
+import os
+import pty
+import statistics
+import subprocess
+import sys
+import threading
+import time
+import tty
+
+from PIL import Image, ImageDraw, ImageFont
+
+from replay_bench import TOOLS_DIR, CountingFlipper, load_trace, percentile, pz
+
+# size of the pwnagotchi's default waveshare display
+PWNAGOTCHI_WIDTH = 250
+PWNAGOTCHI_HEIGHT = 122
+
+# STX, command, ETX around every body
+PACKET_OVERHEAD = 3
+
+
+def render_ui(ui):
+    """
+    Draws a ui snapshot black on white, close enough to the pwnagotchi's layout for the byte counts
+    """
+    small = ImageFont.load_default(size=10)
+    face = ImageFont.load_default(size=30)
+    image = Image.new('1', (PWNAGOTCHI_WIDTH, PWNAGOTCHI_HEIGHT), 255)
+    draw = ImageDraw.Draw(image)
+
+    draw.text((0, 0), f"CH {ui.get('channel') or ''}", font=small, fill=0)
+    draw.text((28, 0), f"APS {ui.get('aps') or ''}", font=small, fill=0)
+    draw.text((185, 0), f"UP {ui.get('uptime') or ''}", font=small, fill=0)
+    draw.line((0, 14, PWNAGOTCHI_WIDTH, 14), fill=0)
+    draw.text((5, 20), ui.get('name') or '', font=small, fill=0)
+    draw.text((0, 40), ui.get('face') or '', font=face, fill=0)
+
+    # the status wraps at the right of the face
+    words = (ui.get('status') or '').split()
+    line = ''
+    y = 20
+    for word in words:
+        if draw.textlength(f"{line} {word}", font=small) > PWNAGOTCHI_WIDTH - 125 and line:
+            draw.text((125, y), line, font=small, fill=0)
+            y += 12
+            line = word
+        else:
+            line = f"{line} {word}".strip()
+    draw.text((125, y), line, font=small, fill=0)
+
+    draw.line((0, 108, PWNAGOTCHI_WIDTH, 108), fill=0)
+    draw.text((0, 109), f"PWND {ui.get('shakes') or ''}", font=small, fill=0)
+    draw.text((222, 109), ui.get('mode') or '', font=small, fill=0)
+    return image
+
+
+def wire_bytes(packets):
+    return sum(len(body) + PACKET_OVERHEAD for body in packets)
+
+
+def frame_costs(frames):
+    """
+    :return: (bytes to send each frame over the one before it, packets per frame, bytes of a full frame)
+    """
+    deltas = []
+    packets = []
+    for previous, frame in zip(frames, frames[1:]):
+        bodies = pz._tile_packets(previous, frame)
+        deltas.append(wire_bytes(bodies))
+        packets.append(len(bodies))
+    full = statistics.mean(wire_bytes(pz._tile_packets(None, frame)) for frame in frames)
+    return deltas, packets, full
+
+
+class FrameScreen():
+    """
+    Follows the host app's FRAME lines, waiters are woken when a given framebuffer is on screen
+    """
+
+    def __init__(self, stream):
+        self._stream = stream
+        self._cond = threading.Condition()
+        self._shown = None
+        threading.Thread(target=self._read, daemon=True).start()
+
+    def _read(self):
+        for line in self._stream:
+            columns = line.rstrip("\n").split("\t")
+            if columns[0] != "FRAME" or len(columns) != 3:
+                continue
+            with self._cond:
+                self._shown = columns[2]
+                self._cond.notify_all()
+
+    def wait_for(self, framebuffer: bytes, timeout: float) -> bool:
+        expected = framebuffer.hex()
+        with self._cond:
+            return self._cond.wait_for(lambda: self._shown == expected, timeout)
+
+
+def run_live(args, frames, baud):
+    master, slave = pty.openpty()
+    tty.setraw(master)
+    tty.setraw(slave)
+
+    host = subprocess.Popen(
+        [args.host, "--fd", str(master), "--baud", str(baud)],
+        stdin=subprocess.PIPE,
+        stdout=subprocess.PIPE,
+        stderr=subprocess.PIPE,
+        pass_fds=(master,),
+        encoding="utf-8",
+        errors="replace",
+    )
+    os.close(master)
+    screen = FrameScreen(host.stdout)
+
+    plugin = pz.PwnZero()
+    plugin._flipper = CountingFlipper(port=os.ttyname(slave), baud=baud, timeout=args.ack_timeout)
+    plugin.options = {'render': 'tiles', 'clock_sync': False}
+    plugin.on_loaded()
+
+    # the first frame goes out as a full frame once connected, time the deltas after it
+    plugin._mailbox.put_latest({'framebuffer': frames[0]})
+    if not screen.wait_for(frames[0], args.connect_timeout):
+        raise SystemExit("flipper host never showed the first frame")
+
+    bytes_before = plugin._flipper.bytes_sent
+    frame_ms = []
+    missed = 0
+    start = time.monotonic()
+    for frame in frames[1:]:
+        sent = time.monotonic()
+        plugin._mailbox.put_latest({'framebuffer': frame})
+        if screen.wait_for(frame, args.frame_timeout):
+            frame_ms.append((time.monotonic() - sent) * 1e3)
+        else:
+            missed += 1
+    elapsed = time.monotonic() - start
+
+    plugin.on_unload()
+    host.stdin.close()
+    host.wait(timeout=10)
+    if host.returncode != 0:
+        sys.stderr.write(host.stderr.read())
+        raise SystemExit(f"flipper host exited with {host.returncode}")
+
+    return {
+        'baud': baud,
+        'fps': len(frame_ms) / elapsed,
+        'line_fps': baud / 10 / ((plugin._flipper.bytes_sent - bytes_before) / (len(frames) - 1)),
+        'p50_ms': percentile(frame_ms, 50),
+        'p99_ms': percentile(frame_ms, 99),
+        'missed': missed,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--trace", default=str(TOOLS_DIR / "bench" / "traces" / "sample.jsonl"), help="ui trace to render frames from")
+    parser.add_argument("--host", default=str(TOOLS_DIR / "hostsim" / "build" / "flipagotchi_host"), help="host build of the flipper app")
+    parser.add_argument("--bauds", default="115200,230400,460800,921600", help="comma separated emulated baudrates")
+    parser.add_argument("--offline", action="store_true", help="only report the byte counts, don't run the host")
+    parser.add_argument("--ack-timeout", type=float, default=0.5, help="seconds PwnZero waits for an ack")
+    parser.add_argument("--connect-timeout", type=float, default=10)
+    parser.add_argument("--frame-timeout", type=float, default=2, help="seconds to wait for a frame to show")
+    parser.add_argument("--json", action="store_true", help="print the report as json")
+    parser.add_argument("--verbose", action="store_true", help="show PwnZero's logging")
+    args = parser.parse_args()
+
+    logging.basicConfig(level=logging.INFO if args.verbose else logging.CRITICAL)
+
+    rendered = [pz._framebuffer(render_ui(entry['ui'])) for entry in load_trace(args.trace)]
+    # a snapshot that renders the same as the one before costs nothing, leave it out of the rates
+    frames = [frame for index, frame in enumerate(rendered) if index == 0 or frame != rendered[index - 1]]
+    deltas, packets, full = frame_costs(frames)
+    report = {
+        'frames': len(frames),
+        'full_frame_bytes': full,
+        'raw_frame_bytes': len(frames[0]),
+        'delta_mean_bytes': statistics.mean(deltas),
+        'delta_p50_bytes': percentile(deltas, 50),
+        'delta_max_bytes': max(deltas),
+        'packets_per_frame': statistics.mean(packets),
+        'links': [],
+    }
+    if not args.offline:
+        for baud in (int(baud) for baud in args.bauds.split(",")):
+            report['links'].append(run_live(args, frames, baud))
+
+    if args.json:
+        print(json.dumps(report, indent=2))
+        return
+
+    print(f"frames           {report['frames']} distinct from {args.trace}")
+    print(f"full frame       {report['full_frame_bytes']:.0f} bytes on the wire, {report['raw_frame_bytes']} raw")
+    print(f"delta frame      {report['delta_mean_bytes']:.1f} bytes mean, p50 {report['delta_p50_bytes']}, max {report['delta_max_bytes']}")
+    print(f"packets          {report['packets_per_frame']:.2f} per delta frame")
+    for link in report['links']:
+        print(
+            f"{link['baud']:>7} baud     {link['fps']:.1f} fps shown ({link['line_fps']:.1f} line bound), "
+            f"frame p50 {link['p50_ms']:.2f} ms, p99 {link['p99_ms']:.2f} ms, {link['missed']} missed")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,167 @@
+"""
+Runs a host build of the flipagotchi app over each of its transports and reports the offload
+throughput on each, then switches transports under a connected PwnZero like the settings scene does
+and reports how long the link takes to come back
+
+Every transport ends up on the same pty in the host build. The uarts are paced at `--baud` like the
+real wire, usb and the pty go as fast as the pty does, which is what usb gets close to on a flipper
+
+Build the host app first with `make -C tools/hostsim`
+"""
+import argparse
+import copy
+import json
+import logging
+import queue
+import tempfile
+import time
+from pathlib import Path
+
+from replay_bench import TOOLS_DIR, TraceView, expected_screen, load_trace, percentile
+from offload_bench import Session, make_files, offload
+
+TRANSPORTS = ["lpuart", "usart", "usb", "pty"]
+# no line rate of their own, PwnZero still paces the offload at its baud option
+UNPACED = ["usb", "pty"]
+# how long a switch may take to connect again, in seconds
+RELINK_BOUND = 5
+
+
+def throughput(args, trace, transport):
+    """
+    :return: Bytes per second offloaded over the transport
+    """
+    if transport in UNPACED:
+        args = copy.copy(args)
+        args.baud = args.usb_baud
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp = Path(tmp)
+        sd = tmp / "sd"
+        captures = tmp / "handshakes"
+        sd.mkdir()
+        captures.mkdir()
+        files = make_files(captures, args.files, args.size, args.seed)
+        options = {
+            'offload': True,
+            'offload_dir': str(captures),
+            'offload_log': str(tmp / "offloaded"),
+        }
+        _, _, seconds = offload(args, sd, options, trace, files, args.timeout, ["--transport", transport])
+        log = Path(options['offload_log'])
+        done = len(log.read_text().splitlines()) if log.exists() else 0
+    return {
+        'transport': transport,
+        'baud': args.baud,
+        'intact': done == len(files),
+        'bytes_per_second': len(files) * args.size / seconds,
+    }
+
+
+def switches(args, trace):
+    """
+    :return: Seconds each switch took to connect again and whether the screen followed
+    """
+    lines = queue.Queue()
+
+    def on_line(columns):
+        if columns[0] == "TRANSPORT":
+            lines.put(columns)
+
+    def ask(session):
+        session.host.stdin.write("TRANSPORT\n")
+        session.host.stdin.flush()
+        return lines.get(timeout=args.connect_timeout)
+
+    relinks = []
+    shown = 0
+    with tempfile.TemporaryDirectory() as sd:
+        session = Session(args, Path(sd), {}, on_line)
+        session.wait_connected(trace[0]['ui'], args.connect_timeout)
+        for index in range(args.switches):
+            transport = args.transports[(index + 1) % len(args.transports)]
+            start = time.monotonic()
+            session.host.stdin.write(f"TRANSPORT {transport}\n")
+            session.host.stdin.flush()
+            while True:
+                columns = ask(session)
+                if columns[2] == transport and columns[4] == "connected":
+                    relinks.append(time.monotonic() - start)
+                    break
+                if time.monotonic() - start > RELINK_BOUND:
+                    relinks.append(None)
+                    break
+                time.sleep(0.005)
+
+            # the screen has to follow over the new transport too
+            entry = trace[(index + 1) % len(trace)]
+            draws = session.screen.draws
+            session.screen.expect(time.monotonic_ns(), expected_screen(entry['ui']))
+            session.plugin.on_ui_update(TraceView(entry['ui']))
+            deadline = time.monotonic() + args.connect_timeout
+            while session.screen.outstanding() and time.monotonic() < deadline:
+                time.sleep(0.005)
+            shown += session.screen.draws > draws and not session.screen.outstanding()
+        session.stop()
+    return relinks, shown
+
+
+def run(args):
+    trace = load_trace(args.trace or TOOLS_DIR / "bench" / "traces" / "sample.jsonl")
+    rates = [throughput(args, trace, transport) for transport in args.transports]
+    relinks, shown = switches(args, trace)
+    made = [seconds * 1000 for seconds in relinks if seconds is not None]
+    return {
+        'rates': rates,
+        'switches': len(relinks),
+        'relinked': len(made),
+        'relink_p50_ms': percentile(made, 50),
+        'relink_max_ms': max(made) if made else None,
+        'shown': shown,
+        'baud': args.baud,
+        'noise': args.noise,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default=str(TOOLS_DIR / "hostsim" / "build" / "flipagotchi_host"), help="host build of the flipper app")
+    parser.add_argument("--transports", nargs="+", choices=TRANSPORTS, default=TRANSPORTS, help="transports to run over")
+    parser.add_argument("--files", type=int, default=2, help="number of files to offload over each")
+    parser.add_argument("--size", type=int, default=16384, help="bytes in each file")
+    parser.add_argument("--switches", type=int, default=8, help="transport switches under a connected PwnZero")
+    parser.add_argument("--trace", default=None, help="ui trace to take the screens from")
+    parser.add_argument("--baud", type=int, default=115200, help="emulated baudrate of the uarts")
+    parser.add_argument("--usb-baud", type=int, default=2000000, help="baud PwnZero is set to over usb and the pty")
+    parser.add_argument("--noise", type=float, default=0, help="probability per byte of a bit flip on the uarts' wire")
+    parser.add_argument("--seed", type=int, default=1, help="seed for the line noise and the file contents")
+    parser.add_argument("--ack-timeout", type=float, default=0.2, help="seconds PwnZero waits for an ack")
+    parser.add_argument("--connect-timeout", type=float, default=10)
+    parser.add_argument("--timeout", type=float, default=60, help="seconds to give the transfers over each")
+    parser.add_argument("--json", action="store_true", help="print the report as json")
+    parser.add_argument("--verbose", action="store_true", help="show PwnZero's logging")
+    args = parser.parse_args()
+    if args.baud <= 0:
+        parser.error("the line rate needs a --baud above 0")
+
+    logging.basicConfig(level=logging.INFO if args.verbose else logging.CRITICAL)
+
+    report = run(args)
+    if args.json:
+        print(json.dumps(report))
+    else:
+        for rate in report['rates']:
+            print(f"{rate['transport']:<8}         {rate['bytes_per_second']:.0f} B/s offloaded at {rate['baud']} baud{'' if rate['intact'] else ', not all files made it'}")
+        if report['relinked']:
+            print(f"switches         {report['relinked']} of {report['switches']} connected again, p50 {report['relink_p50_ms']:.1f} ms, max {report['relink_max_ms']:.1f} ms, {report['shown']} screens shown after")
+        else:
+            print(f"switches         none of {report['switches']} connected again")
+        print(f"line             {report['baud']} baud, noise {report['noise']}")
+
+    if not all(rate['intact'] for rate in report['rates']):
+        raise SystemExit("an offload didn't finish")
+    if report['relinked'] != report['switches'] or report['shown'] != report['switches']:
+        raise SystemExit(f"a switch didn't connect again within {RELINK_BOUND} s")
+
+
+if __name__ == "__main__":
+    main()
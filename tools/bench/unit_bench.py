@@ -0,0 +1,183 @@
+"""
+Runs a host build of the flipagotchi app with two units, each with a PwnZero of its own on a pty,
+and reports the first unit's screen latency while the second is quiet and again while the second is
+flooded with ui updates and a file offload. The units have their own uart, workers and model, so
+the second unit's traffic should leave the first one's latency where it was
+
+Every file the second unit offloads is compared byte for byte with what ended up in its own
+offload dir on the sd card
+
+Build the host app first with `make -C tools/hostsim`
+"""
+import argparse
+import json
+import logging
+import os
+import pty
+import tempfile
+import threading
+import time
+import tty
+from pathlib import Path
+
+from replay_bench import TOOLS_DIR, CountingFlipper, TraceView, load_trace, percentile, pz
+from offload_bench import Session, make_files, replay
+
+OFFLOAD2_DIR = Path("apps_data") / "flipagotchi" / "offload2"
+# the first unit's p99 may grow by this factor, or this many ms on a fast machine, under load
+ISOLATION_FACTOR = 2
+ISOLATION_SLACK_MS = 5
+
+
+class SecondUnit():
+    """
+    PwnZero talking to the host app's second unit over a pty of its own
+    """
+
+    def __init__(self, args, options):
+        self.master, slave = pty.openpty()
+        tty.setraw(self.master)
+        tty.setraw(slave)
+        self._slave = slave
+        self.draws = 0
+        self.plugin = pz.PwnZero()
+        self.plugin._flipper = CountingFlipper(port=os.ttyname(slave), baud=args.baud, timeout=args.ack_timeout)
+        self.plugin.options = dict({'clock_sync': False}, **options)
+
+    def start(self):
+        # the host app has its own copy of the master by now
+        os.close(self.master)
+        self.plugin.on_loaded()
+
+    def on_line(self, columns):
+        if columns[0] == "DRAW2":
+            self.draws += 1
+
+    def wait_connected(self, ui, timeout):
+        self.plugin.on_ui_update(TraceView(ui))
+        deadline = time.monotonic() + timeout
+        while not (self.plugin.connected and self.draws):
+            if time.monotonic() > deadline:
+                raise SystemExit("second unit never connected")
+            time.sleep(0.01)
+
+    def stop(self):
+        self.plugin.on_unload()
+        os.close(self._slave)
+
+
+def flood(unit, trace, stop):
+    """
+    Sends the second unit every screen of the trace back to back until stopped
+    """
+    index = 0
+    while not stop.wait(0.001):
+        unit.plugin.on_ui_update(TraceView(trace[index % len(trace)]['ui']))
+        index += 1
+
+
+def phase(args, trace, loaded):
+    """
+    Replays the trace to the first unit, with the second one quiet or under load
+
+    :return: The first unit's screen latencies, how many files the second unit got across intact
+             and how many it sent
+    """
+    with tempfile.TemporaryDirectory() as tmp:
+        tmp = Path(tmp)
+        sd = tmp / "sd"
+        captures = tmp / "handshakes"
+        sd.mkdir()
+        captures.mkdir()
+        files = make_files(captures, args.files, args.size, args.seed) if loaded else {}
+        options = {
+            'offload': loaded,
+            'offload_dir': str(captures),
+            'offload_log': str(tmp / "offloaded"),
+        }
+
+        second = SecondUnit(args, options)
+        session = Session(args, sd, {}, second.on_line, host_args=["--fd2", str(second.master)], pass_fds=(second.master,))
+        second.start()
+        session.wait_connected(trace[0]['ui'], args.connect_timeout)
+        second.wait_connected(trace[0]['ui'], args.connect_timeout)
+
+        stop = threading.Event()
+        flooder = None
+        if loaded:
+            flooder = threading.Thread(target=flood, args=(second, trace, stop), daemon=True)
+            flooder.start()
+        replay(session, trace, args.speed, threading.Event())
+        # let the last screens land before the totals are taken
+        deadline = time.monotonic() + args.connect_timeout
+        while session.screen.outstanding() and time.monotonic() < deadline:
+            time.sleep(0.01)
+        stop.set()
+        if flooder is not None:
+            flooder.join()
+
+        second.stop()
+        session.stop()
+        intact = 0
+        for path, data in files.items():
+            target = sd / OFFLOAD2_DIR / path.name
+            intact += target.exists() and target.read_bytes() == data
+    return session.screen.latencies, intact, len(files)
+
+
+def run(args):
+    trace = load_trace(args.trace or TOOLS_DIR / "bench" / "traces" / "sample.jsonl")
+    quiet, _, _ = phase(args, trace, False)
+    loaded, intact, files = phase(args, trace, True)
+    return {
+        'quiet_p50_ms': percentile(quiet, 50),
+        'quiet_p99_ms': percentile(quiet, 99),
+        'quiet_updates': len(quiet),
+        'loaded_p50_ms': percentile(loaded, 50),
+        'loaded_p99_ms': percentile(loaded, 99),
+        'loaded_updates': len(loaded),
+        'files': files,
+        'intact': intact,
+        'baud': args.baud,
+        'noise': args.noise,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--host", default=str(TOOLS_DIR / "hostsim" / "build" / "flipagotchi_host"), help="host build of the flipper app")
+    parser.add_argument("--files", type=int, default=4, help="number of files the second unit offloads")
+    parser.add_argument("--size", type=int, default=16384, help="bytes in each file")
+    parser.add_argument("--trace", default=None, help="ui trace to replay to the first unit")
+    parser.add_argument("--baud", type=int, default=115200, help="emulated baudrate of both uarts")
+    parser.add_argument("--noise", type=float, default=0, help="probability per byte of a bit flip on the wires")
+    parser.add_argument("--seed", type=int, default=1, help="seed for the line noise and the file contents")
+    parser.add_argument("--speed", type=float, default=20, help="replay speed multiplier")
+    parser.add_argument("--ack-timeout", type=float, default=0.2, help="seconds PwnZero waits for an ack")
+    parser.add_argument("--connect-timeout", type=float, default=10)
+    parser.add_argument("--json", action="store_true", help="print the report as json")
+    parser.add_argument("--verbose", action="store_true", help="show PwnZero's logging")
+    args = parser.parse_args()
+    if args.baud <= 0:
+        parser.error("the line rate needs a --baud above 0")
+
+    logging.basicConfig(level=logging.INFO if args.verbose else logging.CRITICAL)
+
+    report = run(args)
+    if args.json:
+        print(json.dumps(report))
+    else:
+        print(f"second quiet     p50 {report['quiet_p50_ms']:.2f} ms, p99 {report['quiet_p99_ms']:.2f} ms over {report['quiet_updates']} updates")
+        print(f"second loaded    p50 {report['loaded_p50_ms']:.2f} ms, p99 {report['loaded_p99_ms']:.2f} ms over {report['loaded_updates']} updates")
+        print(f"offload          {report['intact']} of {report['files']} files intact on the second unit")
+        print(f"line             {report['baud']} baud, noise {report['noise']}")
+
+    bound = max(report['quiet_p99_ms'] * ISOLATION_FACTOR, report['quiet_p99_ms'] + ISOLATION_SLACK_MS)
+    if report['loaded_p99_ms'] > bound:
+        raise SystemExit(f"the second unit's load pushed the first one's p99 past {bound:.2f} ms")
+    if report['intact'] != report['files']:
+        raise SystemExit("the second unit's offload didn't finish")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,339 @@
+/*
+ * Standalone driver for the fuzz targets, for when libFuzzer isn't available
+ *
+ *   fuzz_protocol FILE...          run each file once, for AFL use `afl-fuzz ... -- fuzz_protocol @@`
+ *   fuzz_protocol                  run stdin once
+ *   fuzz_protocol --random N [S]   run N generated inputs from seed S and report the throughput
+ *
+ * Generated inputs splice packets for every command with random bytes, so they get past the
+ * framing far more often than plain noise would. Crc checked bodies are also built record by record
+ * with a valid crc32, so the checks behind the crc get reached too.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "protocol.h"
+#include "flipagotchi_offload.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+#define FUZZ_MAX_INPUT (64 * 1024)
+
+static uint8_t fuzz_input[FUZZ_MAX_INPUT];
+
+static const uint8_t fuzz_cmds[] = {
+    CMD_SYN,
+    CMD_ACK,
+    CMD_NAK,
+    FLIPPER_CMD_UI_FACE,
+    FLIPPER_CMD_UI_NAME,
+    FLIPPER_CMD_UI_APS,
+    FLIPPER_CMD_UI_UPTIME,
+    FLIPPER_CMD_UI_FRIEND,
+    FLIPPER_CMD_UI_MODE,
+    FLIPPER_CMD_UI_HANDSHAKES,
+    FLIPPER_CMD_UI_STATUS,
+    FLIPPER_CMD_UI_CHANNEL,
+    FLIPPER_CMD_UI_FACE_ANIM,
+    FLIPPER_CMD_UI_TILES,
+    FLIPPER_CMD_UI_ELEMENT,
+    FLIPPER_CMD_UI_ELEMENT_SET,
+    FLIPPER_CMD_FILE_OPEN,
+    FLIPPER_CMD_FILE_CHUNK,
+    FLIPPER_CMD_AP_SET,
+    FLIPPER_CMD_AP_EVICT,
+    FLIPPER_CMD_HANDSHAKE_PAGE,
+    FLIPPER_CMD_CHANNEL_STATS,
+    FLIPPER_CMD_PEER_SET,
+    FLIPPER_CMD_PEER_EXPIRE,
+};
+
+// commands whose body ends in a crc32 of the rest
+static const uint8_t fuzz_crc_cmds[] = {
+    FLIPPER_CMD_FILE_CHUNK,
+    FLIPPER_CMD_AP_SET,
+    FLIPPER_CMD_AP_EVICT,
+    FLIPPER_CMD_HANDSHAKE_PAGE,
+    FLIPPER_CMD_CHANNEL_STATS,
+    FLIPPER_CMD_PEER_SET,
+    FLIPPER_CMD_PEER_EXPIRE,
+};
+
+// what a coded ACK or NAK answers
+static const uint8_t fuzz_reply_codes[] = {
+    PWN_CMD_MODE,
+    PWN_CMD_REBOOT,
+    PWN_CMD_SHUTDOWN,
+    PWN_CMD_CLOCK_SET,
+};
+
+/// Unescaped bytes of a generated crc checked body before its crc32, escaped it still fits a message
+#define FUZZ_RECORDS_MAX (FILE_CHUNK_SIZE + FILE_CHUNK_OVERHEAD - BODY_CRC_SIZE)
+
+static uint32_t fuzz_rand_state;
+
+static uint32_t fuzz_rand(void) {
+    uint32_t x = fuzz_rand_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    fuzz_rand_state = x;
+    return x;
+}
+
+// bssids, keys and the like come from a handful, so later records hit earlier ones
+static uint8_t fuzz_pool_byte(void) {
+    return 0x40 + fuzz_rand() % 4;
+}
+
+static size_t fuzz_put_text(uint8_t* raw, size_t len, size_t max_len) {
+    // one over the max now and then
+    uint8_t text_len = fuzz_rand() % (max_len + 2);
+    raw[len++] = text_len;
+    for(size_t i = 0; i < text_len; i++) {
+        raw[len++] = ' ' + fuzz_rand() % 95;
+    }
+    return len;
+}
+
+/**
+ * Build the records of a crc checked body, with lengths that line up but random values
+ *
+ * @return Bytes written to raw, at most FUZZ_RECORDS_MAX
+ */
+static size_t fuzz_records(uint8_t cmd, uint8_t* raw) {
+    size_t len = 0;
+    switch(cmd) {
+    case FLIPPER_CMD_FILE_CHUNK: {
+        uint32_t offset = (fuzz_rand() % 4) * FILE_CHUNK_SIZE;
+        for(size_t i = 0; i < 4; i++) {
+            raw[len++] = offset >> (8 * i);
+        }
+        size_t data = fuzz_rand() % (FILE_CHUNK_SIZE + 1);
+        for(size_t i = 0; i < data; i++) {
+            raw[len++] = fuzz_rand();
+        }
+        break;
+    }
+    case FLIPPER_CMD_AP_SET:
+        while(len + AP_RECORD_HEADER_SIZE + AP_SSID_MAX_LEN + 1 <= FUZZ_RECORDS_MAX &&
+              fuzz_rand() % 4 != 0) {
+            for(size_t i = 0; i < 6; i++) {
+                raw[len++] = fuzz_pool_byte();
+            }
+            raw[len++] = fuzz_rand();
+            raw[len++] = 1 + fuzz_rand() % 14;
+            // one past WPA3 now and then
+            raw[len++] = fuzz_rand() % (AP_SECURITY_WPA3 + 2);
+            raw[len++] = fuzz_rand();
+            len = fuzz_put_text(raw, len, AP_SSID_MAX_LEN);
+        }
+        break;
+    case FLIPPER_CMD_AP_EVICT:
+        while(len + 6 <= FUZZ_RECORDS_MAX && fuzz_rand() % 4 != 0) {
+            for(size_t i = 0; i < 6; i++) {
+                raw[len++] = fuzz_pool_byte();
+            }
+        }
+        break;
+    case FLIPPER_CMD_HANDSHAKE_PAGE: {
+        uint16_t total = fuzz_rand() % (4 * HANDSHAKE_PAGE_SIZE);
+        uint16_t number = fuzz_rand() % 5;
+        raw[len++] = fuzz_rand() % 2;
+        raw[len++] = 0;
+        raw[len++] = 0;
+        raw[len++] = 0;
+        raw[len++] = total;
+        raw[len++] = total >> 8;
+        raw[len++] = number;
+        raw[len++] = number >> 8;
+        size_t first = (size_t)number * HANDSHAKE_PAGE_SIZE;
+        size_t count = first < total ? total - first : 0;
+        for(size_t i = 0; i < count && i < HANDSHAKE_PAGE_SIZE; i++) {
+            if(len + HANDSHAKE_RECORD_HEADER_SIZE + AP_SSID_MAX_LEN + 1 > FUZZ_RECORDS_MAX) {
+                break;
+            }
+            for(size_t b = 0; b < 6; b++) {
+                raw[len++] = fuzz_pool_byte();
+            }
+            for(size_t b = 0; b < 4; b++) {
+                raw[len++] = fuzz_rand();
+            }
+            len = fuzz_put_text(raw, len, AP_SSID_MAX_LEN);
+        }
+        break;
+    }
+    case FLIPPER_CMD_CHANNEL_STATS:
+        while(len + CHANNEL_RECORD_SIZE <= FUZZ_RECORDS_MAX && fuzz_rand() % 4 != 0) {
+            raw[len++] = fuzz_rand() % 4 == 0 ? fuzz_rand() : 1 + fuzz_rand() % 14;
+            for(size_t i = 1; i < CHANNEL_RECORD_SIZE; i++) {
+                raw[len++] = fuzz_rand();
+            }
+        }
+        break;
+    case FLIPPER_CMD_PEER_SET:
+        while(len + PEER_RECORD_HEADER_SIZE + PEER_NAME_MAX_LEN + 1 <= FUZZ_RECORDS_MAX &&
+              fuzz_rand() % 4 != 0) {
+            for(size_t i = 0; i < PEER_KEY_SIZE; i++) {
+                raw[len++] = fuzz_pool_byte();
+            }
+            // the faces run to about 20, past them now and then
+            raw[len++] = fuzz_rand() % 32;
+            for(size_t i = 0; i < 5; i++) {
+                raw[len++] = fuzz_rand();
+            }
+            len = fuzz_put_text(raw, len, PEER_NAME_MAX_LEN);
+        }
+        break;
+    case FLIPPER_CMD_PEER_EXPIRE:
+        while(len + PEER_KEY_SIZE <= FUZZ_RECORDS_MAX && fuzz_rand() % 4 != 0) {
+            for(size_t i = 0; i < PEER_KEY_SIZE; i++) {
+                raw[len++] = fuzz_pool_byte();
+            }
+        }
+        break;
+    }
+    return len;
+}
+
+/**
+ * Write a packet with a crc checked body, escaped like the pwnagotchi does
+ *
+ * @return Bytes written to buf, 0 if the packet didn't fit max
+ */
+static size_t fuzz_crc_packet(uint8_t* buf, size_t max) {
+    uint8_t raw[FUZZ_RECORDS_MAX + BODY_CRC_SIZE];
+    uint8_t cmd = fuzz_crc_cmds[fuzz_rand() % sizeof(fuzz_crc_cmds)];
+    size_t raw_len = fuzz_records(cmd, raw);
+    uint32_t crc = flipagotchi_offload_crc32(0, raw, raw_len);
+    for(size_t i = 0; i < BODY_CRC_SIZE; i++) {
+        raw[raw_len++] = crc >> (8 * i);
+    }
+
+    // every byte escaped, the header and the end
+    if(raw_len * 2 + 3 > max) {
+        return 0;
+    }
+    size_t len = 0;
+    buf[len++] = PACKET_START;
+    buf[len++] = cmd;
+    for(size_t i = 0; i < raw_len; i++) {
+        uint8_t byte = raw[i];
+        if(byte == 0 || byte == PACKET_START || byte == PACKET_END || byte == PACKET_ESCAPE) {
+            buf[len++] = PACKET_ESCAPE;
+            byte ^= PACKET_ESCAPE_XOR;
+        }
+        buf[len++] = byte;
+    }
+    buf[len++] = PACKET_END;
+    return len;
+}
+
+static size_t fuzz_generate(uint8_t* buf, size_t max) {
+    size_t len = 0;
+    buf[len++] = fuzz_rand() % 32;
+
+    size_t target = 1 + fuzz_rand() % 2048;
+    while(len < target && len < max) {
+        switch(fuzz_rand() % 4) {
+        case 0: {
+            // noise
+            size_t n = fuzz_rand() % 16;
+            for(size_t i = 0; i < n && len < max; i++) {
+                buf[len++] = fuzz_rand();
+            }
+            break;
+        }
+        case 1: {
+            size_t n = fuzz_crc_packet(&buf[len], max - len);
+            if(n == 0) {
+                return len;
+            }
+            len += n;
+            break;
+        }
+        default: {
+            // a packet, sometimes oversized, sometimes missing its end
+            size_t body = fuzz_rand() % 4 == 0 ? fuzz_rand() % (PWNAGOTCHI_PROTOCOL_MAX_MESSAGE_SIZE * 2) :
+                                                  fuzz_rand() % 24;
+            if(len + body + 3 > max) {
+                return len;
+            }
+            uint8_t cmd = fuzz_cmds[fuzz_rand() % sizeof(fuzz_cmds)];
+            buf[len++] = PACKET_START;
+            buf[len++] = cmd;
+            if((cmd == CMD_ACK || cmd == CMD_NAK) && body > 0 && fuzz_rand() % 2 == 0) {
+                // a reply to one of our commands carries its code
+                buf[len++] = fuzz_reply_codes[fuzz_rand() % sizeof(fuzz_reply_codes)];
+                body--;
+            }
+            for(size_t i = 0; i < body; i++) {
+                uint8_t byte = fuzz_rand() % 8 == 0 ? fuzz_rand() : ' ' + fuzz_rand() % 95;
+                buf[len++] = byte == PACKET_START || byte == PACKET_END ? 'x' : byte;
+            }
+            if(fuzz_rand() % 16 != 0) {
+                buf[len++] = PACKET_END;
+            }
+            break;
+        }
+        }
+    }
+    return len;
+}
+
+static int fuzz_run_file(FILE* file) {
+    size_t len = fread(fuzz_input, 1, sizeof(fuzz_input), file);
+    return LLVMFuzzerTestOneInput(fuzz_input, len);
+}
+
+static double fuzz_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv) {
+    if(argc >= 3 && strcmp(argv[1], "--random") == 0) {
+        unsigned long runs = strtoul(argv[2], NULL, 10);
+        fuzz_rand_state = argc >= 4 ? strtoul(argv[3], NULL, 10) : 1;
+        if(fuzz_rand_state == 0) {
+            fuzz_rand_state = 1;
+        }
+
+        size_t total = 0;
+        double start = fuzz_seconds();
+        for(unsigned long i = 0; i < runs; i++) {
+            size_t len = fuzz_generate(fuzz_input, sizeof(fuzz_input));
+            LLVMFuzzerTestOneInput(fuzz_input, len);
+            total += len;
+        }
+        double elapsed = fuzz_seconds() - start;
+
+        printf(
+            "%lu inputs, %zu bytes in %.2f s, %.0f ns/byte\n",
+            runs,
+            total,
+            elapsed,
+            total ? elapsed * 1e9 / total : 0);
+        return 0;
+    }
+
+    if(argc == 1) {
+        return fuzz_run_file(stdin);
+    }
+
+    for(int i = 1; i < argc; i++) {
+        FILE* file = fopen(argv[i], "rb");
+        if(file == NULL) {
+            perror(argv[i]);
+            return 1;
+        }
+        fuzz_run_file(file);
+        fclose(file);
+    }
+    return 0;
+}
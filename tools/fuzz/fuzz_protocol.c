@@ -0,0 +1,337 @@
+/*
+ * Fuzz target for the protocol queue and command dispatch
+ *
+ * Every input byte goes through protocol_queue_push_byte exactly like bytes from the uart irq do.
+ * Queued messages are dispatched in batches into a pwnagotchi model which is then drawn, and after every step
+ * the model and queue invariants are checked:
+ *  - every string field is NUL terminated inside its buffer
+ *  - face and mode hold values the view can draw
+ *  - a face animation is one the view can step, at a rate it accepts
+ *  - declared plugin elements are on screen, in a font we have and hold no more than their max length
+ *  - the queue never holds more than PWNAGOTCHI_PROTOCOL_MESSAGE_QUEUE_SIZE messages
+ *  - a file offload never takes bytes past the end of the file or past the end of a buffer
+ *  - the access point table holds no more than PWNAGOTCHI_MAX_APS, every one of them is found
+ *    through the bssid index and the signal index is a permutation sorted strongest first
+ *  - the peer table holds no more than PWNAGOTCHI_MAX_PEERS, closest first, no key twice and only
+ *    faces the view can draw
+ *  - only a reply carrying the pending command's code answers it
+ *  - a reply to a clock probe never moves the flipper's time
+ *
+ * The first input byte decides how many bytes are pushed between drains, so the fuzzer can also
+ * reach the full queue paths. Built as a libFuzzer target with clang, or with the standalone driver
+ * in fuzz_main.c for gcc and AFL.
+ */
+
+// the dispatcher is static, pull the whole file in to reach it
+#include "flipagotchi_uart.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/// Size of the file every input is in the middle of receiving, a few buffers and a short last chunk
+#define FUZZ_OFFLOAD_SIZE (3 * FLIPAGOTCHI_OFFLOAD_BUFFER_SIZE + FILE_CHUNK_SIZE / 2)
+
+static FlipagotchiUart* fuzz_uart;
+static PwnagotchiModel fuzz_start_model;
+
+static void fuzz_fail(const char* what) {
+    fprintf(stderr, "invariant broken: %s\n", what);
+    abort();
+}
+
+static void fuzz_check_field(const char* field, size_t len, const char* name) {
+    if(memchr(field, '\0', len) == NULL) {
+        fuzz_fail(name);
+    }
+}
+
+static void fuzz_check_aps(const PwnagotchiApTable* table) {
+    if(table->count > PWNAGOTCHI_MAX_APS) {
+        fuzz_fail("ap table over capacity");
+    }
+    size_t used = 0;
+    for(size_t i = 0; i < PWNAGOTCHI_AP_SLOTS; i++) {
+        if(table->slots[i] > table->count) {
+            fuzz_fail("ap slot points past the table");
+        }
+        used += table->slots[i] != 0;
+    }
+    if(used != table->count) {
+        fuzz_fail("ap slots don't match the count");
+    }
+    for(size_t i = 0; i < table->count; i++) {
+        const PwnagotchiAp* ap = &table->aps[i];
+        if(flipagotchi_aps_find(table, ap->bssid) != ap) {
+            fuzz_fail("ap not found by its bssid");
+        }
+        if(ap->security > AP_SECURITY_WPA3) {
+            fuzz_fail("ap security out of range");
+        }
+        fuzz_check_field(ap->ssid, sizeof(ap->ssid), "ap ssid not terminated");
+        if(table->order[table->rank[i]] != i) {
+            fuzz_fail("ap rank and order disagree");
+        }
+    }
+    for(size_t rank = 1; rank < table->count; rank++) {
+        if(flipagotchi_aps_get(table, rank - 1)->rssi < flipagotchi_aps_get(table, rank)->rssi) {
+            fuzz_fail("ap signal index out of order");
+        }
+    }
+}
+
+static void fuzz_check_peers(const PwnagotchiPeerTable* table) {
+    if(table->count > PWNAGOTCHI_MAX_PEERS) {
+        fuzz_fail("peer table over capacity");
+    }
+    for(size_t i = 0; i < table->count; i++) {
+        const PwnagotchiPeer* peer = &table->peers[i];
+        if(flipagotchi_peers_find(table, peer->key) != peer) {
+            fuzz_fail("peer key in the table twice");
+        }
+        if(peer->face < Look_r || peer->face >= EndFace) {
+            fuzz_fail("peer face out of range");
+        }
+        fuzz_check_field(peer->name, sizeof(peer->name), "peer name not terminated");
+        if(i > 0 && table->peers[i - 1].rssi < peer->rssi) {
+            fuzz_fail("peers out of order");
+        }
+    }
+}
+
+static void fuzz_check_model(const PwnagotchiModel* model) {
+    fuzz_check_field(model->channel, sizeof(model->channel), "channel not terminated");
+    fuzz_check_field(model->apStat, sizeof(model->apStat), "apStat not terminated");
+    fuzz_check_field(model->uptime, sizeof(model->uptime), "uptime not terminated");
+    fuzz_check_field(model->hostname, sizeof(model->hostname), "hostname not terminated");
+    fuzz_check_field(model->status, sizeof(model->status), "status not terminated");
+    fuzz_check_field(model->handshakes, sizeof(model->handshakes), "handshakes not terminated");
+
+    if(model->face < Look_r || model->face >= EndFace) {
+        fuzz_fail("face out of range");
+    }
+    if(model->mode != PwnMode_Manual && model->mode != PwnMode_Auto && model->mode != PwnMode_Ai) {
+        fuzz_fail("mode out of range");
+    }
+    if(model->animation != PwnAnimation_None &&
+       !pwnagotchi_animation_is_valid(model->animation, model->animation_period_ms)) {
+        fuzz_fail("animation out of range");
+    }
+
+    for(size_t i = 0; i < PWNAGOTCHI_MAX_ELEMENTS; i++) {
+        const PwnagotchiElement* element = &model->elements[i];
+        fuzz_check_field(element->label, sizeof(element->label), "element label not terminated");
+        fuzz_check_field(element->value, sizeof(element->value), "element value not terminated");
+        if(!element->declared) {
+            continue;
+        }
+        if(element->x >= FLIPPER_SCREEN_WIDTH || element->y >= FLIPPER_SCREEN_HEIGHT ||
+           element->font >= FontTotalNumber) {
+            fuzz_fail("element out of range");
+        }
+        if(strlen(element->value) > element->max_len) {
+            fuzz_fail("element value over max length");
+        }
+    }
+
+    fuzz_check_aps(model->aps);
+    fuzz_check_peers(model->peers);
+    if(model->page >= PwnagotchiPageNum) {
+        fuzz_fail("page out of range");
+    }
+}
+
+static void fuzz_check_queue(ProtocolQueue* queue) {
+    if(protocol_queue_get_count(queue) > PWNAGOTCHI_PROTOCOL_MESSAGE_QUEUE_SIZE) {
+        fuzz_fail("queue over depth");
+    }
+    if(queue->cur_message_len > sizeof(PwnMessage)) {
+        fuzz_fail("cur_message over length");
+    }
+}
+
+static void fuzz_check_offload(FlipagotchiOffload* offload) {
+    if(offload->expected > offload->size) {
+        fuzz_fail("offload past the end of the file");
+    }
+    for(size_t i = 0; i < 2; i++) {
+        if(offload->buffer_len[i] > FLIPAGOTCHI_OFFLOAD_BUFFER_SIZE) {
+            fuzz_fail("offload buffer over length");
+        }
+    }
+    fuzz_check_field(offload->name, sizeof(offload->name), "offload name not terminated");
+}
+
+static void fuzz_check_handshakes(FlipagotchiHandshakes* handshakes) {
+    for(size_t i = 0; i < FLIPAGOTCHI_HANDSHAKES_CACHE_PAGES; i++) {
+        const FlipagotchiHandshakePage* page = &handshakes->pages[i];
+        if(!page->valid) {
+            continue;
+        }
+        if(page->count > HANDSHAKE_PAGE_SIZE) {
+            fuzz_fail("handshake page over size");
+        }
+        if(page->used > handshakes->clock) {
+            fuzz_fail("handshake page used after the clock");
+        }
+        for(size_t j = 0; j < i; j++) {
+            if(handshakes->pages[j].valid && handshakes->pages[j].page == page->page) {
+                fuzz_fail("handshake page cached twice");
+            }
+        }
+        for(size_t j = 0; j < HANDSHAKE_PAGE_SIZE; j++) {
+            fuzz_check_field(
+                page->handshakes[j].ssid,
+                sizeof(page->handshakes[j].ssid),
+                "handshake ssid not terminated");
+        }
+    }
+}
+
+static void fuzz_check_control(FlipagotchiControl* control) {
+    FlipagotchiControlResult* result = &control->result;
+    if(result->cmd != PWN_CMD_MODE || result->arg != MODE_AUTO) {
+        fuzz_fail("control command changed by a reply");
+    }
+    if(result->status != FlipagotchiControlPending && result->status != FlipagotchiControlAcked &&
+       result->status != FlipagotchiControlNaked) {
+        fuzz_fail("control command in a status a reply can't put it in");
+    }
+}
+
+/// Where every input starts the clock's estimate, only the rtc moves it
+#define FUZZ_CLOCK_BASE 1700000000000LL
+
+static void fuzz_check_clock(FlipagotchiClock* clock) {
+    if(clock->base_lo != FUZZ_CLOCK_BASE || clock->base_hi != FUZZ_CLOCK_BASE) {
+        fuzz_fail("clock estimate moved by a reply");
+    }
+    if(clock->pending && clock->rtt_ms != FLIPAGOTCHI_CLOCK_NO_RTT) {
+        fuzz_fail("clock probe has a round trip but is still pending");
+    }
+}
+
+static void fuzz_drain(void) {
+    View* view = pwnagotchi_get_view(fuzz_uart->pwnagotchi);
+    while(protocol_queue_has_message(fuzz_uart->queue)) {
+        // same path as the io worker, committing with update set draws the view
+        bool update = false;
+        with_view_model(
+            view,
+            PwnagotchiModel * model,
+            {
+                flipagotchi_exec_batch(model, fuzz_uart, &update);
+                fuzz_check_model(model);
+            },
+            update);
+        fuzz_check_queue(fuzz_uart->queue);
+        fuzz_check_offload(fuzz_uart->offload);
+        fuzz_check_handshakes(fuzz_uart->handshakes);
+        fuzz_check_control(fuzz_uart->control);
+        fuzz_check_clock(fuzz_uart->clock);
+
+        // nobody drains tx here, drop the acks so the ring never fills
+        fuzz_uart->tx_tail = fuzz_uart->tx_head;
+        // nor writes offload buffers out, hand them straight back
+        memset(fuzz_uart->offload->buffer_busy, 0, sizeof(fuzz_uart->offload->buffer_busy));
+        memset(fuzz_uart->offload->buffer_len, 0, sizeof(fuzz_uart->offload->buffer_len));
+    }
+}
+
+static void fuzz_setup(void) {
+    FlipagotchiArena* arena = flipagotchi_arena_alloc(FLIPAGOTCHI_UART_ARENA_SIZE + PWNAGOTCHI_ARENA_SIZE);
+    fuzz_uart = flipagotchi_arena_carve(arena, FlipagotchiDiagHeapUart, sizeof(FlipagotchiUart));
+    fuzz_uart->queue = protocol_queue_alloc(arena);
+    fuzz_uart->tx_mutex = furi_mutex_alloc(FuriMutexTypeNormal);
+    // never started, tx wakeups just collect in its flags
+    fuzz_uart->tx_worker_thread = furi_thread_alloc();
+    fuzz_uart->pwnagotchi = pwnagotchi_alloc(arena);
+    // the offload worker isn't started either, opens and writes collect in its flags
+    fuzz_uart->offload = flipagotchi_arena_carve(arena, FlipagotchiDiagHeapOffload, sizeof(FlipagotchiOffload));
+    fuzz_uart->offload->flip_uart = fuzz_uart;
+    fuzz_uart->offload->mutex = furi_mutex_alloc(FuriMutexTypeNormal);
+    fuzz_uart->offload->worker_thread = furi_thread_alloc();
+    fuzz_uart->handshakes = flipagotchi_handshakes_alloc(arena, fuzz_uart);
+    fuzz_uart->control = flipagotchi_control_alloc(arena, fuzz_uart);
+    fuzz_uart->clock = flipagotchi_clock_alloc(arena, fuzz_uart);
+    fuzz_uart->link_state = FlipagotchiLinkConnected;
+
+    with_view_model(
+        pwnagotchi_get_view(fuzz_uart->pwnagotchi),
+        PwnagotchiModel * model,
+        { fuzz_start_model = *model; },
+        false);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if(fuzz_uart == NULL) {
+        fuzz_setup();
+    }
+
+    protocol_queue_wipe(fuzz_uart->queue);
+    // every input starts in the middle of receiving a file, so chunks have somewhere to go
+    FlipagotchiOffload* offload = fuzz_uart->offload;
+    memset(offload->buffer_len, 0, sizeof(offload->buffer_len));
+    memset(offload->buffer_busy, 0, sizeof(offload->buffer_busy));
+    memset(offload->name, 0, sizeof(offload->name));
+    strcpy(offload->name, "fuzz.pcap");
+    offload->state = FlipagotchiOffloadReceiving;
+    offload->size = FUZZ_OFFLOAD_SIZE;
+    offload->crc = 0;
+    offload->expected = 0;
+    offload->fill = 0;
+    offload->unacked_chunks = 0;
+    offload->nudged = false;
+    // and with the handshake browser just opened
+    FlipagotchiHandshakes* handshakes = fuzz_uart->handshakes;
+    memset(handshakes->pages, 0, sizeof(handshakes->pages));
+    handshakes->known = false;
+    handshakes->clock = 0;
+    // and with a mode switch out, only a reply moves it on since nothing here checks the timeout
+    FlipagotchiControl* control = fuzz_uart->control;
+    memset(&control->result, 0, sizeof(control->result));
+    control->result.status = FlipagotchiControlPending;
+    control->result.cmd = PWN_CMD_MODE;
+    control->result.arg = MODE_AUTO;
+    control->sent_tick = furi_get_tick();
+    // and with a clock probe out
+    FlipagotchiClock* clock = fuzz_uart->clock;
+    clock->anchored = true;
+    clock->base_lo = FUZZ_CLOCK_BASE;
+    clock->base_hi = FUZZ_CLOCK_BASE;
+    clock->pending = true;
+    clock->sent_tick = furi_get_tick();
+    clock->rtt_ms = FLIPAGOTCHI_CLOCK_NO_RTT;
+    with_view_model(
+        pwnagotchi_get_view(fuzz_uart->pwnagotchi),
+        PwnagotchiModel * model,
+        {
+            *model = fuzz_start_model;
+            // the tables live in the arena, the copy above only brought back the pointers
+            memset(model->elements, 0, sizeof(PwnagotchiElement) * PWNAGOTCHI_MAX_ELEMENTS);
+            flipagotchi_aps_clear(model->aps);
+            flipagotchi_channels_clear(model->channels, furi_get_tick());
+            flipagotchi_peers_clear(model->peers);
+        },
+        false);
+
+    if(size == 0) {
+        return 0;
+    }
+
+    // 0 means only drain at the end
+    size_t drain_every = data[0];
+    data++;
+    size--;
+
+    for(size_t i = 0; i < size; i++) {
+        protocol_queue_push_byte(fuzz_uart->queue, data[i]);
+        fuzz_check_queue(fuzz_uart->queue);
+
+        if(drain_every && (i + 1) % drain_every == 0) {
+            fuzz_drain();
+        }
+    }
+    fuzz_drain();
+
+    return 0;
+}
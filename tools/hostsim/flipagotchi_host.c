@@ -0,0 +1,727 @@
+// posix_openpt and friends
+#define _GNU_SOURCE
+
+#include "hostsim.h"
+
+#include "flipagotchi_uart_i.h"
+#include "views/pwnagotchi.h"
+#include "flipagotchi_layout.h"
+#include "flipagotchi_aps.h"
+#include "flipagotchi_channels.h"
+#include "flipagotchi_peers.h"
+#include "flipagotchi_handshakes.h"
+#include "flipagotchi_control.h"
+#include "flipagotchi_clock.h"
+#include "flipagotchi_power_i.h"
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <termios.h>
+#include <unistd.h>
+
+/*
+ * Runs the flipagotchi uart, protocol and dispatch code on linux against a pty
+ *
+ * Every redraw of the pwnagotchi view is written to stdout as one tab separated line:
+ * DRAW <monotonic ns> <face> <mode> <hostname> <channel> <aps> <uptime> <handshakes> <status>
+ *
+ * followed by a line for each declared plugin element
+ * ELEMENT <id> <label> <value>
+ *
+ * or while the view mirrors the pwnagotchi's framebuffer
+ * FRAME <monotonic ns> <framebuffer in hex>
+ *
+ * Lines on stdin browse the captured handshakes like the handshake browser does.
+ * HANDSHAKES opens the browser and HANDSHAKE <index> reads an entry, written to stdout as
+ * HANDSHAKE <index> <bssid> <timestamp> <ssid>
+ * or HANDSHAKE <index> - when its page isn't cached, which asks the pwnagotchi for it. Every page
+ * that comes in is written as
+ * HANDSHAKE_PAGE <monotonic ns> <total>
+ *
+ * MODE <manual, auto or ai>, REBOOT and SHUTDOWN send the command like the control scene does, the
+ * mode is shown right away. The answer, and CONTROL on stdin, write the last command to stdout as
+ * CONTROL <monotonic ns> <status> <command> <milliseconds to the answer>
+ * with status one of idle, pending, acked, naked or timeout
+ *
+ * CLOCK writes what the flipper makes of its rtc to stdout as
+ * CLOCK <monotonic ns> <rtc milliseconds since the epoch> <precision ms> <probes> <last round trip>
+ *
+ * TRANSPORT <lpuart, usart, usb or pty> [rate] switches transports like the settings scene does,
+ * TRANSPORT on its own writes the one in use to stdout as
+ * TRANSPORT <monotonic ns> <name> <rate> <link state>
+ *
+ * Runs until stdin is closed, then writes CORRUPTED <bytes>,
+ * DISPATCH <wakeups> <messages> <max per wakeup> <histogram...> and
+ * OFFLOAD <files> <bytes> <crc errors> <resends> to stderr, then the access point table strongest
+ * first, a line for each
+ * AP <bssid> <rssi> <channel> <security> <clients> <ssid>
+ * then the channel heatmap, a line for each channel that saw anything, as whole decayed counts
+ * CHANNEL <channel> <traffic> <aps> <handshakes>
+ * then the peer table closest first, a line for each
+ * PEER <key> <face> <rssi> <pwned> <seconds since last heard> <name>
+ *
+ * Offloaded files land in $HOSTSIM_SD/apps_data/flipagotchi/offload
+ *
+ * With --state the model is restored from and saved to the state snapshot under $HOSTSIM_SD
+ * like the app does on start and exit
+ *
+ * With --layout the layout under $HOSTSIM_SD replaces the built in one like it does in the app, and
+ * LAYOUT <entries> <loaded or default> is written to stderr
+ *
+ * With --rtc-offset the rtc reads the monotonic clock plus that many milliseconds instead of the
+ * host's wall clock, running --rtc-drift parts per million fast
+ *
+ * --transport picks what the app talks over, all of them end up on the pty. The uarts are paced at
+ * --baud with --noise on the wire, usb and the pty go as fast as the pty does. The pty transport
+ * opens a pty of its own when there is no --fd and writes PTY <path> to stderr, for a PwnZero
+ * started by hand
+ *
+ * With --idle-after the app goes idle after that many seconds without activity, KEY on stdin is a
+ * key press. Going idle and waking up are written to stdout as
+ * IDLE <monotonic ns> <1 idle or 0 awake>
+ * SKIP <ms> moves the tick that far ahead, POWER writes how much of the time went by idle as
+ * POWER <times gone idle> <ms idle>
+ */
+
+static const struct {
+    const char* name;
+    FlipagotchiTransportId id;
+} flipagotchi_host_transports[] = {
+    {"lpuart", FlipagotchiTransportLpuart},
+    {"usart", FlipagotchiTransportUsart},
+    {"usb", FlipagotchiTransportUsbCdc},
+    {"pty", FlipagotchiTransportPty},
+};
+
+static bool flipagotchi_host_transport_id(const char* name, FlipagotchiTransportId* id) {
+    for(size_t i = 0; i < COUNT_OF(flipagotchi_host_transports); i++) {
+        if(strcmp(name, flipagotchi_host_transports[i].name) == 0) {
+            *id = flipagotchi_host_transports[i].id;
+            return true;
+        }
+    }
+    return false;
+}
+
+static const char* flipagotchi_host_transport_name(FlipagotchiTransportId id) {
+    for(size_t i = 0; i < COUNT_OF(flipagotchi_host_transports); i++) {
+        if(flipagotchi_host_transports[i].id == id) {
+            return flipagotchi_host_transports[i].name;
+        }
+    }
+    return "-";
+}
+
+static void flipagotchi_host_transport(FlipagotchiUart* flip_uart, const char* line) {
+    char name[16];
+    unsigned long rate = 0;
+    FlipagotchiTransportSettings transport;
+    flipagotchi_uart_get_transport(flip_uart, &transport);
+
+    int fields = sscanf(line, "TRANSPORT %15s %lu", name, &rate);
+    if(fields >= 1) {
+        if(!flipagotchi_host_transport_id(name, &transport.id)) {
+            fprintf(stderr, "unknown transport %s\n", name);
+            return;
+        }
+        if(fields == 2) {
+            transport.rate = rate;
+        }
+        flipagotchi_uart_set_transport(flip_uart, &transport);
+        return;
+    }
+
+    flockfile(stdout);
+    printf(
+        "TRANSPORT\t%llu\t%s\t%lu\t%s\n",
+        (unsigned long long)hostsim_monotonic_ns(),
+        flipagotchi_host_transport_name(transport.id),
+        (unsigned long)transport.rate,
+        flipagotchi_link_state_name(flipagotchi_uart_get_link_state(flip_uart)));
+    fflush(stdout);
+    funlockfile(stdout);
+}
+
+/**
+ * Open a pty for a PwnZero started by hand
+ *
+ * @return The end the app uses, -1 if there is none
+ */
+static int flipagotchi_host_open_pty(void) {
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if(fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+        perror("pty");
+        return -1;
+    }
+    struct termios tio;
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+    fprintf(stderr, "PTY\t%s\n", ptsname(fd));
+    return fd;
+}
+
+static void flipagotchi_host_on_draw(View* view, void* _model, void* context) {
+    // each unit's view, the second is NULL while it doesn't run
+    View** pwn_views = context;
+    if(view != pwn_views[0] && view != pwn_views[1]) {
+        return;
+    }
+
+    PwnagotchiModel* model = _model;
+    // handshake pages are written from the io worker, they go between whole draws
+    flockfile(stdout);
+    if(view == pwn_views[1]) {
+        // the second unit only shows up as its fields, everything else is the first one's
+        printf(
+            "DRAW2\t%llu\t%d\t%d\t%s\t%s\t%s\t%s\t%s\t%s\n",
+            (unsigned long long)hostsim_monotonic_ns(),
+            model->face,
+            model->mode,
+            model->hostname,
+            model->channel,
+            model->apStat,
+            model->uptime,
+            model->handshakes,
+            model->status);
+        fflush(stdout);
+        funlockfile(stdout);
+        return;
+    }
+    if(model->mirror) {
+        printf("FRAME\t%llu\t", (unsigned long long)hostsim_monotonic_ns());
+        for(size_t i = 0; i < PWNAGOTCHI_FRAMEBUFFER_SIZE; i++) {
+            printf("%02x", model->framebuffer[i]);
+        }
+        printf("\n");
+        fflush(stdout);
+        funlockfile(stdout);
+        return;
+    }
+
+    printf(
+        "DRAW\t%llu\t%d\t%d\t%s\t%s\t%s\t%s\t%s\t%s\n",
+        (unsigned long long)hostsim_monotonic_ns(),
+        model->face,
+        model->mode,
+        model->hostname,
+        model->channel,
+        model->apStat,
+        model->uptime,
+        model->handshakes,
+        model->status);
+    for(size_t i = 0; i < PWNAGOTCHI_MAX_ELEMENTS; i++) {
+        const PwnagotchiElement* element = &model->elements[i];
+        if(element->declared) {
+            printf(
+                "ELEMENT\t%u\t%s\t%s\n",
+                (unsigned)(i + ELEMENT_BYTE_OFFSET),
+                element->label,
+                element->value);
+        }
+    }
+    fflush(stdout);
+    funlockfile(stdout);
+}
+
+static void flipagotchi_host_on_handshake_page(void* context) {
+    FlipagotchiHandshakes* handshakes = context;
+    size_t total = 0;
+    flipagotchi_handshakes_get_total(handshakes, &total);
+    flockfile(stdout);
+    printf("HANDSHAKE_PAGE\t%llu\t%lu\n", (unsigned long long)hostsim_monotonic_ns(), (unsigned long)total);
+    fflush(stdout);
+    funlockfile(stdout);
+}
+
+static void flipagotchi_host_on_control(void* context) {
+    FlipagotchiControl* control = context;
+    static const char* const statuses[] = {"idle", "pending", "acked", "naked", "timeout"};
+    FlipagotchiControlResult result;
+    flipagotchi_control_get(control, &result);
+    flockfile(stdout);
+    printf(
+        "CONTROL\t%llu\t%s\t%02x\t%lu\n",
+        (unsigned long long)hostsim_monotonic_ns(),
+        statuses[result.status],
+        result.cmd,
+        (unsigned long)result.rtt_ms);
+    fflush(stdout);
+    funlockfile(stdout);
+}
+
+static void flipagotchi_host_print_clock(FlipagotchiClock* clock) {
+    FlipagotchiClockInfo info;
+    flipagotchi_clock_get(clock, &info);
+    flockfile(stdout);
+    printf(
+        "CLOCK\t%llu\t%llu\t%lu\t%lu\t%u\n",
+        (unsigned long long)hostsim_monotonic_ns(),
+        (unsigned long long)info.now_ms,
+        (unsigned long)info.precision_ms,
+        (unsigned long)info.probes,
+        info.rtt_ms);
+    fflush(stdout);
+    funlockfile(stdout);
+}
+
+/**
+ * Send a command like the control scene, false if the line isn't one
+ */
+static bool flipagotchi_host_control(FlipagotchiUart* flip_uart, const char* line) {
+    static const struct {
+        const char* line;
+        uint8_t cmd;
+        uint8_t arg;
+        enum PwnagotchiMode mode;
+    } commands[] = {
+        {"MODE manual\n", PWN_CMD_MODE, MODE_MANUAL, PwnMode_Manual},
+        {"MODE auto\n", PWN_CMD_MODE, MODE_AUTO, PwnMode_Auto},
+        {"MODE ai\n", PWN_CMD_MODE, MODE_AI, PwnMode_Ai},
+        {"REBOOT\n", PWN_CMD_REBOOT, 0, 0},
+        {"SHUTDOWN\n", PWN_CMD_SHUTDOWN, 0, 0},
+    };
+    FlipagotchiControl* control = flipagotchi_uart_get_control(flip_uart);
+
+    if(strcmp(line, "CONTROL\n") == 0) {
+        flipagotchi_host_on_control(control);
+        return true;
+    }
+    for(size_t i = 0; i < COUNT_OF(commands); i++) {
+        if(strcmp(line, commands[i].line) != 0) {
+            continue;
+        }
+        if(commands[i].cmd == PWN_CMD_MODE) {
+            pwnagotchi_set_mode(flip_uart->pwnagotchi, commands[i].mode);
+        }
+        flipagotchi_control_send(control, commands[i].cmd, commands[i].arg);
+        return true;
+    }
+    return false;
+}
+
+/// Period of the stand-in for the app's tick, FLIPAGOTCHI_APP_TICK_MS in the app
+#define FLIPAGOTCHI_HOST_TICK_MS 100
+
+/*
+ * Idle mode, a timer stands in for the app's tick and the lock for its thread
+ */
+static struct {
+    pthread_mutex_t lock;
+    FlipagotchiPower* power;
+    FlipagotchiUart** uarts;
+    uint8_t units;
+} flipagotchi_host_idle = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static void flipagotchi_host_set_idle(bool idle) {
+    for(uint8_t unit = 0; unit < flipagotchi_host_idle.units; unit++) {
+        flipagotchi_uart_set_idle(flipagotchi_host_idle.uarts[unit], idle);
+    }
+    flockfile(stdout);
+    printf("IDLE\t%llu\t%d\n", (unsigned long long)hostsim_monotonic_ns(), idle);
+    fflush(stdout);
+    funlockfile(stdout);
+}
+
+static void flipagotchi_host_idle_tick(void* context) {
+    UNUSED(context);
+    pthread_mutex_lock(&flipagotchi_host_idle.lock);
+    if(flipagotchi_power_check(flipagotchi_host_idle.power)) {
+        flipagotchi_host_set_idle(true);
+    }
+    pthread_mutex_unlock(&flipagotchi_host_idle.lock);
+}
+
+static void flipagotchi_host_wake(void* context) {
+    UNUSED(context);
+    pthread_mutex_lock(&flipagotchi_host_idle.lock);
+    if(flipagotchi_power_activity(flipagotchi_host_idle.power)) {
+        flipagotchi_host_set_idle(false);
+    }
+    pthread_mutex_unlock(&flipagotchi_host_idle.lock);
+}
+
+static void flipagotchi_host_print_power(void) {
+    FlipagotchiPowerStats stats;
+    pthread_mutex_lock(&flipagotchi_host_idle.lock);
+    flipagotchi_power_get_stats(flipagotchi_host_idle.power, &stats);
+    pthread_mutex_unlock(&flipagotchi_host_idle.lock);
+    flockfile(stdout);
+    printf("POWER\t%lu\t%lu\n", (unsigned long)stats.idle_count, (unsigned long)stats.idle_ms);
+    fflush(stdout);
+    funlockfile(stdout);
+}
+
+/**
+ * Run a line from stdin
+ */
+static void flipagotchi_host_command(FlipagotchiUart* flip_uart, const char* line) {
+    FlipagotchiHandshakes* handshakes = flipagotchi_uart_get_handshakes(flip_uart);
+    unsigned long index;
+    if(flipagotchi_host_control(flip_uart, line)) {
+        return;
+    }
+    if(strcmp(line, "KEY\n") == 0) {
+        flipagotchi_host_wake(NULL);
+        return;
+    }
+    if(sscanf(line, "SKIP %lu", &index) == 1) {
+        hostsim_tick_skip(index);
+        return;
+    }
+    if(strcmp(line, "POWER\n") == 0) {
+        flipagotchi_host_print_power();
+        return;
+    }
+    if(strcmp(line, "CLOCK\n") == 0) {
+        flipagotchi_host_print_clock(flipagotchi_uart_get_clock(flip_uart));
+        return;
+    }
+    if(strncmp(line, "TRANSPORT", strlen("TRANSPORT")) == 0) {
+        flipagotchi_host_transport(flip_uart, line);
+        return;
+    }
+    if(strcmp(line, "HANDSHAKES\n") == 0) {
+        flipagotchi_handshakes_open(handshakes);
+        return;
+    }
+    if(sscanf(line, "HANDSHAKE %lu", &index) != 1) {
+        return;
+    }
+
+    FlipagotchiHandshake handshake;
+    bool found = flipagotchi_handshakes_get(handshakes, index, &handshake);
+    flockfile(stdout);
+    printf("HANDSHAKE\t%lu\t", index);
+    if(found) {
+        for(size_t i = 0; i < PWNAGOTCHI_BSSID_LEN; i++) {
+            printf("%s%02x", i ? ":" : "", handshake.bssid[i]);
+        }
+        printf("\t%lu\t%s\n", (unsigned long)handshake.timestamp, handshake.ssid);
+    } else {
+        printf("-\n");
+    }
+    fflush(stdout);
+    funlockfile(stdout);
+}
+
+static void flipagotchi_host_print_aps(const PwnagotchiApTable* table) {
+    for(size_t rank = 0; rank < table->count; rank++) {
+        const PwnagotchiAp* ap = flipagotchi_aps_get(table, rank);
+        fprintf(stderr, "AP\t");
+        for(size_t i = 0; i < PWNAGOTCHI_BSSID_LEN; i++) {
+            fprintf(stderr, "%s%02x", i ? ":" : "", ap->bssid[i]);
+        }
+        fprintf(
+            stderr,
+            "\t%d\t%u\t%u\t%u\t%s\n",
+            ap->rssi,
+            ap->channel,
+            ap->security,
+            ap->clients,
+            ap->ssid);
+    }
+}
+
+static void flipagotchi_host_print_channels(const PwnagotchiChannelTable* table) {
+    for(size_t slot = 0; slot < PWNAGOTCHI_CHANNEL_SLOTS; slot++) {
+        uint32_t heat[PwnagotchiHeatNum];
+        bool any = false;
+        for(size_t i = 0; i < PwnagotchiHeatNum; i++) {
+            heat[i] = table->heat[i][slot] >> FLIPAGOTCHI_CHANNELS_FRACTION_BITS;
+            any |= table->heat[i][slot] != 0;
+        }
+        if(any) {
+            fprintf(
+                stderr,
+                "CHANNEL\t%u\t%lu\t%lu\t%lu\n",
+                flipagotchi_channels_number(slot),
+                (unsigned long)heat[PwnagotchiHeatTraffic],
+                (unsigned long)heat[PwnagotchiHeatAps],
+                (unsigned long)heat[PwnagotchiHeatHandshakes]);
+        }
+    }
+}
+
+static void flipagotchi_host_print_peers(const PwnagotchiPeerTable* table) {
+    for(size_t i = 0; i < table->count; i++) {
+        const PwnagotchiPeer* peer = &table->peers[i];
+        fprintf(
+            stderr,
+            "PEER\t%08lx\t%u\t%d\t%u\t%lu\t%s\n",
+            (unsigned long)peer->key,
+            peer->face,
+            peer->rssi,
+            (unsigned)peer->pwned,
+            (unsigned long)((furi_get_tick() - peer->seen_tick) / furi_ms_to_ticks(1000)),
+            peer->name);
+    }
+}
+
+static void flipagotchi_host_usage(const char* name) {
+    fprintf(
+        stderr,
+        "usage: %s --fd N [--baud N] [--noise P] [--seed N] [--state] [--layout]\n"
+        "          [--rtc-offset MS] [--rtc-drift PPM] [--clock-period MS] [--transport NAME]\n"
+        "          [--fd2 N] [--idle-after S]\n"
+        "  --fd     file descriptor of the pty end acting as the flipper's wire\n"
+        "  --baud   emulated baudrate, 0 for unpaced (default 115200)\n"
+        "  --noise  probability per byte of a bit flip on the wire (default 0)\n"
+        "  --seed   seed for the noise (default 1)\n"
+        "  --state  restore the last known state on start and save it on exit\n"
+        "  --layout load the screen layout from the sd card\n"
+        "  --rtc-offset   run the rtc this many ms ahead of the monotonic clock\n"
+        "  --rtc-drift    and this many parts per million fast (default 0)\n"
+        "  --clock-period ms between clock probes after the first few (default 60000)\n"
+        "  --transport    lpuart, usart, usb or pty (default lpuart), pty without --fd opens one\n"
+        "  --fd2    run a second unit over this fd, on the uart the first one doesn't use\n"
+        "  --idle-after   seconds without activity before going idle (default 0, never)\n",
+        name);
+}
+
+int main(int argc, char** argv) {
+    int fd = -1;
+    int fd2 = -1;
+    uint32_t baud = FLIPAGOTCHI_TRANSPORT_DEFAULT_RATE;
+    FlipagotchiTransportSettings transport = {
+        .id = FlipagotchiTransportLpuart,
+        .rate = FLIPAGOTCHI_TRANSPORT_DEFAULT_RATE,
+    };
+    double noise = 0;
+    uint32_t seed = 1;
+    bool state = false;
+    bool layout = false;
+    bool rtc = false;
+    int64_t rtc_offset = 0;
+    double rtc_drift = 0;
+    uint32_t clock_period = FLIPAGOTCHI_CLOCK_PERIOD_MS;
+    FlipagotchiPowerSettings power = {.idle_s = 0, .backlight = FlipagotchiPowerBacklightOff};
+
+    static const struct option options[] = {
+        {"fd", required_argument, NULL, 'f'},
+        {"baud", required_argument, NULL, 'b'},
+        {"noise", required_argument, NULL, 'n'},
+        {"seed", required_argument, NULL, 's'},
+        {"state", no_argument, NULL, 'S'},
+        {"layout", no_argument, NULL, 'L'},
+        {"rtc-offset", required_argument, NULL, 'r'},
+        {"rtc-drift", required_argument, NULL, 'd'},
+        {"clock-period", required_argument, NULL, 'p'},
+        {"transport", required_argument, NULL, 't'},
+        {"fd2", required_argument, NULL, 'F'},
+        {"idle-after", required_argument, NULL, 'i'},
+        {NULL, 0, NULL, 0},
+    };
+
+    int opt;
+    while((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+        switch(opt) {
+        case 'f':
+            fd = atoi(optarg);
+            break;
+        case 'b':
+            baud = strtoul(optarg, NULL, 10);
+            break;
+        case 'n':
+            noise = strtod(optarg, NULL);
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 10);
+            break;
+        case 'S':
+            state = true;
+            break;
+        case 'L':
+            layout = true;
+            break;
+        case 'r':
+            rtc = true;
+            rtc_offset = strtoll(optarg, NULL, 10);
+            break;
+        case 'd':
+            rtc_drift = strtod(optarg, NULL);
+            break;
+        case 'p':
+            clock_period = strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            if(!flipagotchi_host_transport_id(optarg, &transport.id)) {
+                flipagotchi_host_usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 'F':
+            fd2 = atoi(optarg);
+            break;
+        case 'i':
+            power.idle_s = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            flipagotchi_host_usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if(fd < 0 && transport.id == FlipagotchiTransportPty) {
+        fd = flipagotchi_host_open_pty();
+    }
+    if(fd < 0) {
+        flipagotchi_host_usage(argv[0]);
+        return 2;
+    }
+    // the line rate the flipper is set to, the wire is paced at --baud
+    if(baud > 0) {
+        transport.rate = baud;
+    }
+
+    // the second unit gets whichever uart is left, on a wire of its own
+    FlipagotchiTransportConfig config = {.units = fd2 < 0 ? 1 : 2, .unit = {transport, transport}};
+    config.unit[1].id = flipagotchi_transport_config_free(&config, 1);
+    uint8_t units = config.units;
+
+    hostsim_uart_set_fd(fd);
+    if(units > 1) {
+        hostsim_uart_set_channel_fd(
+            config.unit[1].id == FlipagotchiTransportUsart ? FuriHalUartIdUSART1 :
+                                                             FuriHalUartIdLPUART1,
+            fd2);
+    }
+    hostsim_uart_set_emulated_baud(baud);
+    hostsim_uart_set_noise(noise, seed);
+    if(rtc) {
+        hostsim_rtc_set(rtc_offset, rtc_drift);
+    }
+
+    FlipagotchiArena* arena = flipagotchi_arena_alloc(
+        units * (PWNAGOTCHI_ARENA_SIZE + FLIPAGOTCHI_UART_ARENA_SIZE) +
+        FLIPAGOTCHI_POWER_ARENA_SIZE);
+    Pwnagotchi* pwnagotchis[FLIPAGOTCHI_UNITS_MAX] = {NULL};
+    static View* pwn_views[FLIPAGOTCHI_UNITS_MAX];
+    for(uint8_t unit = 0; unit < units; unit++) {
+        pwnagotchis[unit] = pwnagotchi_alloc(arena);
+        pwn_views[unit] = pwnagotchi_get_view(pwnagotchis[unit]);
+    }
+    Pwnagotchi* pwnagotchi = pwnagotchis[0];
+    hostsim_set_draw_hook(flipagotchi_host_on_draw, pwn_views);
+    for(uint8_t unit = 0; unit < units && state; unit++) {
+        // committed with update so the restored screen shows up as a draw, like the app's first frame
+        with_view_model(
+            pwn_views[unit],
+            PwnagotchiModel * model,
+            { flipagotchi_state_load(model, unit); },
+            true);
+    }
+    if(layout) {
+        bool loaded = false;
+        size_t entries = 0;
+        with_view_model(
+            pwnagotchi_get_view(pwnagotchi),
+            PwnagotchiModel * model,
+            {
+                loaded = flipagotchi_layout_load(model);
+                entries = model->layout->count;
+            },
+            true);
+        fprintf(stderr, "LAYOUT\t%u\t%s\n", (unsigned)entries, loaded ? "loaded" : "default");
+    }
+    FlipagotchiUart* flipagotchi_uarts[FLIPAGOTCHI_UNITS_MAX] = {NULL};
+    for(uint8_t unit = 0; unit < units; unit++) {
+        flipagotchi_uarts[unit] =
+            flipagotchi_uart_alloc(arena, pwnagotchis[unit], unit, &config.unit[unit]);
+    }
+    // commands and the totals at exit are the first unit's
+    FlipagotchiUart* flipagotchi_uart = flipagotchi_uarts[0];
+
+    FlipagotchiHandshakes* handshakes = flipagotchi_uart_get_handshakes(flipagotchi_uart);
+    flipagotchi_handshakes_set_callback(
+        handshakes, flipagotchi_host_on_handshake_page, handshakes);
+    FlipagotchiControl* control = flipagotchi_uart_get_control(flipagotchi_uart);
+    flipagotchi_control_set_callback(control, flipagotchi_host_on_control, control);
+    flipagotchi_clock_set_period(flipagotchi_uart_get_clock(flipagotchi_uart), clock_period);
+
+    flipagotchi_host_idle.power = flipagotchi_power_alloc(arena, &power);
+    flipagotchi_host_idle.uarts = flipagotchi_uarts;
+    flipagotchi_host_idle.units = units;
+    for(uint8_t unit = 0; unit < units; unit++) {
+        flipagotchi_uart_set_wake_callback(flipagotchi_uarts[unit], flipagotchi_host_wake, NULL);
+    }
+    FuriTimer* idle_timer =
+        furi_timer_alloc(flipagotchi_host_idle_tick, FuriTimerTypePeriodic, NULL);
+    furi_timer_start(idle_timer, furi_ms_to_ticks(FLIPAGOTCHI_HOST_TICK_MS));
+
+    // the harness closes stdin when it is done with us
+    char line[64];
+    while(fgets(line, sizeof(line), stdin) != NULL) {
+        flipagotchi_host_command(flipagotchi_uart, line);
+    }
+    furi_timer_stop(idle_timer);
+    furi_timer_free(idle_timer);
+    for(uint8_t unit = 0; unit < units; unit++) {
+        flipagotchi_uart_set_wake_callback(flipagotchi_uarts[unit], NULL, NULL);
+    }
+    flipagotchi_handshakes_set_callback(handshakes, NULL, NULL);
+    flipagotchi_control_set_callback(control, NULL, NULL);
+
+    FlipagotchiDispatchStats stats;
+    flipagotchi_uart_get_dispatch_stats(flipagotchi_uart, &stats);
+    FlipagotchiOffloadStats offload;
+    flipagotchi_uart_get_offload_stats(flipagotchi_uart, &offload);
+    // a DIAG=1 build leaves its report in $HOSTSIM_SD/apps_data/flipagotchi/diag.log
+    flipagotchi_diag_log("host exit");
+
+    for(uint8_t unit = 0; unit < units; unit++) {
+        flipagotchi_uart_free(flipagotchi_uarts[unit]);
+    }
+    for(uint8_t unit = 0; unit < units && state; unit++) {
+        uint8_t buf[FLIPAGOTCHI_STATE_MAX_SIZE];
+        size_t len = 0;
+        with_view_model(
+            pwn_views[unit],
+            PwnagotchiModel * model,
+            { len = flipagotchi_state_encode(model, buf); },
+            false);
+        flipagotchi_state_write(buf, len, unit);
+    }
+    // printed with the other totals below, the table goes away with the view
+    static PwnagotchiApTable aps;
+    static PwnagotchiChannelTable channels;
+    static PwnagotchiPeerTable peers;
+    with_view_model(
+        pwnagotchi_get_view(pwnagotchi),
+        PwnagotchiModel * model,
+        {
+            aps = *model->aps;
+            flipagotchi_channels_decay(model->channels, furi_get_tick());
+            channels = *model->channels;
+            peers = *model->peers;
+        },
+        false);
+    for(uint8_t unit = 0; unit < units; unit++) {
+        pwnagotchi_free(pwnagotchis[unit]);
+    }
+    flipagotchi_arena_free(arena);
+
+    fprintf(stderr, "CORRUPTED\t%lu\n", (unsigned long)hostsim_uart_get_corrupted());
+    fprintf(
+        stderr,
+        "DISPATCH\t%lu\t%lu\t%lu",
+        (unsigned long)stats.wakeups,
+        (unsigned long)stats.messages,
+        (unsigned long)stats.max_per_wakeup);
+    for(size_t i = 0; i < PWNAGOTCHI_DISPATCH_HISTOGRAM_SIZE; i++) {
+        fprintf(stderr, "\t%lu", (unsigned long)stats.histogram[i]);
+    }
+    fprintf(stderr, "\n");
+    fprintf(
+        stderr,
+        "OFFLOAD\t%lu\t%lu\t%lu\t%lu\n",
+        (unsigned long)offload.files,
+        (unsigned long)offload.bytes,
+        (unsigned long)offload.crc_errors,
+        (unsigned long)offload.resends);
+    flipagotchi_host_print_aps(&aps);
+    flipagotchi_host_print_channels(&channels);
+    flipagotchi_host_print_peers(&peers);
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "hostsim.h"
+
+#include "flipagotchi_transport.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+
+/*
+ * The pty as a plain linux serial port, no emulated hardware in between. Bytes go as fast as the
+ * pty takes them, without the uart's pacing and line noise
+ */
+
+/// How often the reader looks at whether it should stop
+#define FLIPAGOTCHI_TRANSPORT_PTY_POLL_MS 10
+
+typedef struct {
+    int fd;
+    FlipagotchiTransportRxCallback callback;
+    void* context;
+    pthread_t rx_thread;
+    volatile bool running;
+} FlipagotchiPty;
+
+static FlipagotchiPty flipagotchi_transport_pty_state = {.fd = -1};
+
+static void* flipagotchi_transport_pty_rx_body(void* arg) {
+    FlipagotchiPty* pty = arg;
+    uint8_t buf[256];
+    struct pollfd pfd = {.fd = pty->fd, .events = POLLIN};
+    while(pty->running) {
+        int ready = poll(&pfd, 1, FLIPAGOTCHI_TRANSPORT_PTY_POLL_MS);
+        if(ready == 0 || (ready < 0 && errno == EINTR)) {
+            continue;
+        }
+        ssize_t length = ready < 0 ? -1 : read(pty->fd, buf, sizeof(buf));
+        if(length <= 0) {
+            if(length < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+            break;
+        }
+        pty->callback(buf, length, pty->context);
+    }
+    return NULL;
+}
+
+static bool flipagotchi_transport_pty_open(
+    uint32_t rate,
+    FlipagotchiTransportRxCallback callback,
+    void* context) {
+    UNUSED(rate);
+    FlipagotchiPty* pty = &flipagotchi_transport_pty_state;
+
+    pty->fd = hostsim_uart_get_fd();
+    if(pty->fd < 0) {
+        FURI_LOG_E("PWN", "no pty to open");
+        return false;
+    }
+    pty->callback = callback;
+    pty->context = context;
+    pty->running = true;
+    pthread_create(&pty->rx_thread, NULL, flipagotchi_transport_pty_rx_body, pty);
+    return true;
+}
+
+static void flipagotchi_transport_pty_tx(const uint8_t* data, size_t length) {
+    FlipagotchiPty* pty = &flipagotchi_transport_pty_state;
+    for(size_t written = 0; written < length;) {
+        ssize_t count = write(pty->fd, data + written, length - written);
+        if(count < 0 && errno == EINTR) continue;
+        if(count < 0) {
+            FURI_LOG_W("PWN", "pty write failed: %s", strerror(errno));
+            return;
+        }
+        written += count;
+    }
+}
+
+static void flipagotchi_transport_pty_set_rate(uint32_t rate) {
+    UNUSED(rate);
+}
+
+static void flipagotchi_transport_pty_close(void) {
+    FlipagotchiPty* pty = &flipagotchi_transport_pty_state;
+    pty->running = false;
+    pthread_join(pty->rx_thread, NULL);
+    pty->fd = -1;
+}
+
+const FlipagotchiTransport flipagotchi_transport_pty = {
+    .name = "pty",
+    .has_rate = false,
+    .open = flipagotchi_transport_pty_open,
+    .tx = flipagotchi_transport_pty_tx,
+    .set_rate = flipagotchi_transport_pty_set_rate,
+    .close = flipagotchi_transport_pty_close,
+};
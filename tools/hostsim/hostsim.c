@@ -0,0 +1,1623 @@
+#include "hostsim.h"
+
+#include <furi_hal.h>
+#include <gui/canvas.h>
+#include <notification/notification_messages.h>
+#include <flipagotchi_icons.h>
+#include <storage/storage.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * pthread backed implementation of the furi api declared in include/
+ * Ticks are milliseconds, same as on the flipper
+ */
+
+static uint64_t hostsim_start_ns;
+
+uint64_t hostsim_monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void hostsim_deadline(struct timespec* ts, uint32_t timeout_ms) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += timeout_ms / 1000;
+    ts->tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if(ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+// waits on cond, returns false once timeout_ms is up
+static bool hostsim_cond_wait(
+    pthread_cond_t* cond,
+    pthread_mutex_t* mutex,
+    uint32_t timeout_ms,
+    const struct timespec* deadline) {
+    if(timeout_ms == FuriWaitForever) {
+        pthread_cond_wait(cond, mutex);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, mutex, deadline) != ETIMEDOUT;
+}
+
+/* log */
+
+static pthread_mutex_t hostsim_log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int hostsim_log_enabled = -1;
+
+void hostsim_log(char level, const char* tag, const char* fmt, ...) {
+    if(hostsim_log_enabled < 0) {
+        hostsim_log_enabled = getenv("HOSTSIM_LOG") != NULL;
+    }
+    if(!hostsim_log_enabled && level != 'E') {
+        return;
+    }
+
+    pthread_mutex_lock(&hostsim_log_mutex);
+    fprintf(stderr, "%lu [%c][%s] ", (unsigned long)furi_get_tick(), level, tag);
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputc('\n', stderr);
+    pthread_mutex_unlock(&hostsim_log_mutex);
+}
+
+void hostsim_crash(const char* msg, const char* file, int line) {
+    fprintf(stderr, "furi crash: %s at %s:%d\n", msg, file, line);
+    abort();
+}
+
+size_t strlcpy(char* dst, const char* src, size_t size) {
+    size_t len = strlen(src);
+    if(size > 0) {
+        size_t copy = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, copy);
+        dst[copy] = '\0';
+    }
+    return len;
+}
+
+size_t strlcat(char* dst, const char* src, size_t size) {
+    size_t dst_len = strnlen(dst, size);
+    if(dst_len == size) {
+        return size + strlen(src);
+    }
+    return dst_len + strlcpy(dst + dst_len, src, size - dst_len);
+}
+
+/* kernel */
+
+// added by hostsim_tick_skip
+static uint32_t hostsim_tick_skipped;
+
+uint32_t furi_get_tick(void) {
+    if(hostsim_start_ns == 0) {
+        hostsim_start_ns = hostsim_monotonic_ns();
+    }
+    return (uint32_t)((hostsim_monotonic_ns() - hostsim_start_ns) / 1000000ULL) +
+           __atomic_load_n(&hostsim_tick_skipped, __ATOMIC_RELAXED);
+}
+
+void hostsim_tick_skip(uint32_t ms) {
+    __atomic_add_fetch(&hostsim_tick_skipped, ms, __ATOMIC_RELAXED);
+}
+
+uint32_t furi_kernel_get_tick_frequency(void) {
+    return 1000;
+}
+
+uint32_t furi_ms_to_ticks(uint32_t milliseconds) {
+    return milliseconds;
+}
+
+void furi_delay_ms(uint32_t milliseconds) {
+    usleep(milliseconds * 1000);
+}
+
+void furi_delay_tick(uint32_t ticks) {
+    furi_delay_ms(ticks);
+}
+
+void* furi_record_open(const char* name) {
+    UNUSED(name);
+    // nothing the host build needs is behind a record, hand out a dummy
+    static uint8_t record;
+    return &record;
+}
+
+void furi_record_close(const char* name) {
+    UNUSED(name);
+}
+
+/* threads */
+
+/// Host stack of each thread we start, big enough for the sanitizers whatever the app asked for
+#define HOSTSIM_STACK_REGION (1024 * 1024)
+/// What a stack is painted with before the thread starts, same as FreeRTOS
+#define HOSTSIM_STACK_FILL 0xa5
+
+struct FuriThread {
+    pthread_t pthread;
+    bool started;
+    FuriThreadCallback callback;
+    void* context;
+    size_t stack_size;
+    int32_t ret;
+    // painted before the thread starts, the watermark counts down from where the callback was
+    // entered so glibc's and the sanitizers' own use of the region isn't counted
+    uint8_t* stack;
+    uintptr_t stack_entry;
+
+    pthread_mutex_t flags_mutex;
+    pthread_cond_t flags_cond;
+    uint32_t flags;
+};
+
+static __thread FuriThread* hostsim_current_thread;
+
+static FuriThread* hostsim_thread_new(void) {
+    FuriThread* thread = calloc(1, sizeof(FuriThread));
+    pthread_mutex_init(&thread->flags_mutex, NULL);
+    pthread_cond_init(&thread->flags_cond, NULL);
+    return thread;
+}
+
+static FuriThread* hostsim_thread_self(void) {
+    // threads we didn't start (main) get a record the first time they touch flags
+    if(hostsim_current_thread == NULL) {
+        hostsim_current_thread = hostsim_thread_new();
+    }
+    return hostsim_current_thread;
+}
+
+FuriThread* furi_thread_alloc(void) {
+    return hostsim_thread_new();
+}
+
+FuriThread* furi_thread_alloc_ex(
+    const char* name,
+    uint32_t stack_size,
+    FuriThreadCallback callback,
+    void* context) {
+    FuriThread* thread = furi_thread_alloc();
+    furi_thread_set_name(thread, name);
+    furi_thread_set_stack_size(thread, stack_size);
+    furi_thread_set_callback(thread, callback);
+    furi_thread_set_context(thread, context);
+    return thread;
+}
+
+void furi_thread_free(FuriThread* thread) {
+    if(thread->stack != NULL) {
+        munmap(thread->stack, HOSTSIM_STACK_REGION);
+    }
+    pthread_mutex_destroy(&thread->flags_mutex);
+    pthread_cond_destroy(&thread->flags_cond);
+    free(thread);
+}
+
+void furi_thread_set_name(FuriThread* thread, const char* name) {
+    UNUSED(thread);
+    UNUSED(name);
+}
+
+void furi_thread_set_stack_size(FuriThread* thread, size_t stack_size) {
+    thread->stack_size = stack_size;
+}
+
+void furi_thread_set_context(FuriThread* thread, void* context) {
+    thread->context = context;
+}
+
+void furi_thread_set_callback(FuriThread* thread, FuriThreadCallback callback) {
+    thread->callback = callback;
+}
+
+static void* hostsim_thread_body(void* arg) {
+    FuriThread* thread = arg;
+    hostsim_current_thread = thread;
+    __atomic_store_n(
+        &thread->stack_entry, (uintptr_t)__builtin_frame_address(0), __ATOMIC_RELEASE);
+    thread->ret = thread->callback(thread->context);
+    return NULL;
+}
+
+void furi_thread_start(FuriThread* thread) {
+    furi_check(thread->callback);
+    // the region is far bigger than the flipper's stack so the sanitizers aren't squeezed, only
+    // the painted bytes below the entry frame tell how much the app's stack would have taken
+    if(thread->stack == NULL) {
+        thread->stack = mmap(
+            NULL,
+            HOSTSIM_STACK_REGION,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK,
+            -1,
+            0);
+        furi_check(thread->stack != MAP_FAILED);
+    }
+    memset(thread->stack, HOSTSIM_STACK_FILL, HOSTSIM_STACK_REGION);
+    thread->stack_entry = 0;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, thread->stack, HOSTSIM_STACK_REGION);
+    furi_check(pthread_create(&thread->pthread, &attr, hostsim_thread_body, thread) == 0);
+    pthread_attr_destroy(&attr);
+    thread->started = true;
+}
+
+bool furi_thread_join(FuriThread* thread) {
+    if(thread->started) {
+        pthread_join(thread->pthread, NULL);
+        thread->started = false;
+    }
+    return true;
+}
+
+FuriThreadId furi_thread_get_id(FuriThread* thread) {
+    return thread;
+}
+
+FuriThreadId furi_thread_get_current_id(void) {
+    return hostsim_thread_self();
+}
+
+// reads another thread's stack, which asan has poisoned around that thread's locals
+__attribute__((no_sanitize("address"))) uint32_t
+    furi_thread_get_stack_space(FuriThreadId thread_id) {
+    FuriThread* thread = thread_id;
+    if(thread == NULL) {
+        return 0;
+    }
+    uintptr_t entry = __atomic_load_n(&thread->stack_entry, __ATOMIC_ACQUIRE);
+    // threads we didn't start have no painted stack, report them as untouched
+    if(thread->stack == NULL || entry == 0) {
+        return thread->stack_size;
+    }
+    // stacks grow down, the first byte off the fill from the bottom is as deep as it went
+    size_t untouched = 0;
+    while(untouched < HOSTSIM_STACK_REGION && thread->stack[untouched] == HOSTSIM_STACK_FILL) {
+        untouched++;
+    }
+    uintptr_t deepest = (uintptr_t)&thread->stack[untouched];
+    size_t used = deepest < entry ? entry - deepest : 0;
+    return used < thread->stack_size ? thread->stack_size - used : 0;
+}
+
+uint32_t furi_thread_flags_set(FuriThreadId thread_id, uint32_t flags) {
+    FuriThread* thread = thread_id;
+    pthread_mutex_lock(&thread->flags_mutex);
+    thread->flags |= flags;
+    uint32_t ret = thread->flags;
+    pthread_cond_broadcast(&thread->flags_cond);
+    pthread_mutex_unlock(&thread->flags_mutex);
+    return ret;
+}
+
+uint32_t furi_thread_flags_clear(uint32_t flags) {
+    FuriThread* thread = hostsim_thread_self();
+    pthread_mutex_lock(&thread->flags_mutex);
+    uint32_t ret = thread->flags;
+    thread->flags &= ~flags;
+    pthread_mutex_unlock(&thread->flags_mutex);
+    return ret;
+}
+
+uint32_t furi_thread_flags_wait(uint32_t flags, uint32_t options, uint32_t timeout) {
+    FuriThread* thread = hostsim_thread_self();
+    struct timespec deadline;
+    hostsim_deadline(&deadline, timeout);
+
+    pthread_mutex_lock(&thread->flags_mutex);
+    uint32_t ret;
+    while(true) {
+        uint32_t match = thread->flags & flags;
+        bool done = (options & FuriFlagWaitAll) ? (match == flags) : (match != 0);
+        if(done) {
+            ret = match;
+            if(!(options & FuriFlagNoClear)) {
+                thread->flags &= ~match;
+            }
+            break;
+        }
+        if(timeout == 0 ||
+           !hostsim_cond_wait(&thread->flags_cond, &thread->flags_mutex, timeout, &deadline)) {
+            ret = (uint32_t)FuriFlagErrorTimeout;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&thread->flags_mutex);
+    return ret;
+}
+
+/* mutex */
+
+struct FuriMutex {
+    pthread_mutex_t mutex;
+};
+
+FuriMutex* furi_mutex_alloc(FuriMutexType type) {
+    FuriMutex* instance = malloc(sizeof(FuriMutex));
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    if(type == FuriMutexTypeRecursive) {
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    }
+    pthread_mutex_init(&instance->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    return instance;
+}
+
+void furi_mutex_free(FuriMutex* instance) {
+    pthread_mutex_destroy(&instance->mutex);
+    free(instance);
+}
+
+FuriStatus furi_mutex_acquire(FuriMutex* instance, uint32_t timeout) {
+    if(timeout == FuriWaitForever) {
+        pthread_mutex_lock(&instance->mutex);
+        return FuriStatusOk;
+    }
+    struct timespec deadline;
+    hostsim_deadline(&deadline, timeout);
+    return pthread_mutex_timedlock(&instance->mutex, &deadline) == 0 ? FuriStatusOk :
+                                                                      FuriStatusErrorTimeout;
+}
+
+FuriStatus furi_mutex_release(FuriMutex* instance) {
+    pthread_mutex_unlock(&instance->mutex);
+    return FuriStatusOk;
+}
+
+/* semaphore */
+
+struct FuriSemaphore {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint32_t max_count;
+    uint32_t count;
+};
+
+FuriSemaphore* furi_semaphore_alloc(uint32_t max_count, uint32_t initial_count) {
+    FuriSemaphore* instance = calloc(1, sizeof(FuriSemaphore));
+    pthread_mutex_init(&instance->mutex, NULL);
+    pthread_cond_init(&instance->cond, NULL);
+    instance->max_count = max_count;
+    instance->count = initial_count;
+    return instance;
+}
+
+void furi_semaphore_free(FuriSemaphore* instance) {
+    pthread_mutex_destroy(&instance->mutex);
+    pthread_cond_destroy(&instance->cond);
+    free(instance);
+}
+
+FuriStatus furi_semaphore_acquire(FuriSemaphore* instance, uint32_t timeout) {
+    struct timespec deadline;
+    hostsim_deadline(&deadline, timeout);
+
+    pthread_mutex_lock(&instance->mutex);
+    while(instance->count == 0) {
+        if(timeout == 0 || !hostsim_cond_wait(&instance->cond, &instance->mutex, timeout, &deadline)) {
+            pthread_mutex_unlock(&instance->mutex);
+            return timeout == 0 ? FuriStatusErrorResource : FuriStatusErrorTimeout;
+        }
+    }
+    instance->count--;
+    pthread_mutex_unlock(&instance->mutex);
+    return FuriStatusOk;
+}
+
+FuriStatus furi_semaphore_release(FuriSemaphore* instance) {
+    FuriStatus status = FuriStatusErrorResource;
+    pthread_mutex_lock(&instance->mutex);
+    if(instance->count < instance->max_count) {
+        instance->count++;
+        pthread_cond_broadcast(&instance->cond);
+        status = FuriStatusOk;
+    }
+    pthread_mutex_unlock(&instance->mutex);
+    return status;
+}
+
+/* stream buffer */
+
+struct FuriStreamBuffer {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint8_t* data;
+    size_t size;
+    size_t head;
+    size_t count;
+};
+
+FuriStreamBuffer* furi_stream_buffer_alloc(size_t size, size_t trigger_level) {
+    UNUSED(trigger_level);
+    FuriStreamBuffer* stream_buffer = calloc(1, sizeof(FuriStreamBuffer));
+    pthread_mutex_init(&stream_buffer->mutex, NULL);
+    pthread_cond_init(&stream_buffer->cond, NULL);
+    stream_buffer->data = malloc(size);
+    stream_buffer->size = size;
+    return stream_buffer;
+}
+
+void furi_stream_buffer_free(FuriStreamBuffer* stream_buffer) {
+    pthread_mutex_destroy(&stream_buffer->mutex);
+    pthread_cond_destroy(&stream_buffer->cond);
+    free(stream_buffer->data);
+    free(stream_buffer);
+}
+
+size_t furi_stream_buffer_send(
+    FuriStreamBuffer* stream_buffer,
+    const void* data,
+    size_t length,
+    uint32_t timeout) {
+    UNUSED(timeout);
+    pthread_mutex_lock(&stream_buffer->mutex);
+    size_t sent = 0;
+    const uint8_t* bytes = data;
+    while(sent < length && stream_buffer->count < stream_buffer->size) {
+        size_t tail = (stream_buffer->head + stream_buffer->count) % stream_buffer->size;
+        stream_buffer->data[tail] = bytes[sent++];
+        stream_buffer->count++;
+    }
+    pthread_cond_broadcast(&stream_buffer->cond);
+    pthread_mutex_unlock(&stream_buffer->mutex);
+    return sent;
+}
+
+size_t furi_stream_buffer_receive(
+    FuriStreamBuffer* stream_buffer,
+    void* data,
+    size_t length,
+    uint32_t timeout) {
+    struct timespec deadline;
+    hostsim_deadline(&deadline, timeout);
+
+    pthread_mutex_lock(&stream_buffer->mutex);
+    while(stream_buffer->count == 0 && timeout != 0) {
+        if(!hostsim_cond_wait(&stream_buffer->cond, &stream_buffer->mutex, timeout, &deadline)) {
+            break;
+        }
+    }
+    size_t received = 0;
+    uint8_t* bytes = data;
+    while(received < length && stream_buffer->count > 0) {
+        bytes[received++] = stream_buffer->data[stream_buffer->head];
+        stream_buffer->head = (stream_buffer->head + 1) % stream_buffer->size;
+        stream_buffer->count--;
+    }
+    pthread_mutex_unlock(&stream_buffer->mutex);
+    return received;
+}
+
+size_t furi_stream_buffer_bytes_available(FuriStreamBuffer* stream_buffer) {
+    pthread_mutex_lock(&stream_buffer->mutex);
+    size_t count = stream_buffer->count;
+    pthread_mutex_unlock(&stream_buffer->mutex);
+    return count;
+}
+
+size_t furi_stream_buffer_spaces_available(FuriStreamBuffer* stream_buffer) {
+    return stream_buffer->size - furi_stream_buffer_bytes_available(stream_buffer);
+}
+
+bool furi_stream_buffer_is_empty(FuriStreamBuffer* stream_buffer) {
+    return furi_stream_buffer_bytes_available(stream_buffer) == 0;
+}
+
+FuriStatus furi_stream_buffer_reset(FuriStreamBuffer* stream_buffer) {
+    pthread_mutex_lock(&stream_buffer->mutex);
+    stream_buffer->head = 0;
+    stream_buffer->count = 0;
+    pthread_mutex_unlock(&stream_buffer->mutex);
+    return FuriStatusOk;
+}
+
+/* message queue */
+
+struct FuriMessageQueue {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint8_t* data;
+    uint32_t msg_count;
+    uint32_t msg_size;
+    uint32_t head;
+    uint32_t count;
+};
+
+FuriMessageQueue* furi_message_queue_alloc(uint32_t msg_count, uint32_t msg_size) {
+    FuriMessageQueue* instance = calloc(1, sizeof(FuriMessageQueue));
+    pthread_mutex_init(&instance->mutex, NULL);
+    pthread_cond_init(&instance->cond, NULL);
+    instance->data = malloc((size_t)msg_count * msg_size);
+    instance->msg_count = msg_count;
+    instance->msg_size = msg_size;
+    return instance;
+}
+
+void furi_message_queue_free(FuriMessageQueue* instance) {
+    pthread_mutex_destroy(&instance->mutex);
+    pthread_cond_destroy(&instance->cond);
+    free(instance->data);
+    free(instance);
+}
+
+FuriStatus furi_message_queue_put(FuriMessageQueue* instance, const void* msg_ptr, uint32_t timeout) {
+    struct timespec deadline;
+    hostsim_deadline(&deadline, timeout);
+
+    pthread_mutex_lock(&instance->mutex);
+    while(instance->count == instance->msg_count) {
+        if(timeout == 0 || !hostsim_cond_wait(&instance->cond, &instance->mutex, timeout, &deadline)) {
+            pthread_mutex_unlock(&instance->mutex);
+            return FuriStatusErrorTimeout;
+        }
+    }
+    uint32_t tail = (instance->head + instance->count) % instance->msg_count;
+    memcpy(instance->data + (size_t)tail * instance->msg_size, msg_ptr, instance->msg_size);
+    instance->count++;
+    pthread_cond_broadcast(&instance->cond);
+    pthread_mutex_unlock(&instance->mutex);
+    return FuriStatusOk;
+}
+
+FuriStatus furi_message_queue_get(FuriMessageQueue* instance, void* msg_ptr, uint32_t timeout) {
+    struct timespec deadline;
+    hostsim_deadline(&deadline, timeout);
+
+    pthread_mutex_lock(&instance->mutex);
+    while(instance->count == 0) {
+        if(timeout == 0 || !hostsim_cond_wait(&instance->cond, &instance->mutex, timeout, &deadline)) {
+            pthread_mutex_unlock(&instance->mutex);
+            return FuriStatusErrorTimeout;
+        }
+    }
+    memcpy(msg_ptr, instance->data + (size_t)instance->head * instance->msg_size, instance->msg_size);
+    instance->head = (instance->head + 1) % instance->msg_count;
+    instance->count--;
+    pthread_cond_broadcast(&instance->cond);
+    pthread_mutex_unlock(&instance->mutex);
+    return FuriStatusOk;
+}
+
+uint32_t furi_message_queue_get_count(FuriMessageQueue* instance) {
+    pthread_mutex_lock(&instance->mutex);
+    uint32_t count = instance->count;
+    pthread_mutex_unlock(&instance->mutex);
+    return count;
+}
+
+uint32_t furi_message_queue_get_space(FuriMessageQueue* instance) {
+    return instance->msg_count - furi_message_queue_get_count(instance);
+}
+
+FuriStatus furi_message_queue_reset(FuriMessageQueue* instance) {
+    pthread_mutex_lock(&instance->mutex);
+    instance->head = 0;
+    instance->count = 0;
+    pthread_cond_broadcast(&instance->cond);
+    pthread_mutex_unlock(&instance->mutex);
+    return FuriStatusOk;
+}
+
+/* timers, one thread per timer is plenty for the handful the app uses */
+
+struct FuriTimer {
+    FuriTimerCallback callback;
+    FuriTimerType type;
+    void* context;
+
+    pthread_t pthread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool thread_running;
+    bool armed;
+    bool quit;
+    uint32_t period;
+    uint64_t generation;
+};
+
+static void* hostsim_timer_body(void* arg) {
+    FuriTimer* timer = arg;
+    pthread_mutex_lock(&timer->mutex);
+    while(!timer->quit) {
+        if(!timer->armed) {
+            pthread_cond_wait(&timer->cond, &timer->mutex);
+            continue;
+        }
+        uint64_t generation = timer->generation;
+        struct timespec deadline;
+        hostsim_deadline(&deadline, timer->period);
+        while(!timer->quit && timer->armed && generation == timer->generation) {
+            if(pthread_cond_timedwait(&timer->cond, &timer->mutex, &deadline) == ETIMEDOUT) {
+                break;
+            }
+        }
+        if(timer->quit || !timer->armed || generation != timer->generation) {
+            continue;
+        }
+        if(timer->type == FuriTimerTypeOnce) {
+            timer->armed = false;
+        }
+        pthread_mutex_unlock(&timer->mutex);
+        timer->callback(timer->context);
+        pthread_mutex_lock(&timer->mutex);
+    }
+    pthread_mutex_unlock(&timer->mutex);
+    return NULL;
+}
+
+FuriTimer* furi_timer_alloc(FuriTimerCallback func, FuriTimerType type, void* context) {
+    FuriTimer* timer = calloc(1, sizeof(FuriTimer));
+    timer->callback = func;
+    timer->type = type;
+    timer->context = context;
+    pthread_mutex_init(&timer->mutex, NULL);
+    pthread_cond_init(&timer->cond, NULL);
+    pthread_create(&timer->pthread, NULL, hostsim_timer_body, timer);
+    timer->thread_running = true;
+    return timer;
+}
+
+void furi_timer_free(FuriTimer* instance) {
+    pthread_mutex_lock(&instance->mutex);
+    instance->quit = true;
+    pthread_cond_broadcast(&instance->cond);
+    pthread_mutex_unlock(&instance->mutex);
+    pthread_join(instance->pthread, NULL);
+    pthread_mutex_destroy(&instance->mutex);
+    pthread_cond_destroy(&instance->cond);
+    free(instance);
+}
+
+FuriStatus furi_timer_start(FuriTimer* instance, uint32_t ticks) {
+    pthread_mutex_lock(&instance->mutex);
+    instance->period = ticks;
+    instance->armed = true;
+    instance->generation++;
+    pthread_cond_broadcast(&instance->cond);
+    pthread_mutex_unlock(&instance->mutex);
+    return FuriStatusOk;
+}
+
+FuriStatus furi_timer_stop(FuriTimer* instance) {
+    pthread_mutex_lock(&instance->mutex);
+    instance->armed = false;
+    instance->generation++;
+    pthread_cond_broadcast(&instance->cond);
+    pthread_mutex_unlock(&instance->mutex);
+    return FuriStatusOk;
+}
+
+uint32_t furi_timer_is_running(FuriTimer* instance) {
+    pthread_mutex_lock(&instance->mutex);
+    uint32_t armed = instance->armed;
+    pthread_mutex_unlock(&instance->mutex);
+    return armed;
+}
+
+size_t memmgr_get_free_heap(void) {
+    return 0;
+}
+
+size_t memmgr_get_minimum_free_heap(void) {
+    return 0;
+}
+
+/* critical sections */
+
+static pthread_mutex_t hostsim_critical_mutex;
+static pthread_once_t hostsim_critical_once = PTHREAD_ONCE_INIT;
+
+static void hostsim_critical_init(void) {
+    // critical sections nest on the flipper
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&hostsim_critical_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+void hostsim_critical_enter(void) {
+    pthread_once(&hostsim_critical_once, hostsim_critical_init);
+    pthread_mutex_lock(&hostsim_critical_mutex);
+}
+
+void hostsim_critical_exit(void) {
+    pthread_mutex_unlock(&hostsim_critical_mutex);
+}
+
+/* strings */
+
+struct FuriString {
+    char* data;
+    size_t size;
+    size_t capacity;
+};
+
+static void hostsim_string_reserve(FuriString* string, size_t size) {
+    if(size + 1 > string->capacity) {
+        string->capacity = MAX(size + 1, string->capacity * 2);
+        string->data = realloc(string->data, string->capacity);
+        furi_check(string->data);
+    }
+}
+
+static int hostsim_string_vcat(FuriString* string, const char* format, va_list args) {
+    va_list copy;
+    va_copy(copy, args);
+    int len = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+    if(len > 0) {
+        hostsim_string_reserve(string, string->size + len);
+        vsnprintf(string->data + string->size, len + 1, format, args);
+        string->size += len;
+    }
+    return len;
+}
+
+FuriString* furi_string_alloc(void) {
+    FuriString* string = calloc(1, sizeof(FuriString));
+    hostsim_string_reserve(string, 0);
+    string->data[0] = '\0';
+    return string;
+}
+
+FuriString* furi_string_alloc_printf(const char* format, ...) {
+    FuriString* string = furi_string_alloc();
+    va_list args;
+    va_start(args, format);
+    hostsim_string_vcat(string, format, args);
+    va_end(args);
+    return string;
+}
+
+void furi_string_free(FuriString* string) {
+    free(string->data);
+    free(string);
+}
+
+void furi_string_reset(FuriString* string) {
+    string->size = 0;
+    string->data[0] = '\0';
+}
+
+int furi_string_printf(FuriString* string, const char* format, ...) {
+    furi_string_reset(string);
+    va_list args;
+    va_start(args, format);
+    int len = hostsim_string_vcat(string, format, args);
+    va_end(args);
+    return len;
+}
+
+int furi_string_cat_printf(FuriString* string, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int len = hostsim_string_vcat(string, format, args);
+    va_end(args);
+    return len;
+}
+
+void furi_string_cat_str(FuriString* string, const char* str) {
+    size_t len = strlen(str);
+    hostsim_string_reserve(string, string->size + len);
+    memcpy(string->data + string->size, str, len + 1);
+    string->size += len;
+}
+
+const char* furi_string_get_cstr(const FuriString* string) {
+    return string->data;
+}
+
+size_t furi_string_size(const FuriString* string) {
+    return string->size;
+}
+
+/* storage, /ext lives in a directory on the host */
+
+struct File {
+    FILE* file;
+};
+
+static void hostsim_storage_path(const char* path, char* out, size_t out_size) {
+    const char* root = getenv("HOSTSIM_SD");
+    if(root == NULL) {
+        root = "build/sd";
+    }
+    if(strncmp(path, "/ext", 4) == 0) {
+        path += 4;
+    }
+    snprintf(out, out_size, "%s%s", root, path);
+}
+
+File* storage_file_alloc(Storage* storage) {
+    UNUSED(storage);
+    return calloc(1, sizeof(File));
+}
+
+void storage_file_free(File* file) {
+    storage_file_close(file);
+    free(file);
+}
+
+bool storage_file_open(File* file, const char* path, FS_AccessMode access_mode, FS_OpenMode open_mode) {
+    char host_path[512];
+    hostsim_storage_path(path, host_path, sizeof(host_path));
+
+    const char* mode = "rb";
+    if(access_mode & FSAM_WRITE) {
+        if(open_mode & FSOM_OPEN_APPEND) {
+            mode = access_mode & FSAM_READ ? "a+b" : "ab";
+        } else if(open_mode & (FSOM_CREATE_ALWAYS | FSOM_CREATE_NEW)) {
+            mode = access_mode & FSAM_READ ? "w+b" : "wb";
+        } else {
+            mode = "r+b";
+        }
+    }
+    file->file = fopen(host_path, mode);
+    if(file->file == NULL && (open_mode & FSOM_OPEN_ALWAYS) && (access_mode & FSAM_WRITE)) {
+        file->file = fopen(host_path, "w+b");
+    }
+    return file->file != NULL;
+}
+
+bool storage_file_close(File* file) {
+    if(file->file) {
+        fclose(file->file);
+        file->file = NULL;
+    }
+    return true;
+}
+
+bool storage_file_is_open(File* file) {
+    return file->file != NULL;
+}
+
+uint16_t storage_file_read(File* file, void* buff, uint16_t bytes_to_read) {
+    return file->file ? fread(buff, 1, bytes_to_read, file->file) : 0;
+}
+
+uint16_t storage_file_write(File* file, const void* buff, uint16_t bytes_to_write) {
+    return file->file ? fwrite(buff, 1, bytes_to_write, file->file) : 0;
+}
+
+bool storage_file_seek(File* file, uint32_t offset, bool from_start) {
+    return file->file && fseek(file->file, offset, from_start ? SEEK_SET : SEEK_CUR) == 0;
+}
+
+uint64_t storage_file_tell(File* file) {
+    return file->file ? (uint64_t)ftell(file->file) : 0;
+}
+
+uint64_t storage_file_size(File* file) {
+    if(file->file == NULL) {
+        return 0;
+    }
+    long pos = ftell(file->file);
+    fseek(file->file, 0, SEEK_END);
+    long size = ftell(file->file);
+    fseek(file->file, pos, SEEK_SET);
+    return size;
+}
+
+bool storage_file_truncate(File* file) {
+    // like the real one, cuts the file off at the current position
+    return file->file && fflush(file->file) == 0 &&
+           ftruncate(fileno(file->file), ftell(file->file)) == 0;
+}
+
+bool storage_file_eof(File* file) {
+    if(file->file == NULL) {
+        return true;
+    }
+    return storage_file_tell(file) >= storage_file_size(file);
+}
+
+FS_Error storage_common_remove(Storage* storage, const char* path) {
+    UNUSED(storage);
+    char host_path[512];
+    hostsim_storage_path(path, host_path, sizeof(host_path));
+    return remove(host_path) == 0 ? FSE_OK : FSE_NOT_EXIST;
+}
+
+FS_Error storage_common_rename(Storage* storage, const char* old_path, const char* new_path) {
+    UNUSED(storage);
+    char host_old[512];
+    char host_new[512];
+    hostsim_storage_path(old_path, host_old, sizeof(host_old));
+    hostsim_storage_path(new_path, host_new, sizeof(host_new));
+    return rename(host_old, host_new) == 0 ? FSE_OK : FSE_INTERNAL;
+}
+
+bool storage_simply_mkdir(Storage* storage, const char* path) {
+    UNUSED(storage);
+    char host_path[512];
+    hostsim_storage_path(path, host_path, sizeof(host_path));
+    // make the root too, so a fresh build dir works
+    char* slash = host_path;
+    while((slash = strchr(slash + 1, '/')) != NULL) {
+        *slash = '\0';
+        mkdir(host_path, 0755);
+        *slash = '/';
+    }
+    return mkdir(host_path, 0755) == 0 || errno == EEXIST;
+}
+
+/* random */
+
+uint32_t furi_hal_random_get(void) {
+    static __thread uint32_t state;
+    if(state == 0) {
+        state = (uint32_t)hostsim_monotonic_ns() | 1;
+    }
+    // xorshift32
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+/* rtc, the host's wall clock unless told otherwise */
+
+static bool hostsim_rtc_configured;
+static int64_t hostsim_rtc_offset_ns;
+static double hostsim_rtc_drift_ppm;
+
+void hostsim_rtc_set(int64_t offset_ms, double drift_ppm) {
+    hostsim_rtc_offset_ns = offset_ms * 1000000LL;
+    hostsim_rtc_drift_ppm = drift_ppm;
+    hostsim_rtc_configured = true;
+}
+
+uint32_t furi_hal_rtc_get_timestamp(void) {
+    if(!hostsim_rtc_configured) {
+        return (uint32_t)time(NULL);
+    }
+    uint64_t now = hostsim_monotonic_ns();
+    int64_t ns = (int64_t)now + hostsim_rtc_offset_ns + (int64_t)(now * hostsim_rtc_drift_ppm / 1e6);
+    // only whole seconds, like the flipper's
+    return (uint32_t)(ns / 1000000000LL);
+}
+
+/* power, there is no fuel gauge on the host so nothing is drawn */
+
+float furi_hal_power_get_battery_current(FuriHalPowerIC ic) {
+    UNUSED(ic);
+    return 0;
+}
+
+/* uart and usb, each a wire on a pty. the uarts are paced at the emulated baud with optional line
+ * noise, usb goes as fast as the pty does. every wire is on the same pty unless it was given one of
+ * its own */
+
+typedef enum {
+    HostsimWireUsart,
+    HostsimWireLpuart,
+    HostsimWireUsb,
+    HostsimWireNum,
+} HostsimWireId;
+
+typedef struct {
+    // -1 for the shared pty
+    int fd;
+    uint32_t noise_state;
+    uint32_t corrupted;
+    pthread_mutex_t noise_mutex;
+
+    // whoever the reader hands bytes to, the uart's irq or usb's rx endpoint
+    void (*irq_cb)(UartIrqEvent event, uint8_t data, void* context);
+    void* irq_context;
+    CdcCallbacks* cdc;
+    void* cdc_context;
+    // a usb packet, taken by furi_hal_cdc_receive from inside the rx endpoint callback
+    uint8_t cdc_rx[CDC_DATA_SZ];
+    size_t cdc_rx_length;
+    pthread_mutex_t irq_mutex;
+
+    pthread_t rx_thread;
+    volatile bool rx_running;
+    // time the wire is free again, per direction
+    uint64_t rx_wire_free_ns;
+    uint64_t tx_wire_free_ns;
+} HostsimUart;
+
+#define HOSTSIM_WIRE_INIT                         \
+    {                                             \
+        .fd = -1,                                 \
+        .noise_mutex = PTHREAD_MUTEX_INITIALIZER, \
+        .irq_mutex = PTHREAD_MUTEX_INITIALIZER,   \
+    }
+
+static HostsimUart hostsim_wires[HostsimWireNum] = {
+    HOSTSIM_WIRE_INIT,
+    HOSTSIM_WIRE_INIT,
+    HOSTSIM_WIRE_INIT,
+};
+
+static int hostsim_uart_fd = -1;
+static uint32_t hostsim_uart_baud;
+static double hostsim_uart_noise;
+
+static FuriHalUsbInterface* hostsim_usb_config = &usb_cdc_single;
+
+FuriHalUsbInterface usb_cdc_single = {.name = "cdc single"};
+FuriHalUsbInterface usb_cdc_dual = {.name = "cdc dual"};
+
+static HostsimUart* hostsim_uart_wire_of(FuriHalUartId channel) {
+    return &hostsim_wires[channel == FuriHalUartIdUSART1 ? HostsimWireUsart : HostsimWireLpuart];
+}
+
+static int hostsim_uart_fd_of(const HostsimUart* wire) {
+    return wire->fd >= 0 ? wire->fd : hostsim_uart_fd;
+}
+
+void hostsim_uart_set_fd(int fd) {
+    hostsim_uart_fd = fd;
+}
+
+void hostsim_uart_set_channel_fd(FuriHalUartId channel, int fd) {
+    hostsim_uart_wire_of(channel)->fd = fd;
+}
+
+int hostsim_uart_get_fd(void) {
+    return hostsim_uart_fd;
+}
+
+void hostsim_uart_set_emulated_baud(uint32_t baud) {
+    hostsim_uart_baud = baud;
+}
+
+void hostsim_uart_set_noise(double probability, uint32_t seed) {
+    hostsim_uart_noise = probability;
+    for(size_t i = 0; i < HostsimWireNum; i++) {
+        // the lpuart keeps the noise a given seed always had
+        uint32_t state = seed + (i + HostsimWireNum - HostsimWireLpuart) % HostsimWireNum;
+        hostsim_wires[i].noise_state = state ? state : 1;
+    }
+}
+
+uint32_t hostsim_uart_get_corrupted(void) {
+    uint32_t corrupted = 0;
+    for(size_t i = 0; i < HostsimWireNum; i++) {
+        corrupted += hostsim_wires[i].corrupted;
+    }
+    return corrupted;
+}
+
+static uint8_t hostsim_uart_wire(HostsimUart* wire, uint8_t byte) {
+    if(hostsim_uart_noise <= 0) {
+        return byte;
+    }
+
+    pthread_mutex_lock(&wire->noise_mutex);
+    uint32_t state = wire->noise_state;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    double roll = (double)state / (double)UINT32_MAX;
+    if(roll < hostsim_uart_noise) {
+        byte ^= (uint8_t)(1 << (state % 8));
+        wire->corrupted++;
+    }
+    wire->noise_state = state;
+    pthread_mutex_unlock(&wire->noise_mutex);
+    return byte;
+}
+
+/// How far the wire can fall behind the clock before it counts as having gone idle
+#define HOSTSIM_UART_PACE_SLACK_NS 1000000ULL
+
+/// How often the reader looks at whether it should stop
+#define HOSTSIM_UART_POLL_MS 10
+
+// sleep until a byte started at the wire's free time would have finished arriving
+static void hostsim_uart_pace(uint64_t* wire_free_ns) {
+    if(hostsim_uart_baud == 0) {
+        return;
+    }
+    // 8N1, 10 bits on the wire per byte
+    uint64_t byte_ns = 10ULL * 1000000000ULL / hostsim_uart_baud;
+    uint64_t now = hostsim_monotonic_ns();
+    // a wire that only just went free was kept busy by bytes that were already waiting, waking
+    // late from the last sleep must not stretch the gap between them
+    uint64_t start = *wire_free_ns + HOSTSIM_UART_PACE_SLACK_NS > now ? *wire_free_ns : now;
+    uint64_t done = start + byte_ns;
+    *wire_free_ns = done;
+    if(done > now) {
+        struct timespec ts = {
+            .tv_sec = (done - now) / 1000000000ULL,
+            .tv_nsec = (done - now) % 1000000000ULL,
+        };
+        nanosleep(&ts, NULL);
+    }
+}
+
+static void hostsim_uart_deliver(HostsimUart* wire, const uint8_t* buf, size_t length) {
+    for(size_t i = 0; i < length;) {
+        pthread_mutex_lock(&wire->irq_mutex);
+        if(wire->cdc) {
+            // a packet at a time, like the endpoint
+            wire->cdc_rx_length = MIN(length - i, (size_t)CDC_DATA_SZ);
+            memcpy(wire->cdc_rx, &buf[i], wire->cdc_rx_length);
+            i += wire->cdc_rx_length;
+            wire->cdc->rx_ep_callback(wire->cdc_context);
+            wire->cdc_rx_length = 0;
+            pthread_mutex_unlock(&wire->irq_mutex);
+            continue;
+        }
+        pthread_mutex_unlock(&wire->irq_mutex);
+
+        hostsim_uart_pace(&wire->rx_wire_free_ns);
+        uint8_t byte = hostsim_uart_wire(wire, buf[i++]);
+
+        pthread_mutex_lock(&wire->irq_mutex);
+        if(wire->irq_cb) {
+            wire->irq_cb(UartIrqEventRXNE, byte, wire->irq_context);
+        }
+        pthread_mutex_unlock(&wire->irq_mutex);
+    }
+}
+
+static void* hostsim_uart_rx_body(void* arg) {
+    HostsimUart* wire = arg;
+    uint8_t buf[256];
+    struct pollfd pfd = {.fd = hostsim_uart_fd_of(wire), .events = POLLIN};
+    while(wire->rx_running) {
+        // woken up now and then to see if the wire was handed to someone else
+        int ready = poll(&pfd, 1, HOSTSIM_UART_POLL_MS);
+        if(ready == 0 || (ready < 0 && errno == EINTR)) {
+            continue;
+        }
+        ssize_t length = ready < 0 ? -1 : read(pfd.fd, buf, sizeof(buf));
+        if(length <= 0) {
+            if(length < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+            break;
+        }
+        hostsim_uart_deliver(wire, buf, length);
+    }
+    return NULL;
+}
+
+static void hostsim_uart_start(HostsimUart* wire) {
+    if(wire->rx_running || hostsim_uart_fd_of(wire) < 0) {
+        return;
+    }
+    wire->rx_running = true;
+    pthread_create(&wire->rx_thread, NULL, hostsim_uart_rx_body, wire);
+}
+
+/**
+ * Stop reading once neither the uart nor usb listens, so another backend can have the pty
+ */
+static void hostsim_uart_stop_unused(HostsimUart* wire) {
+    pthread_mutex_lock(&wire->irq_mutex);
+    bool unused = wire->irq_cb == NULL && wire->cdc == NULL;
+    pthread_mutex_unlock(&wire->irq_mutex);
+    if(unused && wire->rx_running) {
+        wire->rx_running = false;
+        pthread_join(wire->rx_thread, NULL);
+    }
+}
+
+void furi_hal_uart_init(FuriHalUartId channel, uint32_t baud) {
+    UNUSED(channel);
+    UNUSED(baud);
+}
+
+void furi_hal_uart_deinit(FuriHalUartId channel) {
+    UNUSED(channel);
+}
+
+void furi_hal_uart_set_br(FuriHalUartId channel, uint32_t baud) {
+    UNUSED(channel);
+    UNUSED(baud);
+}
+
+void furi_hal_uart_tx(FuriHalUartId channel, uint8_t* buffer, size_t buffer_size) {
+    HostsimUart* wire = hostsim_uart_wire_of(channel);
+    int fd = hostsim_uart_fd_of(wire);
+    if(fd < 0) {
+        return;
+    }
+    for(size_t i = 0; i < buffer_size; i++) {
+        hostsim_uart_pace(&wire->tx_wire_free_ns);
+        uint8_t byte = hostsim_uart_wire(wire, buffer[i]);
+        while(write(fd, &byte, 1) < 0 && errno == EINTR) {
+        }
+    }
+}
+
+void furi_hal_uart_set_irq_cb(
+    FuriHalUartId channel,
+    void (*cb)(UartIrqEvent event, uint8_t data, void* context),
+    void* context) {
+    HostsimUart* wire = hostsim_uart_wire_of(channel);
+    pthread_mutex_lock(&wire->irq_mutex);
+    wire->irq_cb = cb;
+    wire->irq_context = context;
+    pthread_mutex_unlock(&wire->irq_mutex);
+    // usart1 is set up by the console rather than init, reading starts with the first listener
+    if(cb == NULL) {
+        hostsim_uart_stop_unused(wire);
+    } else {
+        hostsim_uart_start(wire);
+    }
+}
+
+void furi_hal_console_enable(void) {
+}
+
+void furi_hal_console_disable(void) {
+}
+
+FuriHalUsbInterface* furi_hal_usb_get_config(void) {
+    return hostsim_usb_config;
+}
+
+bool furi_hal_usb_set_config(FuriHalUsbInterface* new_if, void* ctx) {
+    UNUSED(ctx);
+    hostsim_usb_config = new_if;
+    return true;
+}
+
+void furi_hal_usb_lock(void) {
+}
+
+void furi_hal_usb_unlock(void) {
+}
+
+void furi_hal_cdc_set_callbacks(uint8_t if_num, CdcCallbacks* cb, void* context) {
+    HostsimUart* wire = &hostsim_wires[HostsimWireUsb];
+    // the cli's interface goes nowhere, the other one of a dual config is the pty
+    if(if_num != 1 || hostsim_usb_config != &usb_cdc_dual) {
+        return;
+    }
+    pthread_mutex_lock(&wire->irq_mutex);
+    wire->cdc = cb;
+    wire->cdc_context = context;
+    pthread_mutex_unlock(&wire->irq_mutex);
+    if(cb == NULL) {
+        hostsim_uart_stop_unused(wire);
+        return;
+    }
+    hostsim_uart_start(wire);
+    // the pty is always open on the other end
+    if(cb->state_callback) {
+        cb->state_callback(context, CdcStateConnected);
+    }
+}
+
+void furi_hal_cdc_send(uint8_t if_num, uint8_t* buf, uint16_t len) {
+    HostsimUart* wire = &hostsim_wires[HostsimWireUsb];
+    int fd = hostsim_uart_fd_of(wire);
+    if(if_num != 1 || fd < 0) {
+        return;
+    }
+    for(size_t written = 0; written < len;) {
+        ssize_t length = write(fd, buf + written, len - written);
+        if(length < 0 && errno == EINTR) continue;
+        if(length < 0) break;
+        written += length;
+    }
+    // taken by the host right away
+    pthread_mutex_lock(&wire->irq_mutex);
+    if(wire->cdc && wire->cdc->tx_ep_callback) {
+        wire->cdc->tx_ep_callback(wire->cdc_context);
+    }
+    pthread_mutex_unlock(&wire->irq_mutex);
+}
+
+int32_t furi_hal_cdc_receive(uint8_t if_num, uint8_t* buf, uint16_t max_len) {
+    HostsimUart* wire = &hostsim_wires[HostsimWireUsb];
+    if(if_num != 1) {
+        return 0;
+    }
+    // only called from the rx endpoint callback, the reader holds the lock
+    size_t length = MIN(wire->cdc_rx_length, (size_t)max_len);
+    memcpy(buf, wire->cdc_rx, length);
+    memmove(wire->cdc_rx, wire->cdc_rx + length, wire->cdc_rx_length - length);
+    wire->cdc_rx_length -= length;
+    return length;
+}
+
+/* views, drawn synchronously on commit so a redraw is observable the moment it is requested */
+
+struct View {
+    void* context;
+    ViewDrawCallback draw_callback;
+    ViewInputCallback input_callback;
+    ViewCustomCallback custom_callback;
+    ViewNavigationCallback previous_callback;
+    ViewCallback enter_callback;
+    ViewCallback exit_callback;
+    ViewModelType model_type;
+    void* model;
+    pthread_mutex_t model_mutex;
+};
+
+static HostsimDrawHook hostsim_draw_hook;
+static void* hostsim_draw_hook_context;
+
+void hostsim_set_draw_hook(HostsimDrawHook hook, void* context) {
+    hostsim_draw_hook = hook;
+    hostsim_draw_hook_context = context;
+}
+
+View* view_alloc(void) {
+    View* view = calloc(1, sizeof(View));
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&view->model_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    return view;
+}
+
+void view_free(View* view) {
+    view_free_model(view);
+    pthread_mutex_destroy(&view->model_mutex);
+    free(view);
+}
+
+void view_set_context(View* view, void* context) {
+    view->context = context;
+}
+
+void view_set_draw_callback(View* view, ViewDrawCallback callback) {
+    view->draw_callback = callback;
+}
+
+void view_set_input_callback(View* view, ViewInputCallback callback) {
+    view->input_callback = callback;
+}
+
+void view_set_custom_callback(View* view, ViewCustomCallback callback) {
+    view->custom_callback = callback;
+}
+
+void view_set_previous_callback(View* view, ViewNavigationCallback callback) {
+    view->previous_callback = callback;
+}
+
+void view_set_enter_callback(View* view, ViewCallback callback) {
+    view->enter_callback = callback;
+}
+
+void view_set_exit_callback(View* view, ViewCallback callback) {
+    view->exit_callback = callback;
+}
+
+void view_allocate_model(View* view, ViewModelType type, size_t size) {
+    view->model_type = type;
+    view->model = calloc(1, size);
+}
+
+void view_free_model(View* view) {
+    free(view->model);
+    view->model = NULL;
+}
+
+void* view_get_model(View* view) {
+    if(view->model_type == ViewModelTypeLocking) {
+        pthread_mutex_lock(&view->model_mutex);
+    }
+    return view->model;
+}
+
+struct Canvas {
+    Font font;
+};
+
+void view_commit_model(View* view, bool update) {
+    if(update) {
+        Canvas canvas = {.font = FontSecondary};
+        if(view->draw_callback) {
+            view->draw_callback(&canvas, view->model);
+        }
+        if(hostsim_draw_hook) {
+            hostsim_draw_hook(view, view->model, hostsim_draw_hook_context);
+        }
+    }
+    if(view->model_type == ViewModelTypeLocking) {
+        pthread_mutex_unlock(&view->model_mutex);
+    }
+}
+
+/* canvas, nothing is rasterized. metrics are close enough to FontSecondary for layout code */
+
+uint8_t canvas_width(Canvas* canvas) {
+    UNUSED(canvas);
+    return 128;
+}
+
+uint8_t canvas_height(Canvas* canvas) {
+    UNUSED(canvas);
+    return 64;
+}
+
+void canvas_clear(Canvas* canvas) {
+    UNUSED(canvas);
+}
+
+void canvas_set_color(Canvas* canvas, Color color) {
+    UNUSED(canvas);
+    UNUSED(color);
+}
+
+void canvas_set_font(Canvas* canvas, Font font) {
+    canvas->font = font;
+}
+
+uint8_t canvas_current_font_height(Canvas* canvas) {
+    return canvas->font == FontPrimary ? 10 : 8;
+}
+
+uint16_t canvas_string_width(Canvas* canvas, const char* str) {
+    uint16_t char_width = canvas->font == FontPrimary ? 6 : 5;
+    return (uint16_t)(strlen(str) * char_width);
+}
+
+void canvas_draw_str(Canvas* canvas, uint8_t x, uint8_t y, const char* str) {
+    UNUSED(canvas);
+    UNUSED(x);
+    UNUSED(y);
+    // still touch every byte so the sanitizers see unterminated strings
+    (void)strlen(str);
+}
+
+void canvas_draw_str_aligned(
+    Canvas* canvas,
+    uint8_t x,
+    uint8_t y,
+    Align horizontal,
+    Align vertical,
+    const char* str) {
+    UNUSED(horizontal);
+    UNUSED(vertical);
+    canvas_draw_str(canvas, x, y, str);
+}
+
+void canvas_draw_icon(Canvas* canvas, uint8_t x, uint8_t y, const Icon* icon) {
+    UNUSED(canvas);
+    UNUSED(x);
+    UNUSED(y);
+    furi_check(icon);
+}
+
+void canvas_draw_line(Canvas* canvas, uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2) {
+    UNUSED(canvas);
+    UNUSED(x1);
+    UNUSED(y1);
+    UNUSED(x2);
+    UNUSED(y2);
+}
+
+void canvas_draw_box(Canvas* canvas, uint8_t x, uint8_t y, uint8_t width, uint8_t height) {
+    UNUSED(canvas);
+    UNUSED(x);
+    UNUSED(y);
+    UNUSED(width);
+    UNUSED(height);
+}
+
+void canvas_draw_frame(Canvas* canvas, uint8_t x, uint8_t y, uint8_t width, uint8_t height) {
+    UNUSED(canvas);
+    UNUSED(x);
+    UNUSED(y);
+    UNUSED(width);
+    UNUSED(height);
+}
+
+void canvas_draw_dot(Canvas* canvas, uint8_t x, uint8_t y) {
+    UNUSED(canvas);
+    UNUSED(x);
+    UNUSED(y);
+}
+
+void canvas_draw_xbm(
+    Canvas* canvas,
+    uint8_t x,
+    uint8_t y,
+    uint8_t w,
+    uint8_t h,
+    const uint8_t* bitmap) {
+    UNUSED(canvas);
+    UNUSED(x);
+    UNUSED(y);
+    furi_check(bitmap || w == 0 || h == 0);
+}
+
+/* notification */
+
+const NotificationMessage message_display_backlight_on = {
+    .type = NotificationMessageTypeLedDisplayBacklight,
+    .data.led.value = 0xFF,
+};
+const NotificationMessage message_display_backlight_off = {
+    .type = NotificationMessageTypeLedDisplayBacklight,
+    .data.led.value = 0x00,
+};
+const NotificationMessage message_display_backlight_enforce_on = {
+    .type = NotificationMessageTypeLedDisplayBacklightEnforceOn,
+    .data.led.value = 0xFF,
+};
+const NotificationMessage message_display_backlight_enforce_auto = {
+    .type = NotificationMessageTypeLedDisplayBacklightEnforceAuto,
+    .data.led.value = 0x00,
+};
+const NotificationMessage message_green_255 = {
+    .type = NotificationMessageTypeLedGreen,
+    .data.led.value = 0xFF,
+};
+const NotificationMessage message_delay_10 = {
+    .type = NotificationMessageTypeDelay,
+    .data.delay.length = 10,
+};
+const NotificationMessage message_do_not_reset = {
+    .type = NotificationMessageTypeDoNotReset,
+};
+
+const NotificationSequence sequence_display_backlight_on = {&message_display_backlight_on, NULL};
+const NotificationSequence sequence_display_backlight_off = {&message_display_backlight_off, NULL};
+const NotificationSequence sequence_display_backlight_enforce_on = {
+    &message_display_backlight_enforce_on,
+    NULL,
+};
+const NotificationSequence sequence_display_backlight_enforce_auto = {
+    &message_display_backlight_enforce_auto,
+    NULL,
+};
+
+void notification_message(NotificationApp* app, const NotificationSequence* sequence) {
+    UNUSED(app);
+    UNUSED(sequence);
+}
+
+void notification_message_block(NotificationApp* app, const NotificationSequence* sequence) {
+    UNUSED(app);
+    UNUSED(sequence);
+}
+
+/* icons, only their identity matters on the host */
+
+const Icon I_angry_flipagotchi = {48, 23};
+const Icon I_awake_flipagotchi = {48, 23};
+const Icon I_bored_flipagotchi = {48, 23};
+const Icon I_broken_flipagotchi = {48, 23};
+const Icon I_cool_flipagotchi = {48, 23};
+const Icon I_debug_flipagotchi = {48, 23};
+const Icon I_demotivated_flipagotchi = {48, 23};
+const Icon I_excited_flipagotchi = {48, 23};
+const Icon I_friend_flipagotchi = {48, 23};
+const Icon I_grateful_flipagotchi = {48, 23};
+const Icon I_happy_flipagotchi = {48, 23};
+const Icon I_intense_flipagotchi = {48, 23};
+const Icon I_lonely_flipagotchi = {48, 23};
+const Icon I_look_l_flipagotchi = {48, 23};
+const Icon I_look_l_happy_flipagotchi = {48, 23};
+const Icon I_look_r_flipagotchi = {48, 23};
+const Icon I_look_r_happy_flipagotchi = {48, 23};
+const Icon I_motivated_flipagotchi = {48, 23};
+const Icon I_sad_flipagotchi = {48, 23};
+const Icon I_sleep2_flipagotchi = {48, 23};
+const Icon I_sleep_flipagotchi = {48, 23};
+const Icon I_smart_flipagotchi = {48, 23};
+const Icon I_upload1_flipagotchi = {48, 23};
+const Icon I_upload2_flipagotchi = {48, 23};
+const Icon I_upload_flipagotchi = {48, 23};
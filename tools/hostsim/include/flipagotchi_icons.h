@@ -0,0 +1,29 @@
+#pragma once
+
+#include <gui/canvas.h>
+
+extern const Icon I_angry_flipagotchi;
+extern const Icon I_awake_flipagotchi;
+extern const Icon I_bored_flipagotchi;
+extern const Icon I_broken_flipagotchi;
+extern const Icon I_cool_flipagotchi;
+extern const Icon I_debug_flipagotchi;
+extern const Icon I_demotivated_flipagotchi;
+extern const Icon I_excited_flipagotchi;
+extern const Icon I_friend_flipagotchi;
+extern const Icon I_grateful_flipagotchi;
+extern const Icon I_happy_flipagotchi;
+extern const Icon I_intense_flipagotchi;
+extern const Icon I_lonely_flipagotchi;
+extern const Icon I_look_l_flipagotchi;
+extern const Icon I_look_l_happy_flipagotchi;
+extern const Icon I_look_r_flipagotchi;
+extern const Icon I_look_r_happy_flipagotchi;
+extern const Icon I_motivated_flipagotchi;
+extern const Icon I_sad_flipagotchi;
+extern const Icon I_sleep2_flipagotchi;
+extern const Icon I_sleep_flipagotchi;
+extern const Icon I_smart_flipagotchi;
+extern const Icon I_upload1_flipagotchi;
+extern const Icon I_upload2_flipagotchi;
+extern const Icon I_upload_flipagotchi;
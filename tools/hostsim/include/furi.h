@@ -0,0 +1,195 @@
+#pragma once
+
+/*
+ * Host stand-in for the parts of the furi API the flipagotchi app uses.
+ * Only enough is implemented to run the protocol and dispatch code on linux,
+ * everything is backed by pthreads in hostsim.c
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UNUSED(x) (void)(x)
+#define COUNT_OF(x) (sizeof(x) / sizeof(x[0]))
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+#define CLAMP(x, upper, lower) (MIN(upper, MAX(x, lower)))
+
+#define FuriWaitForever 0xFFFFFFFFU
+
+typedef enum {
+    FuriStatusOk = 0,
+    FuriStatusError = -1,
+    FuriStatusErrorTimeout = -2,
+    FuriStatusErrorResource = -3,
+    FuriStatusErrorParameter = -4,
+} FuriStatus;
+
+typedef enum {
+    FuriFlagWaitAny = 0x00000000U,
+    FuriFlagWaitAll = 0x00000001U,
+    FuriFlagNoClear = 0x00000002U,
+    FuriFlagError = 0x80000000U,
+    FuriFlagErrorUnknown = 0xFFFFFFFFU,
+    FuriFlagErrorTimeout = 0xFFFFFFFEU,
+    FuriFlagErrorResource = 0xFFFFFFFDU,
+    FuriFlagErrorParameter = 0xFFFFFFFCU,
+    FuriFlagErrorISR = 0xFFFFFFFAU,
+} FuriFlag;
+
+// no format checking, the app uses %lu for uint32_t which is correct on the target
+void hostsim_log(char level, const char* tag, const char* fmt, ...);
+
+#define FURI_LOG_E(tag, ...) hostsim_log('E', tag, __VA_ARGS__)
+#define FURI_LOG_W(tag, ...) hostsim_log('W', tag, __VA_ARGS__)
+#define FURI_LOG_I(tag, ...) hostsim_log('I', tag, __VA_ARGS__)
+#define FURI_LOG_D(tag, ...) hostsim_log('D', tag, __VA_ARGS__)
+#define FURI_LOG_T(tag, ...) hostsim_log('T', tag, __VA_ARGS__)
+
+void hostsim_crash(const char* msg, const char* file, int line) __attribute__((noreturn));
+
+#define furi_check(x) \
+    do { \
+        if(!(x)) hostsim_crash("furi_check failed: " #x, __FILE__, __LINE__); \
+    } while(0)
+#define furi_assert(x) furi_check(x)
+#define furi_crash(msg) hostsim_crash(msg, __FILE__, __LINE__)
+
+size_t strlcpy(char* dst, const char* src, size_t size);
+size_t strlcat(char* dst, const char* src, size_t size);
+
+/* kernel */
+uint32_t furi_get_tick(void);
+uint32_t furi_kernel_get_tick_frequency(void);
+uint32_t furi_ms_to_ticks(uint32_t milliseconds);
+void furi_delay_ms(uint32_t milliseconds);
+void furi_delay_tick(uint32_t ticks);
+
+/* records */
+void* furi_record_open(const char* name);
+void furi_record_close(const char* name);
+
+/* threads */
+typedef struct FuriThread FuriThread;
+typedef void* FuriThreadId;
+typedef int32_t (*FuriThreadCallback)(void* context);
+
+FuriThread* furi_thread_alloc(void);
+FuriThread* furi_thread_alloc_ex(
+    const char* name,
+    uint32_t stack_size,
+    FuriThreadCallback callback,
+    void* context);
+void furi_thread_free(FuriThread* thread);
+void furi_thread_set_name(FuriThread* thread, const char* name);
+void furi_thread_set_stack_size(FuriThread* thread, size_t stack_size);
+void furi_thread_set_context(FuriThread* thread, void* context);
+void furi_thread_set_callback(FuriThread* thread, FuriThreadCallback callback);
+void furi_thread_start(FuriThread* thread);
+bool furi_thread_join(FuriThread* thread);
+FuriThreadId furi_thread_get_id(FuriThread* thread);
+FuriThreadId furi_thread_get_current_id(void);
+uint32_t furi_thread_get_stack_space(FuriThreadId thread_id);
+uint32_t furi_thread_flags_set(FuriThreadId thread_id, uint32_t flags);
+uint32_t furi_thread_flags_clear(uint32_t flags);
+uint32_t furi_thread_flags_wait(uint32_t flags, uint32_t options, uint32_t timeout);
+
+/* mutex */
+typedef enum {
+    FuriMutexTypeNormal,
+    FuriMutexTypeRecursive,
+} FuriMutexType;
+typedef struct FuriMutex FuriMutex;
+
+FuriMutex* furi_mutex_alloc(FuriMutexType type);
+void furi_mutex_free(FuriMutex* instance);
+FuriStatus furi_mutex_acquire(FuriMutex* instance, uint32_t timeout);
+FuriStatus furi_mutex_release(FuriMutex* instance);
+
+/* semaphore */
+typedef struct FuriSemaphore FuriSemaphore;
+
+FuriSemaphore* furi_semaphore_alloc(uint32_t max_count, uint32_t initial_count);
+void furi_semaphore_free(FuriSemaphore* instance);
+FuriStatus furi_semaphore_acquire(FuriSemaphore* instance, uint32_t timeout);
+FuriStatus furi_semaphore_release(FuriSemaphore* instance);
+
+/* stream buffer */
+typedef struct FuriStreamBuffer FuriStreamBuffer;
+
+FuriStreamBuffer* furi_stream_buffer_alloc(size_t size, size_t trigger_level);
+void furi_stream_buffer_free(FuriStreamBuffer* stream_buffer);
+size_t furi_stream_buffer_send(
+    FuriStreamBuffer* stream_buffer,
+    const void* data,
+    size_t length,
+    uint32_t timeout);
+size_t furi_stream_buffer_receive(
+    FuriStreamBuffer* stream_buffer,
+    void* data,
+    size_t length,
+    uint32_t timeout);
+size_t furi_stream_buffer_bytes_available(FuriStreamBuffer* stream_buffer);
+size_t furi_stream_buffer_spaces_available(FuriStreamBuffer* stream_buffer);
+bool furi_stream_buffer_is_empty(FuriStreamBuffer* stream_buffer);
+FuriStatus furi_stream_buffer_reset(FuriStreamBuffer* stream_buffer);
+
+/* message queue */
+typedef struct FuriMessageQueue FuriMessageQueue;
+
+FuriMessageQueue* furi_message_queue_alloc(uint32_t msg_count, uint32_t msg_size);
+void furi_message_queue_free(FuriMessageQueue* instance);
+FuriStatus furi_message_queue_put(FuriMessageQueue* instance, const void* msg_ptr, uint32_t timeout);
+FuriStatus furi_message_queue_get(FuriMessageQueue* instance, void* msg_ptr, uint32_t timeout);
+uint32_t furi_message_queue_get_count(FuriMessageQueue* instance);
+uint32_t furi_message_queue_get_space(FuriMessageQueue* instance);
+FuriStatus furi_message_queue_reset(FuriMessageQueue* instance);
+
+/* timers */
+typedef void (*FuriTimerCallback)(void* context);
+typedef enum {
+    FuriTimerTypeOnce = 0,
+    FuriTimerTypePeriodic = 1,
+} FuriTimerType;
+typedef struct FuriTimer FuriTimer;
+
+FuriTimer* furi_timer_alloc(FuriTimerCallback func, FuriTimerType type, void* context);
+void furi_timer_free(FuriTimer* instance);
+FuriStatus furi_timer_start(FuriTimer* instance, uint32_t ticks);
+FuriStatus furi_timer_stop(FuriTimer* instance);
+uint32_t furi_timer_is_running(FuriTimer* instance);
+
+/* memmgr */
+size_t memmgr_get_free_heap(void);
+size_t memmgr_get_minimum_free_heap(void);
+
+/* critical sections, one process wide lock on the host */
+void hostsim_critical_enter(void);
+void hostsim_critical_exit(void);
+#define FURI_CRITICAL_ENTER() hostsim_critical_enter()
+#define FURI_CRITICAL_EXIT() hostsim_critical_exit()
+
+/* strings */
+typedef struct FuriString FuriString;
+
+FuriString* furi_string_alloc(void);
+FuriString* furi_string_alloc_printf(const char* format, ...);
+void furi_string_free(FuriString* string);
+void furi_string_reset(FuriString* string);
+int furi_string_printf(FuriString* string, const char* format, ...);
+int furi_string_cat_printf(FuriString* string, const char* format, ...);
+void furi_string_cat_str(FuriString* string, const char* str);
+const char* furi_string_get_cstr(const FuriString* string);
+size_t furi_string_size(const FuriString* string);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <furi.h>
+#include <furi_hal_uart.h>
+#include <furi_hal_console.h>
+#include <furi_hal_usb.h>
+#include <furi_hal_usb_cdc.h>
+
+#include <furi_hal_random.h>
+#include <furi_hal_rtc.h>
+#include <furi_hal_power.h>
@@ -0,0 +1,4 @@
+#pragma once
+
+void furi_hal_console_enable(void);
+void furi_hal_console_disable(void);
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <furi.h>
+
+typedef enum {
+    FuriHalPowerICCharger,
+    FuriHalPowerICFuelGauge,
+} FuriHalPowerIC;
+
+float furi_hal_power_get_battery_current(FuriHalPowerIC ic);
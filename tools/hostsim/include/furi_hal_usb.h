@@ -0,0 +1,18 @@
+#pragma once
+
+#include <furi.h>
+
+/*
+ * Only the usb configs are told apart on the host, both end up on the pty
+ */
+typedef struct {
+    const char* name;
+} FuriHalUsbInterface;
+
+extern FuriHalUsbInterface usb_cdc_single;
+extern FuriHalUsbInterface usb_cdc_dual;
+
+FuriHalUsbInterface* furi_hal_usb_get_config(void);
+bool furi_hal_usb_set_config(FuriHalUsbInterface* new_if, void* ctx);
+void furi_hal_usb_lock(void);
+void furi_hal_usb_unlock(void);
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <furi.h>
+
+#define CDC_DATA_SZ 64
+
+typedef enum {
+    CdcStateDisconnected,
+    CdcStateConnected,
+} CdcState;
+
+struct usb_cdc_line_coding;
+
+typedef struct {
+    void (*tx_ep_callback)(void* context);
+    void (*rx_ep_callback)(void* context);
+    void (*state_callback)(void* context, uint8_t state);
+    void (*ctrl_line_callback)(void* context, uint8_t state);
+    void (*config_callback)(void* context, struct usb_cdc_line_coding* config);
+} CdcCallbacks;
+
+void furi_hal_cdc_set_callbacks(uint8_t if_num, CdcCallbacks* cb, void* context);
+void furi_hal_cdc_send(uint8_t if_num, uint8_t* buf, uint16_t len);
+int32_t furi_hal_cdc_receive(uint8_t if_num, uint8_t* buf, uint16_t max_len);
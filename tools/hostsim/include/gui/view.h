@@ -0,0 +1,43 @@
+#pragma once
+
+#include <furi.h>
+#include <gui/canvas.h>
+#include <input/input.h>
+
+#define VIEW_NONE 0xFFFFFFFF
+#define VIEW_IGNORE 0xFFFFFFFE
+
+typedef enum {
+    ViewModelTypeNone,
+    ViewModelTypeLockFree,
+    ViewModelTypeLocking,
+} ViewModelType;
+
+typedef struct View View;
+
+typedef void (*ViewDrawCallback)(Canvas* canvas, void* model);
+typedef bool (*ViewInputCallback)(InputEvent* event, void* context);
+typedef bool (*ViewCustomCallback)(uint32_t event, void* context);
+typedef uint32_t (*ViewNavigationCallback)(void* context);
+typedef void (*ViewCallback)(void* context);
+
+View* view_alloc(void);
+void view_free(View* view);
+void view_set_context(View* view, void* context);
+void view_set_draw_callback(View* view, ViewDrawCallback callback);
+void view_set_input_callback(View* view, ViewInputCallback callback);
+void view_set_custom_callback(View* view, ViewCustomCallback callback);
+void view_set_previous_callback(View* view, ViewNavigationCallback callback);
+void view_set_enter_callback(View* view, ViewCallback callback);
+void view_set_exit_callback(View* view, ViewCallback callback);
+void view_allocate_model(View* view, ViewModelType type, size_t size);
+void view_free_model(View* view);
+void* view_get_model(View* view);
+void view_commit_model(View* view, bool update);
+
+#define with_view_model(view, type, code, update) \
+    {                                             \
+        type = view_get_model(view);              \
+        {code};                                   \
+        view_commit_model(view, update);          \
+    }
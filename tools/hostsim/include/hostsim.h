@@ -0,0 +1,79 @@
+#pragma once
+
+/*
+ * Host only controls for the simulated hardware, not part of the furi API
+ */
+
+#include <furi.h>
+#include <furi_hal_uart.h>
+#include <gui/view.h>
+
+/**
+ * Use an already open file descriptor (one end of a pty pair) as the uart wire, usb's second cdc
+ * interface ends up on it too
+ *
+ * @param fd File descriptor to read and write
+ */
+void hostsim_uart_set_fd(int fd);
+
+/**
+ * Give one uart a wire of its own instead of the shared one, for a second unit
+ *
+ * @param channel Uart that reads and writes fd from now on
+ * @param fd File descriptor to read and write
+ */
+void hostsim_uart_set_channel_fd(FuriHalUartId channel, int fd);
+
+/**
+ * Get the file descriptor the uarts and usb share, -1 if there is none
+ */
+int hostsim_uart_get_fd(void);
+
+/**
+ * Pace bytes in both directions as if they went over a real uart at this baud
+ *
+ * @param baud Emulated baudrate, 0 to deliver bytes as fast as the pty allows
+ */
+void hostsim_uart_set_emulated_baud(uint32_t baud);
+
+/**
+ * Corrupt bytes on the wire
+ *
+ * @param probability Chance per byte, in either direction, that one random bit gets flipped
+ * @param seed Seed for the noise generator so runs are repeatable
+ */
+void hostsim_uart_set_noise(double probability, uint32_t seed);
+
+/**
+ * Get the number of bytes that were corrupted on the wire so far
+ */
+uint32_t hostsim_uart_get_corrupted(void);
+
+typedef void (*HostsimDrawHook)(View* view, void* model, void* context);
+
+/**
+ * Called every time a view model is committed with update set, right after its draw callback
+ * ran, which is the point the flipper would push new pixels to the screen
+ */
+void hostsim_set_draw_hook(HostsimDrawHook hook, void* context);
+
+/**
+ * Monotonic clock in nanoseconds, the same clock python's time.monotonic_ns reads
+ */
+uint64_t hostsim_monotonic_ns(void);
+
+/**
+ * Move the tick forward without waiting, for what only shows after hours. Timers still run on the
+ * monotonic clock
+ *
+ * @param ms Milliseconds to add to furi_get_tick from now on
+ */
+void hostsim_tick_skip(uint32_t ms);
+
+/**
+ * Run the rtc off the monotonic clock instead of the host's wall clock
+ *
+ * @param offset_ms Milliseconds the rtc is ahead of the monotonic clock
+ * @param drift_ppm How much faster than the monotonic clock it runs, in parts per million
+ */
+void hostsim_rtc_set(int64_t offset_ms, double drift_ppm);
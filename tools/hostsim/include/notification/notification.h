@@ -0,0 +1,51 @@
+#pragma once
+
+#include <furi.h>
+
+#define RECORD_NOTIFICATION "notification"
+
+typedef enum {
+    NotificationMessageTypeVibro,
+    NotificationMessageTypeSoundOn,
+    NotificationMessageTypeSoundOff,
+    NotificationMessageTypeLedRed,
+    NotificationMessageTypeLedGreen,
+    NotificationMessageTypeLedBlue,
+    NotificationMessageTypeLedDisplayBacklight,
+    NotificationMessageTypeLedDisplayBacklightEnforceOn,
+    NotificationMessageTypeLedDisplayBacklightEnforceAuto,
+    NotificationMessageTypeDelay,
+    NotificationMessageTypeDoNotReset,
+    NotificationMessageTypeForceSpeakerVolumeSetting,
+    NotificationMessageTypeForceVibroSetting,
+    NotificationMessageTypeForceDisplayBrightnessSetting,
+} NotificationMessageType;
+
+typedef struct {
+    uint8_t value;
+} NotificationMessageDataLed;
+
+typedef struct {
+    uint32_t length;
+} NotificationMessageDataDelay;
+
+typedef struct {
+    float display_brightness_setting;
+} NotificationMessageDataForcedSettings;
+
+typedef union {
+    NotificationMessageDataLed led;
+    NotificationMessageDataDelay delay;
+    NotificationMessageDataForcedSettings forced_settings;
+} NotificationMessageData;
+
+typedef struct {
+    NotificationMessageType type;
+    NotificationMessageData data;
+} NotificationMessage;
+
+typedef const NotificationMessage* NotificationSequence[];
+typedef struct NotificationApp NotificationApp;
+
+void notification_message(NotificationApp* app, const NotificationSequence* sequence);
+void notification_message_block(NotificationApp* app, const NotificationSequence* sequence);
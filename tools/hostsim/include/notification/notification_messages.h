@@ -0,0 +1,16 @@
+#pragma once
+
+#include "notification.h"
+
+extern const NotificationMessage message_display_backlight_on;
+extern const NotificationMessage message_display_backlight_off;
+extern const NotificationMessage message_display_backlight_enforce_on;
+extern const NotificationMessage message_display_backlight_enforce_auto;
+extern const NotificationMessage message_green_255;
+extern const NotificationMessage message_delay_10;
+extern const NotificationMessage message_do_not_reset;
+
+extern const NotificationSequence sequence_display_backlight_on;
+extern const NotificationSequence sequence_display_backlight_off;
+extern const NotificationSequence sequence_display_backlight_enforce_on;
+extern const NotificationSequence sequence_display_backlight_enforce_auto;
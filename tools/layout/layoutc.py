@@ -0,0 +1,152 @@
+"""
+Compiles a screen layout for the flipagotchi app into the layout.bin it reads from the SD card
+
+A layout is json, a list of entries drawn in order:
+
+  {"kind": "uptime", "rect": [77, 1, 51, 7], "font": "secondary", "align": "start end", "text": "UP"}
+
+rect is x, y, width and height on the flipper's 128x64 screen. Text entries are aligned in their
+rect, "horizontal vertical" each of start, center or end, and their text is drawn around the field
+with % marking where the field goes (in front of it without one). Lines run from the top left to
+the bottom right of their rect. Every entry has to be on screen and no two entries may overlap,
+unless one of them sets "overlap": true.
+
+See flipagotchi/flipagotchi_layout.h for the file format
+"""
+import argparse
+import itertools
+import json
+import sys
+
+SCREEN_WIDTH = 128
+SCREEN_HEIGHT = 64
+
+# PwnagotchiLayoutKind
+KINDS = ['face', 'name', 'channel', 'aps', 'uptime', 'mode', 'handshakes', 'status', 'line', 'friend']
+# Font
+FONTS = ['primary', 'secondary', 'keyboard', 'big_numbers']
+# PwnagotchiLayoutAlign
+ALIGNS = ['start', 'center', 'end']
+
+# kinds that draw their text around the field, the rest ignore it
+TEXT_KINDS = {'name', 'channel', 'aps', 'uptime', 'handshakes', 'friend'}
+# the face icons are drawn from the top left of the rect at their own size
+FACE_SIZE = (60, 14)
+
+MAGIC = b'PWNL'
+VERSION = 1
+MAX_ENTRIES = 16
+# PWNAGOTCHI_LAYOUT_TEXT_LEN, the terminator included
+TEXT_LEN = 8
+FIELD_MARK = '%'
+
+
+class LayoutError(Exception):
+    pass
+
+
+def check_entry(index, entry):
+    """
+    :return: (kind, x, y, width, height, font, align, text) of a valid entry
+    """
+    where = f"entry {index}"
+    kind = entry.get('kind')
+    if kind not in KINDS:
+        raise LayoutError(f"{where}: unknown kind {kind!r}, expected one of {', '.join(KINDS)}")
+    where = f"entry {index} ({kind})"
+
+    rect = entry.get('rect')
+    if not isinstance(rect, list) or len(rect) != 4 or not all(isinstance(n, int) and n >= 0 for n in rect):
+        raise LayoutError(f"{where}: rect must be [x, y, width, height] of non negative integers")
+    x, y, width, height = rect
+    if width == 0 or height == 0:
+        raise LayoutError(f"{where}: rect is empty")
+    if x + width > SCREEN_WIDTH or y + height > SCREEN_HEIGHT:
+        raise LayoutError(f"{where}: rect {rect} runs off the {SCREEN_WIDTH}x{SCREEN_HEIGHT} screen")
+    if kind == 'face' and (width < FACE_SIZE[0] or height < FACE_SIZE[1]):
+        raise LayoutError(f"{where}: rect {rect} is smaller than the {FACE_SIZE[0]}x{FACE_SIZE[1]} face")
+
+    font = entry.get('font', 'secondary')
+    if font not in FONTS:
+        raise LayoutError(f"{where}: unknown font {font!r}, expected one of {', '.join(FONTS)}")
+
+    align = entry.get('align', 'start start').split()
+    if len(align) != 2 or any(a not in ALIGNS for a in align):
+        raise LayoutError(f"{where}: align must be \"horizontal vertical\", each of {', '.join(ALIGNS)}")
+
+    text = entry.get('text', '')
+    if text and kind not in TEXT_KINDS:
+        raise LayoutError(f"{where}: only {', '.join(sorted(TEXT_KINDS))} draw text")
+    if len(text) > TEXT_LEN - 1 or not all(' ' <= c <= '~' for c in text):
+        raise LayoutError(f"{where}: text must be at most {TEXT_LEN - 1} printable ascii characters")
+    if text.count(FIELD_MARK) > 1:
+        raise LayoutError(f"{where}: text can only mark the field once")
+
+    return kind, x, y, width, height, font, align, text
+
+
+def overlaps(a, b):
+    ax, ay, aw, ah = a
+    bx, by, bw, bh = b
+    return ax < bx + bw and bx < ax + aw and ay < by + bh and by < ay + ah
+
+
+def compile_layout(layout):
+    """
+    :param: layout: List of entries as loaded from json
+    :return: (layout.bin contents, list of warnings)
+    """
+    if not isinstance(layout, list) or not layout:
+        raise LayoutError("a layout is a non empty list of entries")
+    if len(layout) > MAX_ENTRIES:
+        raise LayoutError(f"{len(layout)} entries, the flipper holds at most {MAX_ENTRIES}")
+
+    entries = [check_entry(index, entry) for index, entry in enumerate(layout)]
+
+    for (i, a), (j, b) in itertools.combinations(enumerate(entries), 2):
+        if layout[i].get('overlap') or layout[j].get('overlap'):
+            continue
+        if overlaps(a[1:5], b[1:5]):
+            raise LayoutError(f"entry {i} ({a[0]}) {list(a[1:5])} overlaps entry {j} ({b[0]}) {list(b[1:5])}")
+
+    warnings = []
+    shown = {entry[0] for entry in entries}
+    for kind in KINDS:
+        if kind != 'line' and kind not in shown:
+            warnings.append(f"{kind} is not shown")
+
+    out = bytearray(MAGIC) + bytes([VERSION, len(entries)])
+    for kind, x, y, width, height, font, align, text in entries:
+        out += bytes([
+            KINDS.index(kind), x, y, width, height, FONTS.index(font),
+            ALIGNS.index(align[0]) | ALIGNS.index(align[1]) << 4,
+        ])
+        out += text.encode('ascii').ljust(TEXT_LEN, b'\0')
+    return bytes(out), warnings
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("layout", help="layout json")
+    parser.add_argument("-o", "--output", default="layout.bin", help="where to write the compiled layout")
+    parser.add_argument("--check", action="store_true", help="only validate, don't write anything")
+    args = parser.parse_args()
+
+    try:
+        with open(args.layout) as f:
+            layout = json.load(f)
+        compiled, warnings = compile_layout(layout)
+    except (OSError, ValueError, LayoutError) as e:
+        print(f"{args.layout}: {e}", file=sys.stderr)
+        sys.exit(1)
+
+    for warning in warnings:
+        print(f"{args.layout}: warning: {warning}", file=sys.stderr)
+    if not args.check:
+        with open(args.output, 'wb') as f:
+            f.write(compiled)
+        print(f"{args.output}: {len(layout)} entries, {len(compiled)} bytes")
+
+
+if __name__ == "__main__":
+    main()